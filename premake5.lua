@@ -1,3 +1,9 @@
+-- Same default as the CG_GL_COUNTERS option in CMake.
+newoption {
+    trigger = "gl-counters",
+    description = "Count GL calls, state changes and uploads per frame"
+}
+
 workspace "ComputerGraphics"
     configurations { "Debug", "Release" }
     startproject "CG"
@@ -13,6 +19,9 @@ workspace "ComputerGraphics"
         optimize "Speed"
         flags { "LinkTimeOptimization" }
 
+    filter "options:gl-counters"
+        defines { "CG_GL_COUNTERS_ENABLED" }
+
 project "CG"
     kind "ConsoleApp"
     language "C++"
@@ -37,6 +46,31 @@ project "CG"
     filter "system:windows"
         defines { "_WINDOWS" }
 
+-- Headless benchmark. Shares everything but main.cpp and the UI with "CG".
+project "cg_bench"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+	architecture "x86_64"
+
+    targetdir "bin/%{cfg.buildcfg}"
+    objdir "obj/%{cfg.buildcfg}/cg_bench"
+
+    includedirs { "dependencies/GLAD/include/", "dependencies/GLFW/include", "dependencies/GLM/", "src" }
+
+    files { "src/*.cpp", "src/vendor/*.cpp ", "src/bench/*.cpp", "src/*.h", "src/bench/*.h" }
+    removefiles { "src/main.cpp", "src/ui.cpp" }
+
+    links { "GLFW", "GLM", "GLAD" }
+
+    filter "system:linux"
+        links { "dl", "pthread" }
+
+        defines { "_X11" }
+
+    filter "system:windows"
+        defines { "_WINDOWS" }
+
 include "dependencies/glfw.lua"
 include "dependencies/glad.lua"
 include "dependencies/glm.lua"
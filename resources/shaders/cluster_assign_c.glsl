@@ -0,0 +1,123 @@
+#version 460 core
+
+/*
+ * One work group per cluster of the 16 x 9 x 24 froxel grid. Every light
+ * whose sphere touches the cluster's view space box goes into its list;
+ * lists are packed back to back by reserving their range with one atomic.
+ */
+layout(local_size_x = 64) in;
+
+const uvec3 grid = uvec3(16u, 9u, 24u);        /* clustered.h */
+const uint group_size = 64u;
+const uint max_lights_per_cluster = 255u;
+const uint max_cluster_light_indices = 1048576u;
+
+struct PointLight
+{
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+/* Offset and count of every cluster's list. */
+layout(std430, binding = 1) writeonly buffer ClusterGrid
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 2) writeonly buffer LightIndices
+{
+    uint light_indices[];
+};
+
+layout(std430, binding = 3) buffer ClusterCounters
+{
+    uint light_cluster_pairs;
+    uint max_cluster_lights;
+    uint overflowed_clusters;
+};
+
+uniform mat4 u_view;
+uniform mat4 u_inverse_projection;
+uniform vec2 u_depth_range; /* z_near, z_far */
+uniform int u_light_count;
+
+shared uint s_count;
+shared uint s_offset;
+shared uint s_kept;
+shared uint s_indices[max_lights_per_cluster];
+
+/* Through a point of the near plane, scaled to a view depth of 1. */
+vec3 view_ray(vec2 ndc)
+{
+    vec4 point = u_inverse_projection * vec4(ndc, -1.0, 1.0);
+    vec3 position = point.xyz / point.w;
+    return position / -position.z;
+}
+
+float slice_depth(uint slice)
+{
+    return u_depth_range.x * pow(u_depth_range.y / u_depth_range.x, float(slice) / float(grid.z));
+}
+
+void main()
+{
+    uvec3 cluster = gl_WorkGroupID;
+    uint index = (cluster.z * grid.y + cluster.y) * grid.x + cluster.x;
+    if (gl_LocalInvocationIndex == 0u)
+        s_count = 0u;
+    barrier();
+
+    float start = slice_depth(cluster.z);
+    float end = slice_depth(cluster.z + 1u);
+    vec2 ndc_min = vec2(cluster.xy) / vec2(grid.xy) * 2.0 - 1.0;
+    vec2 ndc_max = vec2(cluster.xy + 1u) / vec2(grid.xy) * 2.0 - 1.0;
+    vec3 rays[4] = vec3[4](view_ray(ndc_min),
+                           view_ray(vec2(ndc_max.x, ndc_min.y)),
+                           view_ray(vec2(ndc_min.x, ndc_max.y)),
+                           view_ray(ndc_max));
+    vec3 box_min = rays[0] * start;
+    vec3 box_max = box_min;
+    for (int i = 0; i < 4; i++)
+    {
+        box_min = min(box_min, min(rays[i] * start, rays[i] * end));
+        box_max = max(box_max, max(rays[i] * start, rays[i] * end));
+    }
+
+    for (uint i = gl_LocalInvocationIndex; i < uint(u_light_count); i += group_size)
+    {
+        vec4 position_radius = lights[i].position_radius;
+        vec3 center = vec3(u_view * vec4(position_radius.xyz, 1.0));
+        vec3 distance = max(max(box_min - center, center - box_max), 0.0);
+        if (dot(distance, distance) > position_radius.w * position_radius.w)
+            continue;
+
+        uint slot = atomicAdd(s_count, 1u);
+        if (slot < max_lights_per_cluster)
+            s_indices[slot] = i;
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        uint kept = min(s_count, max_lights_per_cluster);
+        uint offset = atomicAdd(light_cluster_pairs, kept);
+        if (offset + kept > max_cluster_light_indices)
+            kept = 0u;
+        if (kept < s_count)
+            atomicAdd(overflowed_clusters, 1u);
+        atomicMax(max_cluster_lights, s_count);
+
+        clusters[index] = uvec2(offset, kept);
+        s_offset = offset;
+        s_kept = kept;
+    }
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < s_kept; i += group_size)
+        light_indices[s_offset + i] = s_indices[i];
+}
@@ -0,0 +1,90 @@
+#version 460 core
+
+/*
+ * Lights every pixel of the G-buffer with the lights of its tile, as
+ * light_cull_c.glsl listed them.
+ */
+const uint tile_size = 16u;     /* light_tile_size */
+const uint tile_stride = 256u;  /* max_lights_per_tile + 1 */
+
+struct PointLight
+{
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+/* Per tile, a count and then the indices. */
+layout(std430, binding = 1) readonly buffer TileLights
+{
+    uint tile_lights[];
+};
+
+layout(binding = 0) uniform sampler2D u_albedo_specular;
+layout(binding = 1) uniform sampler2D u_normal;
+layout(binding = 2) uniform sampler2D u_depth;
+
+uniform mat4 u_inverse_view_projection;
+uniform vec3 u_view_pos;
+uniform ivec2 u_origin; /* Of the viewport. */
+uniform ivec2 u_size;
+uniform int u_tiles_x;
+
+out vec4 o_color;
+
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+/* Diffuse and specular of one light, fading out towards its radius. */
+vec3 point_light(PointLight light, vec3 pos, vec3 norm, vec3 view_dir, float specular_strength)
+{
+    vec3 to_light = light.position_radius.xyz - pos;
+    float distance = length(to_light);
+    float falloff = clamp(1.0 - distance / light.position_radius.w, 0.0, 1.0);
+    if (falloff == 0.0)
+        return vec3(0.0);
+
+    vec3 light_dir = to_light / distance;
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    return (diff + specular_strength * spec) * falloff * falloff * light.color.rgb;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) - u_origin;
+    float depth = texelFetch(u_depth, pixel, 0).r;
+    if (depth == 1.0)
+        discard;
+    gl_FragDepth = depth;
+
+    vec4 albedo_specular = texelFetch(u_albedo_specular, pixel, 0);
+    vec3 norm = decode_octahedral(texelFetch(u_normal, pixel, 0).xy);
+    vec4 clip = vec4((vec2(pixel) + 0.5) / vec2(u_size) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = u_inverse_view_projection * clip;
+    vec3 pos = world.xyz / world.w;
+    vec3 view_dir = normalize(u_view_pos - pos);
+
+    /* Ambient */
+    float ambient_strength = 0.1;
+    vec3 light = vec3(ambient_strength);
+
+    uvec2 tile = uvec2(pixel) / tile_size;
+    uint base = (tile.y * uint(u_tiles_x) + tile.x) * tile_stride;
+    uint count = tile_lights[base];
+    for (uint i = 0u; i < count; i++)
+        light += point_light(lights[tile_lights[base + 1u + i]], pos, norm, view_dir, albedo_specular.a);
+
+    o_color = vec4(light * albedo_specular.rgb, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 460 core
+
+/*
+ * One triangle over the whole viewport, without vertex data.
+ */
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
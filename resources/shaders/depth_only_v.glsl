@@ -0,0 +1,20 @@
+#version 460 core
+
+/*
+ * Position only, for the depth pre-pass. gl_Position is computed exactly
+ * as in tex_v.glsl, phong_v.glsl and phong_shadow_v.glsl, and all of them
+ * declare it invariant, so the shading pass can test with GL_EQUAL.
+ */
+layout(location = 0) in vec3 i_pos;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 pos = vec3(u_model * vec4(i_pos, 1.0f));
+    gl_Position = u_projection * (u_view * vec4(pos, 1.0f));
+}
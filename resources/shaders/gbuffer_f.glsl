@@ -0,0 +1,33 @@
+#version 460 core
+
+in vec2 v_tex_coord;
+in vec3 v_pos;
+in vec3 v_normal;
+
+uniform sampler2D tex;
+
+layout(location = 0) out vec4 o_albedo_specular;
+layout(location = 1) out vec2 o_normal;
+
+/*
+ * Unit vector to the octahedron folded onto the [-1, 1] square.
+ */
+vec2 encode_octahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0)
+    {
+        vec2 sign_xy = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        return (1.0 - abs(n.yx)) * sign_xy;
+    }
+    return n.xy;
+}
+
+void main()
+{
+    /* The one material: phong_f.glsl's specular strength. */
+    float specular_strength = 0.5;
+    vec4 tex_color = texture(tex, v_tex_coord);
+    o_albedo_specular = vec4(tex_color.rgb, specular_strength);
+    o_normal = encode_octahedral(normalize(v_normal));
+}
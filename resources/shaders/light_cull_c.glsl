@@ -0,0 +1,137 @@
+#version 460 core
+
+/*
+ * One work group per 16 x 16 pixel tile. The tile's depth range and its
+ * four side planes bound a small frustum; every light whose sphere
+ * touches it goes into the tile's list.
+ */
+layout(local_size_x = 16, local_size_y = 16) in;
+
+const uint group_size = 256u;
+const uint max_lights_per_tile = 255u; /* deferred.h */
+
+struct PointLight
+{
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+/* Per tile, a count and then max_lights_per_tile indices. */
+layout(std430, binding = 1) writeonly buffer TileLights
+{
+    uint tile_lights[];
+};
+
+layout(std430, binding = 2) buffer TileCounters
+{
+    uint light_tile_pairs;
+    uint max_tile_lights;
+    uint overflowed_tiles;
+};
+
+layout(binding = 2) uniform sampler2D u_depth;
+
+uniform mat4 u_view;
+uniform mat4 u_inverse_projection;
+uniform ivec2 u_size;
+uniform int u_light_count;
+
+shared uint s_min_depth;
+shared uint s_max_depth;
+shared uint s_count;
+shared uint s_indices[max_lights_per_tile];
+
+/* View space of a pixel corner at a depth buffer value. */
+vec3 view_position(vec2 pixel, float depth)
+{
+    vec4 clip = vec4(pixel / vec2(u_size) * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 view = u_inverse_projection * clip;
+    return view.xyz / view.w;
+}
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        s_min_depth = 0xffffffffu;
+        s_max_depth = 0u;
+        s_count = 0u;
+    }
+    barrier();
+
+    /*
+     * Depths are positive, so their bits order like the floats. The
+     * background leaves the range alone.
+     */
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    float depth = 1.0;
+    if (pixel.x < u_size.x && pixel.y < u_size.y)
+        depth = texelFetch(u_depth, pixel, 0).r;
+    if (depth < 1.0)
+    {
+        atomicMin(s_min_depth, floatBitsToUint(depth));
+        atomicMax(s_max_depth, floatBitsToUint(depth));
+    }
+    barrier();
+
+    uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    uint base = tile * (max_lights_per_tile + 1u);
+    if (s_max_depth == 0u)
+    {
+        if (gl_LocalInvocationIndex == 0u)
+            tile_lights[base] = 0u;
+        return;
+    }
+
+    /* The camera looks down -z, so the nearest depth has the largest z. */
+    float nearest_z = view_position(vec2(0.0), uintBitsToFloat(s_min_depth)).z;
+    float farthest_z = view_position(vec2(0.0), uintBitsToFloat(s_max_depth)).z;
+
+    /* Side planes through the eye, normals pointing into the tile. */
+    vec2 tile_min = vec2(gl_WorkGroupID.xy * 16u);
+    vec2 tile_max = tile_min + 16.0;
+    vec3 corners[4] = vec3[4](view_position(tile_min, 1.0),
+                              view_position(vec2(tile_max.x, tile_min.y), 1.0),
+                              view_position(tile_max, 1.0),
+                              view_position(vec2(tile_min.x, tile_max.y), 1.0));
+    vec3 planes[4];
+    for (int i = 0; i < 4; i++)
+        planes[i] = normalize(cross(corners[(i + 1) & 3], corners[i]));
+
+    for (uint i = gl_LocalInvocationIndex; i < uint(u_light_count); i += group_size)
+    {
+        vec4 position_radius = lights[i].position_radius;
+        vec3 center = vec3(u_view * vec4(position_radius.xyz, 1.0));
+        float radius = position_radius.w;
+        if (center.z - radius > nearest_z || center.z + radius < farthest_z)
+            continue;
+
+        bool inside = true;
+        for (int p = 0; p < 4; p++)
+            inside = inside && dot(planes[p], center) >= -radius;
+        if (inside == false)
+            continue;
+
+        uint slot = atomicAdd(s_count, 1u);
+        if (slot < max_lights_per_tile)
+            s_indices[slot] = i;
+    }
+    barrier();
+
+    uint count = min(s_count, max_lights_per_tile);
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        tile_lights[base] = count;
+        atomicAdd(light_tile_pairs, count);
+        atomicMax(max_tile_lights, s_count);
+        if (s_count > max_lights_per_tile)
+            atomicAdd(overflowed_tiles, 1u);
+    }
+    for (uint i = gl_LocalInvocationIndex; i < count; i += group_size)
+        tile_lights[base + 1u + i] = s_indices[i];
+}
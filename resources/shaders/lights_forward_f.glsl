@@ -0,0 +1,60 @@
+#version 460 core
+
+/*
+ * Every fragment evaluates every light; the baseline the tiled paths are
+ * measured against.
+ */
+in vec2 v_tex_coord;
+in vec3 v_pos;
+in vec3 v_normal;
+
+struct PointLight
+{
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+uniform sampler2D tex;
+uniform vec3 u_view_pos;
+uniform int u_light_count;
+
+out vec4 o_color;
+
+/* Diffuse and specular of one light, fading out towards its radius. */
+vec3 point_light(PointLight light, vec3 pos, vec3 norm, vec3 view_dir, float specular_strength)
+{
+    vec3 to_light = light.position_radius.xyz - pos;
+    float distance = length(to_light);
+    float falloff = clamp(1.0 - distance / light.position_radius.w, 0.0, 1.0);
+    if (falloff == 0.0)
+        return vec3(0.0);
+
+    vec3 light_dir = to_light / distance;
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    return (diff + specular_strength * spec) * falloff * falloff * light.color.rgb;
+}
+
+void main()
+{
+    vec3 norm = normalize(v_normal);
+    vec3 view_dir = normalize(u_view_pos - v_pos);
+
+    /* Ambient */
+    float ambient_strength = 0.1;
+    vec3 light = vec3(ambient_strength);
+
+    /* Specular strength as in phong_f.glsl. */
+    float specular_strength = 0.5;
+    for (int i = 0; i < u_light_count; i++)
+        light += point_light(lights[i], v_pos, norm, view_dir, specular_strength);
+
+    vec4 tex_color = texture(tex, v_tex_coord);
+    o_color = vec4(light * tex_color.rgb, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 460 core
+
+/*
+ * Lays the weighted average of the transparent fragments over the frame,
+ * blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA by how much of the
+ * frame they cover. The targets are as large as the framebuffer, so the
+ * fragment coordinates address them directly.
+ */
+layout(binding = 0) uniform sampler2D u_accumulation;
+layout(binding = 1) uniform sampler2D u_revealage;
+
+out vec4 o_color;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(u_revealage, texel, 0).r;
+    if (revealage == 1.0)
+        discard;
+
+    vec4 accumulation = texelFetch(u_accumulation, texel, 0);
+
+    /* Past half float range; fall back to an even mix. */
+    if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+        accumulation.rgb = vec3(accumulation.a);
+
+    vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+    o_color = vec4(average, 1.0 - revealage);
+}
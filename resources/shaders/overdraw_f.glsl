@@ -0,0 +1,13 @@
+#version 460 core
+
+/*
+ * Every fragment that passes the depth test adds a little, with GL_ONE,
+ * GL_ONE over black: one layer is dark red, four are red, ten or more
+ * turn yellow and then white.
+ */
+out vec4 o_color;
+
+void main()
+{
+    o_color = vec4(0.25, 0.1, 0.04, 1.0);
+}
@@ -0,0 +1,81 @@
+#version 460 core
+
+/*
+ * Point lights of the fragment's cluster only, as cluster_assign_c.glsl
+ * or the CPU listed them.
+ */
+const uvec3 grid = uvec3(16u, 9u, 24u); /* clustered.h */
+
+in vec2 v_tex_coord;
+in vec3 v_pos;
+in vec3 v_normal;
+in float v_view_depth;
+
+struct PointLight
+{
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights
+{
+    PointLight lights[];
+};
+
+/* Offset and count of every cluster's list. */
+layout(std430, binding = 1) readonly buffer ClusterGrid
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 2) readonly buffer LightIndices
+{
+    uint light_indices[];
+};
+
+uniform sampler2D tex;
+uniform vec3 u_view_pos;
+uniform ivec2 u_origin; /* Of the viewport. */
+uniform ivec2 u_size;
+uniform vec2 u_slice_scale_bias; /* Slice of log(view depth). */
+
+out vec4 o_color;
+
+/* Diffuse and specular of one light, fading out towards its radius. */
+vec3 point_light(PointLight light, vec3 pos, vec3 norm, vec3 view_dir, float specular_strength)
+{
+    vec3 to_light = light.position_radius.xyz - pos;
+    float distance = length(to_light);
+    float falloff = clamp(1.0 - distance / light.position_radius.w, 0.0, 1.0);
+    if (falloff == 0.0)
+        return vec3(0.0);
+
+    vec3 light_dir = to_light / distance;
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    return (diff + specular_strength * spec) * falloff * falloff * light.color.rgb;
+}
+
+void main()
+{
+    vec2 screen = (gl_FragCoord.xy - vec2(u_origin)) / vec2(u_size);
+    float slice = log(v_view_depth) * u_slice_scale_bias.x + u_slice_scale_bias.y;
+    uvec3 cluster = min(uvec3(uvec2(max(screen * vec2(grid.xy), 0.0)), uint(max(slice, 0.0))), grid - 1u);
+    uvec2 list = clusters[(cluster.z * grid.y + cluster.y) * grid.x + cluster.x];
+
+    vec3 norm = normalize(v_normal);
+    vec3 view_dir = normalize(u_view_pos - v_pos);
+
+    /* Ambient */
+    float ambient_strength = 0.1;
+    vec3 light = vec3(ambient_strength);
+
+    /* Specular strength as in phong_f.glsl. */
+    float specular_strength = 0.5;
+    for (uint i = 0u; i < list.y; i++)
+        light += point_light(lights[light_indices[list.x + i]], v_pos, norm, view_dir, specular_strength);
+
+    vec4 tex_color = texture(tex, v_tex_coord);
+    o_color = vec4(light * tex_color.rgb, 1.0);
+}
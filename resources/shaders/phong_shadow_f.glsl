@@ -0,0 +1,61 @@
+#version 460 core
+
+in vec2 v_tex_coord;
+in vec3 v_pos;
+in vec3 v_normal;
+in float v_view_depth;
+
+uniform sampler2D tex;
+uniform sampler2DArrayShadow u_shadow_map;
+uniform vec3 u_light_dir; /* Towards the light. */
+uniform vec3 u_light_color;
+uniform vec3 u_view_pos;
+
+uniform mat4 u_cascade_matrices[4];
+uniform vec4 u_cascade_splits; /* Far view distance of every cascade. */
+uniform vec4 u_cascade_texels; /* World size of a texel of every cascade. */
+uniform int u_cascade_count;
+
+out vec4 o_color;
+
+/* 1 lit, 0 in shadow. */
+float shadow(vec3 norm)
+{
+    int cascade = 0;
+    while (cascade < u_cascade_count && v_view_depth > u_cascade_splits[cascade])
+        cascade++;
+    if (cascade == u_cascade_count)
+        return 1.0;
+
+    /* Moved off the surface by a texel and a half against acne. */
+    vec3 pos = v_pos + norm * u_cascade_texels[cascade] * 1.5;
+    vec3 coord = vec3(u_cascade_matrices[cascade] * vec4(pos, 1.0)) * 0.5 + 0.5;
+    return texture(u_shadow_map, vec4(coord.xy, float(cascade), coord.z));
+}
+
+void main()
+{
+    /* Ambient */
+    float ambient_strength = 0.3;
+    vec3 ambient = ambient_strength * u_light_color;
+
+    /* Diffuse */
+    vec3 norm = normalize(v_normal);
+    vec3 light_dir = u_light_dir;
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 diffuse = diff * u_light_color;
+
+    /* Specular */
+    float specular_strength = 0.5;
+    vec3 view_dir = normalize(u_view_pos - v_pos);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    vec3 specular = specular_strength * spec * u_light_color;
+
+    /* Final color */
+    float lit = diff > 0.0 ? shadow(norm) : 0.0;
+    vec4 tex_color = texture(tex, v_tex_coord);
+    vec3 object_color = vec3(tex_color.x, tex_color.y, tex_color.z);
+    vec3 result = (ambient + (diffuse + specular) * lit) * object_color;
+    o_color = vec4(result, 1.0);
+}
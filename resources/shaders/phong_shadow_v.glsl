@@ -0,0 +1,28 @@
+#version 460 core
+
+layout(location = 0) in vec3 i_pos;
+layout(location = 1) in vec3 i_normal;
+layout(location = 2) in vec2 i_tex_coord;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+out vec2 v_tex_coord;
+out vec3 v_pos;
+out vec3 v_normal;
+out float v_view_depth;
+
+invariant gl_Position;
+
+void main()
+{
+    v_pos = vec3(u_model * vec4(i_pos, 1.0f));
+    v_normal = mat3(transpose(inverse(u_model))) * i_normal;
+
+    vec4 view_pos = u_view * vec4(v_pos, 1.0f);
+    v_view_depth = -view_pos.z;
+    gl_Position = u_projection * view_pos;
+
+    v_tex_coord = i_tex_coord;
+}
@@ -12,12 +12,14 @@ out vec2 v_tex_coord;
 out vec3 v_pos;
 out vec3 v_normal;
 
+invariant gl_Position;
+
 void main()
 {
     v_pos = vec3(u_model * vec4(i_pos, 1.0f));
     v_normal = mat3(transpose(inverse(u_model))) * i_normal;
 
-    gl_Position = u_projection * u_view * vec4(v_pos, 1.0f);
+    gl_Position = u_projection * (u_view * vec4(v_pos, 1.0f));
 
     v_tex_coord = i_tex_coord;
 }
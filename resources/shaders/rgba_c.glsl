@@ -0,0 +1,25 @@
+#version 460 core
+
+/*
+ * Packed RGBA8, top row first.
+ */
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D u_frame;
+
+layout(std430, binding = 0) writeonly buffer Pixels
+{
+    uint pixels[];
+};
+
+uniform ivec2 u_size;
+
+void main()
+{
+    const ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= u_size.x || pixel.y >= u_size.y)
+        return;
+
+    const vec4 color = texelFetch(u_frame, ivec2(pixel.x, u_size.y - 1 - pixel.y), 0);
+    pixels[pixel.y * u_size.x + pixel.x] = packUnorm4x8(color);
+}
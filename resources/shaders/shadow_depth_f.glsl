@@ -0,0 +1,6 @@
+#version 460 core
+
+/* Depth only. */
+void main()
+{
+}
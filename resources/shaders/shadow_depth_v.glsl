@@ -0,0 +1,11 @@
+#version 460 core
+
+layout(location = 0) in vec3 i_pos;
+
+uniform mat4 u_model;
+uniform mat4 u_light_view_projection;
+
+void main()
+{
+    gl_Position = u_light_view_projection * u_model * vec4(i_pos, 1.0f);
+}
@@ -10,11 +10,12 @@ uniform mat4 u_projection;
 
 out vec2 v_tex_coord;
 
+invariant gl_Position;
+
 void main()
 {
-    vec4 pos = u_projection * u_view * u_model * vec4(i_pos, 1.0f);
-
-    gl_Position = pos;
+    vec3 pos = vec3(u_model * vec4(i_pos, 1.0f));
+    gl_Position = u_projection * (u_view * vec4(pos, 1.0f));
 
     v_tex_coord = i_tex_coord;
 }
@@ -0,0 +1,32 @@
+#version 460 core
+
+/*
+ * Blended over the frame with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, so the
+ * result depends on the drawing order.
+ */
+in vec3 v_pos;
+in vec3 v_normal;
+in vec4 v_color;
+
+uniform vec3 u_view_pos;
+uniform vec3 u_light_pos;
+uniform vec3 u_light_color;
+
+out vec4 o_color;
+
+void main()
+{
+    /* Lit from either side, the back faces show through. */
+    vec3 norm = normalize(v_normal);
+    vec3 view_dir = normalize(u_view_pos - v_pos);
+    if (dot(norm, view_dir) < 0.0)
+        norm = -norm;
+
+    vec3 light_dir = normalize(u_light_pos - v_pos);
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    vec3 light = (0.3 + diff + 0.5 * spec) * u_light_color;
+
+    o_color = vec4(light * v_color.rgb, v_color.a);
+}
@@ -0,0 +1,45 @@
+#version 460 core
+
+/*
+ * Weighted blended order independent transparency. Target 0 adds up the
+ * weighted premultiplied colours (GL_ONE, GL_ONE); target 1 is multiplied
+ * by what every fragment lets through (GL_ZERO, GL_ONE_MINUS_SRC_COLOR).
+ * Lighting as in transparent_f.glsl.
+ */
+in vec3 v_pos;
+in vec3 v_normal;
+in vec4 v_color;
+in float v_view_depth;
+
+uniform vec3 u_view_pos;
+uniform vec3 u_light_pos;
+uniform vec3 u_light_color;
+
+layout(location = 0) out vec4 o_accumulation;
+layout(location = 1) out float o_revealage;
+
+void main()
+{
+    vec3 norm = normalize(v_normal);
+    vec3 view_dir = normalize(u_view_pos - v_pos);
+    if (dot(norm, view_dir) < 0.0)
+        norm = -norm;
+
+    vec3 light_dir = normalize(u_light_pos - v_pos);
+    float diff = max(dot(norm, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, norm);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
+    vec3 light = (0.3 + diff + 0.5 * spec) * u_light_color;
+
+    vec4 color = vec4(light * v_color.rgb, v_color.a);
+
+    /*
+     * Nearer surfaces weigh more. Equation 7 of the paper, bounded so a
+     * few dozen layers stay within half floats.
+     */
+    float depth = v_view_depth;
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(depth / 5.0, 2.0) + pow(depth / 200.0, 6.0)), 1e-2, 3e3);
+
+    o_accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    o_revealage = color.a;
+}
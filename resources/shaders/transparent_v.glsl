@@ -0,0 +1,48 @@
+#version 460 core
+
+/*
+ * One instance per transparent cube. Sorted, instances are drawn in the
+ * order the CPU wrote; otherwise as they were placed.
+ */
+layout(location = 0) in vec3 i_pos;
+layout(location = 1) in vec3 i_normal;
+
+struct TransparentObject
+{
+    mat4 model;
+    vec4 color;
+};
+
+layout(std430, binding = 4) readonly buffer Objects
+{
+    TransparentObject objects[];
+};
+
+layout(std430, binding = 5) readonly buffer Order
+{
+    uint order[];
+};
+
+uniform mat4 u_view;
+uniform mat4 u_projection;
+uniform bool u_sorted;
+
+out vec3 v_pos;
+out vec3 v_normal;
+out vec4 v_color;
+out float v_view_depth;
+
+void main()
+{
+    uint index = u_sorted ? order[gl_InstanceID] : uint(gl_InstanceID);
+    TransparentObject object = objects[index];
+
+    v_pos = vec3(object.model * vec4(i_pos, 1.0));
+    /* Rotated and scaled alike on every axis, so no inverse transpose. */
+    v_normal = mat3(object.model) * i_normal;
+    v_color = object.color;
+
+    vec4 view_pos = u_view * vec4(v_pos, 1.0);
+    v_view_depth = -view_pos.z;
+    gl_Position = u_projection * view_pos;
+}
@@ -0,0 +1,62 @@
+#version 460 core
+
+/*
+ * RGBA to planar YUV 4:2:0 (I420), BT.709 limited range, top row first.
+ * Each invocation converts an 8 x 2 block: four words of luma and one
+ * word each of U and V, averaged over 2 x 2 pixels.
+ */
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D u_frame;
+
+layout(std430, binding = 0) writeonly buffer Planes
+{
+    uint planes[];
+};
+
+uniform ivec2 u_size;
+
+float luma(vec3 rgb)
+{
+    return dot(rgb, vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+void main()
+{
+    const ivec2 block = ivec2(gl_GlobalInvocationID.xy);
+    const int x0 = block.x * 8;
+    const int y0 = block.y * 2;
+    if (x0 >= u_size.x || y0 >= u_size.y)
+        return;
+
+    vec3 rgb[2][8];
+    for (int y = 0; y < 2; y++)
+        for (int x = 0; x < 8; x++)
+            rgb[y][x] = texelFetch(u_frame, ivec2(x0 + x, u_size.y - 1 - y0 - y), 0).rgb;
+
+    for (int y = 0; y < 2; y++)
+    {
+        for (int word = 0; word < 2; word++)
+        {
+            vec4 l;
+            for (int i = 0; i < 4; i++)
+                l[i] = 16.0f + 219.0f * luma(rgb[y][word * 4 + i]);
+            planes[((y0 + y) * u_size.x + x0) / 4 + word] = packUnorm4x8(l / 255.0f);
+        }
+    }
+
+    vec4 u;
+    vec4 v;
+    for (int i = 0; i < 4; i++)
+    {
+        const vec3 c = 0.25f * (rgb[0][i * 2] + rgb[0][i * 2 + 1] + rgb[1][i * 2] + rgb[1][i * 2 + 1]);
+        const float l = luma(c);
+        u[i] = 128.0f + 224.0f * (c.b - l) / 1.8556f;
+        v[i] = 128.0f + 224.0f * (c.r - l) / 1.5748f;
+    }
+
+    const int luma_words = u_size.x * u_size.y / 4;
+    const int chroma_word = (block.y * u_size.x / 2 + x0 / 2) / 4;
+    planes[luma_words + chroma_word] = packUnorm4x8(u / 255.0f);
+    planes[luma_words + luma_words / 4 + chroma_word] = packUnorm4x8(v / 255.0f);
+}
@@ -0,0 +1,152 @@
+#include "allocation_tracker.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_allocations = 0;
+static std::atomic<uint64_t> s_bytes = 0;
+
+static void* tracked_allocate(size_t size, size_t alignment)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    s_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (size == 0)
+        size = 1;
+
+    void* memory = nullptr;
+#ifdef _WIN32
+    memory = _aligned_malloc(size, alignment);
+#else
+    if (alignment <= alignof(std::max_align_t))
+        memory = std::malloc(size);
+    else
+        memory = std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+static void tracked_free(void* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+/*
+ * Replacements for the global allocation functions. The array, nothrow and
+ * sized forms of the standard library forward to these.
+ */
+void* operator new(size_t size)
+{
+    return tracked_allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return tracked_allocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size)
+{
+    return tracked_allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return tracked_allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    tracked_free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+    tracked_free(memory);
+}
+
+namespace cg
+{
+
+static uint64_t s_frame = 0;
+static uint64_t s_frame_start = 0;
+static uint64_t s_last_frame = 0;
+
+AllocationCounts allocation_counts(void)
+{
+    return
+    {
+        .allocations = s_allocations.load(std::memory_order_relaxed),
+        .bytes = s_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+void begin_allocation_frame(void)
+{
+    s_frame_start = s_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t end_allocation_frame(void)
+{
+    const uint64_t allocations = s_allocations.load(std::memory_order_relaxed) - s_frame_start;
+    s_last_frame = allocations;
+
+    if (s_frame++ >= warm_up_frames && allocations > 0)
+    {
+        std::fprintf(stderr,
+                     "Frame %llu allocated %llu times in steady state.\n",
+                     static_cast<unsigned long long>(s_frame),
+                     static_cast<unsigned long long>(allocations));
+#ifdef CG_STRICT_ALLOCATIONS
+        std::abort();
+#endif
+    }
+
+    return allocations;
+}
+
+uint64_t last_frame_allocations(void)
+{
+    return s_last_frame;
+}
+
+} // namespace cg
@@ -0,0 +1,38 @@
+#ifndef CG_ALLOCATION_TRACKER
+#define CG_ALLOCATION_TRACKER
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Counts every call to the global operator new, from all threads.
+ * C libraries (GLFW, ImGui) allocate with malloc and are not counted.
+ */
+struct AllocationCounts
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+AllocationCounts allocation_counts(void);
+
+/*
+ * Frame loop check. After warm_up_frames frames, every frame between
+ * begin_allocation_frame() and end_allocation_frame() must not allocate.
+ * end_allocation_frame() returns the allocations made during the frame and
+ * reports steady state violations on stderr. Built with
+ * CG_STRICT_ALLOCATIONS it aborts instead. cg_bench exits non-zero when
+ * its measured frames allocate, so automated runs fail either way.
+ */
+void begin_allocation_frame(void);
+uint64_t end_allocation_frame(void);
+uint64_t last_frame_allocations(void);
+
+constexpr uint64_t warm_up_frames = 60;
+
+} // namespace cg
+
+#endif
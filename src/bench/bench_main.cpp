@@ -0,0 +1,2004 @@
+#include "glad/glad.h"
+
+#include "offscreen_context.h"
+#include "golden.h"
+#include "recorder.h"
+#include "triple_buffer_check.h"
+#include "allocation_tracker.h"
+#include "frame_arena.h"
+#include "frame_stats.h"
+#include "frame_stream.h"
+#include "gl_counters.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "bvh_benchmark.h"
+#include "job_benchmark.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "scene.h"
+#include "shadows.h"
+#include "simulation.h"
+#include "clustered.h"
+#include "deferred.h"
+#include "depth_prepass.h"
+#include "lights.h"
+#include "mesh_lod.h"
+#include "occlusion.h"
+#include "path_tracer.h"
+#include "software_renderer.h"
+#include "structs.h"
+#include "tiled_render.h"
+#include "transparency.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/*
+ * cg_bench: renders a scene headless along its camera path and writes a
+ * JSON report, so performance can be tracked by scripts and CI.
+ */
+
+struct BenchOptions
+{
+    const char* scene = "grid";
+    uint64_t frames = 600;
+    uint64_t warm_up = 60;
+    int width = 1280;
+    int height = 720;
+    bool size_given = false;
+    const char* output = "bench.json";
+    bool debug = false;
+    bool job_scaling = false;
+    bool bvh_benchmark = false;
+    bool golden = false;
+    bool triple_buffer = false;
+    bool sim_load = false;
+    cg::GoldenOptions golden_options =
+    {
+        .reference_directory = "resources/golden",
+        .output_directory = "golden_out",
+        .bless = false,
+        .software = false
+    };
+    const char* record = nullptr;
+    cg::ImageFormat record_format = cg::ImageFormat::png;
+    const char* stream = nullptr;
+    cg::StreamFormat stream_format = cg::StreamFormat::y4m;
+    int fps = 60;
+    const char* screenshot = nullptr;
+    int tile_size = 1024;
+    int overlap = 16;
+    bool software = false;
+    cg::SoftwareRenderOptions software_options;
+    bool occlusion = false;
+    bool shadows = false;
+    cg::LightingPath lighting = cg::LightingPath::single;
+    int lights = 4096;
+    cg::ClusterAssignment cluster_assignment = cg::ClusterAssignment::gpu;
+    bool light_sweep = false;
+    cg::TransparencyMode transparency = cg::TransparencyMode::sorted;
+    int transparent = 0;
+    bool transparency_sweep = false;
+    cg::DepthPrepassMode prepass = cg::DepthPrepassMode::off;
+    bool overdraw = false;
+    bool lod = false;
+    int lod_level = -1;
+    float lod_error = 1.0f;
+    bool lod_sweep = false;
+    float camera_distance = 0.0f;
+    const char* path_trace = nullptr;
+};
+
+/*
+ * GPU time of every pass, summed over the measured frames.
+ */
+struct PassTotal
+{
+    const char* name;
+    double total_ms;
+    double worst_ms;
+    uint64_t frames;
+};
+
+/*
+ * One shadow cascade over the measured frames.
+ */
+struct CascadeTotal
+{
+    uint64_t renders;
+    uint64_t draw_calls;
+    double cpu_ms;
+};
+
+/*
+ * Tile culling counters of the deferred path, summed over the culling
+ * passes read back while measuring.
+ */
+struct TileTotal
+{
+    uint64_t passes;
+    uint64_t tiles;
+    uint64_t light_tile_pairs;
+    uint64_t overflowed_tiles;
+    uint32_t max_tile_lights;
+    uint64_t last_frame;
+};
+
+/*
+ * Light assignment of the clustered path, summed over the assignments
+ * counted while measuring.
+ */
+struct ClusterTotal
+{
+    uint64_t assignments;
+    uint64_t light_cluster_pairs;
+    uint64_t overflowed_clusters;
+    uint32_t max_cluster_lights;
+    double cpu_ms;
+    uint64_t last_frame;
+};
+
+/*
+ * One run of --light-sweep.
+ */
+struct SweepRun
+{
+    const char* path;
+    int lights;
+    double gpu_ms;          /* Mean per frame. */
+    double cpu_ms;
+    double lights_per_list; /* Per tile or cluster. */
+};
+
+/*
+ * One run of --transparency-sweep.
+ */
+struct TransparencySweepRun
+{
+    const char* mode;
+    int objects;
+    double gpu_ms;          /* Mean per frame, of the whole frame. */
+    double transparency_ms; /* Mean per frame, of the transparent pass. */
+    double cpu_ms;
+    double sort_ms;
+    double frame_ms;        /* Mean wall clock time per frame. */
+};
+
+/*
+ * One run of --lod-sweep.
+ */
+struct LodSweepRun
+{
+    float distance;
+    const char* detail;
+    double triangles;  /* Mean per frame. */
+    double mean_level; /* Over the items, per frame. */
+    double frame_ms;   /* Mean wall clock time per frame. */
+    double gpu_ms;
+    double cpu_ms;
+};
+
+/*
+ * One step of --sim-load.
+ */
+struct SimLoadRun
+{
+    float load_ms;
+    double p50_ms;           /* Of the frame time, end to end of frame. */
+    double p99_ms;
+    double steps_per_second; /* Simulation steps the frames saw. */
+    bool stable;
+};
+
+/*
+ * How far the frame time of --sim-load may move from that without load:
+ * the fraction of it, or the slack, whichever is larger. Loose enough for
+ * the noise of a busy machine with a single core, which the simulation's
+ * busy work shares with the renderer; a render thread that waited for
+ * the simulation's 32 ms steps would still be far outside.
+ */
+constexpr double sim_load_p50_tolerance = 0.5;
+constexpr double sim_load_p99_tolerance = 1.0;
+constexpr double sim_load_slack_ms = 2.0;
+
+/*
+ * Every load runs at least this long, so the simulation takes enough
+ * steps under it however fast the frames are.
+ */
+constexpr double sim_load_seconds = 2.0;
+
+/*
+ * Path tracer throughput at one worker count.
+ */
+struct TraceScaling
+{
+    unsigned int workers;
+    double rays_per_second;
+};
+
+struct BenchResult
+{
+    std::array<PassTotal, cg::max_gpu_zones> passes;
+    size_t pass_count;
+    uint64_t draw_calls;
+    uint64_t triangles;
+    cg::GlCounters gl_counters;
+    uint64_t steady_state_allocations;
+    uint64_t measured_frames;
+    cg::SoftwareStats software;
+    cg::OcclusionStats occlusion;
+    std::array<CascadeTotal, cg::max_shadow_cascades> shadows;
+    TileTotal tiles;
+    ClusterTotal clusters;
+    double cpu_ms;
+    double gpu_ms;
+    uint64_t gpu_frames;
+    double sort_ms;    /* Of the transparent cubes. */
+    double present_ms; /* Between the ends of consecutive frames. */
+    uint64_t prepass_frames;
+    std::array<uint64_t, cg::max_lod_levels> lod_items; /* Items drawn at every level, summed. */
+    uint64_t lod_switches;
+    uint64_t rays;
+    double trace_ms;
+    std::vector<TraceScaling> trace_scaling;
+    std::vector<cg::BvhBenchmarkResult> bvh_benchmark;
+};
+
+/*
+ * What rendered the frames, for the report.
+ */
+struct Backend
+{
+    std::string context;
+    std::string renderer;
+    std::string version;
+};
+
+static void print_usage(void)
+{
+    std::cout << "Usage: cg_bench [options]\n"
+                 "  --scene <name>     Scene to render (default grid)\n"
+                 "  --frames <n>       Measured frames (default 600)\n"
+                 "  --warm-up <n>      Frames rendered before measuring (default 60)\n"
+                 "  --size <w>x<h>     Render target size (default 1280x720)\n"
+                 "  --output <path>    JSON report (default bench.json)\n"
+                 "  --debug            Debug context with KHR_debug output\n"
+                 "  --job-scaling      Also run the job system scaling benchmark\n"
+                 "  --bvh-benchmark    Also run the BVH build and refit benchmark\n"
+                 "  --golden           Compare reference scenes with the stored images\n"
+                 "  --references <dir> Stored images (default resources/golden)\n"
+                 "  --diffs <dir>      Actual and diff images of failures (default golden_out)\n"
+                 "  --bless            Overwrite the stored images with this renderer's output\n"
+                 "  --triple-buffer    Check the simulation to render hand-off, without GL\n"
+                 "  --sim-load         Fail if the frame time moves as the simulation step load goes up\n"
+                 "  --record <dir>     Write every frame to dir, at 1080p and 4K unless --size\n"
+                 "  --format png|qoi   Image format of --record (default png)\n"
+                 "  --stream <path>    Write raw video to a file or named pipe, - for stdout\n"
+                 "  --stream-format y4m|yuv|rgba  Video format of --stream (default y4m)\n"
+                 "  --fps <n>          Frame rate in the Y4M header (default 60)\n"
+                 "  --screenshot <path> Render one PNG in tiles, 15360x8640 unless --size\n"
+                 "  --tile <n>         Largest tile of --screenshot (default 1024)\n"
+                 "  --overlap <n>      Guard band around every tile (default 16)\n"
+                 "  --software         Render on the CPU, without a GL context\n"
+                 "  --pipeline textured|phong  Shaders of --software (default textured)\n"
+                 "  --filter bilinear|trilinear  Texture filter of --software (default bilinear)\n"
+                 "  --occlusion        Cull items hidden behind the largest ones on the CPU\n"
+                 "  --shadows          Phong lighting with cascaded shadow maps (GL only)\n"
+                 "  --lighting single|forward|deferred|clustered  Point light path (default single, GL only)\n"
+                 "  --lights <n>       Point lights of every --lighting but single (default 4096)\n"
+                 "  --cluster-assign gpu|cpu  Where the clustered path lists its lights (default gpu)\n"
+                 "  --light-sweep      Time single, deferred and clustered lighting as the light count grows\n"
+                 "  --transparent <n>  Transparent cubes drawn over the scene (default 0, GL only)\n"
+                 "  --transparency sorted|weighted  Sorted back to front, or weighted blended OIT (default sorted)\n"
+                 "  --transparency-sweep  Time both transparency modes as the cube count grows\n"
+                 "  --prepass off|on|auto  Depth pre-pass before shading; auto measures overdraw (default off)\n"
+                 "  --overdraw         Draw how often every pixel is shaded instead of the scene\n"
+                 "  --lod              Rounded cubes, each at the level of detail its screen-space error allows\n"
+                 "  --lod-level <n>    Draw every item of --lod at this level instead\n"
+                 "  --lod-error <px>   Largest projected error of the level picked (default 1)\n"
+                 "  --camera-distance <d>  Keep the path's view direction, this far from the point it looks at\n"
+                 "  --lod-sweep        Time full detail and picked levels as the camera moves away\n"
+                 "  --path-trace <png> Path trace --frames samples per pixel on the CPU into a PNG\n"
+                 "  --list             List the scenes\n";
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view argument = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (argument == "--scene" && has_value == true)
+            options.scene = argv[++i];
+        else if (argument == "--frames" && has_value == true)
+            options.frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--warm-up" && has_value == true)
+            options.warm_up = std::strtoull(argv[++i], nullptr, 10);
+        else if (argument == "--size" && has_value == true)
+        {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2)
+                return false;
+            options.size_given = true;
+        }
+        else if (argument == "--output" && has_value == true)
+            options.output = argv[++i];
+        else if (argument == "--debug")
+            options.debug = true;
+        else if (argument == "--job-scaling")
+            options.job_scaling = true;
+        else if (argument == "--bvh-benchmark")
+            options.bvh_benchmark = true;
+        else if (argument == "--golden")
+            options.golden = true;
+        else if (argument == "--references" && has_value == true)
+            options.golden_options.reference_directory = argv[++i];
+        else if (argument == "--diffs" && has_value == true)
+            options.golden_options.output_directory = argv[++i];
+        else if (argument == "--triple-buffer")
+            options.triple_buffer = true;
+        else if (argument == "--sim-load")
+            options.sim_load = true;
+        else if (argument == "--bless")
+        {
+            options.golden = true;
+            options.golden_options.bless = true;
+        }
+        else if (argument == "--record" && has_value == true)
+            options.record = argv[++i];
+        else if (argument == "--format" && has_value == true)
+        {
+            const std::string_view format = argv[++i];
+            if (format == "png")
+                options.record_format = cg::ImageFormat::png;
+            else if (format == "qoi")
+                options.record_format = cg::ImageFormat::qoi;
+            else
+                return false;
+        }
+        else if (argument == "--stream" && has_value == true)
+            options.stream = argv[++i];
+        else if (argument == "--stream-format" && has_value == true)
+        {
+            const std::string_view format = argv[++i];
+            if (format == "y4m")
+                options.stream_format = cg::StreamFormat::y4m;
+            else if (format == "yuv")
+                options.stream_format = cg::StreamFormat::yuv420;
+            else if (format == "rgba")
+                options.stream_format = cg::StreamFormat::rgba;
+            else
+                return false;
+        }
+        else if (argument == "--fps" && has_value == true)
+            options.fps = std::atoi(argv[++i]);
+        else if (argument == "--screenshot" && has_value == true)
+            options.screenshot = argv[++i];
+        else if (argument == "--tile" && has_value == true)
+            options.tile_size = std::atoi(argv[++i]);
+        else if (argument == "--overlap" && has_value == true)
+            options.overlap = std::atoi(argv[++i]);
+        else if (argument == "--path-trace" && has_value == true)
+            options.path_trace = argv[++i];
+        else if (argument == "--occlusion")
+            options.occlusion = true;
+        else if (argument == "--shadows")
+            options.shadows = true;
+        else if (argument == "--lighting" && has_value == true)
+        {
+            const std::string_view path = argv[++i];
+            if (path == "single")
+                options.lighting = cg::LightingPath::single;
+            else if (path == "forward")
+                options.lighting = cg::LightingPath::forward;
+            else if (path == "deferred")
+                options.lighting = cg::LightingPath::deferred;
+            else if (path == "clustered")
+                options.lighting = cg::LightingPath::clustered;
+            else
+                return false;
+        }
+        else if (argument == "--cluster-assign" && has_value == true)
+        {
+            const std::string_view assignment = argv[++i];
+            if (assignment == "gpu")
+                options.cluster_assignment = cg::ClusterAssignment::gpu;
+            else if (assignment == "cpu")
+                options.cluster_assignment = cg::ClusterAssignment::cpu;
+            else
+                return false;
+        }
+        else if (argument == "--light-sweep")
+            options.light_sweep = true;
+        else if (argument == "--transparency" && has_value == true)
+        {
+            const std::string_view mode = argv[++i];
+            if (mode == "sorted")
+                options.transparency = cg::TransparencyMode::sorted;
+            else if (mode == "weighted")
+                options.transparency = cg::TransparencyMode::weighted;
+            else
+                return false;
+        }
+        else if (argument == "--transparent" && has_value == true)
+            options.transparent = std::atoi(argv[++i]);
+        else if (argument == "--transparency-sweep")
+            options.transparency_sweep = true;
+        else if (argument == "--prepass" && has_value == true)
+        {
+            const std::string_view mode = argv[++i];
+            if (mode == "off")
+                options.prepass = cg::DepthPrepassMode::off;
+            else if (mode == "on")
+                options.prepass = cg::DepthPrepassMode::on;
+            else if (mode == "auto")
+                options.prepass = cg::DepthPrepassMode::automatic;
+            else
+                return false;
+        }
+        else if (argument == "--overdraw")
+            options.overdraw = true;
+        else if (argument == "--lod")
+            options.lod = true;
+        else if (argument == "--lod-level" && has_value == true)
+        {
+            options.lod = true;
+            options.lod_level = std::atoi(argv[++i]);
+        }
+        else if (argument == "--lod-error" && has_value == true)
+            options.lod_error = static_cast<float>(std::atof(argv[++i]));
+        else if (argument == "--lod-sweep")
+            options.lod_sweep = true;
+        else if (argument == "--camera-distance" && has_value == true)
+            options.camera_distance = static_cast<float>(std::atof(argv[++i]));
+        else if (argument == "--lights" && has_value == true)
+            options.lights = std::atoi(argv[++i]);
+        else if (argument == "--software")
+        {
+            options.software = true;
+            options.golden_options.software = true;
+        }
+        else if (argument == "--pipeline" && has_value == true)
+        {
+            const std::string_view pipeline = argv[++i];
+            if (pipeline == "textured")
+                options.software_options.pipeline = cg::SoftwarePipeline::textured;
+            else if (pipeline == "phong")
+                options.software_options.pipeline = cg::SoftwarePipeline::phong;
+            else
+                return false;
+        }
+        else if (argument == "--filter" && has_value == true)
+        {
+            const std::string_view filter = argv[++i];
+            if (filter == "bilinear")
+                options.software_options.filter = cg::SoftwareFilter::bilinear;
+            else if (filter == "trilinear")
+                options.software_options.filter = cg::SoftwareFilter::trilinear;
+            else
+                return false;
+        }
+        else if (argument == "--list")
+        {
+            for (size_t s = 0; s < cg::scene_count(); s++)
+                std::cout << cg::scene(s).name << ": " << cg::scene(s).description << "\n";
+            std::exit(0);
+        }
+        else
+            return false;
+    }
+
+    return options.frames > 0 && options.width > 0 && options.height > 0 && options.fps > 0 &&
+           options.tile_size > 0 && options.lights >= 0 && options.lights <= cg::max_point_lights &&
+           options.transparent >= 0 && options.transparent <= cg::max_transparent_objects;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point begin,
+                         std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+static void add_gpu_frame(const cg::GpuFrameResult& frame, BenchResult& result)
+{
+    cg::record_frame_time(cg::FrameMetric::gpu, frame.total_ms);
+    result.gpu_ms += frame.total_ms;
+    result.gpu_frames++;
+
+    for (size_t z = 0; z < frame.zone_count; z++)
+    {
+        const cg::GpuZoneResult& zone = frame.zones[z];
+
+        size_t index = 0;
+        while (index < result.pass_count && std::strcmp(result.passes[index].name, zone.name) != 0)
+            index++;
+        if (index == result.passes.size())
+            continue;
+        if (index == result.pass_count)
+            result.passes[result.pass_count++] = { zone.name, 0.0, 0.0, 0 };
+
+        PassTotal& pass = result.passes[index];
+        pass.total_ms += zone.ms;
+        pass.worst_ms = std::max(pass.worst_ms, zone.ms);
+        pass.frames++;
+    }
+}
+
+/*
+ * Mean GPU time per frame of one pass, 0 if it never ran.
+ */
+static double pass_ms(const BenchResult& result, const char* name)
+{
+    for (size_t i = 0; i < result.pass_count; i++)
+    {
+        const PassTotal& pass = result.passes[i];
+        if (std::strcmp(pass.name, name) == 0)
+            return pass.total_ms / static_cast<double>(std::max<uint64_t>(pass.frames, 1));
+    }
+    return 0.0;
+}
+
+/*
+ * Peak resident set size in kilobytes. Zero where unsupported.
+ */
+static uint64_t peak_rss_kb(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+static void write_metric(std::ofstream& out, cg::FrameMetric metric)
+{
+    const cg::FrameStatsSummary stats = cg::lifetime_frame_stats(metric);
+    out << "  \"" << cg::frame_metric_name(metric) << "\": {"
+        << "\"frames\": " << stats.frames
+        << ", \"mean_ms\": " << stats.mean
+        << ", \"p50_ms\": " << stats.p50
+        << ", \"p90_ms\": " << stats.p90
+        << ", \"p99_ms\": " << stats.p99
+        << ", \"p99_9_ms\": " << stats.p999
+        << ", \"worst_ms\": " << stats.worst
+        << ", \"hitches\": " << stats.hitches
+        << "},\n";
+}
+
+static bool write_report(const BenchOptions& options,
+                         const Backend& backend,
+                         const BenchResult& result,
+                         const std::vector<cg::JobBenchmarkResult>& job_scaling)
+{
+    std::ofstream out(options.output);
+    if (out.good() == false)
+        return false;
+
+    const cg::AllocationCounts allocations = cg::allocation_counts();
+    const auto per_frame = [&](uint64_t value)
+    {
+        return static_cast<double>(value) / static_cast<double>(result.measured_frames);
+    };
+
+    out << "{\n"
+        << "  \"scene\": \"" << options.scene << "\",\n"
+        << "  \"frames\": " << result.measured_frames << ",\n"
+        << "  \"warm_up_frames\": " << options.warm_up << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"context\": \"" << backend.context << "\",\n"
+        << "  \"renderer\": \"" << backend.renderer << "\",\n"
+        << "  \"version\": \"" << backend.version << "\",\n"
+        << "  \"job_workers\": " << cg::job_worker_count() << ",\n";
+
+    write_metric(out, cg::FrameMetric::cpu);
+    write_metric(out, cg::FrameMetric::gpu);
+    write_metric(out, cg::FrameMetric::present);
+
+    out << "  \"gpu_passes\": [";
+    for (size_t i = 0; i < result.pass_count; i++)
+    {
+        const PassTotal& pass = result.passes[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << pass.name << "\""
+            << ", \"mean_ms\": " << pass.total_ms / static_cast<double>(pass.frames)
+            << ", \"worst_ms\": " << pass.worst_ms
+            << ", \"frames\": " << pass.frames << "}";
+    }
+    out << "\n  ],\n";
+
+    out << "  \"draws\": {"
+        << "\"draw_calls_per_frame\": " << per_frame(result.draw_calls)
+        << ", \"triangles_per_frame\": " << per_frame(result.triangles)
+        << "},\n";
+
+    if (cg::gl_counters_enabled() == true)
+    {
+        const cg::GlCounters& counters = result.gl_counters;
+        out << "  \"gl_counters_per_frame\": {"
+            << "\"calls\": " << per_frame(counters.calls)
+            << ", \"draw_calls\": " << per_frame(counters.draw_calls)
+            << ", \"compute_dispatches\": " << per_frame(counters.compute_dispatches)
+            << ", \"memory_barriers\": " << per_frame(counters.memory_barriers)
+            << ", \"queries\": " << per_frame(counters.queries)
+            << ", \"primitives\": " << per_frame(counters.primitives)
+            << ", \"program_binds\": " << per_frame(counters.program_binds)
+            << ", \"vertex_array_binds\": " << per_frame(counters.vertex_array_binds)
+            << ", \"buffer_binds\": " << per_frame(counters.buffer_binds)
+            << ", \"texture_binds\": " << per_frame(counters.texture_binds)
+            << ", \"framebuffer_binds\": " << per_frame(counters.framebuffer_binds)
+            << ", \"render_state_changes\": " << per_frame(counters.render_state_changes)
+            << ", \"uniform_updates\": " << per_frame(counters.uniform_updates)
+            << ", \"buffer_bytes_uploaded\": " << per_frame(counters.buffer_bytes_uploaded)
+            << ", \"texture_bytes_uploaded\": " << per_frame(counters.texture_bytes_uploaded)
+            << "},\n";
+    }
+
+    if (options.software == true)
+    {
+        const cg::SoftwareStats& software = result.software;
+        out << "  \"software_per_frame\": {"
+            << "\"triangles_culled\": " << per_frame(software.triangles_culled)
+            << ", \"triangles_clipped\": " << per_frame(software.triangles_clipped)
+            << ", \"tile_triangles\": " << per_frame(software.tile_triangles)
+            << ", \"fragments\": " << per_frame(software.fragments)
+            << "},\n";
+    }
+
+    if (options.occlusion == true)
+    {
+        const cg::OcclusionStats& occlusion = result.occlusion;
+        out << "  \"occlusion_per_frame\": {"
+            << "\"occluders\": " << per_frame(occlusion.occluders)
+            << ", \"occluder_triangles\": " << per_frame(occlusion.occluder_triangles)
+            << ", \"tested\": " << per_frame(occlusion.tested)
+            << ", \"frustum_culled\": " << per_frame(occlusion.frustum_culled)
+            << ", \"occluded\": " << per_frame(occlusion.occluded)
+            << ", \"raster_ms\": " << occlusion.raster_ms / static_cast<double>(result.measured_frames)
+            << ", \"test_ms\": " << occlusion.test_ms / static_cast<double>(result.measured_frames)
+            << "},\n";
+    }
+
+    if (options.shadows == true)
+    {
+        out << "  \"shadow_cascades\": [";
+        const cg::ShadowStats& stats = cg::last_shadow_stats();
+        for (int i = 0; i < stats.cascade_count; i++)
+        {
+            const CascadeTotal& cascade = result.shadows[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"start\": " << stats.cascades[i].start
+                << ", \"end\": " << stats.cascades[i].end
+                << ", \"rendered_fraction\": " << per_frame(cascade.renders)
+                << ", \"draw_calls_per_frame\": " << per_frame(cascade.draw_calls)
+                << ", \"cpu_ms_per_frame\": " << cascade.cpu_ms / static_cast<double>(result.measured_frames) << "}";
+        }
+        out << "\n  ],\n";
+    }
+
+    if (options.lighting != cg::LightingPath::single)
+    {
+        const TileTotal& tiles = result.tiles;
+        const double passes = static_cast<double>(std::max<uint64_t>(tiles.passes, 1));
+        out << "  \"lighting\": {"
+            << "\"path\": \"" << cg::lighting_path_name(options.lighting) << "\""
+            << ", \"lights\": " << cg::point_light_count()
+            << ", \"light_radius\": " << cg::lighting_settings.light_radius;
+        if (options.lighting == cg::LightingPath::deferred)
+            out << ", \"tile_size\": " << cg::light_tile_size
+                << ", \"tiles\": " << static_cast<double>(tiles.tiles) / passes
+                << ", \"lights_per_tile\": "
+                << static_cast<double>(tiles.light_tile_pairs) / static_cast<double>(std::max<uint64_t>(tiles.tiles, 1))
+                << ", \"max_tile_lights\": " << tiles.max_tile_lights
+                << ", \"overflowed_tiles_per_pass\": " << static_cast<double>(tiles.overflowed_tiles) / passes;
+        if (options.lighting == cg::LightingPath::clustered)
+        {
+            const ClusterTotal& clusters = result.clusters;
+            const double assignments = static_cast<double>(std::max<uint64_t>(clusters.assignments, 1));
+            out << ", \"assignment\": \"" << (options.cluster_assignment == cg::ClusterAssignment::cpu ? "cpu" : "gpu") << "\""
+                << ", \"clusters\": " << cg::cluster_count
+                << ", \"lights_per_cluster\": "
+                << static_cast<double>(clusters.light_cluster_pairs) / assignments / cg::cluster_count
+                << ", \"max_cluster_lights\": " << clusters.max_cluster_lights
+                << ", \"overflowed_clusters_per_assignment\": " << static_cast<double>(clusters.overflowed_clusters) / assignments
+                << ", \"assignment_cpu_ms_per_frame\": " << clusters.cpu_ms / static_cast<double>(result.measured_frames);
+        }
+        out << "},\n";
+    }
+
+    if (options.prepass != cg::DepthPrepassMode::off)
+    {
+        const cg::DepthPrepassStats& stats = cg::last_depth_prepass_stats();
+        out << "  \"depth_prepass\": {"
+            << "\"mode\": \"" << cg::depth_prepass_mode_name(options.prepass) << "\""
+            << ", \"prepass_fraction\": " << per_frame(result.prepass_frames)
+            << ", \"overdraw\": " << stats.overdraw
+            << ", \"overdraw_threshold\": " << cg::depth_prepass_settings.overdraw_threshold
+            << ", \"measurements\": " << stats.measurements
+            << ", \"prepass_gpu_ms_per_frame\": " << pass_ms(result, "depth pre-pass")
+            << "},\n";
+    }
+
+    if (options.lod == true)
+    {
+        out << "  \"lod\": {"
+            << "\"pixel_error\": " << cg::lod_settings.pixel_error
+            << ", \"hysteresis\": " << cg::lod_settings.hysteresis
+            << ", \"forced_level\": " << cg::lod_settings.forced_level
+            << ", \"switches_per_frame\": " << per_frame(result.lod_switches)
+            << ", \"levels\": [";
+        const std::vector<cg::LodLevel>& levels = cg::lod_levels();
+        for (size_t i = 0; i < levels.size(); i++)
+            out << (i == 0 ? "" : ", ")
+                << "{\"triangles\": " << levels[i].index_count / 3
+                << ", \"error\": " << levels[i].error
+                << ", \"items_per_frame\": " << per_frame(result.lod_items[i]) << "}";
+        out << "]},\n";
+    }
+
+    if (options.transparent > 0)
+        out << "  \"transparency\": {"
+            << "\"mode\": \"" << cg::transparency_mode_name(options.transparency) << "\""
+            << ", \"objects\": " << cg::last_transparency_stats().objects
+            << ", \"opacity\": " << cg::transparency_settings.opacity
+            << ", \"gpu_ms_per_frame\": " << pass_ms(result, "transparency")
+            << ", \"sort_cpu_ms_per_frame\": " << result.sort_ms / static_cast<double>(result.measured_frames)
+            << "},\n";
+
+    if (options.path_trace != nullptr)
+    {
+        const cg::PathTracerStats& stats = cg::path_tracer_stats();
+        out << "  \"path_tracer\": {"
+            << "\"samples_per_pixel\": " << result.measured_frames
+            << ", \"rays_per_sample\": " << per_frame(result.rays) / (static_cast<double>(options.width) * options.height)
+            << ", \"rays_per_second\": " << static_cast<double>(result.rays) / (result.trace_ms / 1000.0)
+            << ", \"triangles\": " << stats.triangles
+            << ", \"bvh_nodes\": " << stats.bvh_nodes
+            << ", \"bvh_build_ms\": " << stats.build_ms
+            << ", \"scaling\": [";
+        for (size_t i = 0; i < result.trace_scaling.size(); i++)
+            out << (i == 0 ? "" : ", ")
+                << "{\"workers\": " << result.trace_scaling[i].workers
+                << ", \"rays_per_second\": " << result.trace_scaling[i].rays_per_second << "}";
+        out << "]},\n";
+    }
+
+    if (result.bvh_benchmark.empty() == false)
+    {
+        out << "  \"bvh_benchmark\": [";
+        for (size_t i = 0; i < result.bvh_benchmark.size(); i++)
+        {
+            const cg::BvhBenchmarkResult& run = result.bvh_benchmark[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"mesh\": \"" << run.mesh << "\""
+                << ", \"workers\": " << run.workers
+                << ", \"triangles\": " << run.triangles
+                << ", \"nodes\": " << run.nodes
+                << ", \"build_ms\": " << run.build_ms
+                << ", \"refit_ms\": " << run.refit_ms
+                << ", \"sah_cost\": " << run.sah_cost
+                << ", \"refit_sah_cost\": " << run.refit_sah_cost
+                << ", \"rebuilt_sah_cost\": " << run.rebuilt_sah_cost << "}";
+        }
+        out << "\n  ],\n";
+    }
+
+    if (job_scaling.empty() == false)
+    {
+        out << "  \"job_scaling\": [";
+        for (size_t i = 0; i < job_scaling.size(); i++)
+        {
+            const cg::JobBenchmarkResult& run = job_scaling[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"workers\": " << run.workers
+                << ", \"animation_ms\": " << run.animation_ms
+                << ", \"culling_ms\": " << run.culling_ms
+                << ", \"decode_ms\": " << run.decode_ms
+                << ", \"utilisation\": " << run.utilisation << "}";
+        }
+        out << "\n  ],\n";
+    }
+
+    out << "  \"memory\": {"
+        << "\"heap_allocations\": " << allocations.allocations
+        << ", \"heap_bytes\": " << allocations.bytes
+        << ", \"steady_state_allocations\": " << result.steady_state_allocations
+        << ", \"peak_rss_kb\": " << peak_rss_kb()
+        << "}\n}\n";
+
+    return out.good();
+}
+
+/*
+ * Says whether a report made it to disk; the exit status to go with it.
+ */
+static int report_written(const char* path, bool written)
+{
+    if (written == true)
+        std::cout << "Wrote " << path << std::endl;
+    else
+        std::cerr << "Failed to write " << path << std::endl;
+    return written == true ? 0 : 1;
+}
+
+/*
+ * Measured frames past the allocation tracker's warm-up must not touch the
+ * heap; a run where they did fails, however the report turned out.
+ */
+static int check_steady_state(const BenchResult& result)
+{
+    if (result.steady_state_allocations == 0)
+        return 0;
+
+    std::cerr << result.steady_state_allocations << " allocation(s) in steady state frames." << std::endl;
+    return 1;
+}
+
+/*
+ * Sustained throughput to disk. Without --size this runs at 1080p and 4K,
+ * each into its own subdirectory.
+ */
+static bool run_record(const BenchOptions& options, const cg::Scene& scene)
+{
+    struct Size
+    {
+        int width;
+        int height;
+    };
+
+    std::vector<Size> sizes = { { 1920, 1080 }, { 3840, 2160 } };
+    if (options.size_given == true)
+        sizes = { { options.width, options.height } };
+
+    bool succeeded = true;
+    for (const Size& size : sizes)
+    {
+        const std::string directory = std::string(options.record) + "/" + std::to_string(size.width) +
+                                      "x" + std::to_string(size.height);
+        const cg::RecordOptions record =
+        {
+            .directory = directory.c_str(),
+            .format = options.record_format,
+            .frames = options.frames,
+            .width = size.width,
+            .height = size.height
+        };
+
+        const cg::RecordResult result = cg::record_frames(record, scene);
+        if (result.frames == 0 || result.write_failures > 0 || result.readback_failed == true)
+            succeeded = false;
+
+        const double megabytes = static_cast<double>(result.bytes) / (1024.0 * 1024.0);
+        char line[256];
+        std::snprintf(line,
+                      sizeof(line),
+                      "%dx%d %s: %llu frames in %.2f s, %.1f fps, %.1f MB/s, %.1f ms encode per frame, "
+                      "%llu stalls, %llu write failures%s",
+                      size.width,
+                      size.height,
+                      cg::image_extension(options.record_format) + 1,
+                      static_cast<unsigned long long>(result.frames),
+                      result.seconds,
+                      static_cast<double>(result.frames) / result.seconds,
+                      megabytes / result.seconds,
+                      result.encode_ms / static_cast<double>(std::max<uint64_t>(result.frames, 1)),
+                      static_cast<unsigned long long>(result.stalls),
+                      static_cast<unsigned long long>(result.write_failures),
+                      result.readback_failed == true ? ", readback failed" : "");
+        std::cout << line << std::endl;
+    }
+
+    return succeeded;
+}
+
+/*
+ * Descriptor for --stream. Streaming to stdout moves stdout to a private
+ * descriptor and points the original at stderr, so log output can never
+ * end up in the video.
+ */
+static int open_stream(const char* path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    /*
+     * A reader closing the pipe should fail the write, not kill us.
+     */
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (std::string_view(path) == "-")
+    {
+        const int fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        return fd;
+    }
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#elif defined(_WIN32)
+    if (std::string_view(path) == "-")
+    {
+        _setmode(1, _O_BINARY);
+        const int fd = _dup(1);
+        _dup2(2, 1);
+        return fd;
+    }
+    return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    return -1;
+#endif
+}
+
+static void close_stream(int fd)
+{
+#if defined(_WIN32)
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+/*
+ * Render the camera path as fast as possible into the stream. Nothing
+ * throttles rendering but the stream's slots, so the reported rate is
+ * what the whole pipeline sustains.
+ */
+static bool run_stream(const BenchOptions& options, const cg::Scene& scene, int fd)
+{
+    const cg::RenderTarget target = cg::create_render_target(options.width, options.height, "stream");
+    cg::perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    const auto start = std::chrono::steady_clock::now();
+    cg::StreamStats stats{};
+    {
+        cg::FrameStream stream(fd, options.stream_format, options.width, options.height, options.fps, 3);
+        if (stream.valid() == false)
+            return false;
+
+        for (uint64_t frame = 0; frame < options.frames; frame++)
+        {
+            cg::begin_frame_arena();
+            cg::profiler_frame_mark();
+            cg::follow_camera_path(scene, static_cast<float>(frame) / static_cast<float>(options.frames));
+
+            cg::begin_gpu_frame();
+            cg::bind_render_target(target);
+            cg::clear_frame();
+            cg::render_scene();
+            const bool submitted = stream.submit(target);
+            cg::end_gpu_frame();
+
+            if (submitted == false)
+                break;
+        }
+
+        stream.flush();
+        stats = stream.stats();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "%dx%d: %llu frames in %.2f s, %.1f fps, %.1f MB/s, %llu stalls%s",
+                  options.width,
+                  options.height,
+                  static_cast<unsigned long long>(stats.frames),
+                  seconds,
+                  static_cast<double>(stats.frames) / seconds,
+                  static_cast<double>(stats.bytes) / (1024.0 * 1024.0) / seconds,
+                  static_cast<unsigned long long>(stats.stalls),
+                  stats.failed == true ? ", stream failed" : "");
+    std::cerr << line << std::endl;
+
+    cg::RenderTarget destroyed = target;
+    cg::destroy_render_target(destroyed);
+    return stats.failed == false;
+}
+
+static void add_occlusion_stats(BenchResult& result)
+{
+    if (cg::occlusion_settings.enabled == false)
+        return;
+
+    const cg::OcclusionStats& stats = cg::last_occlusion_stats();
+    result.occlusion.occluders += stats.occluders;
+    result.occlusion.occluder_triangles += stats.occluder_triangles;
+    result.occlusion.tested += stats.tested;
+    result.occlusion.frustum_culled += stats.frustum_culled;
+    result.occlusion.occluded += stats.occluded;
+    result.occlusion.raster_ms += stats.raster_ms;
+    result.occlusion.test_ms += stats.test_ms;
+}
+
+static void add_shadow_stats(BenchResult& result)
+{
+    if (cg::shadow_settings.enabled == false)
+        return;
+
+    const cg::ShadowStats& stats = cg::last_shadow_stats();
+    for (int i = 0; i < stats.cascade_count; i++)
+    {
+        const cg::CascadeStats& cascade = stats.cascades[i];
+        if (cascade.rendered == true)
+        {
+            result.shadows[i].renders++;
+            result.shadows[i].draw_calls += cascade.draw_calls;
+        }
+        result.shadows[i].cpu_ms += cascade.cpu_ms;
+    }
+}
+
+/*
+ * Every culling pass is counted once, when its counters come back.
+ */
+static void add_tile_stats(BenchResult& result)
+{
+    if (cg::lighting_settings.path != cg::LightingPath::deferred)
+        return;
+
+    const cg::DeferredStats& stats = cg::last_deferred_stats();
+    TileTotal& tiles = result.tiles;
+    if (stats.tiles_x == 0 || (tiles.passes > 0 && stats.frame == tiles.last_frame))
+        return;
+
+    tiles.passes++;
+    tiles.tiles += static_cast<uint64_t>(stats.tiles_x) * stats.tiles_y;
+    tiles.light_tile_pairs += stats.light_tile_pairs;
+    tiles.overflowed_tiles += stats.overflowed_tiles;
+    tiles.max_tile_lights = std::max(tiles.max_tile_lights, stats.max_tile_lights);
+    tiles.last_frame = stats.frame;
+}
+
+/*
+ * Counters of an assignment on the GPU come back a few frames late and are
+ * counted once; the CPU time is of every frame.
+ */
+static void add_cluster_stats(BenchResult& result)
+{
+    if (cg::lighting_settings.path != cg::LightingPath::clustered)
+        return;
+
+    const cg::ClusterStats& stats = cg::last_cluster_stats();
+    ClusterTotal& clusters = result.clusters;
+    clusters.cpu_ms += stats.cpu_ms;
+    if (clusters.assignments > 0 && stats.frame == clusters.last_frame)
+        return;
+
+    clusters.assignments++;
+    clusters.light_cluster_pairs += stats.light_cluster_pairs;
+    clusters.overflowed_clusters += stats.overflowed_clusters;
+    clusters.max_cluster_lights = std::max(clusters.max_cluster_lights, stats.max_cluster_lights);
+    clusters.last_frame = stats.frame;
+}
+
+/*
+ * run_frames() on the CPU backend. The whole frame is CPU time; there is
+ * nothing to wait for afterwards.
+ */
+static BenchResult run_software_frames(const BenchOptions& options, const cg::Scene& scene)
+{
+    BenchResult result{};
+
+    cg::SoftwareTarget target;
+    cg::resize_software_target(target, options.width, options.height);
+    cg::perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    auto last_present = std::chrono::steady_clock::now();
+    const uint64_t total_frames = options.warm_up + options.frames;
+    for (uint64_t frame = 0; frame < total_frames; frame++)
+    {
+        const bool measured = frame >= options.warm_up;
+        const auto frame_start = std::chrono::steady_clock::now();
+
+        cg::begin_allocation_frame();
+        cg::begin_frame_arena();
+        cg::profiler_frame_mark();
+
+        const float t = static_cast<float>(frame % options.frames) / static_cast<float>(options.frames);
+        cg::follow_camera_path(scene, t);
+
+        cg::software_clear(target);
+        cg::software_render_scene(target, options.software_options);
+
+        const auto present = std::chrono::steady_clock::now();
+        const uint64_t allocations = cg::end_allocation_frame();
+
+        if (measured == true)
+        {
+            cg::record_frame_time(cg::FrameMetric::cpu, elapsed_ms(frame_start, present));
+            cg::record_frame_time(cg::FrameMetric::present, elapsed_ms(last_present, present));
+            cg::end_stats_frame();
+
+            const cg::SoftwareStats& stats = cg::last_software_stats();
+            result.draw_calls += stats.triangles / (cg::cube_vertex_count / 3);
+            result.triangles += stats.triangles;
+            result.software.triangles += stats.triangles;
+            result.software.triangles_culled += stats.triangles_culled;
+            result.software.triangles_clipped += stats.triangles_clipped;
+            result.software.tile_triangles += stats.tile_triangles;
+            result.software.fragments += stats.fragments;
+            add_occlusion_stats(result);
+            if (frame >= cg::warm_up_frames)
+                result.steady_state_allocations += allocations;
+            result.measured_frames++;
+        }
+
+        last_present = present;
+    }
+
+    return result;
+}
+
+/*
+ * --software: everything that needs no GL context.
+ */
+static int run_software(const BenchOptions& options, const cg::Scene& scene)
+{
+    cg::set_profiler_thread_name("Main");
+    cg::init_jobs();
+    if (cg::init_software_renderer() == false)
+    {
+        cg::shutdown_jobs();
+        return 1;
+    }
+
+    const Backend backend =
+    {
+        .context = "none",
+        .renderer = cg::software_renderer_uses_avx2() == true ? "cg software (AVX2)" : "cg software (scalar)",
+        .version = ""
+    };
+    std::cout << "cg_bench: " << backend.renderer << ", " << cg::job_worker_count() << " workers" << std::endl;
+
+    int status = 0;
+    if (options.golden == true)
+    {
+        const int failures = cg::run_golden_tests(options.golden_options);
+        if (failures > 0)
+            std::cout << failures << " golden image test(s) failed." << std::endl;
+        status = failures > 0 ? 1 : 0;
+    }
+    else
+    {
+        std::vector<cg::JobBenchmarkResult> job_scaling;
+        if (options.job_scaling == true)
+            job_scaling = cg::run_job_benchmark(cg::job_worker_count());
+
+        cg::load_scene(scene);
+        BenchResult result = run_software_frames(options, scene);
+        if (options.bvh_benchmark == true)
+            result.bvh_benchmark = cg::run_bvh_benchmark(cg::job_worker_count());
+
+        status = report_written(options.output, write_report(options, backend, result, job_scaling));
+        status |= check_steady_state(result);
+    }
+
+    cg::destroy_all_draw_items();
+    cg::cleanup_software_renderer();
+    cg::shutdown_jobs();
+    return status;
+}
+
+/*
+ * Rays per second over a few passes with the job system restarted at
+ * every worker count, like the job benchmark.
+ */
+static std::vector<TraceScaling> run_trace_scaling(const BenchOptions& options)
+{
+    constexpr int passes = 4;
+    const unsigned int max_workers = cg::job_worker_count();
+
+    std::vector<TraceScaling> scaling;
+    for (unsigned int workers = 1; workers <= max_workers; workers++)
+    {
+        cg::shutdown_jobs();
+        cg::init_jobs(workers);
+        cg::restart_path_tracer();
+
+        uint64_t rays = 0;
+        double ms = 0.0;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            cg::path_trace_pass(options.width, options.height);
+            rays += cg::path_tracer_stats().rays;
+            ms += cg::path_tracer_stats().pass_ms;
+        }
+
+        scaling.push_back(TraceScaling{ workers, static_cast<double>(rays) / (ms / 1000.0) });
+        std::cout << "Path tracer " << workers << " workers: "
+                  << scaling.back().rays_per_second / 1e6 << " Mrays/s" << std::endl;
+    }
+    return scaling;
+}
+
+/*
+ * --path-trace: --frames passes of one sample per pixel from the start of
+ * the camera path, then the image. Needs no GL context.
+ */
+static int run_path_trace(const BenchOptions& options, const cg::Scene& scene)
+{
+    cg::set_profiler_thread_name("Main");
+    cg::init_jobs();
+    if (cg::init_path_tracer() == false)
+    {
+        cg::shutdown_jobs();
+        return 1;
+    }
+
+    const Backend backend = { .context = "none", .renderer = "cg path tracer (two level BVH4)", .version = "" };
+    std::cout << "cg_bench: " << backend.renderer << ", " << cg::job_worker_count() << " workers" << std::endl;
+
+    cg::load_scene(scene);
+    cg::follow_camera_path(scene, 0.0f);
+    cg::perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    BenchResult result{};
+    for (uint64_t pass = 0; pass < options.frames; pass++)
+    {
+        cg::begin_allocation_frame();
+        cg::path_trace_pass(options.width, options.height);
+        const uint64_t allocations = cg::end_allocation_frame();
+
+        const cg::PathTracerStats& stats = cg::path_tracer_stats();
+        cg::record_frame_time(cg::FrameMetric::cpu, stats.pass_ms);
+        cg::end_stats_frame();
+        result.rays += stats.rays;
+        result.trace_ms += stats.pass_ms;
+        if (pass > 0)
+            result.steady_state_allocations += allocations;
+        result.measured_frames++;
+    }
+
+    int status = 0;
+    if (cg::write_png(options.path_trace, cg::path_tracer_view()) == true)
+        std::cout << "Wrote " << options.path_trace << ", "
+                  << static_cast<double>(result.rays) / (result.trace_ms / 1000.0) / 1e6 << " Mrays/s" << std::endl;
+    else
+    {
+        std::cerr << "Failed to write " << options.path_trace << std::endl;
+        status = 1;
+    }
+
+    if (options.job_scaling == true)
+        result.trace_scaling = run_trace_scaling(options);
+    if (options.bvh_benchmark == true)
+        result.bvh_benchmark = cg::run_bvh_benchmark(cg::job_worker_count());
+
+    status |= report_written(options.output, write_report(options, backend, result, {}));
+    status |= check_steady_state(result);
+
+    cg::destroy_all_draw_items();
+    cg::cleanup_path_tracer();
+    cg::shutdown_jobs();
+    return status;
+}
+
+static BenchResult run_frames(const BenchOptions& options, const cg::Scene& scene)
+{
+    BenchResult result{};
+
+    const cg::RenderTarget target = cg::create_render_target(options.width, options.height, "bench");
+    cg::perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    /*
+     * Without a swap chain nothing throttles the CPU. A fence per frame
+     * keeps at most one frame queued, like double buffering would.
+     */
+    GLsync previous_fence = nullptr;
+
+    /*
+     * GPU frames are numbered since the profiler started. A run before
+     * this one ended with an empty frame after its last resolved one.
+     */
+    const cg::GpuFrameResult* previous_run = cg::latest_gpu_frame();
+    const uint64_t first_gpu_frame = previous_run != nullptr ? previous_run->frame + 2 : 0;
+    uint64_t last_gpu_frame = previous_run != nullptr ? previous_run->frame : UINT64_MAX;
+    auto last_present = std::chrono::steady_clock::now();
+
+    /*
+     * Every GPU frame of the measured range, however many resolve at once.
+     */
+    const auto add_gpu_frames = [&](void)
+    {
+        last_gpu_frame = cg::for_each_new_gpu_frame(last_gpu_frame, [&](const cg::GpuFrameResult& frame)
+        {
+            if (frame.frame >= first_gpu_frame + options.warm_up && frame.zone_count > 0)
+                add_gpu_frame(frame, result);
+        });
+    };
+
+    const uint64_t total_frames = options.warm_up + options.frames;
+    for (uint64_t frame = 0; frame < total_frames; frame++)
+    {
+        const bool measured = frame >= options.warm_up;
+        const auto frame_start = std::chrono::steady_clock::now();
+
+        cg::begin_allocation_frame();
+        cg::begin_frame_arena();
+        cg::profiler_frame_mark();
+
+        const float t = static_cast<float>(frame % options.frames) / static_cast<float>(options.frames);
+        cg::follow_camera_path(scene, t);
+        if (options.camera_distance > 0.0f)
+            cg::camera.eye = cg::camera.center +
+                             glm::normalize(cg::camera.eye - cg::camera.center) * options.camera_distance;
+
+        cg::begin_gpu_frame();
+        cg::bind_render_target(target);
+        cg::clear_frame();
+        cg::render_scene();
+        cg::end_gpu_frame();
+
+        const auto cpu_end = std::chrono::steady_clock::now();
+
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        if (previous_fence != nullptr)
+        {
+            glClientWaitSync(previous_fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+            glDeleteSync(previous_fence);
+        }
+        previous_fence = fence;
+
+        const auto present = std::chrono::steady_clock::now();
+
+        cg::end_gl_counter_frame();
+        const uint64_t allocations = cg::end_allocation_frame();
+
+        if (measured == true)
+        {
+            cg::record_frame_time(cg::FrameMetric::cpu, elapsed_ms(frame_start, cpu_end));
+            cg::record_frame_time(cg::FrameMetric::present, elapsed_ms(last_present, present));
+            add_gpu_frames();
+            cg::end_stats_frame();
+
+            const cg::RenderStats& render = cg::last_render_stats();
+            result.draw_calls += render.draw_calls;
+            result.triangles += render.triangles;
+            add_occlusion_stats(result);
+            add_shadow_stats(result);
+            add_tile_stats(result);
+            add_cluster_stats(result);
+            result.sort_ms += cg::last_transparency_stats().sort_ms;
+            result.present_ms += elapsed_ms(last_present, present);
+            result.prepass_frames += cg::last_depth_prepass_stats().enabled == true ? 1 : 0;
+            if (cg::lod_settings.enabled == true)
+            {
+                const cg::LodStats& lod = cg::last_lod_stats();
+                for (int i = 0; i < cg::max_lod_levels; i++)
+                    result.lod_items[i] += lod.items[i];
+                result.lod_switches += lod.switches;
+            }
+            result.cpu_ms += elapsed_ms(frame_start, cpu_end);
+            if (frame >= cg::warm_up_frames)
+                result.steady_state_allocations += allocations;
+            result.measured_frames++;
+
+            const cg::GlCounters& counters = cg::last_frame_gl_counters();
+            result.gl_counters.calls += counters.calls;
+            result.gl_counters.draw_calls += counters.draw_calls;
+            result.gl_counters.compute_dispatches += counters.compute_dispatches;
+            result.gl_counters.memory_barriers += counters.memory_barriers;
+            result.gl_counters.queries += counters.queries;
+            result.gl_counters.primitives += counters.primitives;
+            result.gl_counters.program_binds += counters.program_binds;
+            result.gl_counters.vertex_array_binds += counters.vertex_array_binds;
+            result.gl_counters.buffer_binds += counters.buffer_binds;
+            result.gl_counters.texture_binds += counters.texture_binds;
+            result.gl_counters.framebuffer_binds += counters.framebuffer_binds;
+            result.gl_counters.render_state_changes += counters.render_state_changes;
+            result.gl_counters.uniform_updates += counters.uniform_updates;
+            result.gl_counters.buffer_bytes_uploaded += counters.buffer_bytes_uploaded;
+            result.gl_counters.texture_bytes_uploaded += counters.texture_bytes_uploaded;
+        }
+
+        last_present = present;
+    }
+
+    if (previous_fence != nullptr)
+    {
+        glClientWaitSync(previous_fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(previous_fence);
+    }
+
+    /*
+     * Collect the GPU frames still in flight.
+     */
+    glFinish();
+    cg::begin_gpu_frame();
+    cg::end_gpu_frame();
+    add_gpu_frames();
+
+    cg::RenderTarget destroyed = target;
+    cg::destroy_render_target(destroyed);
+    return result;
+}
+
+/*
+ * --sim-load: the simulation on its own thread as in the application, a
+ * cube following it, and its step load going up past the timestep. The
+ * triple buffer should keep the render thread from ever waiting on the
+ * simulation, so the frame time percentiles must stay within the
+ * tolerances of those without load. 1 if they do not. The scene must
+ * leave room for the cube.
+ */
+static int run_sim_load(const BenchOptions& options, const cg::Scene& scene)
+{
+    static const float loads[] = { 0.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f };
+
+    cg::DrawItem* const cube = cg::create_draw_item(glm::mat4(1.0f));
+    if (cube == nullptr)
+    {
+        std::cerr << "--sim-load needs room for one more draw item than " << options.scene << " has; try --scene city." << std::endl;
+        return 1;
+    }
+
+    const cg::RenderTarget target = cg::create_render_target(options.width, options.height, "sim load");
+    cg::perspective.aspect = static_cast<float>(options.width) / options.height;
+    cg::start_simulation();
+
+    const auto run = [&](float load_ms)
+    {
+        cg::sim_settings.extra_load_ms.store(load_ms);
+
+        cg::TimeHistogram frame_times;
+        GLsync previous_fence = nullptr;
+        uint64_t first_tick = 0;
+        double first_time = cg::sim_clock();
+        auto last_present = std::chrono::steady_clock::now();
+
+        const uint64_t total_frames = options.warm_up + options.frames;
+        for (uint64_t frame = 0; frame < total_frames || cg::sim_clock() - first_time < sim_load_seconds; frame++)
+        {
+            cg::begin_frame_arena();
+            cg::profiler_frame_mark();
+
+            const float t = static_cast<float>(frame % options.frames) / static_cast<float>(options.frames);
+            cg::follow_camera_path(scene, t);
+            const cg::SimSnapshot& snapshot = cg::simulation_snapshot();
+            cube->model = cg::interpolate_model(snapshot, cg::sim_clock());
+            if (frame == options.warm_up)
+            {
+                first_tick = snapshot.current.tick;
+                first_time = cg::sim_clock();
+            }
+
+            cg::begin_gpu_frame();
+            cg::bind_render_target(target);
+            cg::clear_frame();
+            cg::render_scene();
+            cg::end_gpu_frame();
+
+            GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            if (previous_fence != nullptr)
+            {
+                glClientWaitSync(previous_fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+                glDeleteSync(previous_fence);
+            }
+            previous_fence = fence;
+
+            const auto present = std::chrono::steady_clock::now();
+            if (frame >= options.warm_up)
+                frame_times.record(elapsed_ms(last_present, present));
+            last_present = present;
+        }
+
+        glClientWaitSync(previous_fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+        glDeleteSync(previous_fence);
+
+        const uint64_t steps = cg::simulation_snapshot().current.tick - first_tick;
+        return SimLoadRun
+        {
+            .load_ms = load_ms,
+            .p50_ms = frame_times.percentile(0.5),
+            .p99_ms = frame_times.percentile(0.99),
+            .steps_per_second = static_cast<double>(steps) / (cg::sim_clock() - first_time),
+            .stable = true
+        };
+    };
+
+    std::vector<SimLoadRun> runs;
+    int unstable = 0;
+    for (float load : loads)
+    {
+        SimLoadRun sweep = run(load);
+        const SimLoadRun& base = runs.empty() == true ? sweep : runs.front();
+        const double p50_limit = std::max(base.p50_ms * (1.0 + sim_load_p50_tolerance), base.p50_ms + sim_load_slack_ms);
+        const double p99_limit = std::max(base.p99_ms * (1.0 + sim_load_p99_tolerance), base.p99_ms + sim_load_slack_ms);
+        sweep.stable = sweep.p50_ms <= p50_limit && sweep.p99_ms <= p99_limit;
+        unstable += sweep.stable == true ? 0 : 1;
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s    %5.1f ms load: frame p50 %6.2f ms (limit %6.2f), p99 %6.2f ms (limit %6.2f), %5.1f steps/s",
+                      sweep.stable == true ? "PASS" : "FAIL", sweep.load_ms, sweep.p50_ms, p50_limit, sweep.p99_ms, p99_limit,
+                      sweep.steps_per_second);
+        std::cout << line << std::endl;
+        runs.push_back(sweep);
+    }
+
+    cg::stop_simulation();
+    cg::sim_settings.extra_load_ms.store(0.0f);
+    cg::destroy_draw_item(cube);
+    cg::RenderTarget destroyed = target;
+    cg::destroy_render_target(destroyed);
+
+    std::ofstream out(options.output);
+    out << "{\n"
+        << "  \"scene\": \"" << options.scene << "\",\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+        << "  \"timestep_ms\": " << cg::sim_settings.timestep * 1000.0 << ",\n"
+        << "  \"p50_tolerance\": " << sim_load_p50_tolerance << ",\n"
+        << "  \"p99_tolerance\": " << sim_load_p99_tolerance << ",\n"
+        << "  \"slack_ms\": " << sim_load_slack_ms << ",\n"
+        << "  \"sim_load\": [";
+    for (size_t i = 0; i < runs.size(); i++)
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"load_ms\": " << runs[i].load_ms
+            << ", \"p50_ms\": " << runs[i].p50_ms
+            << ", \"p99_ms\": " << runs[i].p99_ms
+            << ", \"steps_per_second\": " << runs[i].steps_per_second
+            << ", \"stable\": " << (runs[i].stable == true ? "true" : "false") << "}";
+    out << "\n  ]\n}\n";
+
+    const int status = report_written(options.output, out.good());
+    if (unstable > 0)
+    {
+        std::cout << unstable << " simulation load(s) moved the frame time too far." << std::endl;
+        return 1;
+    }
+    return status;
+}
+
+/*
+ * --light-sweep: the scene once with the single light, then with more
+ * and more point lights on every path that culls them. Forward shading
+ * of every light is left out; it is far too slow past a few hundred.
+ */
+static bool run_light_sweep(const BenchOptions& options, const cg::Scene& scene)
+{
+    struct SweepPath
+    {
+        const char* name;
+        cg::LightingPath path;
+        cg::ClusterAssignment assignment;
+    };
+    static const SweepPath paths[] =
+    {
+        { "deferred", cg::LightingPath::deferred, cg::ClusterAssignment::gpu },
+        { "clustered gpu", cg::LightingPath::clustered, cg::ClusterAssignment::gpu },
+        { "clustered cpu", cg::LightingPath::clustered, cg::ClusterAssignment::cpu }
+    };
+    static const int light_counts[] = { 256, 1024, 4096, 16384 };
+
+    if (cg::renderer_features().deferred == false || cg::renderer_features().clustered == false)
+    {
+        std::cerr << "--light-sweep needs the deferred and clustered paths." << std::endl;
+        return false;
+    }
+
+    const auto run = [&](const char* name, int lights)
+    {
+        const BenchResult result = run_frames(options, scene);
+        SweepRun sweep =
+        {
+            .path = name,
+            .lights = lights,
+            .gpu_ms = result.gpu_ms / static_cast<double>(std::max<uint64_t>(result.gpu_frames, 1)),
+            .cpu_ms = result.cpu_ms / static_cast<double>(std::max<uint64_t>(result.measured_frames, 1)),
+            .lights_per_list = 0.0
+        };
+        if (result.tiles.tiles > 0)
+            sweep.lights_per_list = static_cast<double>(result.tiles.light_tile_pairs) / result.tiles.tiles;
+        if (result.clusters.assignments > 0)
+            sweep.lights_per_list = static_cast<double>(result.clusters.light_cluster_pairs) /
+                                    static_cast<double>(result.clusters.assignments) / cg::cluster_count;
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-14s %6d lights: GPU %8.2f ms, CPU %6.2f ms, %6.1f lights per list",
+                      sweep.path, sweep.lights, sweep.gpu_ms, sweep.cpu_ms, sweep.lights_per_list);
+        std::cout << line << std::endl;
+        return sweep;
+    };
+
+    std::vector<SweepRun> runs;
+    cg::lighting_settings.path = cg::LightingPath::single;
+    runs.push_back(run("single", 1));
+    for (int lights : light_counts)
+    {
+        for (const SweepPath& path : paths)
+        {
+            cg::lighting_settings.path = path.path;
+            cg::lighting_settings.cluster_assignment = path.assignment;
+            cg::lighting_settings.light_count = lights;
+            runs.push_back(run(path.name, lights));
+        }
+    }
+
+    std::ofstream out(options.output);
+    out << "{\n"
+        << "  \"scene\": \"" << options.scene << "\",\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+        << "  \"light_sweep\": [";
+    for (size_t i = 0; i < runs.size(); i++)
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"path\": \"" << runs[i].path << "\""
+            << ", \"lights\": " << runs[i].lights
+            << ", \"gpu_ms\": " << runs[i].gpu_ms
+            << ", \"cpu_ms\": " << runs[i].cpu_ms
+            << ", \"lights_per_list\": " << runs[i].lights_per_list << "}";
+    out << "\n  ]\n}\n";
+
+    return out.good();
+}
+
+/*
+ * --transparency-sweep: the scene without transparent cubes, then with
+ * more and more of them, sorted and weighted.
+ */
+static bool run_transparency_sweep(const BenchOptions& options, const cg::Scene& scene)
+{
+    static const cg::TransparencyMode modes[] = { cg::TransparencyMode::sorted, cg::TransparencyMode::weighted };
+    static const int object_counts[] = { 1024, 4096, 16384 };
+
+    if (cg::renderer_features().weighted_oit == false)
+    {
+        std::cerr << "--transparency-sweep needs weighted blended OIT." << std::endl;
+        return false;
+    }
+
+    const auto run = [&](const char* mode, int objects)
+    {
+        const BenchResult result = run_frames(options, scene);
+        const double frames = static_cast<double>(std::max<uint64_t>(result.measured_frames, 1));
+        const TransparencySweepRun sweep =
+        {
+            .mode = mode,
+            .objects = objects,
+            .gpu_ms = result.gpu_ms / static_cast<double>(std::max<uint64_t>(result.gpu_frames, 1)),
+            .transparency_ms = pass_ms(result, "transparency"),
+            .cpu_ms = result.cpu_ms / frames,
+            .sort_ms = result.sort_ms / frames,
+            .frame_ms = result.present_ms / frames
+        };
+
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "%-9s %6d cubes: frame %8.2f ms, GPU %8.2f ms (%7.2f transparent), CPU %6.2f ms (%5.2f sorting)",
+                      sweep.mode, sweep.objects, sweep.frame_ms, sweep.gpu_ms, sweep.transparency_ms, sweep.cpu_ms,
+                      sweep.sort_ms);
+        std::cout << line << std::endl;
+        return sweep;
+    };
+
+    std::vector<TransparencySweepRun> runs;
+    cg::transparency_settings.object_count = 0;
+    runs.push_back(run("none", 0));
+    for (int objects : object_counts)
+    {
+        for (cg::TransparencyMode mode : modes)
+        {
+            cg::transparency_settings.mode = mode;
+            cg::transparency_settings.object_count = objects;
+            runs.push_back(run(cg::transparency_mode_name(mode), objects));
+        }
+    }
+    cg::transparency_settings.object_count = 0;
+
+    std::ofstream out(options.output);
+    out << "{\n"
+        << "  \"scene\": \"" << options.scene << "\",\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+        << "  \"opacity\": " << cg::transparency_settings.opacity << ",\n"
+        << "  \"transparency_sweep\": [";
+    for (size_t i = 0; i < runs.size(); i++)
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"mode\": \"" << runs[i].mode << "\""
+            << ", \"objects\": " << runs[i].objects
+            << ", \"gpu_ms\": " << runs[i].gpu_ms
+            << ", \"transparency_gpu_ms\": " << runs[i].transparency_ms
+            << ", \"cpu_ms\": " << runs[i].cpu_ms
+            << ", \"sort_ms\": " << runs[i].sort_ms
+            << ", \"frame_ms\": " << runs[i].frame_ms << "}";
+    out << "\n  ]\n}\n";
+
+    return out.good();
+}
+
+/*
+ * --lod-sweep: the rounded cubes at full detail and at the levels their
+ * screen-space error allows, with the camera farther and farther from
+ * the point its path looks at.
+ */
+static bool run_lod_sweep(BenchOptions options, const cg::Scene& scene)
+{
+    /*
+     * Within the default far plane of 100.
+     */
+    static const float distances[] = { 5.0f, 10.0f, 20.0f, 40.0f, 60.0f, 80.0f };
+
+    const auto run = [&](const char* detail, float distance)
+    {
+        options.camera_distance = distance;
+        const BenchResult result = run_frames(options, scene);
+        const double frames = static_cast<double>(std::max<uint64_t>(result.measured_frames, 1));
+
+        uint64_t items = 0;
+        uint64_t levels = 0;
+        for (int i = 0; i < cg::max_lod_levels; i++)
+        {
+            items += result.lod_items[i];
+            levels += result.lod_items[i] * i;
+        }
+
+        const LodSweepRun sweep =
+        {
+            .distance = distance,
+            .detail = detail,
+            .triangles = static_cast<double>(result.triangles) / frames,
+            .mean_level = static_cast<double>(levels) / static_cast<double>(std::max<uint64_t>(items, 1)),
+            .frame_ms = result.present_ms / frames,
+            .gpu_ms = result.gpu_ms / static_cast<double>(std::max<uint64_t>(result.gpu_frames, 1)),
+            .cpu_ms = result.cpu_ms / frames
+        };
+
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "%-6s %6.0f away: %10.0f triangles, level %4.2f, frame %8.2f ms, GPU %8.2f ms, CPU %6.2f ms",
+                      sweep.detail, sweep.distance, sweep.triangles, sweep.mean_level, sweep.frame_ms, sweep.gpu_ms,
+                      sweep.cpu_ms);
+        std::cout << line << std::endl;
+        return sweep;
+    };
+
+    std::vector<LodSweepRun> runs;
+    cg::lod_settings.enabled = true;
+    if (cg::prepare_mesh_lod() == false)
+    {
+        std::cerr << "--lod-sweep could not build the levels of detail." << std::endl;
+        return false;
+    }
+    for (float distance : distances)
+    {
+        cg::lod_settings.forced_level = 0;
+        runs.push_back(run("full", distance));
+        cg::lod_settings.forced_level = -1;
+        runs.push_back(run("picked", distance));
+    }
+
+    std::ofstream out(options.output);
+    out << "{\n"
+        << "  \"scene\": \"" << options.scene << "\",\n"
+        << "  \"frames\": " << options.frames << ",\n"
+        << "  \"width\": " << options.width << ",\n"
+        << "  \"height\": " << options.height << ",\n"
+        << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n"
+        << "  \"pixel_error\": " << cg::lod_settings.pixel_error << ",\n"
+        << "  \"hysteresis\": " << cg::lod_settings.hysteresis << ",\n"
+        << "  \"lod_sweep\": [";
+    for (size_t i = 0; i < runs.size(); i++)
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"distance\": " << runs[i].distance
+            << ", \"detail\": \"" << runs[i].detail << "\""
+            << ", \"triangles\": " << runs[i].triangles
+            << ", \"mean_level\": " << runs[i].mean_level
+            << ", \"frame_ms\": " << runs[i].frame_ms
+            << ", \"gpu_ms\": " << runs[i].gpu_ms
+            << ", \"cpu_ms\": " << runs[i].cpu_ms << "}";
+    out << "\n  ]\n}\n";
+
+    return out.good();
+}
+
+/*
+ * Everything that renders with GL, once main() has the context, the
+ * renderer, the GPU profiler and the jobs up; it tears them down after.
+ */
+static int run_with_context(const BenchOptions& options, const cg::Scene& scene, int stream_fd)
+{
+    if (options.golden == true)
+    {
+        const int failures = cg::run_golden_tests(options.golden_options);
+        if (failures > 0)
+            std::cout << failures << " golden image test(s) failed." << std::endl;
+        return failures > 0 ? 1 : 0;
+    }
+
+    if (options.record != nullptr)
+    {
+        cg::load_scene(scene);
+        return run_record(options, scene) == true ? 0 : 1;
+    }
+
+    if (options.screenshot != nullptr)
+    {
+        cg::load_scene(scene);
+        cg::follow_camera_path(scene, 0.0f);
+
+        const cg::TiledRenderOptions tiled =
+        {
+            .path = options.screenshot,
+            .width = options.size_given == true ? options.width : 15360,
+            .height = options.size_given == true ? options.height : 8640,
+            .tile_size = options.tile_size,
+            .overlap = options.overlap
+        };
+        const cg::TiledRenderResult result = cg::render_tiled(tiled);
+
+        char line[256];
+        std::snprintf(line,
+                      sizeof(line),
+                      "%s %dx%d in %d x %d tiles of %d, %.2f s",
+                      result.written == true ? "Wrote" : "FAILED to write",
+                      tiled.width,
+                      tiled.height,
+                      result.tiles_x,
+                      result.tiles_y,
+                      result.tile_size,
+                      result.seconds);
+        std::cout << line << " " << options.screenshot << std::endl;
+        return result.written == true ? 0 : 1;
+    }
+
+    if (stream_fd >= 0)
+    {
+        cg::load_scene(scene);
+        const bool streamed = run_stream(options, scene, stream_fd);
+        close_stream(stream_fd);
+        return streamed == true ? 0 : 1;
+    }
+
+    if (options.sim_load == true)
+    {
+        cg::load_scene(scene);
+        return run_sim_load(options, scene);
+    }
+
+    if (options.light_sweep == true)
+    {
+        cg::load_scene(scene);
+        return report_written(options.output, run_light_sweep(options, scene));
+    }
+
+    if (options.transparency_sweep == true)
+    {
+        cg::load_scene(scene);
+        return report_written(options.output, run_transparency_sweep(options, scene));
+    }
+
+    if (options.lod_sweep == true)
+    {
+        cg::load_scene(scene);
+        return report_written(options.output, run_lod_sweep(options, scene));
+    }
+
+    std::vector<cg::JobBenchmarkResult> job_scaling;
+    if (options.job_scaling == true)
+        job_scaling = cg::run_job_benchmark(cg::job_worker_count());
+
+    cg::load_scene(scene);
+    BenchResult result = run_frames(options, scene);
+    if (options.bvh_benchmark == true)
+        result.bvh_benchmark = cg::run_bvh_benchmark(cg::job_worker_count());
+
+    const Backend backend =
+    {
+        .context = cg::offscreen_context_name(),
+        .renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+        .version = reinterpret_cast<const char*>(glGetString(GL_VERSION))
+    };
+    const int status = report_written(options.output, write_report(options, backend, result, job_scaling));
+    return status | check_steady_state(result);
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (parse_options(argc, argv, options) == false)
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (options.triple_buffer == true)
+    {
+        const int failures = cg::run_triple_buffer_checks();
+        if (failures > 0)
+            std::cout << failures << " triple buffer check(s) failed." << std::endl;
+        return failures > 0 ? 1 : 0;
+    }
+
+    const cg::Scene* scene = cg::find_scene(options.scene);
+    if (scene == nullptr)
+    {
+        std::cerr << "Unknown scene " << options.scene << ". Try --list." << std::endl;
+        return 1;
+    }
+
+    cg::occlusion_settings.enabled = options.occlusion;
+    cg::shadow_settings.enabled = options.shadows;
+    cg::lighting_settings.path = options.lighting;
+    cg::lighting_settings.light_count = options.lights;
+    cg::lighting_settings.cluster_assignment = options.cluster_assignment;
+    cg::transparency_settings.mode = options.transparency;
+    cg::transparency_settings.object_count = options.transparent;
+    cg::depth_prepass_settings.mode = options.prepass;
+    cg::depth_prepass_settings.show_overdraw = options.overdraw;
+    cg::lod_settings.enabled = options.lod;
+    cg::lod_settings.forced_level = options.lod_level;
+    cg::lod_settings.pixel_error = options.lod_error;
+    if (options.software == true)
+        return run_software(options, *scene);
+    if (options.path_trace != nullptr)
+        return run_path_trace(options, *scene);
+
+    int stream_fd = -1;
+    if (options.stream != nullptr)
+    {
+        stream_fd = open_stream(options.stream);
+        if (stream_fd < 0)
+        {
+            std::cerr << "Failed to open " << options.stream << std::endl;
+            return 1;
+        }
+    }
+
+    if (cg::create_offscreen_context(options.debug) == false)
+        return 1;
+
+    cg::set_profiler_thread_name("Main");
+    cg::install_gl_counters();
+    if (options.debug == true)
+        cg::init_gl_debug();
+
+    std::cout << "cg_bench: " << glGetString(GL_RENDERER) << " via "
+              << cg::offscreen_context_name() << std::endl;
+
+    if (cg::init_renderer() == false)
+    {
+        cg::destroy_offscreen_context();
+        return 1;
+    }
+
+    cg::init_gpu_profiler();
+    cg::init_jobs();
+
+    const int status = run_with_context(options, *scene, stream_fd);
+
+    cg::shutdown_jobs();
+    cg::cleanup_gpu_profiler();
+    cg::cleanup_renderer();
+    cg::destroy_offscreen_context();
+    return status;
+}
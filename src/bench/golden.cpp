@@ -0,0 +1,345 @@
+#include "golden.h"
+#include "frame_arena.h"
+#include "image.h"
+#include "readback.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "scene.h"
+#include "software_renderer.h"
+#include "structs.h"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace cg
+{
+
+constexpr int golden_width = 320;
+constexpr int golden_height = 240;
+
+/*
+ * Pixels whose colour difference exceeds delta_e_threshold against every
+ * reference pixel in their 3 x 3 neighbourhood count as different, so a
+ * one pixel edge shift between rasterisers is tolerated. A case fails when
+ * more than max_different_fraction of its pixels differ.
+ */
+constexpr float delta_e_threshold = 3.0f;
+constexpr double max_different_fraction = 0.001;
+
+struct GoldenCase
+{
+    const char* name;
+    const char* scene;
+    float path_time;
+};
+
+static constexpr std::array<GoldenCase, 5> golden_cases =
+{{
+    { "cube_front", "cube", 0.0f },
+    { "cube_side", "cube", 0.3f },
+    { "grid_outside", "grid", 0.1f },
+    { "grid_inside", "grid", 0.5f },
+    { "layers", "layers", 0.4f }
+}};
+
+struct Lab
+{
+    float l;
+    float a;
+    float b;
+};
+
+static float srgb_to_linear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float lab_f(float t)
+{
+    return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+}
+
+/*
+ * sRGB to CIELAB with a D65 white point. Euclidean distance in Lab (CIE76
+ * delta E) is roughly perceptually uniform; about 2.3 is just noticeable.
+ */
+static Lab to_lab(const uint8_t* rgba)
+{
+    static const std::array<float, 256> linear = []
+    {
+        std::array<float, 256> table{};
+        for (int i = 0; i < 256; i++)
+            table[i] = srgb_to_linear(i / 255.0f);
+        return table;
+    }();
+
+    const float r = linear[rgba[0]];
+    const float g = linear[rgba[1]];
+    const float b = linear[rgba[2]];
+
+    const float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f;
+    const float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    const float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f;
+
+    const float fx = lab_f(x);
+    const float fy = lab_f(y);
+    const float fz = lab_f(z);
+    return { 116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz) };
+}
+
+static float delta_e(const Lab& p, const Lab& q)
+{
+    const float dl = p.l - q.l;
+    const float da = p.a - q.a;
+    const float db = p.b - q.b;
+    return std::sqrt(dl * dl + da * da + db * db);
+}
+
+struct Comparison
+{
+    uint64_t different;
+    uint64_t tolerated; /* Above the threshold, but matched a neighbour. */
+    float max_delta_e;
+    double mean_delta_e;
+};
+
+/*
+ * The diff image shows the reference in grey, tolerated pixels in yellow
+ * and differing pixels in red.
+ */
+static Comparison compare(const ImageView& actual, const Image& reference, Image& diff)
+{
+    Comparison result{};
+    diff.width = reference.width;
+    diff.height = reference.height;
+    diff.pixels.resize(reference.pixels.size());
+
+    const ImageView expected = view_of(reference);
+    const auto pixel = [](const ImageView& image, int x, int y)
+    {
+        return image.pixels + y * image.stride + x * 4;
+    };
+
+    double total = 0.0;
+    for (int y = 0; y < actual.height; y++)
+    {
+        for (int x = 0; x < actual.width; x++)
+        {
+            const Lab lab = to_lab(pixel(actual, x, y));
+            const float error = delta_e(lab, to_lab(pixel(expected, x, y)));
+            total += error;
+            result.max_delta_e = std::max(result.max_delta_e, error);
+
+            float best = error;
+            for (int dy = -1; dy <= 1 && best > delta_e_threshold; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const int nx = x + dx;
+                    const int ny = y + dy;
+                    if (nx < 0 || ny < 0 || nx >= actual.width || ny >= actual.height)
+                        continue;
+                    best = std::min(best, delta_e(lab, to_lab(pixel(expected, nx, ny))));
+                }
+            }
+
+            const uint8_t* source = pixel(expected, x, y);
+            const uint8_t grey = static_cast<uint8_t>((source[0] + source[1] + source[2]) / 6);
+            uint8_t* out = &diff.pixels[(static_cast<size_t>(y) * diff.width + x) * 4];
+            out[0] = grey;
+            out[1] = grey;
+            out[2] = grey;
+            out[3] = 255;
+
+            if (best > delta_e_threshold)
+            {
+                result.different++;
+                out[0] = 255;
+                out[1] = 0;
+                out[2] = 0;
+            }
+            else if (error > delta_e_threshold)
+            {
+                result.tolerated++;
+                out[0] = 255;
+                out[1] = 220;
+                out[2] = 0;
+            }
+        }
+    }
+
+    result.mean_delta_e = total / (static_cast<double>(actual.width) * actual.height);
+    return result;
+}
+
+static bool check_case(const GoldenOptions& options, const GoldenCase& test, const ImageView& actual)
+{
+    namespace fs = std::filesystem;
+
+    const std::string reference_path =
+        (fs::path(options.reference_directory) / (std::string(test.name) + ".png")).string();
+
+    if (options.bless == true)
+    {
+        fs::create_directories(options.reference_directory);
+        const bool written = write_png(reference_path.c_str(), actual);
+        std::cout << (written == true ? "BLESSED " : "FAILED to write ") << reference_path << std::endl;
+        return written;
+    }
+
+    Image reference;
+    if (load_image(reference_path.c_str(), reference) == false)
+    {
+        std::cout << "MISSING " << test.name << ": no " << reference_path
+                  << ", run with --bless to create it." << std::endl;
+        return false;
+    }
+
+    if (reference.width != actual.width || reference.height != actual.height)
+    {
+        std::cout << "FAIL    " << test.name << ": reference is " << reference.width << "x"
+                  << reference.height << std::endl;
+        return false;
+    }
+
+    Image diff;
+    const Comparison result = compare(actual, reference, diff);
+    const double fraction = static_cast<double>(result.different) /
+                            (static_cast<double>(actual.width) * actual.height);
+    const bool passed = fraction <= max_different_fraction;
+
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "%s %-14s %.3f%% differ, %llu tolerated, max dE %.1f, mean dE %.2f",
+                  passed == true ? "PASS   " : "FAIL   ",
+                  test.name,
+                  fraction * 100.0,
+                  static_cast<unsigned long long>(result.tolerated),
+                  result.max_delta_e,
+                  result.mean_delta_e);
+    std::cout << line << std::endl;
+
+    if (passed == false)
+    {
+        fs::create_directories(options.output_directory);
+        const fs::path output = options.output_directory;
+        write_png((output / (std::string(test.name) + "_actual.png")).string().c_str(), actual);
+        write_png((output / (std::string(test.name) + "_diff.png")).string().c_str(), view_of(diff));
+    }
+
+    return passed;
+}
+
+/*
+ * The CPU backend against the same references, so both backends are held
+ * to one set of images.
+ */
+static int run_software_golden_tests(const GoldenOptions& options)
+{
+    SoftwareTarget target;
+    resize_software_target(target, golden_width, golden_height);
+    perspective.aspect = static_cast<float>(golden_width) / golden_height;
+
+    int failures = 0;
+    for (const GoldenCase& test : golden_cases)
+    {
+        const Scene* scene = find_scene(test.scene);
+        if (scene == nullptr)
+        {
+            std::cout << "FAIL    " << test.name << ": unknown scene " << test.scene << std::endl;
+            failures++;
+            continue;
+        }
+
+        load_scene(*scene);
+        follow_camera_path(*scene, test.path_time);
+        software_clear(target);
+        software_render_scene(target, SoftwareRenderOptions{});
+
+        if (check_case(options, test, software_view(target)) == false)
+            failures++;
+    }
+
+    return failures;
+}
+
+int run_golden_tests(const GoldenOptions& options)
+{
+    if (options.software == true)
+        return run_software_golden_tests(options);
+
+    RenderTarget target = create_render_target(golden_width, golden_height, "golden");
+    if (target.framebuffer == 0)
+        return static_cast<int>(golden_cases.size());
+
+    perspective.aspect = static_cast<float>(golden_width) / golden_height;
+
+    /*
+     * Two slots: the next case renders while the previous one is copied.
+     */
+    ReadbackRing readback(golden_width, golden_height, 2);
+    int failures = 0;
+    bool readback_failed = false;
+
+    /*
+     * A failed wait leaves the frame pending for good, so every case not
+     * yet checked fails and the run stops.
+     */
+    const auto check_oldest = [&](void)
+    {
+        const ReadbackFrame* frame = readback.acquire(true);
+        if (frame == nullptr)
+        {
+            std::cout << "FAIL    readback: waiting for the GPU failed" << std::endl;
+            failures += static_cast<int>(readback.pending());
+            readback_failed = true;
+            return;
+        }
+
+        if (check_case(options, golden_cases[frame->tag], frame->view) == false)
+            failures++;
+        readback.release(frame);
+    };
+
+    for (size_t i = 0; i < golden_cases.size(); i++)
+    {
+        const GoldenCase& test = golden_cases[i];
+        const Scene* scene = find_scene(test.scene);
+        if (scene == nullptr)
+        {
+            std::cout << "FAIL    " << test.name << ": unknown scene " << test.scene << std::endl;
+            failures++;
+            continue;
+        }
+
+        begin_frame_arena();
+        load_scene(*scene);
+        follow_camera_path(*scene, test.path_time);
+
+        bind_render_target(target);
+        clear_frame();
+        render_scene();
+
+        if (readback.pending() == 2)
+            check_oldest();
+        if (readback_failed == true)
+        {
+            failures += static_cast<int>(golden_cases.size() - i);
+            break;
+        }
+        readback.capture(target, i);
+    }
+
+    while (readback.pending() > 0 && readback_failed == false)
+        check_oldest();
+
+    destroy_render_target(target);
+    return failures;
+}
+
+} // namespace cg
@@ -0,0 +1,25 @@
+#ifndef CG_GOLDEN
+#define CG_GOLDEN
+
+namespace cg
+{
+
+struct GoldenOptions
+{
+    const char* reference_directory; /* Stored PNGs, one per case. */
+    const char* output_directory;    /* Actual and diff images of failures. */
+    bool bless;                      /* Overwrite the references instead. */
+    bool software;                   /* Render with the CPU backend. */
+};
+
+/*
+ * Render every reference case into an FBO, read it back asynchronously and
+ * compare it with the stored image. Needs the renderer initialised, or the
+ * software renderer with options.software.
+ * Returns the number of failed cases.
+ */
+int run_golden_tests(const GoldenOptions& options);
+
+} // namespace cg
+
+#endif
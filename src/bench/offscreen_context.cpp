@@ -0,0 +1,232 @@
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "offscreen_context.h"
+#include "structs.h"
+
+#include <cstdint>
+#include <iostream>
+
+#if defined(__linux__)
+#include <dlfcn.h>
+#endif
+
+namespace cg
+{
+
+static const char* s_name = "none";
+static GLFWwindow* s_window = nullptr;
+
+#if defined(__linux__)
+
+/*
+ * The few EGL declarations needed, so no EGL headers or import library
+ * are required. libEGL is loaded at runtime like GLFW does.
+ */
+using EGLDisplay = void*;
+using EGLConfig = void*;
+using EGLContext = void*;
+using EGLSurface = void*;
+using EGLint = int32_t;
+using EGLBoolean = unsigned int;
+using EGLenum = unsigned int;
+
+constexpr EGLint egl_none = 0x3038;
+constexpr EGLint egl_renderable_type = 0x3040;
+constexpr EGLint egl_opengl_bit = 0x0008;
+constexpr EGLenum egl_opengl_api = 0x30A2;
+constexpr EGLenum egl_platform_surfaceless_mesa = 0x31DD;
+constexpr EGLint egl_context_major_version = 0x3098;
+constexpr EGLint egl_context_minor_version = 0x30FB;
+constexpr EGLint egl_context_opengl_profile_mask = 0x30FD;
+constexpr EGLint egl_context_opengl_core_profile_bit = 0x0001;
+constexpr EGLint egl_context_opengl_debug = 0x31B0;
+
+struct Egl
+{
+    void* library;
+    EGLDisplay display;
+    EGLContext context;
+
+    void* (*GetProcAddress)(const char*);
+    EGLDisplay (*GetPlatformDisplayEXT)(EGLenum, void*, const EGLint*);
+    EGLBoolean (*Initialize)(EGLDisplay, EGLint*, EGLint*);
+    EGLBoolean (*Terminate)(EGLDisplay);
+    EGLBoolean (*BindAPI)(EGLenum);
+    EGLBoolean (*ChooseConfig)(EGLDisplay, const EGLint*, EGLConfig*, EGLint, EGLint*);
+    EGLContext (*CreateContext)(EGLDisplay, EGLConfig, EGLContext, const EGLint*);
+    EGLBoolean (*DestroyContext)(EGLDisplay, EGLContext);
+    EGLBoolean (*MakeCurrent)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
+};
+
+static Egl s_egl{};
+
+template <typename T>
+static void load_egl_symbol(T& function, const char* name)
+{
+    function = reinterpret_cast<T>(dlsym(s_egl.library, name));
+}
+
+static void destroy_egl_context(void)
+{
+    if (s_egl.context != nullptr)
+    {
+        s_egl.MakeCurrent(s_egl.display, nullptr, nullptr, nullptr);
+        s_egl.DestroyContext(s_egl.display, s_egl.context);
+    }
+    if (s_egl.display != nullptr)
+        s_egl.Terminate(s_egl.display);
+    if (s_egl.library != nullptr)
+        dlclose(s_egl.library);
+    s_egl = {};
+}
+
+static bool create_egl_context(bool debug)
+{
+    s_egl.library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (s_egl.library == nullptr)
+        return false;
+
+    load_egl_symbol(s_egl.GetProcAddress, "eglGetProcAddress");
+    load_egl_symbol(s_egl.Initialize, "eglInitialize");
+    load_egl_symbol(s_egl.Terminate, "eglTerminate");
+    load_egl_symbol(s_egl.BindAPI, "eglBindAPI");
+    load_egl_symbol(s_egl.ChooseConfig, "eglChooseConfig");
+    load_egl_symbol(s_egl.CreateContext, "eglCreateContext");
+    load_egl_symbol(s_egl.DestroyContext, "eglDestroyContext");
+    load_egl_symbol(s_egl.MakeCurrent, "eglMakeCurrent");
+    if (s_egl.GetProcAddress == nullptr || s_egl.MakeCurrent == nullptr)
+    {
+        destroy_egl_context();
+        return false;
+    }
+
+    s_egl.GetPlatformDisplayEXT = reinterpret_cast<decltype(s_egl.GetPlatformDisplayEXT)>(
+        s_egl.GetProcAddress("eglGetPlatformDisplayEXT"));
+    if (s_egl.GetPlatformDisplayEXT == nullptr)
+    {
+        destroy_egl_context();
+        return false;
+    }
+
+    s_egl.display = s_egl.GetPlatformDisplayEXT(egl_platform_surfaceless_mesa, nullptr, nullptr);
+    if (s_egl.display == nullptr ||
+        s_egl.Initialize(s_egl.display, nullptr, nullptr) == 0 ||
+        s_egl.BindAPI(egl_opengl_api) == 0)
+    {
+        destroy_egl_context();
+        return false;
+    }
+
+    /*
+     * Surfaceless displays may expose no configs at all. A context without
+     * a config (EGL_KHR_no_config_context) is fine since it never has a
+     * surface.
+     */
+    const EGLint config_attributes[] = { egl_renderable_type, egl_opengl_bit, egl_none };
+    EGLConfig config = nullptr;
+    EGLint config_count = 0;
+    s_egl.ChooseConfig(s_egl.display, config_attributes, &config, 1, &config_count);
+    if (config_count == 0)
+        config = nullptr;
+
+    /*
+     * The version the application asks for, else the newest below it that
+     * the shaders can still be lowered to.
+     */
+    const int minors[] = { version.gl_minor, 5 };
+    for (int minor : minors)
+    {
+        const EGLint context_attributes[] =
+        {
+            egl_context_major_version, version.gl_major,
+            egl_context_minor_version, minor,
+            egl_context_opengl_profile_mask, egl_context_opengl_core_profile_bit,
+            egl_context_opengl_debug, debug == true ? 1 : 0,
+            egl_none
+        };
+        s_egl.context = s_egl.CreateContext(s_egl.display, config, nullptr, context_attributes);
+        if (s_egl.context != nullptr)
+            break;
+    }
+
+    if (s_egl.context == nullptr ||
+        s_egl.MakeCurrent(s_egl.display, nullptr, nullptr, s_egl.context) == 0 ||
+        gladLoadGLLoader(reinterpret_cast<GLADloadproc>(s_egl.GetProcAddress)) == 0)
+    {
+        destroy_egl_context();
+        return false;
+    }
+
+    s_name = "EGL surfaceless";
+    return true;
+}
+
+#endif
+
+static bool create_glfw_context(bool debug)
+{
+    if (glfwInit() == GLFW_FALSE)
+        return false;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version.gl_major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version.gl_minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debug);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    s_window = glfwCreateWindow(64, 64, "cg offscreen", nullptr, nullptr);
+    if (s_window == nullptr)
+    {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(s_window);
+    if (gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)) == 0)
+    {
+        destroy_offscreen_context();
+        return false;
+    }
+
+    s_name = "GLFW hidden window";
+    return true;
+}
+
+bool create_offscreen_context(bool debug)
+{
+#if defined(__linux__)
+    if (create_egl_context(debug) == true)
+        return true;
+#endif
+
+    if (create_glfw_context(debug) == true)
+        return true;
+
+    std::cerr << "Failed to create an offscreen GL context." << std::endl;
+    return false;
+}
+
+void destroy_offscreen_context(void)
+{
+#if defined(__linux__)
+    if (s_egl.library != nullptr)
+        destroy_egl_context();
+#endif
+
+    if (s_window != nullptr)
+    {
+        glfwDestroyWindow(s_window);
+        glfwTerminate();
+        s_window = nullptr;
+    }
+    s_name = "none";
+}
+
+const char* offscreen_context_name(void)
+{
+    return s_name;
+}
+
+} // namespace cg
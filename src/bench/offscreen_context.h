@@ -0,0 +1,25 @@
+#ifndef CG_OFFSCREEN_CONTEXT
+#define CG_OFFSCREEN_CONTEXT
+
+namespace cg
+{
+
+/*
+ * A current GL context without a visible window, with GL loaded.
+ *
+ * Linux first tries a surfaceless EGL display, which needs neither X11 nor
+ * Wayland and runs on Mesa's llvmpipe on machines without a GPU. Elsewhere,
+ * or if that fails, a hidden GLFW window provides the context. Either way
+ * there is no usable default framebuffer: render into a RenderTarget.
+ */
+bool create_offscreen_context(bool debug);
+void destroy_offscreen_context(void);
+
+/*
+ * "EGL surfaceless" or "GLFW hidden window".
+ */
+const char* offscreen_context_name(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,156 @@
+#include "recorder.h"
+#include "frame_arena.h"
+#include "jobs.h"
+#include "readback.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * One per readback slot, so the encoded bytes are reused frame to frame.
+ * Frame n always lands in slot n % slot_count.
+ */
+struct EncodeTask
+{
+    ReadbackRing* readback;
+    const ReadbackFrame* frame;
+    const RecordOptions* options;
+    std::vector<uint8_t> encoded;
+    JobCounter counter;
+    double encode_ms;
+    uint64_t bytes;
+    uint64_t write_failures;
+};
+
+static void encode_frame(EncodeTask& task)
+{
+    const auto start = std::chrono::steady_clock::now();
+    encode_image(task.options->format, task.frame->view, task.encoded);
+    task.encode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    /*
+     * The pixels are no longer needed; let the GL thread reuse the slot
+     * while the file is written.
+     */
+    const uint64_t frame = task.frame->tag;
+    task.readback->release(task.frame);
+
+    char path[1024];
+    std::snprintf(path,
+                  sizeof(path),
+                  "%s/frame_%05llu%s",
+                  task.options->directory,
+                  static_cast<unsigned long long>(frame),
+                  image_extension(task.options->format));
+
+    if (write_file(path, task.encoded) == true)
+        task.bytes += task.encoded.size();
+    else
+        task.write_failures++;
+}
+
+RecordResult record_frames(const RecordOptions& options, const Scene& scene)
+{
+    RecordResult result{};
+
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+
+    RenderTarget target = create_render_target(options.width, options.height, "record");
+    if (target.framebuffer == 0)
+        return result;
+
+    perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    /*
+     * One slot per worker keeps every worker encoding, plus two so the GPU
+     * can copy the next frames meanwhile.
+     */
+    const size_t slot_count = std::max<size_t>(3, job_worker_count() + 2);
+    ReadbackRing readback(options.width, options.height, slot_count);
+    std::unique_ptr<EncodeTask[]> tasks = std::make_unique<EncodeTask[]>(slot_count);
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        tasks[i].readback = &readback;
+        tasks[i].options = &options;
+    }
+
+    /*
+     * Hand every finished readback to a worker. A wait that returns
+     * nothing while frames are pending failed, and would fail again.
+     */
+    const auto dispatch = [&](bool wait)
+    {
+        while (const ReadbackFrame* frame = readback.acquire(wait))
+        {
+            EncodeTask* task = &tasks[frame->tag % slot_count];
+            wait_for_counter(task->counter);
+            task->frame = frame;
+            run_job([task]() { encode_frame(*task); }, &task->counter);
+            wait = false;
+        }
+
+        if (wait == true && readback.pending() > 0)
+            result.readback_failed = true;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    uint64_t frame = 0;
+    for (; frame < options.frames && result.readback_failed == false; frame++)
+    {
+        begin_frame_arena();
+        follow_camera_path(scene, static_cast<float>(frame) / static_cast<float>(options.frames));
+
+        bind_render_target(target);
+        clear_frame();
+        render_scene();
+
+        dispatch(false);
+        if (readback.capture(target, frame) == true)
+            continue;
+
+        /*
+         * Every slot is busy. Wait for the one this frame needs; the main
+         * thread runs encode jobs itself while it waits.
+         */
+        result.stalls++;
+        EncodeTask& task = tasks[frame % slot_count];
+        while (result.readback_failed == false && readback.capture(target, frame) == false)
+        {
+            if (task.counter.value.load(std::memory_order_acquire) > 0)
+                wait_for_counter(task.counter);
+            else
+                dispatch(true);
+        }
+    }
+
+    while (readback.pending() > 0 && result.readback_failed == false)
+        dispatch(true);
+    for (size_t i = 0; i < slot_count; i++)
+        wait_for_counter(tasks[i].counter);
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.frames = frame;
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        result.bytes += tasks[i].bytes;
+        result.write_failures += tasks[i].write_failures;
+        result.encode_ms += tasks[i].encode_ms;
+    }
+
+    destroy_render_target(target);
+    return result;
+}
+
+} // namespace cg
@@ -0,0 +1,43 @@
+#ifndef CG_RECORDER
+#define CG_RECORDER
+
+#include "image.h"
+#include "scene.h"
+
+#include <cstdint>
+
+namespace cg
+{
+
+struct RecordOptions
+{
+    const char* directory; /* Created if missing. */
+    ImageFormat format;
+    uint64_t frames;       /* One trip along the scene's camera path. */
+    int width;
+    int height;
+};
+
+struct RecordResult
+{
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t write_failures;
+    uint64_t stalls;       /* Frames that waited for a free readback slot. */
+    double seconds;        /* First frame rendered to last file closed. */
+    double encode_ms;      /* Summed over all frames and workers. */
+    bool readback_failed;  /* Waiting for the GPU failed; frames from there on are missing. */
+};
+
+/*
+ * Render the scene into an FBO and write every frame to
+ * directory/frame_NNNNN.ext. Frames are read back through a ring of pixel
+ * buffers and encoded and written by job workers, so the GL thread only
+ * waits when every slot is still being encoded. Needs the renderer and the
+ * job system initialised.
+ */
+RecordResult record_frames(const RecordOptions& options, const Scene& scene);
+
+} // namespace cg
+
+#endif
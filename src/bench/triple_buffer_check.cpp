@@ -0,0 +1,186 @@
+#include "triple_buffer_check.h"
+#include "triple_buffer.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace cg
+{
+
+/*
+ * Every word holds the same sequence number. A slot that both sides held
+ * at once would show up as a mix of two numbers, or as one that changes
+ * while the reader looks at it.
+ */
+struct CheckPayload
+{
+    std::array<uint64_t, 16> words;
+};
+
+constexpr uint64_t sequence_steps = 100000;
+constexpr uint64_t threaded_writes = 2000000;
+
+static bool report(const char* name, bool passed, const std::string& message)
+{
+    if (passed == true)
+        std::cout << "PASS    " << name << std::endl;
+    else
+        std::cout << "FAIL    " << name << ": " << message << std::endl;
+    return passed;
+}
+
+static bool consistent(const CheckPayload& payload)
+{
+    for (uint64_t word : payload.words)
+    {
+        if (word != payload.words[0])
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Nothing published yet: the reader sees the initial value, in a slot
+ * other than the writer's.
+ */
+static bool check_initial(void)
+{
+    TripleBuffer<int> buffer(7);
+    const int& front = buffer.read();
+    if (front != 7)
+        return report("initial", false, "read " + std::to_string(front) + ", expected 7");
+    if (&front == &buffer.back())
+        return report("initial", false, "reader and writer share a slot");
+    return report("initial", true, "");
+}
+
+/*
+ * Several publishes between two reads: only the last one counts, and a
+ * read with nothing new returns the same value again.
+ */
+static bool check_newest(void)
+{
+    TripleBuffer<int> buffer(0);
+    buffer.write(1);
+    buffer.write(2);
+    buffer.write(3);
+    if (buffer.read() != 3)
+        return report("newest", false, "read " + std::to_string(buffer.read()) + " after publishing 1, 2, 3");
+    if (buffer.read() != 3)
+        return report("newest", false, "a read with nothing new changed the value");
+
+    buffer.write(4);
+    if (buffer.read() != 4)
+        return report("newest", false, "read " + std::to_string(buffer.read()) + " after publishing 4");
+    return report("newest", true, "");
+}
+
+/*
+ * One thread, publishes and reads in a fixed pseudo random order. After
+ * every step the two sides hold different slots, and a read returns the
+ * last value published.
+ */
+static bool check_sequence(void)
+{
+    TripleBuffer<uint64_t> buffer(0);
+    const uint64_t* front = &buffer.read();
+    uint64_t published = 0;
+    uint32_t state = 12345;
+
+    for (uint64_t step = 1; step <= sequence_steps; step++)
+    {
+        state = state * 1664525u + 1013904223u;
+        if ((state >> 16) % 3 != 0)
+        {
+            buffer.write(step);
+            published = step;
+        }
+        else
+        {
+            front = &buffer.read();
+            if (*front != published)
+                return report("sequence", false,
+                              "step " + std::to_string(step) + " read " + std::to_string(*front) +
+                              ", expected " + std::to_string(published));
+        }
+
+        if (front == &buffer.back())
+            return report("sequence", false, "reader and writer share a slot at step " + std::to_string(step));
+    }
+    return report("sequence", true, "");
+}
+
+/*
+ * A writer thread publishes increasing numbers as fast as it can while
+ * this thread reads. Every read must be whole, no older than the one
+ * before, and stay unchanged while it is held. Once the writer is done,
+ * the reader must get its last value.
+ */
+static bool check_threaded(void)
+{
+    TripleBuffer<CheckPayload> buffer(CheckPayload{});
+    std::atomic<bool> done = false;
+
+    std::thread writer([&](void)
+    {
+        for (uint64_t sequence = 1; sequence <= threaded_writes; sequence++)
+        {
+            buffer.back().words.fill(sequence);
+            buffer.publish();
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    std::string failure;
+    uint64_t last = 0;
+    uint64_t reads = 0;
+    while (failure.empty() == true && done.load(std::memory_order_acquire) == false)
+    {
+        const CheckPayload& payload = buffer.read();
+        const uint64_t sequence = payload.words[0];
+        reads++;
+        if (consistent(payload) == false)
+            failure = "torn read near " + std::to_string(sequence);
+        else if (sequence < last)
+            failure = "read " + std::to_string(sequence) + " after " + std::to_string(last);
+
+        /*
+         * Hold the slot a little; the writer must not touch it.
+         */
+        for (int i = 0; i < 64 && failure.empty() == true; i++)
+        {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            if (payload.words[i % payload.words.size()] != sequence)
+                failure = "slot of " + std::to_string(sequence) + " changed while read";
+        }
+        last = sequence;
+    }
+    writer.join();
+    if (failure.empty() == false)
+        return report("threaded", false, failure);
+
+    const uint64_t final_sequence = buffer.read().words[0];
+    if (final_sequence != threaded_writes)
+        return report("threaded", false,
+                      "read " + std::to_string(final_sequence) + " after the last publish of " +
+                      std::to_string(threaded_writes));
+
+    std::cout << "        " << reads << " reads during " << threaded_writes << " publishes" << std::endl;
+    return report("threaded", true, "");
+}
+
+int run_triple_buffer_checks(void)
+{
+    int failures = 0;
+    failures += check_initial() == true ? 0 : 1;
+    failures += check_newest() == true ? 0 : 1;
+    failures += check_sequence() == true ? 0 : 1;
+    failures += check_threaded() == true ? 0 : 1;
+    return failures;
+}
+
+} // namespace cg
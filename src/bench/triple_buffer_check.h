@@ -0,0 +1,18 @@
+#ifndef CG_TRIPLE_BUFFER_CHECK
+#define CG_TRIPLE_BUFFER_CHECK
+
+namespace cg
+{
+
+/*
+ * Behaviour checks of TripleBuffer, the hand-off between the simulation
+ * and render threads: the reader and the writer never hold the same slot,
+ * and the reader gets the newest published value. One case runs a writer
+ * and a reader thread against each other. Needs no GL context.
+ * Returns the number of failed cases.
+ */
+int run_triple_buffer_checks(void);
+
+} // namespace cg
+
+#endif
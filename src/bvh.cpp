@@ -0,0 +1,514 @@
+#include "bvh.h"
+#include "jobs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+
+namespace cg
+{
+
+constexpr size_t bin_count = 16;
+constexpr uint32_t max_leaf_size = 8;
+
+/*
+ * Cost of visiting a node relative to intersecting one primitive.
+ */
+constexpr float traversal_cost = 1.0f;
+
+/*
+ * Nodes with more primitives are binned on the job workers, and subtrees
+ * with more are built as jobs of their own.
+ */
+constexpr uint32_t parallel_bin_threshold = 1 << 16;
+constexpr uint32_t parallel_subtree_threshold = 1 << 12;
+constexpr size_t max_bin_chunks = 64;
+
+struct BinaryNode
+{
+    Bounds bounds;
+    uint32_t left;
+    uint32_t right;
+    uint32_t first;
+    uint32_t count; /* Leaf if not 0. */
+};
+
+struct Bin
+{
+    Bounds bounds;
+    Bounds centroids;
+    uint32_t count;
+};
+
+using BinSet = std::array<std::array<Bin, bin_count>, 3>;
+
+/*
+ * A node still to be split. Its bounds come from the parent's bins, so
+ * every level reads its primitives once to bin and once to partition.
+ */
+struct BuildRange
+{
+    uint32_t index;
+    uint32_t first;
+    uint32_t count;
+    Bounds bounds;
+    Bounds centroids;
+};
+
+struct Builder
+{
+    const Bounds* bounds;
+    std::vector<glm::vec3> centroids;
+    uint32_t* primitives;
+    std::vector<BinaryNode> nodes; /* Sized for the worst case, 2n - 1. */
+    std::atomic<uint32_t> node_count;
+};
+
+static Bounds empty_bounds(void)
+{
+    return Bounds{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+static void grow(Bounds& bounds, const Bounds& other)
+{
+    bounds.min = glm::min(bounds.min, other.min);
+    bounds.max = glm::max(bounds.max, other.max);
+}
+
+static void grow(Bounds& bounds, const glm::vec3& point)
+{
+    bounds.min = glm::min(bounds.min, point);
+    bounds.max = glm::max(bounds.max, point);
+}
+
+static float surface_area(const Bounds& bounds)
+{
+    const glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static size_t bin_of(float value, float min, float scale)
+{
+    return std::min(static_cast<size_t>((value - min) * scale), bin_count - 1);
+}
+
+static void clear_bins(BinSet& bins)
+{
+    for (auto& axis : bins)
+        axis.fill(Bin{ empty_bounds(), empty_bounds(), 0 });
+}
+
+/*
+ * An axis without extent puts everything in bin 0, where no plane splits.
+ */
+static glm::vec3 bin_scale(const Bounds& centroids)
+{
+    const glm::vec3 extent = centroids.max - centroids.min;
+    const float bins = static_cast<float>(bin_count);
+    return glm::vec3(extent.x > 0.0f ? bins / extent.x : 0.0f,
+                     extent.y > 0.0f ? bins / extent.y : 0.0f,
+                     extent.z > 0.0f ? bins / extent.z : 0.0f);
+}
+
+static void bin_primitives(const Builder& builder,
+                           uint32_t first,
+                           uint32_t count,
+                           const Bounds& centroids,
+                           BinSet& bins)
+{
+    const glm::vec3 scale = bin_scale(centroids);
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const uint32_t primitive = builder.primitives[i];
+        const glm::vec3& c = builder.centroids[primitive];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            Bin& bin = bins[axis][bin_of(c[axis], centroids.min[axis], scale[axis])];
+            grow(bin.bounds, builder.bounds[primitive]);
+            grow(bin.centroids, c);
+            bin.count++;
+        }
+    }
+}
+
+static void range_bounds(const Builder& builder, uint32_t first, uint32_t count, Bounds& bounds, Bounds& centroids)
+{
+    bounds = empty_bounds();
+    centroids = empty_bounds();
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        grow(bounds, builder.bounds[builder.primitives[i]]);
+        grow(centroids, builder.centroids[builder.primitives[i]]);
+    }
+}
+
+/*
+ * Split the range of primitives at the cheapest of bin_count - 1 planes
+ * per axis, or make it a leaf if that is cheaper.
+ */
+static void build_node(Builder& builder, const BuildRange& range)
+{
+    const uint32_t first = range.first;
+    const uint32_t count = range.count;
+    BinaryNode& node = builder.nodes[range.index];
+    node.bounds = range.bounds;
+    node.first = first;
+    node.count = count;
+    if (count <= 2)
+        return;
+
+    BinSet bins;
+    clear_bins(bins);
+    if (count < parallel_bin_threshold)
+    {
+        bin_primitives(builder, first, count, range.centroids, bins);
+    }
+    else
+    {
+        std::vector<BinSet> partial(max_bin_chunks);
+        const uint32_t chunk = static_cast<uint32_t>((count + max_bin_chunks - 1) / max_bin_chunks);
+        parallel_for(max_bin_chunks, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const uint32_t chunk_first = first + static_cast<uint32_t>(i) * chunk;
+                const uint32_t chunk_end = std::min(chunk_first + chunk, first + count);
+                clear_bins(partial[i]);
+                if (chunk_first < chunk_end)
+                    bin_primitives(builder, chunk_first, chunk_end - chunk_first, range.centroids, partial[i]);
+            }
+        });
+
+        for (const BinSet& set : partial)
+        {
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                for (size_t i = 0; i < bin_count; i++)
+                {
+                    grow(bins[axis][i].bounds, set[axis][i].bounds);
+                    grow(bins[axis][i].centroids, set[axis][i].centroids);
+                    bins[axis][i].count += set[axis][i].count;
+                }
+            }
+        }
+    }
+
+    int best_axis = -1;
+    size_t best_split = 0;
+    float best_cost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        /*
+         * Sweep from the right, then from the left. Split i puts bins
+         * below i on the left.
+         */
+        std::array<float, bin_count> right_cost{};
+        Bounds right = empty_bounds();
+        uint32_t right_count = 0;
+        for (size_t i = bin_count - 1; i > 0; i--)
+        {
+            grow(right, bins[axis][i].bounds);
+            right_count += bins[axis][i].count;
+            right_cost[i] = surface_area(right) * static_cast<float>(right_count);
+        }
+
+        Bounds left = empty_bounds();
+        uint32_t left_count = 0;
+        for (size_t i = 1; i < bin_count; i++)
+        {
+            grow(left, bins[axis][i - 1].bounds);
+            left_count += bins[axis][i - 1].count;
+            if (left_count == 0 || left_count == count)
+                continue;
+
+            const float cost = surface_area(left) * static_cast<float>(left_count) + right_cost[i];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = i;
+            }
+        }
+    }
+
+    const float area = surface_area(range.bounds);
+    const float split_cost = area > 0.0f ? traversal_cost + best_cost / area : FLT_MAX;
+    if (split_cost >= static_cast<float>(count) && count <= max_leaf_size)
+        return;
+
+    const uint32_t left_index = builder.node_count.fetch_add(2, std::memory_order_relaxed);
+    BuildRange left{ .index = left_index, .first = first, .count = 0, .bounds = empty_bounds(), .centroids = empty_bounds() };
+    BuildRange right{ .index = left_index + 1, .first = 0, .count = 0, .bounds = empty_bounds(), .centroids = empty_bounds() };
+
+    if (best_axis >= 0)
+    {
+        const float scale = bin_scale(range.centroids)[best_axis];
+        const float min = range.centroids.min[best_axis];
+        const glm::vec3* centroids = builder.centroids.data();
+        const auto below = [&](uint32_t primitive)
+        {
+            return bin_of(centroids[primitive][best_axis], min, scale) < best_split;
+        };
+        uint32_t* primitives = builder.primitives;
+        right.first = static_cast<uint32_t>(std::partition(primitives + first, primitives + first + count, below) - primitives);
+
+        for (size_t i = 0; i < bin_count; i++)
+        {
+            BuildRange& side = i < best_split ? left : right;
+            grow(side.bounds, bins[best_axis][i].bounds);
+            grow(side.centroids, bins[best_axis][i].centroids);
+        }
+    }
+    else
+    {
+        /*
+         * Every centroid in one place: no plane separates them, so split
+         * the range in half.
+         */
+        right.first = first + count / 2;
+        range_bounds(builder, first, right.first - first, left.bounds, left.centroids);
+        range_bounds(builder, right.first, first + count - right.first, right.bounds, right.centroids);
+    }
+    left.count = right.first - first;
+    right.count = first + count - right.first;
+
+    node.left = left.index;
+    node.right = right.index;
+    node.count = 0;
+
+    if (count < parallel_subtree_threshold)
+    {
+        build_node(builder, left);
+        build_node(builder, right);
+        return;
+    }
+
+    /*
+     * left stays on this stack until the job is done.
+     */
+    JobCounter counter;
+    Builder* shared = &builder;
+    const BuildRange* pending = &left;
+    run_job([shared, pending]() { build_node(*shared, *pending); }, &counter);
+    build_node(builder, right);
+    wait_for_counter(counter);
+}
+
+static void set_child(Bvh4Node& node, size_t slot, const Bounds& bounds, uint32_t child, uint32_t count)
+{
+    node.min_x[slot] = bounds.min.x;
+    node.min_y[slot] = bounds.min.y;
+    node.min_z[slot] = bounds.min.z;
+    node.max_x[slot] = bounds.max.x;
+    node.max_y[slot] = bounds.max.y;
+    node.max_z[slot] = bounds.max.z;
+    node.child[slot] = child;
+    node.count[slot] = count;
+}
+
+/*
+ * Pull grandchildren up until the node has four children, opening the
+ * largest first.
+ */
+static uint32_t collapse(const std::vector<BinaryNode>& binary, uint32_t index, Bvh& bvh)
+{
+    std::array<uint32_t, 4> slots{};
+    size_t slot_count = 0;
+    if (binary[index].count > 0)
+    {
+        slots[slot_count++] = index;
+    }
+    else
+    {
+        slots[slot_count++] = binary[index].left;
+        slots[slot_count++] = binary[index].right;
+    }
+
+    while (slot_count < slots.size())
+    {
+        size_t largest = slots.size();
+        float largest_area = -1.0f;
+        for (size_t i = 0; i < slot_count; i++)
+        {
+            const BinaryNode& node = binary[slots[i]];
+            if (node.count == 0 && surface_area(node.bounds) > largest_area)
+            {
+                largest = i;
+                largest_area = surface_area(node.bounds);
+            }
+        }
+        if (largest == slots.size())
+            break;
+
+        const BinaryNode& opened = binary[slots[largest]];
+        slots[largest] = opened.left;
+        slots[slot_count++] = opened.right;
+    }
+
+    const uint32_t node_index = static_cast<uint32_t>(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+    for (size_t i = 0; i < slots.size(); i++)
+        set_child(bvh.nodes[node_index], i, empty_bounds(), bvh_empty, 0);
+
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        const BinaryNode& child = binary[slots[i]];
+        if (child.count > 0)
+        {
+            set_child(bvh.nodes[node_index], i, child.bounds, child.first, child.count);
+            continue;
+        }
+
+        const uint32_t child_index = collapse(binary, slots[i], bvh);
+        set_child(bvh.nodes[node_index], i, child.bounds, child_index, 0);
+    }
+
+    return node_index;
+}
+
+static Bounds slot_bounds(const Bvh4Node& node, size_t slot)
+{
+    return Bounds
+    {
+        glm::vec3(node.min_x[slot], node.min_y[slot], node.min_z[slot]),
+        glm::vec3(node.max_x[slot], node.max_y[slot], node.max_z[slot])
+    };
+}
+
+static Bounds node_bounds(const Bvh4Node& node)
+{
+    Bounds bounds = empty_bounds();
+    for (size_t i = 0; i < 4; i++)
+    {
+        if (node.child[i] != bvh_empty)
+            grow(bounds, slot_bounds(node, i));
+    }
+    return bounds;
+}
+
+void build_bvh(const Bounds* bounds, size_t count, Bvh& bvh)
+{
+    bvh.nodes.clear();
+    bvh.primitives.resize(count);
+    for (size_t i = 0; i < count; i++)
+        bvh.primitives[i] = static_cast<uint32_t>(i);
+
+    if (count == 0)
+    {
+        bvh.nodes.emplace_back();
+        for (size_t i = 0; i < 4; i++)
+            set_child(bvh.nodes[0], i, empty_bounds(), bvh_empty, 0);
+        return;
+    }
+
+    Builder builder;
+    builder.bounds = bounds;
+    builder.centroids.resize(count);
+    builder.primitives = bvh.primitives.data();
+    builder.nodes.resize(2 * count);
+    builder.node_count.store(1, std::memory_order_relaxed);
+
+    BuildRange root{ .index = 0, .first = 0, .count = static_cast<uint32_t>(count), .bounds = empty_bounds(), .centroids = empty_bounds() };
+    std::array<BuildRange, max_bin_chunks> partial;
+    const size_t chunk = (count + max_bin_chunks - 1) / max_bin_chunks;
+    parallel_for(max_bin_chunks, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            partial[i].bounds = empty_bounds();
+            partial[i].centroids = empty_bounds();
+            for (size_t p = i * chunk; p < std::min((i + 1) * chunk, count); p++)
+            {
+                builder.centroids[p] = (bounds[p].min + bounds[p].max) * 0.5f;
+                grow(partial[i].bounds, bounds[p]);
+                grow(partial[i].centroids, builder.centroids[p]);
+            }
+        }
+    });
+    for (const BuildRange& range : partial)
+    {
+        grow(root.bounds, range.bounds);
+        grow(root.centroids, range.centroids);
+    }
+
+    build_node(builder, root);
+
+    const size_t binary_count = builder.node_count.load(std::memory_order_relaxed);
+    bvh.nodes.reserve(binary_count / 2 + 1);
+    collapse(builder.nodes, 0, bvh);
+}
+
+/*
+ * collapse() adds a node before its children, so walking backwards sees
+ * every child refitted before its parent.
+ */
+void refit_bvh(const Bounds* bounds, Bvh& bvh)
+{
+    for (size_t n = bvh.nodes.size(); n-- > 0;)
+    {
+        Bvh4Node& node = bvh.nodes[n];
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (node.child[i] == bvh_empty)
+                continue;
+
+            Bounds refitted = empty_bounds();
+            if (node.count[i] == 0)
+            {
+                refitted = node_bounds(bvh.nodes[node.child[i]]);
+            }
+            else
+            {
+                for (uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; p++)
+                    grow(refitted, bounds[bvh.primitives[p]]);
+            }
+            set_child(node, i, refitted, node.child[i], node.count[i]);
+        }
+    }
+}
+
+float bvh_sah_cost(const Bvh& bvh)
+{
+    const float root_area = surface_area(bvh_bounds(bvh));
+    if (root_area <= 0.0f)
+        return 0.0f;
+
+    double cost = traversal_cost;
+    for (const Bvh4Node& node : bvh.nodes)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            if (node.child[i] == bvh_empty)
+                continue;
+
+            const double area = surface_area(slot_bounds(node, i)) / root_area;
+            cost += area * (node.count[i] == 0 ? traversal_cost : static_cast<float>(node.count[i]));
+        }
+    }
+    return static_cast<float>(cost);
+}
+
+Bounds bvh_bounds(const Bvh& bvh)
+{
+    return bvh.nodes.empty() == true ? empty_bounds() : node_bounds(bvh.nodes[0]);
+}
+
+/*
+ * Each output extent is the sum of the smaller and of the larger products
+ * per matrix entry (Arvo).
+ */
+Bounds transform_bounds(const Bounds& bounds, const glm::mat4& transform)
+{
+    Bounds result{ glm::vec3(transform[3]), glm::vec3(transform[3]) };
+    for (int column = 0; column < 3; column++)
+    {
+        const glm::vec3 axis(transform[column]);
+        const glm::vec3 a = axis * bounds.min[column];
+        const glm::vec3 b = axis * bounds.max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
+} // namespace cg
@@ -0,0 +1,82 @@
+#ifndef CG_BVH
+#define CG_BVH
+
+#include "glm/ext.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+struct Bounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+/*
+ * Four children per node. Bounds are stored by axis, so one SSE compare
+ * tests a ray against all four. A node is exactly two cache lines: the
+ * bounds fill the first and a half, the links the rest.
+ */
+struct alignas(64) Bvh4Node
+{
+    std::array<float, 4> min_x;
+    std::array<float, 4> min_y;
+    std::array<float, 4> min_z;
+    std::array<float, 4> max_x;
+    std::array<float, 4> max_y;
+    std::array<float, 4> max_z;
+    std::array<uint32_t, 4> child; /* Node index, or first primitive of a leaf. */
+    std::array<uint32_t, 4> count; /* Primitives of a leaf, 0 for a node. */
+};
+static_assert(sizeof(Bvh4Node) == 128, "Bvh4Node should fill two cache lines.");
+
+/*
+ * Child of an unused slot. Its bounds are empty, so no ray enters it.
+ */
+constexpr uint32_t bvh_empty = UINT32_MAX;
+
+struct Bvh
+{
+    std::vector<Bvh4Node> nodes;      /* nodes[0] is the root. */
+    std::vector<uint32_t> primitives; /* Leaves are ranges of this. */
+};
+
+/*
+ * Surface area heuristic over the primitives' bounds, binned by centroid,
+ * into a binary tree that is then collapsed to four children per node.
+ * Large ranges are binned and large subtrees built on the job workers, so
+ * the job system must be running. Reuses the storage in bvh.
+ */
+void build_bvh(const Bounds* bounds, size_t count, Bvh& bvh);
+
+/*
+ * Recompute every node's bounds from the primitives' new bounds, keeping
+ * the tree. Linear in the node count; the tree gets worse as primitives
+ * drift from where they were built, which bvh_sah_cost() shows.
+ */
+void refit_bvh(const Bounds* bounds, Bvh& bvh);
+
+/*
+ * Expected cost of a random ray through the tree, in primitive tests:
+ * every node and leaf weighted by the chance of hitting its bounds given
+ * the root was hit. Lower is better.
+ */
+float bvh_sah_cost(const Bvh& bvh);
+
+Bounds bvh_bounds(const Bvh& bvh);
+
+/*
+ * Bounds of the box after transform. For the top level of instanced
+ * objects: bottom level trees stay in object space and only the instances'
+ * bounds change when they move.
+ */
+Bounds transform_bounds(const Bounds& bounds, const glm::mat4& transform);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,147 @@
+#include "bvh_benchmark.h"
+#include "bvh.h"
+#include "jobs.h"
+
+#include "glm/ext.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace cg
+{
+
+/*
+ * Both meshes are grids of quads, two triangles each: 2 * 707 * 707 and
+ * 2 * 500 * 1000 triangles.
+ */
+struct GridMesh
+{
+    const char* name;
+    size_t columns;
+    size_t rows;
+    glm::vec3 (*position)(float u, float v, float time);
+};
+
+/*
+ * Rolling hills. Deforming moves vertices up and down only, so refitted
+ * boxes stay close to fresh ones.
+ */
+static glm::vec3 terrain(float u, float v, float time)
+{
+    const float height = 2.0f * std::sin(u * 25.0f + time) * std::cos(v * 19.0f - time) +
+                         0.5f * std::sin((u + v) * 90.0f + 2.0f * time);
+    return glm::vec3((u - 0.5f) * 100.0f, height, (v - 0.5f) * 100.0f);
+}
+
+/*
+ * A bumpy sphere that twists about its axis as time goes on, which moves
+ * triangles far from the ones they were grouped with.
+ */
+static glm::vec3 twisted_sphere(float u, float v, float time)
+{
+    const float theta = v * 3.14159265f;
+    const float y = std::cos(theta);
+    const float phi = u * 6.28318531f + time * y * 3.0f;
+    const float radius = 10.0f + 0.3f * std::sin(u * 160.0f) * std::sin(v * 80.0f);
+    return radius * glm::vec3(std::sin(theta) * std::cos(phi), y, std::sin(theta) * std::sin(phi));
+}
+
+static const GridMesh meshes[] =
+{
+    { "terrain", 707, 707, terrain },
+    { "twisted sphere", 1000, 500, twisted_sphere }
+};
+
+static double time_ms(const auto& function)
+{
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    function();
+    return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+/*
+ * Bounds of every triangle with the mesh at time.
+ */
+static void triangle_bounds(const GridMesh& mesh, float time, std::vector<Bounds>& bounds)
+{
+    bounds.resize(mesh.columns * mesh.rows * 2);
+    parallel_for(mesh.rows, 16, [&](size_t begin, size_t end)
+    {
+        for (size_t row = begin; row < end; row++)
+        {
+            for (size_t column = 0; column < mesh.columns; column++)
+            {
+                const auto corner = [&](size_t x, size_t y)
+                {
+                    return mesh.position(static_cast<float>(x) / mesh.columns,
+                                         static_cast<float>(y) / mesh.rows,
+                                         time);
+                };
+                const glm::vec3 p00 = corner(column, row);
+                const glm::vec3 p10 = corner(column + 1, row);
+                const glm::vec3 p01 = corner(column, row + 1);
+                const glm::vec3 p11 = corner(column + 1, row + 1);
+
+                const size_t quad = (row * mesh.columns + column) * 2;
+                bounds[quad] = { glm::min(p00, glm::min(p10, p11)), glm::max(p00, glm::max(p10, p11)) };
+                bounds[quad + 1] = { glm::min(p00, glm::min(p11, p01)), glm::max(p00, glm::max(p11, p01)) };
+            }
+        }
+    });
+}
+
+std::vector<BvhBenchmarkResult> run_bvh_benchmark(unsigned int max_workers)
+{
+    std::vector<Bounds> rest;
+    std::vector<Bounds> deformed;
+    Bvh bvh;
+    Bvh rebuilt;
+
+    std::vector<BvhBenchmarkResult> results;
+    for (unsigned int workers = 1; workers <= max_workers; workers++)
+    {
+        shutdown_jobs();
+        init_jobs(workers);
+
+        for (const GridMesh& mesh : meshes)
+        {
+            triangle_bounds(mesh, 0.0f, rest);
+            triangle_bounds(mesh, 1.0f, deformed);
+
+            BvhBenchmarkResult result =
+            {
+                .mesh = mesh.name,
+                .workers = workers,
+                .triangles = rest.size(),
+                .nodes = 0,
+                .build_ms = time_ms([&]() { build_bvh(rest.data(), rest.size(), bvh); }),
+                .refit_ms = 0.0,
+                .sah_cost = bvh_sah_cost(bvh),
+                .refit_sah_cost = 0.0f,
+                .rebuilt_sah_cost = 0.0f
+            };
+            result.nodes = bvh.nodes.size();
+            result.refit_ms = time_ms([&]() { refit_bvh(deformed.data(), bvh); });
+            result.refit_sah_cost = bvh_sah_cost(bvh);
+            build_bvh(deformed.data(), deformed.size(), rebuilt);
+            result.rebuilt_sah_cost = bvh_sah_cost(rebuilt);
+
+            std::cout << "BVH benchmark " << workers << " workers, " << result.mesh << ": "
+                      << result.triangles << " triangles, "
+                      << result.nodes << " nodes, "
+                      << "build " << result.build_ms << " ms, "
+                      << "refit " << result.refit_ms << " ms, "
+                      << "SAH cost " << result.sah_cost
+                      << " (deformed: refit " << result.refit_sah_cost
+                      << ", rebuilt " << result.rebuilt_sah_cost << ")" << std::endl;
+
+            results.push_back(result);
+        }
+    }
+
+    return results;
+}
+
+} // namespace cg
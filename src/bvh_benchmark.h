@@ -0,0 +1,34 @@
+#ifndef CG_BVH_BENCHMARK
+#define CG_BVH_BENCHMARK
+
+#include <cstddef>
+#include <vector>
+
+namespace cg
+{
+
+struct BvhBenchmarkResult
+{
+    const char* mesh;
+    unsigned int workers;
+    size_t triangles;
+    size_t nodes;
+    double build_ms;
+    double refit_ms;
+    float sah_cost;         /* As built. */
+    float refit_sah_cost;   /* Refitted after the mesh deformed. */
+    float rebuilt_sah_cost; /* Built again for the deformed mesh. */
+};
+
+/*
+ * Build BVHs over procedural meshes of about a million triangles with 1 to
+ * max_workers workers, then deform each mesh and compare a refit with a
+ * rebuild. Restarts the job system for every worker count and leaves it
+ * running with max_workers workers. Must be called from the main thread
+ * while no jobs are in flight.
+ */
+std::vector<BvhBenchmarkResult> run_bvh_benchmark(unsigned int max_workers);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,494 @@
+#include "glad/glad.h"
+
+#include "clustered.h"
+#include "cpu_features.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "jobs.h"
+#include "lights.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+static_assert(cluster_tiles_x == 16, "A row of clusters is tested as two groups of 8 and kept in 16 bits.");
+
+/*
+ * Written by every assignment on the GPU, as cluster_assign_c.glsl
+ * declares them.
+ */
+struct ClusterCounters
+{
+    uint32_t light_cluster_pairs;
+    uint32_t max_cluster_lights;
+    uint32_t overflowed_clusters;
+    uint32_t padding;
+};
+
+constexpr size_t counter_slots = 3;
+
+struct CounterSlot
+{
+    unsigned int buffer;
+    GLsync fence;
+    uint64_t frame;
+};
+
+/*
+ * View space boxes of one row of clusters, as arrays so a light is tested
+ * against eight of them at once.
+ */
+struct ClusterRow
+{
+    alignas(32) std::array<float, cluster_tiles_x> min_x;
+    alignas(32) std::array<float, cluster_tiles_x> max_x;
+    alignas(32) std::array<float, cluster_tiles_x> min_y;
+    alignas(32) std::array<float, cluster_tiles_x> max_y;
+    alignas(32) std::array<float, cluster_tiles_x> min_z;
+    alignas(32) std::array<float, cluster_tiles_x> max_z;
+};
+
+/*
+ * A light in view space and the slices it reaches; its masks start at
+ * first_mask, cluster_tiles_y of them per slice.
+ */
+struct LightSpan
+{
+    glm::vec3 center;
+    float radius;
+    int first_slice;
+    int last_slice;
+    size_t first_mask;
+};
+
+using RowMaskFunction = uint32_t (*)(const ClusterRow& row, const glm::vec3& center, float radius);
+
+static unsigned int s_program = 0;
+static unsigned int s_assign_program = 0;
+static unsigned int s_grid_buffer = 0;  /* Offset and count of every cluster. */
+static unsigned int s_index_buffer = 0; /* The lists, back to back. */
+static std::array<CounterSlot, counter_slots> s_counters{};
+static uint64_t s_frame = 0;
+static ClusterStats s_stats{};
+static std::array<int, 4> s_viewport{};
+
+static std::vector<ClusterRow> s_rows;
+static glm::mat4 s_rows_projection = glm::mat4(0.0f);
+static glm::vec2 s_rows_depth_range = glm::vec2(0.0f);
+static std::vector<glm::uvec2> s_grid;
+static std::vector<uint32_t> s_cursors;
+static std::vector<uint32_t> s_indices;
+static std::vector<LightSpan> s_spans;
+static std::vector<uint16_t> s_masks; /* Sized for every light reaching every slice. */
+
+/*
+ * Where slice starts; slice_of() is its inverse.
+ */
+static float slice_depth(int slice)
+{
+    return perspective.z_near * std::pow(perspective.z_far / perspective.z_near,
+                                         static_cast<float>(slice) / static_cast<float>(cluster_slices));
+}
+
+static int slice_of(float depth)
+{
+    const float slice = std::log(depth / perspective.z_near) /
+                        std::log(perspective.z_far / perspective.z_near) * static_cast<float>(cluster_slices);
+    return std::clamp(static_cast<int>(std::floor(slice)), 0, cluster_slices - 1);
+}
+
+/*
+ * Boxes around the part of the frustum every cluster covers. They only
+ * change with the projection.
+ */
+static void build_cluster_rows(const glm::mat4& projection)
+{
+    const glm::mat4 inverse_projection = glm::inverse(projection);
+    const auto view_ray = [&](float x, float y)
+    {
+        const glm::vec4 point = inverse_projection * glm::vec4(x, y, -1.0f, 1.0f);
+        const glm::vec3 position = glm::vec3(point) / point.w;
+        return position / -position.z;
+    };
+
+    for (int slice = 0; slice < cluster_slices; slice++)
+    {
+        const float start = slice_depth(slice);
+        const float end = slice_depth(slice + 1);
+        for (int y = 0; y < cluster_tiles_y; y++)
+        {
+            ClusterRow& row = s_rows[slice * cluster_tiles_y + y];
+            for (int x = 0; x < cluster_tiles_x; x++)
+            {
+                const float x0 = static_cast<float>(x) / cluster_tiles_x * 2.0f - 1.0f;
+                const float x1 = static_cast<float>(x + 1) / cluster_tiles_x * 2.0f - 1.0f;
+                const float y0 = static_cast<float>(y) / cluster_tiles_y * 2.0f - 1.0f;
+                const float y1 = static_cast<float>(y + 1) / cluster_tiles_y * 2.0f - 1.0f;
+                const std::array<glm::vec3, 4> rays = { view_ray(x0, y0), view_ray(x1, y0),
+                                                        view_ray(x0, y1), view_ray(x1, y1) };
+
+                glm::vec3 low = rays[0] * start;
+                glm::vec3 high = low;
+                for (const glm::vec3& ray : rays)
+                {
+                    low = glm::min(low, glm::min(ray * start, ray * end));
+                    high = glm::max(high, glm::max(ray * start, ray * end));
+                }
+                row.min_x[x] = low.x;
+                row.max_x[x] = high.x;
+                row.min_y[x] = low.y;
+                row.max_y[x] = high.y;
+                row.min_z[x] = low.z;
+                row.max_z[x] = high.z;
+            }
+        }
+    }
+
+    s_rows_projection = projection;
+    s_rows_depth_range = glm::vec2(perspective.z_near, perspective.z_far);
+}
+
+/*
+ * Bit x is set where the sphere touches the box of cluster x of the row.
+ */
+static uint32_t row_mask_scalar(const ClusterRow& row, const glm::vec3& center, float radius)
+{
+    uint32_t mask = 0;
+    for (int x = 0; x < cluster_tiles_x; x++)
+    {
+        const float dx = std::max(std::max(row.min_x[x] - center.x, center.x - row.max_x[x]), 0.0f);
+        const float dy = std::max(std::max(row.min_y[x] - center.y, center.y - row.max_y[x]), 0.0f);
+        const float dz = std::max(std::max(row.min_z[x] - center.z, center.z - row.max_z[x]), 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= radius * radius)
+            mask |= 1u << x;
+    }
+    return mask;
+}
+
+#if defined(CG_AVX2)
+CG_TARGET_AVX2 static uint32_t row_mask_avx2(const ClusterRow& row, const glm::vec3& center, float radius)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 cx = _mm256_set1_ps(center.x);
+    const __m256 cy = _mm256_set1_ps(center.y);
+    const __m256 cz = _mm256_set1_ps(center.z);
+    const __m256 radius_squared = _mm256_set1_ps(radius * radius);
+
+    uint32_t mask = 0;
+    for (int x = 0; x < cluster_tiles_x; x += 8)
+    {
+        const __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_load_ps(&row.min_x[x]), cx),
+                                                      _mm256_sub_ps(cx, _mm256_load_ps(&row.max_x[x]))), zero);
+        const __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_load_ps(&row.min_y[x]), cy),
+                                                      _mm256_sub_ps(cy, _mm256_load_ps(&row.max_y[x]))), zero);
+        const __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_load_ps(&row.min_z[x]), cz),
+                                                      _mm256_sub_ps(cz, _mm256_load_ps(&row.max_z[x]))), zero);
+        const __m256 distance = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+        const __m256 inside = _mm256_cmp_ps(distance, radius_squared, _CMP_LE_OQ);
+        mask |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << x;
+    }
+    return mask;
+}
+#endif
+
+static RowMaskFunction select_row_mask(void)
+{
+#if defined(CG_AVX2)
+    if (cpu_has_avx2() == true)
+        return row_mask_avx2;
+#endif
+    return row_mask_scalar;
+}
+
+bool init_clusters(void)
+{
+    s_program = load_program("resources/shaders/phong_shadow_v.glsl", "resources/shaders/phong_clustered_f.glsl");
+    s_assign_program = load_compute_program("resources/shaders/cluster_assign_c.glsl");
+    if (s_program == 0 || s_assign_program == 0)
+        return false;
+
+    glGenBuffers(1, &s_grid_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_grid_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, cluster_count * sizeof(glm::uvec2), nullptr, GL_DYNAMIC_DRAW);
+    label_gl_object(GL_BUFFER, s_grid_buffer, "light clusters");
+
+    glGenBuffers(1, &s_index_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_index_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_cluster_light_indices * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+    label_gl_object(GL_BUFFER, s_index_buffer, "cluster light indices");
+
+    for (CounterSlot& slot : s_counters)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterCounters), nullptr, GL_DYNAMIC_READ);
+        label_gl_object(GL_BUFFER, slot.buffer, "cluster counters");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_rows.resize(cluster_slices * cluster_tiles_y);
+    s_rows_projection = glm::mat4(0.0f);
+    s_grid.resize(cluster_count);
+    s_cursors.resize(cluster_count);
+    s_indices.resize(max_cluster_light_indices);
+    s_frame = 0;
+    s_stats = {};
+    return true;
+}
+
+void cleanup_clusters(void)
+{
+    for (CounterSlot& slot : s_counters)
+    {
+        glDeleteBuffers(1, &slot.buffer);
+        if (slot.fence != nullptr)
+            glDeleteSync(slot.fence);
+        slot = {};
+    }
+
+    glDeleteProgram(s_program);
+    glDeleteProgram(s_assign_program);
+    glDeleteBuffers(1, &s_grid_buffer);
+    glDeleteBuffers(1, &s_index_buffer);
+    s_program = 0;
+    s_assign_program = 0;
+    s_grid_buffer = 0;
+    s_index_buffer = 0;
+    s_rows.clear();
+    s_grid.clear();
+    s_cursors.clear();
+    s_indices.clear();
+    s_spans = {};
+    s_masks = {};
+}
+
+/*
+ * Every light is tested against the rows of the slices its depth range
+ * reaches, in parallel. Then the masks are counted into the grid and
+ * walked again to fill the lists, in light order.
+ */
+static void assign_on_cpu(void)
+{
+    const glm::mat4 projection = projection_matrix();
+    if (projection != s_rows_projection ||
+        s_rows_depth_range != glm::vec2(perspective.z_near, perspective.z_far))
+        build_cluster_rows(projection);
+
+    const glm::mat4 view = view_matrix();
+    const PointLight* lights = point_lights();
+    const size_t light_count = point_light_count();
+
+    /*
+     * Both are far larger than a frame arena block and change size with
+     * the camera, so they are kept instead. Only the first assignment on
+     * the CPU allocates.
+     */
+    if (s_masks.empty() == true)
+    {
+        s_spans.resize(max_point_lights);
+        s_masks.resize(static_cast<size_t>(max_point_lights) * cluster_slices * cluster_tiles_y);
+    }
+
+    LightSpan* spans = s_spans.data();
+    size_t mask_count = 0;
+    for (size_t i = 0; i < light_count; i++)
+    {
+        LightSpan& span = spans[i];
+        span.center = glm::vec3(view * glm::vec4(glm::vec3(lights[i].position_radius), 1.0f));
+        span.radius = lights[i].position_radius.w;
+        span.first_mask = mask_count;
+
+        const float depth = -span.center.z;
+        if (depth + span.radius < perspective.z_near || depth - span.radius > perspective.z_far)
+        {
+            span.first_slice = 1;
+            span.last_slice = 0;
+            continue;
+        }
+        span.first_slice = slice_of(std::max(depth - span.radius, perspective.z_near));
+        span.last_slice = slice_of(std::min(depth + span.radius, perspective.z_far));
+        mask_count += static_cast<size_t>(span.last_slice - span.first_slice + 1) * cluster_tiles_y;
+    }
+
+    uint16_t* masks = s_masks.data();
+    static const RowMaskFunction row_mask = select_row_mask();
+    parallel_for(light_count, 64, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const LightSpan& span = spans[i];
+            uint16_t* light_masks = masks + span.first_mask;
+            for (int slice = span.first_slice; slice <= span.last_slice; slice++)
+                for (int y = 0; y < cluster_tiles_y; y++)
+                    *light_masks++ = static_cast<uint16_t>(row_mask(s_rows[slice * cluster_tiles_y + y],
+                                                                    span.center,
+                                                                    span.radius));
+        }
+    });
+
+    const auto for_each_cluster = [&](const auto& function)
+    {
+        for (size_t i = 0; i < light_count; i++)
+        {
+            const LightSpan& span = spans[i];
+            const uint16_t* light_masks = masks + span.first_mask;
+            for (int row = span.first_slice * cluster_tiles_y; row < (span.last_slice + 1) * cluster_tiles_y; row++)
+            {
+                for (uint32_t mask = *light_masks++; mask != 0; mask &= mask - 1)
+                    function(static_cast<uint32_t>(i), row * cluster_tiles_x + std::countr_zero(mask));
+            }
+        }
+    };
+
+    std::fill(s_cursors.begin(), s_cursors.end(), 0u);
+    for_each_cluster([&](uint32_t, int cluster) { s_cursors[cluster]++; });
+
+    ClusterStats stats{};
+    uint32_t offset = 0;
+    for (int cluster = 0; cluster < cluster_count; cluster++)
+    {
+        const uint32_t found = s_cursors[cluster];
+        uint32_t count = std::min(found, static_cast<uint32_t>(max_lights_per_cluster));
+        if (offset + count > static_cast<uint32_t>(max_cluster_light_indices))
+            count = 0;
+        if (count < found)
+            stats.overflowed_clusters++;
+        stats.max_cluster_lights = std::max(stats.max_cluster_lights, found);
+        stats.light_cluster_pairs += count;
+
+        s_grid[cluster] = glm::uvec2(offset, count);
+        s_cursors[cluster] = 0;
+        offset += count;
+    }
+
+    for_each_cluster([&](uint32_t light, int cluster)
+    {
+        const glm::uvec2 entry = s_grid[cluster];
+        if (s_cursors[cluster] < entry.y)
+            s_indices[entry.x + s_cursors[cluster]++] = light;
+    });
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_grid_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, s_grid.size() * sizeof(glm::uvec2), s_grid.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_index_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, offset * sizeof(uint32_t), s_indices.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    stats.frame = s_frame;
+    s_stats = stats;
+}
+
+/*
+ * The slot written counter_slots frames ago, if the GPU is done with it.
+ */
+static void read_counters(CounterSlot& slot)
+{
+    if (slot.fence == nullptr)
+        return;
+
+    const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    ClusterCounters counters{};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), &counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_stats.light_cluster_pairs = counters.light_cluster_pairs;
+    s_stats.max_cluster_lights = counters.max_cluster_lights;
+    s_stats.overflowed_clusters = counters.overflowed_clusters;
+    s_stats.frame = slot.frame;
+}
+
+/*
+ * One work group per cluster.
+ */
+static void assign_on_gpu(void)
+{
+    GpuZone zone("cluster assignment");
+
+    CounterSlot& slot = s_counters[s_frame % counter_slots];
+    read_counters(slot);
+    if (slot.fence != nullptr)
+    {
+        /*
+         * Still in flight after all these frames; drop it rather than wait.
+         */
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    const ClusterCounters zero{};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(s_assign_program);
+    bind_lights(s_assign_program);
+    glUniformMatrix4fv(get_uniform_location(s_assign_program, "u_view"), 1, false, glm::value_ptr(view_matrix()));
+    glUniformMatrix4fv(get_uniform_location(s_assign_program, "u_inverse_projection"), 1, false,
+                       glm::value_ptr(glm::inverse(projection_matrix())));
+    glUniform2f(get_uniform_location(s_assign_program, "u_depth_range"), perspective.z_near, perspective.z_far);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, s_grid_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, s_index_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, slot.buffer);
+
+    glDispatchCompute(cluster_tiles_x, cluster_tiles_y, cluster_slices);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = s_frame;
+}
+
+void assign_light_clusters(void)
+{
+    CG_PROFILE_SCOPE("light clusters");
+    const auto start = std::chrono::steady_clock::now();
+    glGetIntegerv(GL_VIEWPORT, s_viewport.data());
+
+    if (lighting_settings.cluster_assignment == ClusterAssignment::cpu)
+        assign_on_cpu();
+    else
+        assign_on_gpu();
+
+    s_stats.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    s_frame++;
+}
+
+unsigned int clustered_program(void)
+{
+    return s_program;
+}
+
+void bind_light_clusters(unsigned int program)
+{
+    const float depth_scale = static_cast<float>(cluster_slices) / std::log(perspective.z_far / perspective.z_near);
+    const glm::vec2 slice_scale_bias(depth_scale, -depth_scale * std::log(perspective.z_near));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, light_buffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, s_grid_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, s_index_buffer);
+    glUniform2i(get_uniform_location(program, "u_origin"), s_viewport[0], s_viewport[1]);
+    glUniform2i(get_uniform_location(program, "u_size"), s_viewport[2], s_viewport[3]);
+    glUniform2fv(get_uniform_location(program, "u_slice_scale_bias"), 1, glm::value_ptr(slice_scale_bias));
+}
+
+const ClusterStats& last_cluster_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
@@ -0,0 +1,64 @@
+#ifndef CG_CLUSTERED
+#define CG_CLUSTERED
+
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * The view frustum is cut into cluster_tiles_x by cluster_tiles_y screen
+ * tiles and cluster_slices depth slices, spaced logarithmically from
+ * z_near to z_far. cluster_assign_c.glsl and phong_clustered_f.glsl
+ * assume the same numbers.
+ */
+constexpr int cluster_tiles_x = 16;
+constexpr int cluster_tiles_y = 9;
+constexpr int cluster_slices = 24;
+constexpr int cluster_count = cluster_tiles_x * cluster_tiles_y * cluster_slices;
+
+/*
+ * A cluster keeps at most max_lights_per_cluster lights, and all the
+ * lists together at most max_cluster_light_indices.
+ */
+constexpr int max_lights_per_cluster = 255;
+constexpr int max_cluster_light_indices = 1 << 20;
+
+/*
+ * Of the last assignment. Counters of an assignment on the GPU are read
+ * back a few frames late, without waiting for it.
+ */
+struct ClusterStats
+{
+    uint64_t light_cluster_pairs; /* As kept in the lists. */
+    uint32_t max_cluster_lights;  /* Before clamping to max_lights_per_cluster. */
+    uint32_t overflowed_clusters; /* Lost lights to either limit. */
+    double cpu_ms;                /* Assigning and uploading, or dispatching. */
+    uint64_t frame;               /* Of the assignment counted. */
+};
+
+/*
+ * Needs a current context with GL loaded.
+ */
+bool init_clusters(void);
+void cleanup_clusters(void);
+
+/*
+ * Build this frame's light lists for cg::camera and cg::perspective in
+ * the viewport, on the GPU or the CPU as lighting_settings says. The
+ * lights must be up to date.
+ */
+void assign_light_clusters(void);
+
+/*
+ * The program render_scene() draws with, and its cluster bindings:
+ * shader storage 0 to 2 and the grid uniforms.
+ */
+unsigned int clustered_program(void);
+void bind_light_clusters(unsigned int program);
+
+const ClusterStats& last_cluster_stats(void);
+
+} // namespace cg
+
+#endif
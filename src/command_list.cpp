@@ -0,0 +1,124 @@
+#include "command_list.h"
+#include "jobs.h"
+
+#include <memory>
+
+namespace cg
+{
+
+CommandList::CommandList(LinearAllocator& allocator)
+    : m_allocator(&allocator)
+{
+}
+
+template <typename T>
+T& CommandList::push(CommandType type)
+{
+    static_assert(sizeof(T) <= 255, "Command too large for its header.");
+    static_assert(alignof(T) <= 16, "Command alignment exceeds chunk alignment.");
+
+    /*
+     * Keep every command aligned so the replay loop can read it in place.
+     */
+    constexpr size_t size = (sizeof(T) + alignof(T) - 1) & ~(alignof(T) - 1);
+    constexpr size_t stride = (size + 15) & ~size_t(15);
+
+    if (m_last == nullptr || m_last->used + stride > chunk_size)
+    {
+        Chunk* chunk = static_cast<Chunk*>(m_allocator->allocate(sizeof(Chunk), alignof(Chunk)));
+        chunk->next = nullptr;
+        chunk->used = 0;
+
+        if (m_last == nullptr)
+            m_first = chunk;
+        else
+            m_last->next = chunk;
+        m_last = chunk;
+    }
+
+    T* command = new (m_last->data + m_last->used) T{};
+    command->header.type = type;
+    command->header.size = static_cast<uint8_t>(stride);
+    m_last->used += stride;
+    m_count++;
+    return *command;
+}
+
+void CommandList::bind_program(unsigned int program)
+{
+    push<BindProgramCommand>(CommandType::bind_program).program = program;
+}
+
+void CommandList::bind_vertex_array(unsigned int vertex_array)
+{
+    push<BindVertexArrayCommand>(CommandType::bind_vertex_array).vertex_array = vertex_array;
+}
+
+void CommandList::bind_texture(unsigned int unit, unsigned int texture)
+{
+    BindTextureCommand& command = push<BindTextureCommand>(CommandType::bind_texture);
+    command.unit = unit;
+    command.texture = texture;
+}
+
+void CommandList::set_mat4(int location, const glm::mat4& value)
+{
+    SetMat4Command& command = push<SetMat4Command>(CommandType::set_mat4);
+    command.location = location;
+    command.value = value;
+}
+
+void CommandList::set_vec3(int location, const glm::vec3& value)
+{
+    SetVec3Command& command = push<SetVec3Command>(CommandType::set_vec3);
+    command.location = location;
+    command.value = value;
+}
+
+void CommandList::draw_arrays(Primitive primitive, int first, int count)
+{
+    DrawArraysCommand& command = push<DrawArraysCommand>(CommandType::draw_arrays);
+    command.primitive = primitive;
+    command.first = first;
+    command.count = count;
+}
+
+void CommandList::draw_elements(Primitive primitive, int first, int count)
+{
+    DrawElementsCommand& command = push<DrawElementsCommand>(CommandType::draw_elements);
+    command.primitive = primitive;
+    command.first = first;
+    command.count = count;
+}
+
+const CommandList::Chunk* CommandList::first_chunk(void) const
+{
+    return m_first;
+}
+
+size_t CommandList::command_count(void) const
+{
+    return m_count;
+}
+
+/*
+ * One allocator per worker. Sized on the main thread in
+ * reset_command_allocators(), so workers index without locking.
+ */
+static std::vector<std::unique_ptr<LinearAllocator>> s_allocators;
+
+LinearAllocator& command_allocator(void)
+{
+    return *s_allocators[job_worker_index()];
+}
+
+void reset_command_allocators(void)
+{
+    while (s_allocators.size() < job_worker_count())
+        s_allocators.push_back(std::make_unique<LinearAllocator>());
+
+    for (const auto& allocator : s_allocators)
+        allocator->reset();
+}
+
+} // namespace cg
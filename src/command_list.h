@@ -0,0 +1,154 @@
+#ifndef CG_COMMAND_LIST
+#define CG_COMMAND_LIST
+
+#include "linear_allocator.h"
+
+#include "glm/ext.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * Backend agnostic draw commands.
+ * Any thread can record a CommandList. Only the thread that owns the graphics
+ * context replays it, see submit_commands().
+ */
+enum class CommandType : uint8_t
+{
+    bind_program,
+    bind_vertex_array,
+    bind_texture,
+    set_mat4,
+    set_vec3,
+    draw_arrays,
+    draw_elements
+};
+
+enum class Primitive : uint8_t
+{
+    triangles,
+    lines,
+    points
+};
+
+struct CommandHeader
+{
+    CommandType type;
+    uint8_t size; /* Bytes including the header. */
+};
+
+struct BindProgramCommand
+{
+    CommandHeader header;
+    unsigned int program;
+};
+
+struct BindVertexArrayCommand
+{
+    CommandHeader header;
+    unsigned int vertex_array;
+};
+
+struct BindTextureCommand
+{
+    CommandHeader header;
+    unsigned int unit;
+    unsigned int texture;
+};
+
+struct SetMat4Command
+{
+    CommandHeader header;
+    int location;
+    glm::mat4 value;
+};
+
+struct SetVec3Command
+{
+    CommandHeader header;
+    int location;
+    glm::vec3 value;
+};
+
+struct DrawArraysCommand
+{
+    CommandHeader header;
+    Primitive primitive;
+    int first;
+    int count;
+};
+
+/*
+ * 32 bit indices from the element buffer of the bound vertex array.
+ */
+struct DrawElementsCommand
+{
+    CommandHeader header;
+    Primitive primitive;
+    int first; /* Index, not byte offset. */
+    int count;
+};
+
+/*
+ * Commands are packed back to back in fixed size chunks taken from a
+ * LinearAllocator. The list does not own its memory; it is valid until the
+ * allocator is reset.
+ */
+class CommandList
+{
+public:
+    static constexpr size_t chunk_size = 4096;
+
+    struct Chunk
+    {
+        Chunk* next;
+        size_t used;
+        alignas(16) std::byte data[chunk_size];
+    };
+
+    CommandList(void) = default;
+    explicit CommandList(LinearAllocator& allocator);
+
+    void bind_program(unsigned int program);
+    void bind_vertex_array(unsigned int vertex_array);
+    void bind_texture(unsigned int unit, unsigned int texture);
+    void set_mat4(int location, const glm::mat4& value);
+    void set_vec3(int location, const glm::vec3& value);
+    void draw_arrays(Primitive primitive, int first, int count);
+    void draw_elements(Primitive primitive, int first, int count);
+
+    const Chunk* first_chunk(void) const;
+    size_t command_count(void) const;
+
+private:
+    template <typename T>
+    T& push(CommandType type);
+
+    LinearAllocator* m_allocator = nullptr;
+    Chunk* m_first = nullptr;
+    Chunk* m_last = nullptr;
+    size_t m_count = 0;
+};
+
+/*
+ * Allocator of the calling job worker. reset_command_allocators() runs on
+ * the main thread once per frame, after the lists recorded from them have
+ * been submitted and before any new recording starts.
+ */
+LinearAllocator& command_allocator(void);
+void reset_command_allocators(void);
+
+/*
+ * Replay on the graphics thread. Implemented by the active backend.
+ * Lists are submitted in order.
+ */
+void submit_commands(const CommandList& list);
+void submit_commands(const CommandList* lists, size_t count);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,118 @@
+#include "glad/glad.h"
+
+#include "command_list.h"
+
+namespace cg
+{
+
+static unsigned int to_gl(Primitive primitive)
+{
+    switch (primitive)
+    {
+        case Primitive::lines:
+            return GL_LINES;
+        case Primitive::points:
+            return GL_POINTS;
+        case Primitive::triangles:
+        default:
+            return GL_TRIANGLES;
+    }
+}
+
+/*
+ * Bindings already set by this replay. Redundant binds recorded by
+ * independent lists are skipped.
+ */
+struct ReplayState
+{
+    unsigned int program = 0;
+    unsigned int vertex_array = 0;
+};
+
+static void replay(const CommandList& list, ReplayState& state)
+{
+    for (const CommandList::Chunk* chunk = list.first_chunk();
+         chunk != nullptr;
+         chunk = chunk->next)
+    {
+        const std::byte* it = chunk->data;
+        const std::byte* const end = chunk->data + chunk->used;
+
+        while (it < end)
+        {
+            const CommandHeader& header = *reinterpret_cast<const CommandHeader*>(it);
+            switch (header.type)
+            {
+                case CommandType::bind_program:
+                {
+                    const auto& command = *reinterpret_cast<const BindProgramCommand*>(it);
+                    if (command.program != state.program)
+                    {
+                        glUseProgram(command.program);
+                        state.program = command.program;
+                    }
+                    break;
+                }
+                case CommandType::bind_vertex_array:
+                {
+                    const auto& command = *reinterpret_cast<const BindVertexArrayCommand*>(it);
+                    if (command.vertex_array != state.vertex_array)
+                    {
+                        glBindVertexArray(command.vertex_array);
+                        state.vertex_array = command.vertex_array;
+                    }
+                    break;
+                }
+                case CommandType::bind_texture:
+                {
+                    const auto& command = *reinterpret_cast<const BindTextureCommand*>(it);
+                    glActiveTexture(GL_TEXTURE0 + command.unit);
+                    glBindTexture(GL_TEXTURE_2D, command.texture);
+                    break;
+                }
+                case CommandType::set_mat4:
+                {
+                    const auto& command = *reinterpret_cast<const SetMat4Command*>(it);
+                    glUniformMatrix4fv(command.location, 1, false, glm::value_ptr(command.value));
+                    break;
+                }
+                case CommandType::set_vec3:
+                {
+                    const auto& command = *reinterpret_cast<const SetVec3Command*>(it);
+                    glUniform3fv(command.location, 1, glm::value_ptr(command.value));
+                    break;
+                }
+                case CommandType::draw_arrays:
+                {
+                    const auto& command = *reinterpret_cast<const DrawArraysCommand*>(it);
+                    glDrawArrays(to_gl(command.primitive), command.first, command.count);
+                    break;
+                }
+                case CommandType::draw_elements:
+                {
+                    const auto& command = *reinterpret_cast<const DrawElementsCommand*>(it);
+                    glDrawElements(to_gl(command.primitive), command.count, GL_UNSIGNED_INT,
+                                   reinterpret_cast<const void*>(command.first * sizeof(uint32_t)));
+                    break;
+                }
+            }
+
+            it += header.size;
+        }
+    }
+}
+
+void submit_commands(const CommandList& list)
+{
+    ReplayState state;
+    replay(list, state);
+}
+
+void submit_commands(const CommandList* lists, size_t count)
+{
+    ReplayState state;
+    for (size_t i = 0; i < count; i++)
+        replay(lists[i], state);
+}
+
+} // namespace cg
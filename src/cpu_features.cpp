@@ -0,0 +1,29 @@
+#include "cpu_features.h"
+
+#if defined(CG_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace cg
+{
+
+bool cpu_has_avx2(void)
+{
+#if defined(CG_AVX2)
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+                              (_xgetbv(0) & 6) == 6;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    __cpuidex(info, 7, 0);
+    return os_saves_avx == true && fma == true && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#else
+    return false;
+#endif
+}
+
+} // namespace cg
@@ -0,0 +1,31 @@
+#ifndef CG_CPU_FEATURES
+#define CG_CPU_FEATURES
+
+/*
+ * SIMD paths are compiled for AVX2 function by function and only called
+ * when the CPU supports it, so the rest of the build needs no flags.
+ * CG_AVX2 is defined where such functions can be compiled at all. Every
+ * x86-64 CPU has SSE2, so CG_SSE code needs neither flags nor checks.
+ */
+#if defined(__x86_64__) || defined(_M_X64)
+#define CG_SSE 1
+#define CG_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CG_TARGET_AVX2
+#else
+#define CG_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace cg
+{
+
+/*
+ * AVX2 and FMA, with the OS saving the wider registers.
+ */
+bool cpu_has_avx2(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,333 @@
+#include "glad/glad.h"
+
+#include "deferred.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "lights.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <array>
+#include <iostream>
+
+namespace cg
+{
+
+/*
+ * Written by every culling pass, as light_cull_c.glsl declares them.
+ */
+struct TileCounters
+{
+    uint32_t light_tile_pairs;
+    uint32_t max_tile_lights;
+    uint32_t overflowed_tiles;
+    uint32_t padding;
+};
+
+/*
+ * Counters are read back this many frames after they were written.
+ */
+constexpr size_t counter_slots = 3;
+
+struct CounterSlot
+{
+    unsigned int buffer;
+    GLsync fence;
+    uint64_t frame;
+    int tiles_x;
+    int tiles_y;
+};
+
+static unsigned int s_geometry_program = 0;
+static unsigned int s_cull_program = 0;
+static unsigned int s_light_program = 0;
+static unsigned int s_framebuffer = 0;
+static unsigned int s_albedo_specular = 0;
+static unsigned int s_normal = 0;
+static unsigned int s_depth = 0;
+static unsigned int s_tile_buffer = 0;
+static unsigned int s_vertex_array = 0; /* Empty, for the full screen triangle. */
+static int s_width = 0;
+static int s_height = 0;
+static std::array<CounterSlot, counter_slots> s_counters{};
+static uint64_t s_frame = 0;
+static DeferredStats s_stats{};
+
+/*
+ * Where begin_deferred() found the frame.
+ */
+static int s_target_framebuffer = 0;
+static std::array<int, 4> s_target_viewport{};
+
+static unsigned int create_texture(GLenum format, int width, int height, const char* label)
+{
+    unsigned int texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    label_gl_object(GL_TEXTURE, texture, label);
+    return texture;
+}
+
+static void delete_gbuffer(void)
+{
+    glDeleteTextures(1, &s_albedo_specular);
+    glDeleteTextures(1, &s_normal);
+    glDeleteTextures(1, &s_depth);
+    glDeleteBuffers(1, &s_tile_buffer);
+    s_albedo_specular = 0;
+    s_normal = 0;
+    s_depth = 0;
+    s_tile_buffer = 0;
+    s_width = 0;
+    s_height = 0;
+}
+
+/*
+ * 12 bytes a pixel, and a count and max_lights_per_tile indices a tile.
+ */
+static bool create_gbuffer(int width, int height)
+{
+    delete_gbuffer();
+    s_albedo_specular = create_texture(GL_RGBA8, width, height, "g-buffer albedo and specular");
+    s_normal = create_texture(GL_RG16_SNORM, width, height, "g-buffer normal");
+    s_depth = create_texture(GL_DEPTH_COMPONENT32F, width, height, "g-buffer depth");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_albedo_specular, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, s_normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, s_depth, 0);
+    const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(s_target_framebuffer));
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "G-buffer incomplete: " << status << std::endl;
+        delete_gbuffer();
+        return false;
+    }
+
+    const int tiles_x = (width + light_tile_size - 1) / light_tile_size;
+    const int tiles_y = (height + light_tile_size - 1) / light_tile_size;
+    glGenBuffers(1, &s_tile_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_tile_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 static_cast<size_t>(tiles_x) * tiles_y * (max_lights_per_tile + 1) * sizeof(uint32_t),
+                 nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    label_gl_object(GL_BUFFER, s_tile_buffer, "tile lights");
+
+    s_width = width;
+    s_height = height;
+    return true;
+}
+
+bool init_deferred(void)
+{
+    s_geometry_program = load_program("resources/shaders/phong_v.glsl", "resources/shaders/gbuffer_f.glsl");
+    s_cull_program = load_compute_program("resources/shaders/light_cull_c.glsl");
+    s_light_program = load_program("resources/shaders/deferred_light_v.glsl", "resources/shaders/deferred_light_f.glsl");
+    if (s_geometry_program == 0 || s_cull_program == 0 || s_light_program == 0)
+        return false;
+
+    glGenFramebuffers(1, &s_framebuffer);
+    label_gl_object(GL_FRAMEBUFFER, s_framebuffer, "g-buffer");
+    glGenVertexArrays(1, &s_vertex_array);
+
+    for (CounterSlot& slot : s_counters)
+    {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(TileCounters), nullptr, GL_DYNAMIC_READ);
+        label_gl_object(GL_BUFFER, slot.buffer, "tile counters");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_frame = 0;
+    s_stats = {};
+    return true;
+}
+
+void cleanup_deferred(void)
+{
+    delete_gbuffer();
+    for (CounterSlot& slot : s_counters)
+    {
+        glDeleteBuffers(1, &slot.buffer);
+        if (slot.fence != nullptr)
+            glDeleteSync(slot.fence);
+        slot = {};
+    }
+
+    glDeleteProgram(s_geometry_program);
+    glDeleteProgram(s_cull_program);
+    glDeleteProgram(s_light_program);
+    glDeleteFramebuffers(1, &s_framebuffer);
+    glDeleteVertexArrays(1, &s_vertex_array);
+    s_geometry_program = 0;
+    s_cull_program = 0;
+    s_light_program = 0;
+    s_framebuffer = 0;
+    s_vertex_array = 0;
+}
+
+void begin_deferred(void)
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &s_target_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, s_target_viewport.data());
+
+    const int width = s_target_viewport[2];
+    const int height = s_target_viewport[3];
+    if ((width != s_width || height != s_height) && create_gbuffer(width, height) == false)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+    glViewport(0, 0, s_width, s_height);
+    glDisable(GL_BLEND);
+
+    const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float far_depth = 1.0f;
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, zero);
+    glClearBufferfv(GL_DEPTH, 0, &far_depth);
+}
+
+unsigned int deferred_geometry_program(void)
+{
+    return s_geometry_program;
+}
+
+/*
+ * The slot written counter_slots frames ago, if the GPU is done with it.
+ */
+static void read_counters(CounterSlot& slot)
+{
+    if (slot.fence == nullptr)
+        return;
+
+    const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    TileCounters counters{};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), &counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_stats =
+    {
+        .tiles_x = slot.tiles_x,
+        .tiles_y = slot.tiles_y,
+        .light_tile_pairs = counters.light_tile_pairs,
+        .max_tile_lights = counters.max_tile_lights,
+        .overflowed_tiles = counters.overflowed_tiles,
+        .frame = slot.frame
+    };
+}
+
+void resolve_deferred(void)
+{
+    CG_PROFILE_SCOPE("deferred lighting");
+    if (s_width == 0)
+        return;
+
+    const int tiles_x = (s_width + light_tile_size - 1) / light_tile_size;
+    const int tiles_y = (s_height + light_tile_size - 1) / light_tile_size;
+    const glm::mat4 view = view_matrix();
+    const glm::mat4 projection = projection_matrix();
+
+    CounterSlot& slot = s_counters[s_frame % counter_slots];
+    read_counters(slot);
+    if (slot.fence != nullptr)
+    {
+        /*
+         * Still in flight after all these frames; drop it rather than wait.
+         */
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    {
+        GpuZone zone("light culling");
+        const TileCounters zero{};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glUseProgram(s_cull_program);
+        bind_lights(s_cull_program);
+        glUniformMatrix4fv(get_uniform_location(s_cull_program, "u_view"), 1, false, glm::value_ptr(view));
+        glUniformMatrix4fv(get_uniform_location(s_cull_program, "u_inverse_projection"), 1, false,
+                           glm::value_ptr(glm::inverse(projection)));
+        glUniform2i(get_uniform_location(s_cull_program, "u_size"), s_width, s_height);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, s_tile_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, slot.buffer);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, s_depth);
+
+        glDispatchCompute(tiles_x, tiles_y, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = s_frame;
+        slot.tiles_x = tiles_x;
+        slot.tiles_y = tiles_y;
+    }
+
+    {
+        GpuZone zone("tiled lighting");
+        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(s_target_framebuffer));
+        glViewport(s_target_viewport[0], s_target_viewport[1], s_target_viewport[2], s_target_viewport[3]);
+
+        /*
+         * Depth comes from the G-buffer, so later passes still test
+         * against the scene.
+         */
+        glDepthFunc(GL_ALWAYS);
+
+        glUseProgram(s_light_program);
+        bind_lights(s_light_program);
+        glUniformMatrix4fv(get_uniform_location(s_light_program, "u_inverse_view_projection"), 1, false,
+                           glm::value_ptr(glm::inverse(projection * view)));
+        glUniform3fv(get_uniform_location(s_light_program, "u_view_pos"), 1, glm::value_ptr(camera.eye));
+        glUniform2i(get_uniform_location(s_light_program, "u_origin"), s_target_viewport[0], s_target_viewport[1]);
+        glUniform2i(get_uniform_location(s_light_program, "u_size"), s_width, s_height);
+        glUniform1i(get_uniform_location(s_light_program, "u_tiles_x"), tiles_x);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, s_tile_buffer);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, s_albedo_specular);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, s_normal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, s_depth);
+
+        glBindVertexArray(s_vertex_array);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glDepthFunc(GL_LESS);
+        glEnable(GL_BLEND);
+    }
+
+    s_frame++;
+}
+
+const DeferredStats& last_deferred_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
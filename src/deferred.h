@@ -0,0 +1,58 @@
+#ifndef CG_DEFERRED
+#define CG_DEFERRED
+
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Lights are culled per square of this many pixels. Each tile keeps at
+ * most max_lights_per_tile of them; light_cull_c.glsl and
+ * deferred_light_f.glsl assume both.
+ */
+constexpr int light_tile_size = 16;
+constexpr int max_lights_per_tile = 255;
+
+/*
+ * Of the culling pass a few frames ago; the counters are read back
+ * without waiting for the GPU.
+ */
+struct DeferredStats
+{
+    int tiles_x;
+    int tiles_y;
+    uint64_t light_tile_pairs; /* Summed over the tiles. */
+    uint32_t max_tile_lights;  /* Before clamping to max_lights_per_tile. */
+    uint32_t overflowed_tiles;
+    uint64_t frame;            /* Of the culling pass counted. */
+};
+
+/*
+ * Needs a current context with GL loaded.
+ */
+bool init_deferred(void);
+void cleanup_deferred(void);
+
+/*
+ * Bind and clear the G-buffer, sized to the viewport: albedo and specular
+ * strength in RGBA8, the normal octahedron encoded in RG16, and depth.
+ * Draw the scene with deferred_geometry_program() until
+ * resolve_deferred(). Blending is off in between.
+ */
+void begin_deferred(void);
+unsigned int deferred_geometry_program(void);
+
+/*
+ * Cull the point lights into tiles against each tile's depth range, then
+ * light the framebuffer and viewport begin_deferred() found with only
+ * the lights of each pixel's tile. Writes the G-buffer's depth there too;
+ * the background keeps its colour and depth.
+ */
+void resolve_deferred(void);
+
+const DeferredStats& last_deferred_stats(void);
+
+} // namespace cg
+
+#endif
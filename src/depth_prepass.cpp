@@ -0,0 +1,265 @@
+#include "glad/glad.h"
+
+#include "depth_prepass.h"
+#include "gl_debug.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+DepthPrepassSettings depth_prepass_settings =
+{
+    .mode = DepthPrepassMode::off,
+    .overdraw_threshold = 1.5f,
+    .show_overdraw = false
+};
+
+/*
+ * Sample counts are read back without waiting, from a small ring.
+ */
+constexpr size_t query_slots = 4;
+
+/*
+ * A measurement ends once frames of either kind were counted this often.
+ */
+constexpr uint64_t frames_per_side = 4;
+
+struct QuerySlot
+{
+    unsigned int query;
+    bool pending;
+    bool prepass;
+    uint64_t measurement;
+};
+
+static unsigned int s_program = 0;
+static unsigned int s_overdraw_program = 0;
+static unsigned int s_vbo = 0;
+static unsigned int s_vao = 0;
+static std::array<QuerySlot, query_slots> s_queries{};
+static size_t s_next_query = 0;
+static QuerySlot* s_active_query = nullptr;
+
+static bool s_measuring = false;
+static bool s_decision = false;
+static uint64_t s_measurement = 0;
+static size_t s_measured_items = SIZE_MAX;
+static DepthPrepassMode s_last_mode = DepthPrepassMode::off;
+static uint64_t s_frame = 0;
+static std::array<uint64_t, 2> s_samples{}; /* Without and with the pre-pass. */
+static std::array<uint64_t, 2> s_counted{};
+static DepthPrepassStats s_stats{};
+
+bool init_depth_prepass(void)
+{
+    s_program = load_program("resources/shaders/depth_only_v.glsl", "resources/shaders/shadow_depth_f.glsl");
+    s_overdraw_program = load_program("resources/shaders/depth_only_v.glsl", "resources/shaders/overdraw_f.glsl");
+    if (s_program == 0 || s_overdraw_program == 0)
+        return false;
+
+    /*
+     * Only the positions of the cube, 12 bytes a vertex instead of 32.
+     */
+    std::vector<float> positions(cube_vertex_count * 3);
+    const float* vertices = cube_vertices();
+    for (size_t i = 0; i < cube_vertex_count; i++)
+        std::copy(vertices + i * 8, vertices + i * 8 + 3, positions.begin() + i * 3);
+
+    glGenBuffers(1, &s_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, s_vbo);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    label_gl_object(GL_BUFFER, s_vbo, "cube positions");
+
+    glGenVertexArrays(1, &s_vao);
+    glBindVertexArray(s_vao);
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    label_gl_object(GL_VERTEX_ARRAY, s_vao, "cube positions");
+
+    for (QuerySlot& slot : s_queries)
+    {
+        slot = {};
+        glGenQueries(1, &slot.query);
+    }
+
+    s_next_query = 0;
+    s_active_query = nullptr;
+    s_measuring = false;
+    s_decision = false;
+    s_measured_items = SIZE_MAX;
+    s_last_mode = DepthPrepassMode::off;
+    s_stats = {};
+    return true;
+}
+
+void cleanup_depth_prepass(void)
+{
+    for (QuerySlot& slot : s_queries)
+    {
+        glDeleteQueries(1, &slot.query);
+        slot = {};
+    }
+
+    glDeleteProgram(s_program);
+    glDeleteProgram(s_overdraw_program);
+    glDeleteVertexArrays(1, &s_vao);
+    glDeleteBuffers(1, &s_vbo);
+    s_program = 0;
+    s_overdraw_program = 0;
+    s_vao = 0;
+    s_vbo = 0;
+}
+
+/*
+ * Collect the counts that are ready. Those of an earlier measurement are
+ * dropped.
+ */
+static void read_queries(void)
+{
+    for (QuerySlot& slot : s_queries)
+    {
+        if (slot.pending == false)
+            continue;
+
+        int available = 0;
+        glGetQueryObjectiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == 0)
+            continue;
+
+        uint64_t samples = 0;
+        glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &samples);
+        slot.pending = false;
+        if (s_measuring == false || slot.measurement != s_measurement)
+            continue;
+
+        const size_t side = slot.prepass == true ? 1 : 0;
+        s_samples[side] += samples;
+        s_counted[side]++;
+    }
+}
+
+static void start_measuring(size_t scene_items)
+{
+    s_measuring = true;
+    s_measurement++;
+    s_measured_items = scene_items;
+    s_samples = {};
+    s_counted = {};
+}
+
+/*
+ * Shaded fragments per frame without the pre-pass over visible ones with
+ * it. The pre-pass pays off once the shading it saves outweighs drawing
+ * the geometry twice.
+ */
+static void finish_measuring(void)
+{
+    const double shaded = static_cast<double>(s_samples[0]) / static_cast<double>(s_counted[0]);
+    const double visible = static_cast<double>(s_samples[1]) / static_cast<double>(s_counted[1]);
+    s_stats.overdraw = visible > 0.0 ? shaded / visible : 0.0;
+    s_stats.measurements++;
+    s_decision = s_stats.overdraw >= depth_prepass_settings.overdraw_threshold;
+    s_measuring = false;
+}
+
+bool use_depth_prepass(size_t scene_items, bool lit)
+{
+    read_queries();
+
+    const DepthPrepassMode mode = depth_prepass_settings.mode;
+    bool enabled = mode == DepthPrepassMode::on;
+    if (mode == DepthPrepassMode::automatic && lit == false)
+    {
+        s_measuring = false;
+        s_measured_items = SIZE_MAX;
+    }
+    else if (mode == DepthPrepassMode::automatic)
+    {
+        if (s_last_mode != DepthPrepassMode::automatic || scene_items != s_measured_items)
+            start_measuring(scene_items);
+        if (s_measuring == true && s_counted[0] >= frames_per_side && s_counted[1] >= frames_per_side)
+            finish_measuring();
+        enabled = s_measuring == true ? s_frame % 2 == 1 : s_decision;
+    }
+    else
+    {
+        s_measuring = false;
+    }
+
+    s_last_mode = mode;
+    s_frame++;
+    s_stats.enabled = enabled;
+    s_stats.measuring = s_measuring;
+    return enabled;
+}
+
+unsigned int depth_prepass_program(void)
+{
+    return s_program;
+}
+
+unsigned int depth_prepass_vertex_array(void)
+{
+    return s_vao;
+}
+
+unsigned int overdraw_program(void)
+{
+    return s_overdraw_program;
+}
+
+void begin_shading_pass(bool prepass)
+{
+    if (s_measuring == false)
+        return;
+
+    /*
+     * All slots still in flight: this frame goes uncounted.
+     */
+    QuerySlot& slot = s_queries[s_next_query % query_slots];
+    if (slot.pending == true)
+        return;
+
+    glBeginQuery(GL_SAMPLES_PASSED, slot.query);
+    slot.pending = true;
+    slot.prepass = prepass;
+    slot.measurement = s_measurement;
+    s_active_query = &slot;
+    s_next_query++;
+}
+
+void end_shading_pass(void)
+{
+    if (s_active_query == nullptr)
+        return;
+
+    glEndQuery(GL_SAMPLES_PASSED);
+    s_active_query = nullptr;
+}
+
+const DepthPrepassStats& last_depth_prepass_stats(void)
+{
+    return s_stats;
+}
+
+const char* depth_prepass_mode_name(DepthPrepassMode mode)
+{
+    switch (mode)
+    {
+        case DepthPrepassMode::on:
+            return "on";
+        case DepthPrepassMode::automatic:
+            return "auto";
+        case DepthPrepassMode::off:
+        default:
+            return "off";
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,79 @@
+#ifndef CG_DEPTH_PREPASS
+#define CG_DEPTH_PREPASS
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Whether render_scene() lays down depth before shading. The deferred
+ * path never does; its G-buffer pass is already cheap per fragment.
+ */
+enum class DepthPrepassMode
+{
+    off,
+    on,
+    automatic /* Measure the overdraw of the scene, then pick. */
+};
+
+struct DepthPrepassSettings
+{
+    DepthPrepassMode mode;
+    float overdraw_threshold; /* Automatic: pre-pass from this many shaded fragments per visible one. */
+    bool show_overdraw;       /* Draw how often every pixel is shaded instead of the scene. */
+};
+extern DepthPrepassSettings depth_prepass_settings;
+
+struct DepthPrepassStats
+{
+    bool enabled;          /* In the last frame. */
+    bool measuring;
+    double overdraw;       /* Of the last measurement; 0 before one finished. */
+    uint64_t measurements; /* Finished since init. */
+};
+
+/*
+ * Needs a current context with GL loaded.
+ */
+bool init_depth_prepass(void);
+void cleanup_depth_prepass(void);
+
+/*
+ * Whether this frame draws the pre-pass. In automatic mode the overdraw
+ * of lit shading is measured whenever the number of draw items changes:
+ * frames with and without the pre-pass alternate until both have been
+ * counted a few times, and the decision holds until the next change.
+ * Unlit, textured shading costs about as much per fragment as the
+ * pre-pass itself and never gets one. Call once per frame, before the
+ * shading pass.
+ */
+bool use_depth_prepass(size_t scene_items, bool lit);
+
+/*
+ * Depth only program and a vertex array of the cube's positions alone.
+ */
+unsigned int depth_prepass_program(void);
+unsigned int depth_prepass_vertex_array(void);
+
+/*
+ * Adds a little for every fragment shaded, with the vertex array above.
+ */
+unsigned int overdraw_program(void);
+
+/*
+ * Around the shading pass. While measuring, counts the samples that pass
+ * the depth test: every fragment shaded without the pre-pass, every
+ * visible one with it.
+ */
+void begin_shading_pass(bool prepass);
+void end_shading_pass(void);
+
+const DepthPrepassStats& last_depth_prepass_stats(void);
+
+const char* depth_prepass_mode_name(DepthPrepassMode mode);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,25 @@
+#include "frame_arena.h"
+
+#include <array>
+
+namespace cg
+{
+
+static std::array<LinearAllocator, 2> s_arenas;
+static size_t s_current = 0;
+
+/*
+ * Reset the arena last used two frames ago.
+ */
+void begin_frame_arena(void)
+{
+    s_current = (s_current + 1) % s_arenas.size();
+    s_arenas[s_current].reset();
+}
+
+LinearAllocator& frame_arena(void)
+{
+    return s_arenas[s_current];
+}
+
+} // namespace cg
@@ -0,0 +1,27 @@
+#ifndef CG_FRAME_ARENA
+#define CG_FRAME_ARENA
+
+#include "linear_allocator.h"
+
+#include <cstddef>
+
+namespace cg
+{
+
+/*
+ * Scratch memory for the main thread that lives for two frames.
+ * Two arenas are used in turn, so data handed to the GPU or another thread
+ * in one frame stays valid while the next frame is built.
+ */
+void begin_frame_arena(void);
+LinearAllocator& frame_arena(void);
+
+template <typename T>
+T* frame_allocate(size_t count)
+{
+    return frame_arena().allocate_array<T>(count);
+}
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,231 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace cg
+{
+
+FrameStatsSettings frame_stats_settings =
+{
+    .window_frames = 600,
+    .hitch_threshold_ms = 1000.0 / 30.0
+};
+
+static size_t bucket_of(uint64_t us)
+{
+    if (us < 1)
+        return 0;
+
+    const int octave = std::min(static_cast<int>(std::log2(static_cast<double>(us))),
+                                static_cast<int>(TimeHistogram::octaves) - 1);
+    const double base = std::ldexp(1.0, octave);
+    const size_t sub = std::min(static_cast<size_t>((us - base) / base * TimeHistogram::sub_buckets),
+                                TimeHistogram::sub_buckets - 1);
+    return octave * TimeHistogram::sub_buckets + sub;
+}
+
+static double bucket_middle_ms(size_t bucket)
+{
+    const size_t octave = bucket / TimeHistogram::sub_buckets;
+    const size_t sub = bucket % TimeHistogram::sub_buckets;
+    const double base = std::ldexp(1.0, static_cast<int>(octave));
+    return base * (1.0 + (sub + 0.5) / TimeHistogram::sub_buckets) / 1000.0;
+}
+
+void TimeHistogram::record(double ms)
+{
+    const uint64_t us = static_cast<uint64_t>(std::max(ms, 0.0) * 1000.0);
+    m_buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total_us.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t worst = m_worst_us.load(std::memory_order_relaxed);
+    while (us > worst &&
+           m_worst_us.compare_exchange_weak(worst, us, std::memory_order_relaxed) == false)
+    {
+    }
+}
+
+void TimeHistogram::reset(void)
+{
+    for (auto& bucket : m_buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_total_us.store(0, std::memory_order_relaxed);
+    m_worst_us.store(0, std::memory_order_relaxed);
+}
+
+void TimeHistogram::merge(const TimeHistogram& other)
+{
+    for (size_t i = 0; i < bucket_count; i++)
+        m_buckets[i].fetch_add(other.m_buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_count.fetch_add(other.m_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_total_us.fetch_add(other.m_total_us.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    const uint64_t other_worst = other.m_worst_us.load(std::memory_order_relaxed);
+    uint64_t worst = m_worst_us.load(std::memory_order_relaxed);
+    while (other_worst > worst &&
+           m_worst_us.compare_exchange_weak(worst, other_worst, std::memory_order_relaxed) == false)
+    {
+    }
+}
+
+double TimeHistogram::percentile(double fraction) const
+{
+    const uint64_t total = count();
+    if (total == 0)
+        return 0.0;
+
+    const uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; i++)
+    {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucket_middle_ms(i), worst());
+    }
+    return worst();
+}
+
+uint64_t TimeHistogram::count(void) const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+double TimeHistogram::worst(void) const
+{
+    return m_worst_us.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double TimeHistogram::mean(void) const
+{
+    const uint64_t total = count();
+    return total == 0 ? 0.0 : m_total_us.load(std::memory_order_relaxed) / 1000.0 / total;
+}
+
+constexpr size_t metric_count = static_cast<size_t>(FrameMetric::count);
+
+/*
+ * Frames record into the current slice of the ring. The merged histogram is
+ * only scratch space for publishing the window.
+ */
+static std::array<std::array<TimeHistogram, metric_count>, frame_stats_slices> s_slices;
+static std::array<std::array<std::atomic<uint64_t>, metric_count>, frame_stats_slices> s_slice_hitches{};
+static std::array<TimeHistogram, metric_count> s_merged;
+static std::array<TimeHistogram, metric_count> s_lifetime;
+static std::array<std::atomic<uint64_t>, metric_count> s_lifetime_hitches{};
+static std::array<FrameStatsSummary, metric_count> s_window_summary{};
+static size_t s_slice = 0;
+static uint64_t s_slice_frame = 0;
+
+static FrameStatsSummary summarise(const TimeHistogram& histogram, uint64_t hitches)
+{
+    return
+    {
+        .p50 = histogram.percentile(0.5),
+        .p90 = histogram.percentile(0.9),
+        .p99 = histogram.percentile(0.99),
+        .p999 = histogram.percentile(0.999),
+        .worst = histogram.worst(),
+        .mean = histogram.mean(),
+        .frames = histogram.count(),
+        .hitches = hitches
+    };
+}
+
+void record_frame_time(FrameMetric metric, double ms)
+{
+    const size_t index = static_cast<size_t>(metric);
+    s_slices[s_slice][index].record(ms);
+    s_lifetime[index].record(ms);
+
+    if (ms > frame_stats_settings.hitch_threshold_ms)
+    {
+        s_slice_hitches[s_slice][index].fetch_add(1, std::memory_order_relaxed);
+        s_lifetime_hitches[index].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void end_stats_frame(void)
+{
+    const uint64_t slice_frames = std::max<uint64_t>(frame_stats_settings.window_frames / frame_stats_slices, 1);
+    if (++s_slice_frame < slice_frames)
+        return;
+
+    for (size_t i = 0; i < metric_count; i++)
+    {
+        uint64_t hitches = 0;
+        s_merged[i].reset();
+        for (size_t slice = 0; slice < frame_stats_slices; slice++)
+        {
+            s_merged[i].merge(s_slices[slice][i]);
+            hitches += s_slice_hitches[slice][i].load();
+        }
+        s_window_summary[i] = summarise(s_merged[i], hitches);
+    }
+
+    s_slice = (s_slice + 1) % frame_stats_slices;
+    for (size_t i = 0; i < metric_count; i++)
+    {
+        s_slices[s_slice][i].reset();
+        s_slice_hitches[s_slice][i].store(0);
+    }
+    s_slice_frame = 0;
+}
+
+const FrameStatsSummary& window_frame_stats(FrameMetric metric)
+{
+    return s_window_summary[static_cast<size_t>(metric)];
+}
+
+FrameStatsSummary lifetime_frame_stats(FrameMetric metric)
+{
+    const size_t index = static_cast<size_t>(metric);
+    return summarise(s_lifetime[index], s_lifetime_hitches[index].load());
+}
+
+const char* frame_metric_name(FrameMetric metric)
+{
+    switch (metric)
+    {
+        case FrameMetric::cpu:
+            return "cpu";
+        case FrameMetric::gpu:
+            return "gpu";
+        case FrameMetric::present:
+            return "present";
+        default:
+            return "unknown";
+    }
+}
+
+bool write_frame_stats_json(const char* path)
+{
+    std::ofstream out(path);
+    if (out.good() == false)
+        return false;
+
+    out << "{\n  \"hitch_threshold_ms\": " << frame_stats_settings.hitch_threshold_ms;
+    for (size_t i = 0; i < metric_count; i++)
+    {
+        const FrameMetric metric = static_cast<FrameMetric>(i);
+        const FrameStatsSummary stats = lifetime_frame_stats(metric);
+        out << ",\n  \"" << frame_metric_name(metric) << "\": {"
+            << "\"frames\": " << stats.frames
+            << ", \"mean_ms\": " << stats.mean
+            << ", \"p50_ms\": " << stats.p50
+            << ", \"p90_ms\": " << stats.p90
+            << ", \"p99_ms\": " << stats.p99
+            << ", \"p99_9_ms\": " << stats.p999
+            << ", \"worst_ms\": " << stats.worst
+            << ", \"hitches\": " << stats.hitches
+            << "}";
+    }
+    out << "\n}\n";
+
+    return out.good();
+}
+
+} // namespace cg
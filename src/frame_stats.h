@@ -0,0 +1,107 @@
+#ifndef CG_FRAME_STATS
+#define CG_FRAME_STATS
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Log-linear histogram of durations, 16 buckets per power of two of
+ * microseconds (about 4% resolution) from 1 us to 2^24 us. Recording is a
+ * single relaxed atomic increment, so any thread may record.
+ */
+class TimeHistogram
+{
+public:
+    static constexpr size_t sub_buckets = 16;
+    static constexpr size_t octaves = 24;
+    static constexpr size_t bucket_count = sub_buckets * octaves;
+
+    void record(double ms);
+    void reset(void);
+
+    /*
+     * Add the samples of another histogram to this one.
+     */
+    void merge(const TimeHistogram& other);
+
+    /*
+     * Middle of the bucket holding the given fraction of samples,
+     * e.g. 0.99 for p99. Zero when empty.
+     */
+    double percentile(double fraction) const;
+
+    uint64_t count(void) const;
+    double worst(void) const;
+    double mean(void) const;
+
+private:
+    std::array<std::atomic<uint32_t>, bucket_count> m_buckets{};
+    std::atomic<uint64_t> m_count = 0;
+    std::atomic<uint64_t> m_total_us = 0;
+    std::atomic<uint64_t> m_worst_us = 0;
+};
+
+enum class FrameMetric
+{
+    cpu,     /* Start of the frame to the swap call. */
+    gpu,     /* GPU time of the frame, from the GPU profiler. */
+    present, /* Swap to swap. */
+    count
+};
+
+struct FrameStatsSummary
+{
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double worst;
+    double mean;
+    uint64_t frames;
+    uint64_t hitches;
+};
+
+struct FrameStatsSettings
+{
+    uint64_t window_frames;    /* Frames the rolling window covers. */
+    double hitch_threshold_ms; /* Frames above this are hitches. */
+};
+extern FrameStatsSettings frame_stats_settings;
+
+void record_frame_time(FrameMetric metric, double ms);
+
+/*
+ * The window is a ring of this many histograms, each covering an equal
+ * slice of window_frames.
+ */
+constexpr size_t frame_stats_slices = 10;
+
+/*
+ * Close the frame. Whenever a slice fills up, the statistics over the whole
+ * ring are published and the oldest slice restarts, so the window rolls
+ * forward a slice at a time.
+ */
+void end_stats_frame(void);
+
+/*
+ * The last window_frames frames, as of the last slice, and everything since
+ * startup.
+ */
+const FrameStatsSummary& window_frame_stats(FrameMetric metric);
+FrameStatsSummary lifetime_frame_stats(FrameMetric metric);
+
+/*
+ * Lifetime summary of every metric as JSON, for comparing builds.
+ */
+bool write_frame_stats_json(const char* path);
+
+const char* frame_metric_name(FrameMetric metric);
+
+} // namespace cg
+
+#endif
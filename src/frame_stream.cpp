@@ -0,0 +1,326 @@
+#include "glad/glad.h"
+
+#include "frame_stream.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "profiler.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace cg
+{
+
+struct WriteBuffer
+{
+    const void* data;
+    size_t size;
+};
+
+/*
+ * Write every buffer in order, resuming after short writes, as pipes
+ * accept at most their capacity at a time.
+ */
+static bool write_all(int fd, WriteBuffer* buffers, int count)
+{
+#if defined(_WIN32)
+    for (int i = 0; i < count; i++)
+    {
+        const char* data = static_cast<const char*>(buffers[i].data);
+        size_t left = buffers[i].size;
+        while (left > 0)
+        {
+            const int written = _write(fd, data, static_cast<unsigned int>(std::min<size_t>(left, 1 << 30)));
+            if (written <= 0)
+                return false;
+            data += written;
+            left -= written;
+        }
+    }
+    return true;
+#else
+    iovec vectors[4];
+    for (int i = 0; i < count; i++)
+        vectors[i] = { const_cast<void*>(buffers[i].data), buffers[i].size };
+
+    iovec* next = vectors;
+    while (count > 0)
+    {
+        const ssize_t written = writev(fd, next, count);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        size_t done = static_cast<size_t>(written);
+        while (count > 0 && done >= next->iov_len)
+        {
+            done -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0)
+        {
+            next->iov_base = static_cast<char*>(next->iov_base) + done;
+            next->iov_len -= done;
+        }
+    }
+    return true;
+#endif
+}
+
+FrameStream::FrameStream(int fd, StreamFormat format, int width, int height, int fps, size_t slot_count)
+    : m_slots(std::make_unique<Slot[]>(slot_count)),
+      m_slot_count(slot_count),
+      m_frame_size(static_cast<size_t>(width) * height * (format == StreamFormat::rgba ? 4 : 3) /
+                   (format == StreamFormat::rgba ? 1 : 2)),
+      m_fd(fd),
+      m_format(format),
+      m_width(width),
+      m_height(height),
+      m_fps(fps)
+{
+    if (width % 8 != 0 || height % 2 != 0)
+    {
+        std::cerr << "Streams need a width divisible by 8 and an even height." << std::endl;
+        return;
+    }
+
+    m_program = load_compute_program(format == StreamFormat::rgba ? "resources/shaders/rgba_c.glsl"
+                                                                   : "resources/shaders/yuv420_c.glsl");
+    if (m_program == 0)
+        return;
+    glProgramUniform2i(m_program, get_uniform_location(m_program, "u_size"), width, height);
+
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        Slot& slot = m_slots[i];
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, m_frame_size, nullptr, flags);
+        slot.mapped = static_cast<const uint8_t*>(
+            glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_frame_size, flags));
+        label_gl_object(GL_BUFFER, slot.buffer, "stream");
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_writer = std::thread([this] { write_frames(); });
+}
+
+FrameStream::~FrameStream(void)
+{
+    if (m_writer.joinable() == true)
+    {
+        flush();
+
+        /*
+         * The writer waits on the slot of the next frame it is handed,
+         * which after a failed wait may still be converting.
+         */
+        Slot& next = m_slots[m_handed % m_slot_count];
+        next.state.store(SlotState::closed, std::memory_order_release);
+        next.state.notify_all();
+        m_writer.join();
+    }
+
+    for (; m_handed < m_submitted; m_handed++)
+        glDeleteSync(static_cast<GLsync>(m_slots[m_handed % m_slot_count].fence));
+
+    for (size_t i = 0; i < m_slot_count; i++)
+    {
+        Slot& slot = m_slots[i];
+        if (slot.buffer == 0)
+            continue;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteProgram(m_program);
+}
+
+bool FrameStream::submit(const RenderTarget& target)
+{
+    if (valid() == false || target.width != m_width || target.height != m_height)
+        return false;
+
+    CG_PROFILE_SCOPE("stream");
+
+    hand_over(false);
+
+    Slot& slot = m_slots[m_submitted % m_slot_count];
+    SlotState state = slot.state.load(std::memory_order_acquire);
+    if (state != SlotState::free)
+        m_stalls++;
+
+    /*
+     * Still converting means it is the oldest frame on the GPU; otherwise
+     * the writer has it.
+     */
+    while (state != SlotState::free && m_failed.load(std::memory_order_relaxed) == false)
+    {
+        if (state == SlotState::converting)
+            hand_over(true);
+        else
+            slot.state.wait(state, std::memory_order_acquire);
+        state = slot.state.load(std::memory_order_acquire);
+    }
+
+    if (m_failed.load(std::memory_order_relaxed) == true)
+        return false;
+
+    {
+        GpuZone zone("stream");
+
+        glUseProgram(m_program);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, target.color);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, slot.buffer);
+
+        if (m_format == StreamFormat::rgba)
+            glDispatchCompute((m_width + 7) / 8, (m_height + 7) / 8, 1);
+        else
+            glDispatchCompute((m_width / 8 + 7) / 8, (m_height / 2 + 7) / 8, 1);
+
+        /*
+         * Make the shader writes visible through the persistent mapping
+         * once the fence signals.
+         */
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    }
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state.store(SlotState::converting, std::memory_order_relaxed);
+    m_submitted++;
+    return true;
+}
+
+/*
+ * Pass converted frames to the writer in submission order. A wait that
+ * fails fails the stream; the frames after it never reach the writer.
+ */
+void FrameStream::hand_over(bool wait)
+{
+    while (m_handed < m_submitted)
+    {
+        Slot& slot = m_slots[m_handed % m_slot_count];
+        const GLsync fence = static_cast<GLsync>(slot.fence);
+
+        const GLuint64 timeout = wait == true ? UINT64_MAX : 0;
+        const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            if (wait == true)
+                m_failed.store(true, std::memory_order_relaxed);
+            return;
+        }
+
+        glDeleteSync(fence);
+        slot.fence = nullptr;
+        slot.state.store(SlotState::ready, std::memory_order_release);
+        slot.state.notify_all();
+        m_handed++;
+        wait = false;
+    }
+}
+
+void FrameStream::flush(void)
+{
+    while (m_handed < m_submitted && m_failed.load(std::memory_order_relaxed) == false)
+        hand_over(true);
+
+    for (uint64_t written = m_written.load(std::memory_order_acquire);
+         written < m_handed;
+         written = m_written.load(std::memory_order_acquire))
+    {
+        m_written.wait(written, std::memory_order_acquire);
+    }
+}
+
+StreamStats FrameStream::stats(void) const
+{
+    const uint64_t frames = m_written.load(std::memory_order_acquire);
+    return
+    {
+        .frames = frames,
+        .bytes = frames * m_frame_size,
+        .stalls = m_stalls,
+        .failed = m_failed.load(std::memory_order_relaxed)
+    };
+}
+
+void FrameStream::write_frames(void)
+{
+    set_profiler_thread_name("Stream writer");
+
+    if (m_format == StreamFormat::y4m)
+    {
+        /*
+         * Chroma is averaged over 2 x 2 pixels, so it is sited at their
+         * centre, as in JPEG.
+         */
+        char header[128];
+        const int length = std::snprintf(header,
+                                         sizeof(header),
+                                         "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                                         m_width,
+                                         m_height,
+                                         m_fps);
+        WriteBuffer buffer = { header, static_cast<size_t>(length) };
+        if (write_all(m_fd, &buffer, 1) == false)
+            m_failed.store(true, std::memory_order_relaxed);
+    }
+
+    static const char frame_header[] = "FRAME\n";
+
+    for (size_t frame = 0;; frame++)
+    {
+        Slot& slot = m_slots[frame % m_slot_count];
+        SlotState state = slot.state.load(std::memory_order_acquire);
+        while (state != SlotState::ready && state != SlotState::closed)
+        {
+            slot.state.wait(state, std::memory_order_acquire);
+            state = slot.state.load(std::memory_order_acquire);
+        }
+
+        if (state == SlotState::closed)
+            return;
+
+        /*
+         * After a failure frames are still consumed, so the GL thread
+         * never waits for a slot forever.
+         */
+        if (m_failed.load(std::memory_order_relaxed) == false)
+        {
+            CG_PROFILE_SCOPE("writev");
+
+            WriteBuffer buffers[2];
+            int count = 0;
+            if (m_format == StreamFormat::y4m)
+                buffers[count++] = { frame_header, sizeof(frame_header) - 1 };
+            buffers[count++] = { slot.mapped, m_frame_size };
+
+            if (write_all(m_fd, buffers, count) == false)
+                m_failed.store(true, std::memory_order_relaxed);
+        }
+
+        slot.state.store(SlotState::free, std::memory_order_release);
+        slot.state.notify_all();
+        m_written.fetch_add(1, std::memory_order_release);
+        m_written.notify_all();
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,106 @@
+#ifndef CG_FRAME_STREAM
+#define CG_FRAME_STREAM
+
+#include "render_target.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace cg
+{
+
+enum class StreamFormat
+{
+    y4m,    /* YUV4MPEG2 4:2:0, what ffmpeg and x264 read from a pipe. */
+    yuv420, /* Raw I420 planes. */
+    rgba    /* Raw RGBA8, top row first. */
+};
+
+struct StreamStats
+{
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t stalls; /* Submits that waited for a free slot. */
+    bool failed;     /* A write failed, e.g. the reader closed the pipe, or a wait for the GPU. */
+};
+
+/*
+ * Streams frames of a RenderTarget to a file descriptor as raw video.
+ *
+ * A compute pass converts the frame straight into one of a ring of
+ * persistently mapped buffers, so the GPU does the colour conversion and
+ * the copy out of the texture. A writer thread hands each finished buffer
+ * to writev() in place: no glReadPixels, no intermediate copies.
+ *
+ * The width must be a multiple of 8 and the height even. All members
+ * except the writer thread run on the GL thread.
+ */
+class FrameStream
+{
+public:
+    FrameStream(int fd, StreamFormat format, int width, int height, int fps, size_t slot_count);
+    ~FrameStream(void);
+
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    bool valid(void) const { return m_program != 0; }
+
+    /*
+     * Queue the conversion of the target's color attachment. Waits only
+     * when every slot is still being converted or written. Returns false
+     * once a write has failed.
+     */
+    bool submit(const RenderTarget& target);
+
+    /*
+     * Wait until every submitted frame is written, or until waiting for
+     * the GPU fails.
+     */
+    void flush(void);
+
+    StreamStats stats(void) const;
+
+private:
+    enum class SlotState : uint32_t
+    {
+        free,
+        converting,
+        ready,
+        closed
+    };
+
+    struct Slot
+    {
+        unsigned int buffer = 0;
+        void* fence = nullptr;
+        const uint8_t* mapped = nullptr;
+        std::atomic<SlotState> state = SlotState::free;
+    };
+
+    void hand_over(bool wait);
+    void write_frames(void);
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_slot_count;
+    size_t m_submitted = 0;
+    size_t m_handed = 0;
+    size_t m_frame_size;
+    unsigned int m_program = 0;
+    int m_fd;
+    StreamFormat m_format;
+    int m_width;
+    int m_height;
+    int m_fps;
+    uint64_t m_stalls = 0;
+    std::atomic<uint64_t> m_written = 0;
+    std::atomic<bool> m_failed = false;
+    std::thread m_writer;
+};
+
+} // namespace cg
+
+#endif
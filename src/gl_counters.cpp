@@ -0,0 +1,596 @@
+#include "glad/glad.h"
+
+#include "gl_counters.h"
+
+namespace cg
+{
+
+static GlCounters s_current{};
+static GlCounters s_last{};
+
+#ifdef CG_GL_COUNTERS_ENABLED
+
+static GlCallCallback s_pre = nullptr;
+static GlCallCallback s_post = nullptr;
+
+static uint64_t primitives(GLenum mode, GLsizei count)
+{
+    switch (mode)
+    {
+        case GL_TRIANGLES:
+            return count / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            return count > 2 ? count - 2 : 0;
+        case GL_LINES:
+            return count / 2;
+        case GL_LINE_STRIP:
+            return count > 1 ? count - 1 : 0;
+        default:
+            return count;
+    }
+}
+
+/*
+ * Approximate upload size of a pixel transfer.
+ */
+static uint64_t pixel_bytes(GLenum format, GLenum type)
+{
+    switch (type)
+    {
+        case GL_UNSIGNED_INT_24_8:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_10F_11F_11F_REV:
+            return 4;
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return 2;
+        default:
+            break;
+    }
+
+    uint64_t components = 4;
+    switch (format)
+    {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+        case GL_DEPTH_STENCIL:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+        case GL_RGB_INTEGER:
+            components = 3;
+            break;
+        default:
+            break;
+    }
+
+    switch (type)
+    {
+        case GL_FLOAT:
+        case GL_INT:
+        case GL_UNSIGNED_INT:
+            return components * 4;
+        case GL_HALF_FLOAT:
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return components * 2;
+        default:
+            return components;
+    }
+}
+
+/*
+ * Each hook keeps the GLAD pointer it replaced, counts, and forwards.
+ * Names are passed unexpanded, so #name is the GL function name.
+ */
+#define CG_GL_HOOK(proc, name, params, args, count) \
+    static proc s_##name = nullptr;                  \
+    static void APIENTRY hooked_##name params        \
+    {                                                \
+        if (s_pre != nullptr)                        \
+            s_pre(#name);                            \
+        s_current.calls++;                           \
+        count;                                       \
+        s_##name args;                               \
+        if (s_post != nullptr)                       \
+            s_post(#name);                           \
+    }
+
+/*
+ * For functions that return a value.
+ */
+#define CG_GL_HOOK_RESULT(proc, result, name, params, args, count) \
+    static proc s_##name = nullptr;                                \
+    static result APIENTRY hooked_##name params                    \
+    {                                                              \
+        if (s_pre != nullptr)                                      \
+            s_pre(#name);                                          \
+        s_current.calls++;                                         \
+        count;                                                     \
+        result value = s_##name args;                              \
+        if (s_post != nullptr)                                     \
+            s_post(#name);                                         \
+        return value;                                              \
+    }
+
+/*
+ * Functions the context does not have stay null.
+ */
+#define CG_GL_INSTALL(name)              \
+    if (glad_##name != nullptr)          \
+    {                                    \
+        s_##name = glad_##name;          \
+        glad_##name = hooked_##name;     \
+    }
+
+/*
+ * Draws.
+ */
+CG_GL_HOOK(PFNGLDRAWARRAYSPROC, glDrawArrays,
+           (GLenum mode, GLint first, GLsizei count),
+           (mode, first, count),
+           s_current.draw_calls++; s_current.primitives += primitives(mode, count))
+
+CG_GL_HOOK(PFNGLDRAWELEMENTSPROC, glDrawElements,
+           (GLenum mode, GLsizei count, GLenum type, const void* indices),
+           (mode, count, type, indices),
+           s_current.draw_calls++; s_current.primitives += primitives(mode, count))
+
+CG_GL_HOOK(PFNGLDRAWARRAYSINSTANCEDPROC, glDrawArraysInstanced,
+           (GLenum mode, GLint first, GLsizei count, GLsizei instances),
+           (mode, first, count, instances),
+           s_current.draw_calls++; s_current.primitives += primitives(mode, count) * instances)
+
+CG_GL_HOOK(PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced,
+           (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances),
+           (mode, count, type, indices, instances),
+           s_current.draw_calls++; s_current.primitives += primitives(mode, count) * instances)
+
+/*
+ * Compute.
+ */
+CG_GL_HOOK(PFNGLDISPATCHCOMPUTEPROC, glDispatchCompute,
+           (GLuint x, GLuint y, GLuint z),
+           (x, y, z),
+           s_current.compute_dispatches++)
+
+CG_GL_HOOK(PFNGLMEMORYBARRIERPROC, glMemoryBarrier,
+           (GLbitfield barriers),
+           (barriers),
+           s_current.memory_barriers++)
+
+/*
+ * Bindings.
+ */
+CG_GL_HOOK(PFNGLUSEPROGRAMPROC, glUseProgram,
+           (GLuint program),
+           (program),
+           s_current.program_binds++)
+
+CG_GL_HOOK(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray,
+           (GLuint array),
+           (array),
+           s_current.vertex_array_binds++)
+
+CG_GL_HOOK(PFNGLBINDBUFFERPROC, glBindBuffer,
+           (GLenum target, GLuint buffer),
+           (target, buffer),
+           s_current.buffer_binds++)
+
+CG_GL_HOOK(PFNGLBINDBUFFERBASEPROC, glBindBufferBase,
+           (GLenum target, GLuint index, GLuint buffer),
+           (target, index, buffer),
+           s_current.buffer_binds++)
+
+CG_GL_HOOK(PFNGLBINDTEXTUREPROC, glBindTexture,
+           (GLenum target, GLuint texture),
+           (target, texture),
+           s_current.texture_binds++)
+
+CG_GL_HOOK(PFNGLACTIVETEXTUREPROC, glActiveTexture,
+           (GLenum texture),
+           (texture),
+           (void)0)
+
+CG_GL_HOOK(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer,
+           (GLenum target, GLuint framebuffer),
+           (target, framebuffer),
+           s_current.framebuffer_binds++)
+
+CG_GL_HOOK(PFNGLFRAMEBUFFERTEXTURELAYERPROC, glFramebufferTextureLayer,
+           (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer),
+           (target, attachment, texture, level, layer),
+           (void)0)
+
+/*
+ * Fixed function state.
+ */
+CG_GL_HOOK(PFNGLENABLEPROC, glEnable,
+           (GLenum cap),
+           (cap),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLDISABLEPROC, glDisable,
+           (GLenum cap),
+           (cap),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLBLENDFUNCPROC, glBlendFunc,
+           (GLenum source, GLenum destination),
+           (source, destination),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLDEPTHFUNCPROC, glDepthFunc,
+           (GLenum function),
+           (function),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLDEPTHMASKPROC, glDepthMask,
+           (GLboolean flag),
+           (flag),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLBLENDFUNCIPROC, glBlendFunci,
+           (GLuint buffer, GLenum source, GLenum destination),
+           (buffer, source, destination),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLCOLORMASKPROC, glColorMask,
+           (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha),
+           (red, green, blue, alpha),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLPOLYGONOFFSETPROC, glPolygonOffset,
+           (GLfloat factor, GLfloat units),
+           (factor, units),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLVIEWPORTPROC, glViewport,
+           (GLint x, GLint y, GLsizei width, GLsizei height),
+           (x, y, width, height),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLCLEARCOLORPROC, glClearColor,
+           (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha),
+           (red, green, blue, alpha),
+           s_current.render_state_changes++)
+
+CG_GL_HOOK(PFNGLDRAWBUFFERSPROC, glDrawBuffers,
+           (GLsizei count, const GLenum* buffers),
+           (count, buffers),
+           s_current.render_state_changes++)
+
+/*
+ * Clears, copies and synchronisation.
+ */
+CG_GL_HOOK(PFNGLCLEARPROC, glClear,
+           (GLbitfield mask),
+           (mask),
+           (void)0)
+
+CG_GL_HOOK(PFNGLCLEARBUFFERFVPROC, glClearBufferfv,
+           (GLenum buffer, GLint draw_buffer, const GLfloat* value),
+           (buffer, draw_buffer, value),
+           (void)0)
+
+CG_GL_HOOK(PFNGLBLITNAMEDFRAMEBUFFERPROC, glBlitNamedFramebuffer,
+           (GLuint source, GLuint destination, GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+            GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter),
+           (source, destination, src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1, mask, filter),
+           (void)0)
+
+CG_GL_HOOK(PFNGLBLITFRAMEBUFFERPROC, glBlitFramebuffer,
+           (GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+            GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter),
+           (src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1, mask, filter),
+           (void)0)
+
+CG_GL_HOOK_RESULT(PFNGLFENCESYNCPROC, GLsync, glFenceSync,
+                  (GLenum condition, GLbitfield flags),
+                  (condition, flags),
+                  (void)0)
+
+CG_GL_HOOK_RESULT(PFNGLCLIENTWAITSYNCPROC, GLenum, glClientWaitSync,
+                  (GLsync sync, GLbitfield flags, GLuint64 timeout),
+                  (sync, flags, timeout),
+                  (void)0)
+
+CG_GL_HOOK(PFNGLDELETESYNCPROC, glDeleteSync,
+           (GLsync sync),
+           (sync),
+           (void)0)
+
+/*
+ * State queries and debug groups.
+ */
+CG_GL_HOOK(PFNGLGETINTEGERVPROC, glGetIntegerv,
+           (GLenum name, GLint* data),
+           (name, data),
+           (void)0)
+
+CG_GL_HOOK(PFNGLGETFRAMEBUFFERATTACHMENTPARAMETERIVPROC, glGetFramebufferAttachmentParameteriv,
+           (GLenum target, GLenum attachment, GLenum name, GLint* value),
+           (target, attachment, name, value),
+           (void)0)
+
+CG_GL_HOOK(PFNGLPUSHDEBUGGROUPPROC, glPushDebugGroup,
+           (GLenum source, GLuint id, GLsizei length, const GLchar* message),
+           (source, id, length, message),
+           (void)0)
+
+CG_GL_HOOK(PFNGLPOPDEBUGGROUPPROC, glPopDebugGroup,
+           (void),
+           (),
+           (void)0)
+
+/*
+ * Queries.
+ */
+CG_GL_HOOK(PFNGLBEGINQUERYPROC, glBeginQuery,
+           (GLenum target, GLuint id),
+           (target, id),
+           s_current.queries++)
+
+CG_GL_HOOK(PFNGLENDQUERYPROC, glEndQuery,
+           (GLenum target),
+           (target),
+           s_current.queries++)
+
+CG_GL_HOOK(PFNGLQUERYCOUNTERPROC, glQueryCounter,
+           (GLuint id, GLenum target),
+           (id, target),
+           s_current.queries++)
+
+CG_GL_HOOK(PFNGLGETQUERYOBJECTIVPROC, glGetQueryObjectiv,
+           (GLuint id, GLenum name, GLint* value),
+           (id, name, value),
+           s_current.queries++)
+
+CG_GL_HOOK(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v,
+           (GLuint id, GLenum name, GLuint64* value),
+           (id, name, value),
+           s_current.queries++)
+
+/*
+ * Uniforms.
+ */
+CG_GL_HOOK(PFNGLUNIFORMMATRIX4FVPROC, glUniformMatrix4fv,
+           (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value),
+           (location, count, transpose, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM3FVPROC, glUniform3fv,
+           (GLint location, GLsizei count, const GLfloat* value),
+           (location, count, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM4FVPROC, glUniform4fv,
+           (GLint location, GLsizei count, const GLfloat* value),
+           (location, count, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM1IPROC, glUniform1i,
+           (GLint location, GLint value),
+           (location, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM1FPROC, glUniform1f,
+           (GLint location, GLfloat value),
+           (location, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM2IPROC, glUniform2i,
+           (GLint location, GLint x, GLint y),
+           (location, x, y),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM2FPROC, glUniform2f,
+           (GLint location, GLfloat x, GLfloat y),
+           (location, x, y),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLUNIFORM2FVPROC, glUniform2fv,
+           (GLint location, GLsizei count, const GLfloat* value),
+           (location, count, value),
+           s_current.uniform_updates++)
+
+CG_GL_HOOK(PFNGLPROGRAMUNIFORM2IPROC, glProgramUniform2i,
+           (GLuint program, GLint location, GLint x, GLint y),
+           (program, location, x, y),
+           s_current.uniform_updates++)
+
+/*
+ * Uploads.
+ */
+CG_GL_HOOK(PFNGLBUFFERDATAPROC, glBufferData,
+           (GLenum target, GLsizeiptr size, const void* data, GLenum usage),
+           (target, size, data, usage),
+           s_current.buffer_bytes_uploaded += data != nullptr ? size : 0)
+
+CG_GL_HOOK(PFNGLBUFFERSUBDATAPROC, glBufferSubData,
+           (GLenum target, GLintptr offset, GLsizeiptr size, const void* data),
+           (target, offset, size, data),
+           s_current.buffer_bytes_uploaded += size)
+
+CG_GL_HOOK(PFNGLNAMEDBUFFERSUBDATAPROC, glNamedBufferSubData,
+           (GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data),
+           (buffer, offset, size, data),
+           s_current.buffer_bytes_uploaded += size)
+
+CG_GL_HOOK(PFNGLBUFFERSTORAGEPROC, glBufferStorage,
+           (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags),
+           (target, size, data, flags),
+           s_current.buffer_bytes_uploaded += data != nullptr ? size : 0)
+
+/*
+ * A range mapped for writing counts in full, whatever is written to it.
+ */
+CG_GL_HOOK_RESULT(PFNGLMAPBUFFERRANGEPROC, void*, glMapBufferRange,
+                  (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access),
+                  (target, offset, length, access),
+                  s_current.buffer_bytes_uploaded += (access & GL_MAP_WRITE_BIT) != 0 ? length : 0)
+
+CG_GL_HOOK_RESULT(PFNGLUNMAPBUFFERPROC, GLboolean, glUnmapBuffer,
+                  (GLenum target),
+                  (target),
+                  (void)0)
+
+CG_GL_HOOK(PFNGLGETBUFFERSUBDATAPROC, glGetBufferSubData,
+           (GLenum target, GLintptr offset, GLsizeiptr size, void* data),
+           (target, offset, size, data),
+           (void)0)
+
+CG_GL_HOOK(PFNGLREADPIXELSPROC, glReadPixels,
+           (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels),
+           (x, y, width, height, format, type, pixels),
+           (void)0)
+
+CG_GL_HOOK(PFNGLTEXIMAGE2DPROC, glTexImage2D,
+           (GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+            GLint border, GLenum format, GLenum type, const void* pixels),
+           (target, level, internal_format, width, height, border, format, type, pixels),
+           s_current.texture_bytes_uploaded +=
+               pixels != nullptr ? uint64_t(width) * height * pixel_bytes(format, type) : 0)
+
+CG_GL_HOOK(PFNGLTEXSUBIMAGE2DPROC, glTexSubImage2D,
+           (GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels),
+           (target, level, x, y, width, height, format, type, pixels),
+           s_current.texture_bytes_uploaded += uint64_t(width) * height * pixel_bytes(format, type))
+
+CG_GL_HOOK(PFNGLTEXIMAGE3DPROC, glTexImage3D,
+           (GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+            GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels),
+           (target, level, internal_format, width, height, depth, border, format, type, pixels),
+           s_current.texture_bytes_uploaded +=
+               pixels != nullptr ? uint64_t(width) * height * depth * pixel_bytes(format, type) : 0)
+
+CG_GL_HOOK(PFNGLTEXTURESUBIMAGE2DPROC, glTextureSubImage2D,
+           (GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+            GLenum format, GLenum type, const void* pixels),
+           (texture, level, x, y, width, height, format, type, pixels),
+           s_current.texture_bytes_uploaded += uint64_t(width) * height * pixel_bytes(format, type))
+
+CG_GL_HOOK(PFNGLTEXSUBIMAGE3DPROC, glTexSubImage3D,
+           (GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height,
+            GLsizei depth, GLenum format, GLenum type, const void* pixels),
+           (target, level, x, y, z, width, height, depth, format, type, pixels),
+           s_current.texture_bytes_uploaded +=
+               uint64_t(width) * height * depth * pixel_bytes(format, type))
+
+void install_gl_counters(void)
+{
+    CG_GL_INSTALL(glDrawArrays)
+    CG_GL_INSTALL(glDrawElements)
+    CG_GL_INSTALL(glDrawArraysInstanced)
+    CG_GL_INSTALL(glDrawElementsInstanced)
+    CG_GL_INSTALL(glDispatchCompute)
+    CG_GL_INSTALL(glMemoryBarrier)
+    CG_GL_INSTALL(glUseProgram)
+    CG_GL_INSTALL(glBindVertexArray)
+    CG_GL_INSTALL(glBindBuffer)
+    CG_GL_INSTALL(glBindBufferBase)
+    CG_GL_INSTALL(glBindTexture)
+    CG_GL_INSTALL(glActiveTexture)
+    CG_GL_INSTALL(glBindFramebuffer)
+    CG_GL_INSTALL(glFramebufferTextureLayer)
+    CG_GL_INSTALL(glEnable)
+    CG_GL_INSTALL(glDisable)
+    CG_GL_INSTALL(glBlendFunc)
+    CG_GL_INSTALL(glDepthFunc)
+    CG_GL_INSTALL(glDepthMask)
+    CG_GL_INSTALL(glBlendFunci)
+    CG_GL_INSTALL(glColorMask)
+    CG_GL_INSTALL(glPolygonOffset)
+    CG_GL_INSTALL(glViewport)
+    CG_GL_INSTALL(glClearColor)
+    CG_GL_INSTALL(glDrawBuffers)
+    CG_GL_INSTALL(glClear)
+    CG_GL_INSTALL(glClearBufferfv)
+    CG_GL_INSTALL(glBlitNamedFramebuffer)
+    CG_GL_INSTALL(glBlitFramebuffer)
+    CG_GL_INSTALL(glFenceSync)
+    CG_GL_INSTALL(glClientWaitSync)
+    CG_GL_INSTALL(glDeleteSync)
+    CG_GL_INSTALL(glGetIntegerv)
+    CG_GL_INSTALL(glGetFramebufferAttachmentParameteriv)
+    CG_GL_INSTALL(glPushDebugGroup)
+    CG_GL_INSTALL(glPopDebugGroup)
+    CG_GL_INSTALL(glBeginQuery)
+    CG_GL_INSTALL(glEndQuery)
+    CG_GL_INSTALL(glQueryCounter)
+    CG_GL_INSTALL(glGetQueryObjectiv)
+    CG_GL_INSTALL(glGetQueryObjectui64v)
+    CG_GL_INSTALL(glUniformMatrix4fv)
+    CG_GL_INSTALL(glUniform3fv)
+    CG_GL_INSTALL(glUniform4fv)
+    CG_GL_INSTALL(glUniform1i)
+    CG_GL_INSTALL(glUniform1f)
+    CG_GL_INSTALL(glUniform2i)
+    CG_GL_INSTALL(glUniform2f)
+    CG_GL_INSTALL(glUniform2fv)
+    CG_GL_INSTALL(glProgramUniform2i)
+    CG_GL_INSTALL(glBufferData)
+    CG_GL_INSTALL(glBufferSubData)
+    CG_GL_INSTALL(glNamedBufferSubData)
+    CG_GL_INSTALL(glBufferStorage)
+    CG_GL_INSTALL(glMapBufferRange)
+    CG_GL_INSTALL(glUnmapBuffer)
+    CG_GL_INSTALL(glGetBufferSubData)
+    CG_GL_INSTALL(glReadPixels)
+    CG_GL_INSTALL(glTexImage2D)
+    CG_GL_INSTALL(glTexSubImage2D)
+    CG_GL_INSTALL(glTextureSubImage2D)
+    CG_GL_INSTALL(glTexImage3D)
+    CG_GL_INSTALL(glTexSubImage3D)
+}
+
+void set_gl_call_callbacks(GlCallCallback pre, GlCallCallback post)
+{
+    s_pre = pre;
+    s_post = post;
+}
+
+bool gl_counters_enabled(void)
+{
+    return true;
+}
+
+#else
+
+void install_gl_counters(void)
+{
+}
+
+void set_gl_call_callbacks(GlCallCallback pre, GlCallCallback post)
+{
+}
+
+bool gl_counters_enabled(void)
+{
+    return false;
+}
+
+#endif
+
+void end_gl_counter_frame(void)
+{
+    s_last = s_current;
+    s_current = {};
+}
+
+const GlCounters& last_frame_gl_counters(void)
+{
+    return s_last;
+}
+
+} // namespace cg
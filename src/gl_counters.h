@@ -0,0 +1,55 @@
+#ifndef CG_GL_COUNTERS
+#define CG_GL_COUNTERS
+
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Per frame GL call counts. Only collected in builds with
+ * CG_GL_COUNTERS_ENABLED, otherwise everything here is a no-op and GL calls
+ * go straight to the driver.
+ */
+struct GlCounters
+{
+    uint64_t calls; /* Every hooked call. The hooks cover drawing a frame, not creating objects. */
+    uint64_t draw_calls;
+    uint64_t compute_dispatches;
+    uint64_t memory_barriers;
+    uint64_t queries; /* Begin, end, timestamp and result reads. */
+    uint64_t primitives;
+    uint64_t program_binds;
+    uint64_t vertex_array_binds;
+    uint64_t buffer_binds;
+    uint64_t texture_binds;
+    uint64_t framebuffer_binds;
+    uint64_t render_state_changes; /* Enable, disable, blend, depth, masks, viewport, clear color, draw buffers. */
+    uint64_t uniform_updates;
+    uint64_t buffer_bytes_uploaded;
+    uint64_t texture_bytes_uploaded;
+};
+
+/*
+ * Called with the GL function name around every hooked call, like GLAD's
+ * debug generator. Either may be nullptr.
+ */
+using GlCallCallback = void (*)(const char* name);
+
+/*
+ * Wrap the GLAD function pointers. Call right after gladLoadGL().
+ */
+void install_gl_counters(void);
+void set_gl_call_callbacks(GlCallCallback pre, GlCallCallback post);
+
+/*
+ * Publish the counts of the frame that just ended and start a new one.
+ */
+void end_gl_counter_frame(void);
+const GlCounters& last_frame_gl_counters(void);
+
+bool gl_counters_enabled(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,241 @@
+#include "glad/glad.h"
+
+#include "gl_debug.h"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace cg
+{
+
+GlDebugSettings gl_debug_settings
+{
+#if defined(NDEBUG) || defined(RELEASE)
+    .debug_context = false,
+#else
+    .debug_context = true,
+#endif
+    .min_severity = GlDebugSeverity::low
+};
+
+/*
+ * Distinct messages kept. Further ones are counted as dropped, so a driver
+ * that spams unique ids cannot grow the log without bound.
+ */
+constexpr size_t max_gl_debug_messages = 128;
+
+static std::mutex s_mutex;
+static std::array<GlDebugMessage, max_gl_debug_messages> s_messages;
+static size_t s_message_count = 0;
+static GlDebugStats s_stats{};
+static bool s_enabled = false;
+
+static GlDebugSeverity to_severity(GLenum severity)
+{
+    switch (severity)
+    {
+        case GL_DEBUG_SEVERITY_HIGH:
+            return GlDebugSeverity::high;
+        case GL_DEBUG_SEVERITY_MEDIUM:
+            return GlDebugSeverity::medium;
+        case GL_DEBUG_SEVERITY_LOW:
+            return GlDebugSeverity::low;
+        default:
+            return GlDebugSeverity::notification;
+    }
+}
+
+/*
+ * Linear search. The log is small and repeats hit the same few entries.
+ */
+static GlDebugMessage* find_message(GLenum source, GLenum type, GLuint id)
+{
+    for (size_t i = 0; i < s_message_count; i++)
+    {
+        GlDebugMessage& message = s_messages[i];
+        if (message.id == id && message.type == type && message.source == source)
+            return &message;
+    }
+    return nullptr;
+}
+
+static void APIENTRY debug_callback(GLenum source,
+                                    GLenum type,
+                                    GLuint id,
+                                    GLenum severity,
+                                    GLsizei length,
+                                    const GLchar* text,
+                                    const void* user)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    s_stats.messages++;
+    if (type == GL_DEBUG_TYPE_PERFORMANCE)
+        s_stats.performance_warnings++;
+    if (type == GL_DEBUG_TYPE_ERROR)
+        s_stats.errors++;
+
+    GlDebugMessage* message = find_message(source, type, id);
+    if (message != nullptr)
+    {
+        message->count++;
+        return;
+    }
+
+    if (s_message_count == s_messages.size())
+    {
+        s_stats.dropped++;
+        return;
+    }
+
+    message = &s_messages[s_message_count++];
+    message->source = source;
+    message->type = type;
+    message->id = id;
+    message->severity = to_severity(severity);
+    message->performance = type == GL_DEBUG_TYPE_PERFORMANCE;
+    message->count = 1;
+    std::snprintf(message->text, sizeof(message->text), "%s", text);
+
+    std::fprintf(stderr,
+                 "GL %s %s [%s] %u: %s\n",
+                 gl_debug_source_name(source),
+                 gl_debug_type_name(type),
+                 gl_debug_severity_name(message->severity),
+                 id,
+                 text);
+}
+
+void init_gl_debug(void)
+{
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0 || glad_glDebugMessageCallback == nullptr)
+        return;
+
+    /*
+     * Asynchronous output: the driver may call back from its own threads,
+     * but does not have to serialise every call. Messages then cannot be
+     * traced back to the exact call; use RenderDoc or a breakpoint with
+     * GL_DEBUG_OUTPUT_SYNCHRONOUS for that.
+     */
+    glEnable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback(debug_callback, nullptr);
+
+    /*
+     * Filter in the driver so disabled messages are never even formatted.
+     */
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    const GLenum severities[] =
+    {
+        GL_DEBUG_SEVERITY_NOTIFICATION,
+        GL_DEBUG_SEVERITY_LOW,
+        GL_DEBUG_SEVERITY_MEDIUM
+    };
+    for (size_t i = 0; i < static_cast<size_t>(gl_debug_settings.min_severity); i++)
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, nullptr, GL_FALSE);
+
+    /*
+     * Our own push/pop group markers come back as messages. Drop them.
+     */
+    glDebugMessageControl(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_PUSH_GROUP,
+                          GL_DONT_CARE, 0, nullptr, GL_FALSE);
+    glDebugMessageControl(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_POP_GROUP,
+                          GL_DONT_CARE, 0, nullptr, GL_FALSE);
+
+    s_enabled = true;
+}
+
+bool gl_debug_enabled(void)
+{
+    return s_enabled;
+}
+
+void gl_debug_messages(std::vector<GlDebugMessage>& messages)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    messages.assign(s_messages.begin(), s_messages.begin() + s_message_count);
+}
+
+GlDebugStats gl_debug_stats(void)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_stats;
+}
+
+const char* gl_debug_source_name(unsigned int source)
+{
+    switch (source)
+    {
+        case GL_DEBUG_SOURCE_API:
+            return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+            return "Window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:
+            return "Shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:
+            return "Third party";
+        case GL_DEBUG_SOURCE_APPLICATION:
+            return "Application";
+        default:
+            return "Other";
+    }
+}
+
+const char* gl_debug_type_name(unsigned int type)
+{
+    switch (type)
+    {
+        case GL_DEBUG_TYPE_ERROR:
+            return "Error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+            return "Deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+            return "Undefined";
+        case GL_DEBUG_TYPE_PORTABILITY:
+            return "Portability";
+        case GL_DEBUG_TYPE_PERFORMANCE:
+            return "Performance";
+        case GL_DEBUG_TYPE_MARKER:
+            return "Marker";
+        default:
+            return "Other";
+    }
+}
+
+const char* gl_debug_severity_name(GlDebugSeverity severity)
+{
+    switch (severity)
+    {
+        case GlDebugSeverity::high:
+            return "high";
+        case GlDebugSeverity::medium:
+            return "medium";
+        case GlDebugSeverity::low:
+            return "low";
+        default:
+            return "notification";
+    }
+}
+
+void push_gl_debug_group(const char* name)
+{
+    if (glad_glPushDebugGroup != nullptr)
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+void pop_gl_debug_group(void)
+{
+    if (glad_glPopDebugGroup != nullptr)
+        glPopDebugGroup();
+}
+
+void label_gl_object(unsigned int identifier, unsigned int name, const char* label)
+{
+    if (glad_glObjectLabel != nullptr)
+        glObjectLabel(identifier, name, -1, label);
+}
+
+} // namespace cg
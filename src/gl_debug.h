@@ -0,0 +1,90 @@
+#ifndef CG_GL_DEBUG
+#define CG_GL_DEBUG
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+enum class GlDebugSeverity
+{
+    notification,
+    low,
+    medium,
+    high
+};
+
+struct GlDebugSettings
+{
+    bool debug_context;           /* Ask GLFW for a debug context. On in debug builds. */
+    GlDebugSeverity min_severity; /* Quieter messages are disabled in the driver. */
+};
+extern GlDebugSettings gl_debug_settings;
+
+/*
+ * One distinct message, keyed by source, type and id. Repeats only bump
+ * the count, the first occurrence is also printed to stderr.
+ */
+struct GlDebugMessage
+{
+    unsigned int source;
+    unsigned int type;
+    unsigned int id;
+    GlDebugSeverity severity;
+    bool performance; /* GL_DEBUG_TYPE_PERFORMANCE. */
+    uint64_t count;
+    char text[256];
+};
+
+/*
+ * Totals since init_gl_debug(). Performance warnings are the messages of
+ * type GL_DEBUG_TYPE_PERFORMANCE: pipeline stalls, shader recompiles,
+ * slow paths chosen by the driver.
+ */
+struct GlDebugStats
+{
+    uint64_t messages;
+    uint64_t performance_warnings;
+    uint64_t errors;
+    uint64_t dropped; /* Distinct messages beyond the log capacity. */
+};
+
+/*
+ * Install the message callback. Call after gladLoadGL(). Does nothing
+ * without a debug context.
+ */
+void init_gl_debug(void);
+bool gl_debug_enabled(void);
+
+/*
+ * The callback may run on driver threads, so these copy under a lock.
+ * Fills messages with every distinct message. Reuses the vector's storage.
+ */
+void gl_debug_messages(std::vector<GlDebugMessage>& messages);
+GlDebugStats gl_debug_stats(void);
+const char* gl_debug_source_name(unsigned int source);
+const char* gl_debug_type_name(unsigned int type);
+const char* gl_debug_severity_name(GlDebugSeverity severity);
+
+/*
+ * Annotations for RenderDoc, apitrace and driver messages. No-ops when
+ * KHR_debug is missing.
+ */
+void push_gl_debug_group(const char* name);
+void pop_gl_debug_group(void);
+void label_gl_object(unsigned int identifier, unsigned int name, const char* label);
+
+class GlDebugGroup
+{
+public:
+    explicit GlDebugGroup(const char* name) { push_gl_debug_group(name); }
+    ~GlDebugGroup(void) { pop_gl_debug_group(); }
+
+    GlDebugGroup(const GlDebugGroup&) = delete;
+    GlDebugGroup& operator=(const GlDebugGroup&) = delete;
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,282 @@
+#include "glad/glad.h"
+
+#include "gpu_profiler.h"
+#include "gl_debug.h"
+
+#include <chrono>
+#include <fstream>
+
+namespace cg
+{
+
+/*
+ * Queries of one frame in flight.
+ * Zones use GL_TIMESTAMP queries because GL_TIME_ELAPSED queries cannot
+ * nest. The frame total uses GL_TIME_ELAPSED.
+ */
+struct GpuFrameQueries
+{
+    std::array<unsigned int, max_gpu_zones * 2> timestamps;
+    unsigned int elapsed;
+    std::array<const char*, max_gpu_zones> names;
+    std::array<int, max_gpu_zones> parents;
+    std::array<int, max_gpu_zones> depths;
+    size_t zone_count;
+    uint64_t frame;
+    bool pending;
+};
+
+static std::array<GpuFrameQueries, gpu_profiler_latency> s_frames;
+static std::array<GpuFrameResult, gpu_profiler_history> s_history;
+static size_t s_history_start = 0;
+static size_t s_history_count = 0;
+
+static uint64_t s_frame = 0;
+static uint64_t s_dropped = 0;
+static bool s_initialised = false;
+static bool s_in_frame = false;
+static int64_t s_clock_offset = 0;
+
+/*
+ * Open zones of the current frame.
+ */
+static std::array<int, max_gpu_zones> s_stack;
+static int s_depth = 0;
+
+void init_gpu_profiler(void)
+{
+    for (GpuFrameQueries& frame : s_frames)
+    {
+        glGenQueries(static_cast<int>(frame.timestamps.size()), frame.timestamps.data());
+        glGenQueries(1, &frame.elapsed);
+        frame.zone_count = 0;
+        frame.pending = false;
+    }
+
+    /*
+     * Reading GL_TIMESTAMP directly waits for nothing, it returns the GPU
+     * clock as of now.
+     */
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    const auto cpu_now = std::chrono::steady_clock::now().time_since_epoch();
+    s_clock_offset = std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_now).count() - gpu_now;
+
+    s_initialised = true;
+}
+
+void cleanup_gpu_profiler(void)
+{
+    if (s_initialised == false)
+        return;
+
+    for (GpuFrameQueries& frame : s_frames)
+    {
+        glDeleteQueries(static_cast<int>(frame.timestamps.size()), frame.timestamps.data());
+        glDeleteQueries(1, &frame.elapsed);
+    }
+    s_initialised = false;
+}
+
+static bool query_ready(unsigned int query)
+{
+    int available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available != 0;
+}
+
+static uint64_t query_result(unsigned int query)
+{
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+    return result;
+}
+
+/*
+ * Read a finished frame into the history.
+ */
+static bool resolve(GpuFrameQueries& frame)
+{
+    if (query_ready(frame.elapsed) == false)
+        return false;
+    for (size_t i = 0; i < frame.zone_count; i++)
+    {
+        if (query_ready(frame.timestamps[i * 2 + 1]) == false)
+            return false;
+    }
+
+    GpuFrameResult& result = s_history[(s_history_start + s_history_count) % s_history.size()];
+    if (s_history_count < s_history.size())
+        s_history_count++;
+    else
+        s_history_start = (s_history_start + 1) % s_history.size();
+
+    result.frame = frame.frame;
+    result.origin_ns = 0;
+    result.total_ms = query_result(frame.elapsed) / 1e6;
+    result.zone_count = frame.zone_count;
+
+    const uint64_t origin = frame.zone_count > 0 ? query_result(frame.timestamps[0]) : 0;
+    result.origin_ns = origin;
+    for (size_t i = 0; i < frame.zone_count; i++)
+    {
+        const uint64_t begin = query_result(frame.timestamps[i * 2]);
+        const uint64_t end = query_result(frame.timestamps[i * 2 + 1]);
+        result.zones[i] =
+        {
+            .name = frame.names[i],
+            .depth = frame.depths[i],
+            .parent = frame.parents[i],
+            .begin_ms = (begin - origin) / 1e6,
+            .ms = (end - begin) / 1e6
+        };
+    }
+
+    frame.pending = false;
+    return true;
+}
+
+void begin_gpu_frame(void)
+{
+    if (s_initialised == false)
+        return;
+
+    for (GpuFrameQueries& frame : s_frames)
+    {
+        if (frame.pending == true)
+            resolve(frame);
+    }
+
+    /*
+     * Still not ready after gpu_profiler_latency frames. Drop it rather than
+     * wait.
+     */
+    GpuFrameQueries& frame = s_frames[s_frame % s_frames.size()];
+    if (frame.pending == true)
+        s_dropped++;
+
+    frame.frame = s_frame;
+    frame.zone_count = 0;
+    frame.pending = true;
+    s_depth = 0;
+    s_in_frame = true;
+
+    glBeginQuery(GL_TIME_ELAPSED, frame.elapsed);
+}
+
+void end_gpu_frame(void)
+{
+    if (s_in_frame == false)
+        return;
+
+    while (s_depth > 0)
+        end_gpu_zone();
+
+    glEndQuery(GL_TIME_ELAPSED);
+    s_in_frame = false;
+    s_frame++;
+}
+
+void begin_gpu_zone(const char* name)
+{
+    if (s_in_frame == false)
+        return;
+
+    /*
+     * Zones double as debug groups, so captures show the same passes.
+     */
+    push_gl_debug_group(name);
+
+    /*
+     * Out of zones. Still track depth so end_gpu_zone() stays balanced.
+     */
+    if (s_depth >= static_cast<int>(max_gpu_zones))
+    {
+        s_depth++;
+        return;
+    }
+
+    GpuFrameQueries& frame = s_frames[s_frame % s_frames.size()];
+    if (frame.zone_count == max_gpu_zones)
+    {
+        s_stack[s_depth++] = -1;
+        return;
+    }
+
+    const size_t index = frame.zone_count++;
+    frame.names[index] = name;
+    frame.depths[index] = s_depth;
+    frame.parents[index] = s_depth > 0 ? s_stack[s_depth - 1] : -1;
+    s_stack[s_depth++] = static_cast<int>(index);
+
+    glQueryCounter(frame.timestamps[index * 2], GL_TIMESTAMP);
+}
+
+void end_gpu_zone(void)
+{
+    if (s_in_frame == false || s_depth == 0)
+        return;
+
+    pop_gl_debug_group();
+    s_depth--;
+    if (s_depth >= static_cast<int>(max_gpu_zones))
+        return;
+
+    const int index = s_stack[s_depth];
+    if (index < 0)
+        return;
+
+    GpuFrameQueries& frame = s_frames[s_frame % s_frames.size()];
+    glQueryCounter(frame.timestamps[index * 2 + 1], GL_TIMESTAMP);
+}
+
+size_t gpu_history_size(void)
+{
+    return s_history_count;
+}
+
+const GpuFrameResult& gpu_history(size_t index)
+{
+    return s_history[(s_history_start + index) % s_history.size()];
+}
+
+const GpuFrameResult* latest_gpu_frame(void)
+{
+    if (s_history_count == 0)
+        return nullptr;
+    return &gpu_history(s_history_count - 1);
+}
+
+int64_t gpu_clock_offset_ns(void)
+{
+    return s_clock_offset;
+}
+
+uint64_t dropped_gpu_frames(void)
+{
+    return s_dropped;
+}
+
+bool export_gpu_csv(const char* path)
+{
+    std::ofstream out(path);
+    if (out.good() == false)
+        return false;
+
+    out << "frame,zone,depth,begin_ms,ms\n";
+    for (size_t i = 0; i < gpu_history_size(); i++)
+    {
+        const GpuFrameResult& frame = gpu_history(i);
+        out << frame.frame << ",frame,-1,0," << frame.total_ms << "\n";
+        for (size_t z = 0; z < frame.zone_count; z++)
+        {
+            const GpuZoneResult& zone = frame.zones[z];
+            out << frame.frame << "," << zone.name << "," << zone.depth << ","
+                << zone.begin_ms << "," << zone.ms << "\n";
+        }
+    }
+
+    return out.good();
+}
+
+} // namespace cg
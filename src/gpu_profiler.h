@@ -0,0 +1,107 @@
+#ifndef CG_GPU_PROFILER
+#define CG_GPU_PROFILER
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Frames kept in flight before their queries are read back. Results are only
+ * read once available, so the CPU never waits on the GPU.
+ */
+constexpr size_t gpu_profiler_latency = 4;
+constexpr size_t max_gpu_zones = 64;
+constexpr size_t gpu_profiler_history = 240;
+
+struct GpuZoneResult
+{
+    const char* name; /* Must be a string literal or otherwise outlive the profiler. */
+    int depth;
+    int parent;       /* Index of the enclosing zone, -1 at the top. */
+    double begin_ms;  /* Relative to the start of the frame. */
+    double ms;
+};
+
+struct GpuFrameResult
+{
+    uint64_t frame;
+    uint64_t origin_ns; /* GPU timestamp of the first zone's begin. */
+    double total_ms;
+    size_t zone_count;
+    std::array<GpuZoneResult, max_gpu_zones> zones;
+};
+
+void init_gpu_profiler(void);
+void cleanup_gpu_profiler(void);
+
+/*
+ * Bracket a frame. begin_gpu_frame() also collects every older frame whose
+ * queries are ready.
+ */
+void begin_gpu_frame(void);
+void end_gpu_frame(void);
+
+/*
+ * Named, nestable passes. Use GpuZone to keep them balanced.
+ */
+void begin_gpu_zone(const char* name);
+void end_gpu_zone(void);
+
+struct GpuZone
+{
+    explicit GpuZone(const char* name) { begin_gpu_zone(name); }
+    ~GpuZone(void) { end_gpu_zone(); }
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+};
+
+/*
+ * Resolved frames, oldest first. index 0 .. gpu_history_size() - 1.
+ */
+size_t gpu_history_size(void);
+const GpuFrameResult& gpu_history(size_t index);
+const GpuFrameResult* latest_gpu_frame(void);
+
+/*
+ * Call function for every resolved frame after last_frame, oldest first,
+ * and return the newest frame number, or last_frame if none is new. One
+ * begin_gpu_frame() can resolve several frames, so sampling only the
+ * latest drops some. UINT64_MAX visits the whole history.
+ */
+template <typename Function>
+uint64_t for_each_new_gpu_frame(uint64_t last_frame, Function function)
+{
+    for (size_t i = 0; i < gpu_history_size(); i++)
+    {
+        const GpuFrameResult& frame = gpu_history(i);
+        if (last_frame != UINT64_MAX && frame.frame <= last_frame)
+            continue;
+
+        function(frame);
+        last_frame = frame.frame;
+    }
+    return last_frame;
+}
+
+/*
+ * Add to a GPU timestamp to get steady clock nanoseconds.
+ * Measured once in init_gpu_profiler().
+ */
+int64_t gpu_clock_offset_ns(void);
+
+/*
+ * Frames whose results were not ready when their slot was needed again.
+ */
+uint64_t dropped_gpu_frames(void);
+
+/*
+ * One line per zone per frame: frame,zone,depth,begin_ms,ms
+ */
+bool export_gpu_csv(const char* path);
+
+} // namespace cg
+
+#endif
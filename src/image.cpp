@@ -0,0 +1,674 @@
+#include "image.h"
+#include "vendor/stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace cg
+{
+
+ImageView view_of(const Image& image)
+{
+    return
+    {
+        .pixels = image.pixels.data(),
+        .width = image.width,
+        .height = image.height,
+        .stride = static_cast<ptrdiff_t>(image.width) * 4
+    };
+}
+
+/*
+ * CRC-32 for PNG chunks, table driven.
+ */
+static const std::array<uint32_t, 256> s_crc_table = []
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}();
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = s_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        /* Largest block that cannot overflow before the modulo. */
+        const size_t block = size < 5552 ? size : 5552;
+        for (size_t i = 0; i < block; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+
+/*
+ * Deflate writes bits least significant first.
+ */
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    /*
+     * Continue a stream whose last partial byte is still pending.
+     */
+    BitWriter(std::vector<uint8_t>& out, uint64_t bits, int count) : m_out(out), m_bits(bits), m_count(count) {}
+
+    uint64_t pending_bits(void) const { return m_bits; }
+    int pending_count(void) const { return m_count; }
+
+    void write(uint32_t bits, int count)
+    {
+        m_bits |= static_cast<uint64_t>(bits) << m_count;
+        m_count += count;
+        while (m_count >= 8)
+        {
+            m_out.push_back(static_cast<uint8_t>(m_bits));
+            m_bits >>= 8;
+            m_count -= 8;
+        }
+    }
+
+    void flush(void)
+    {
+        if (m_count > 0)
+            m_out.push_back(static_cast<uint8_t>(m_bits));
+        m_bits = 0;
+        m_count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_bits = 0;
+    int m_count = 0;
+};
+
+/*
+ * Fixed Huffman literal/length codes, RFC 1951 3.2.6, stored bit reversed
+ * so they can be written directly.
+ */
+struct FixedCode
+{
+    uint16_t bits;
+    uint8_t length;
+};
+
+static uint32_t reverse_bits(uint32_t code, int count)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < count; i++)
+        reversed |= ((code >> i) & 1) << (count - 1 - i);
+    return reversed;
+}
+
+static const std::array<FixedCode, 288> s_fixed_codes = []
+{
+    std::array<FixedCode, 288> codes{};
+    for (uint32_t symbol = 0; symbol < 288; symbol++)
+    {
+        uint32_t code = 0;
+        int length = 0;
+        if (symbol < 144)
+            code = 0x30 + symbol, length = 8;
+        else if (symbol < 256)
+            code = 0x190 + symbol - 144, length = 9;
+        else if (symbol < 280)
+            code = symbol - 256, length = 7;
+        else
+            code = 0xC0 + symbol - 280, length = 8;
+        codes[symbol] = { static_cast<uint16_t>(reverse_bits(code, length)), static_cast<uint8_t>(length) };
+    }
+    return codes;
+}();
+
+static void write_literal(BitWriter& writer, uint32_t symbol)
+{
+    writer.write(s_fixed_codes[symbol].bits, s_fixed_codes[symbol].length);
+}
+
+static constexpr std::array<uint16_t, 29> length_base =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr std::array<uint8_t, 29> length_extra =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static constexpr std::array<uint16_t, 30> distance_base =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static constexpr std::array<uint8_t, 30> distance_extra =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/*
+ * Length and distance to their code index.
+ */
+static const std::array<uint8_t, 259> s_length_codes = []
+{
+    std::array<uint8_t, 259> codes{};
+    for (size_t length = 3, code = 0; length <= 258; length++)
+    {
+        while (code + 1 < length_base.size() && length_base[code + 1] <= length)
+            code++;
+        codes[length] = static_cast<uint8_t>(code);
+    }
+    return codes;
+}();
+
+static uint32_t distance_code(uint32_t distance)
+{
+    uint32_t code = 0;
+    while (code + 1 < distance_base.size() && distance_base[code + 1] <= distance)
+        code++;
+    return code;
+}
+
+static void write_match(BitWriter& writer, uint32_t length, uint32_t distance)
+{
+    const uint32_t length_code = s_length_codes[length];
+    write_literal(writer, 257 + length_code);
+    writer.write(length - length_base[length_code], length_extra[length_code]);
+
+    const uint32_t code = distance_code(distance);
+    writer.write(reverse_bits(code, 5), 5);
+    writer.write(distance - distance_base[code], distance_extra[code]);
+}
+
+/*
+ * Greedy LZ77 over a hash chain, emitted as a single fixed Huffman block.
+ */
+constexpr size_t deflate_window = 1 << 15;
+constexpr size_t deflate_hash_size = 1 << 15;
+constexpr int deflate_max_chain = 8;
+constexpr uint32_t deflate_min_match = 3;
+constexpr uint32_t deflate_max_match = 258;
+constexpr size_t deflate_max_insert = 16;
+
+static uint32_t hash3(const uint8_t* data)
+{
+    const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> (32 - 15);
+}
+
+static void deflate_block(const uint8_t* data, size_t size, BitWriter& writer, bool final)
+{
+    thread_local std::vector<int32_t> head;
+    thread_local std::vector<int32_t> previous;
+    head.assign(deflate_hash_size, -1);
+    previous.resize(deflate_window);
+
+    writer.write(final == true ? 1 : 0, 1);
+    writer.write(1, 2); /* Fixed Huffman codes. */
+
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t best_length = 0;
+        uint32_t best_distance = 0;
+
+        if (i + deflate_min_match <= size)
+        {
+            const uint32_t hash = hash3(&data[i]);
+            const size_t limit = std::min<size_t>(deflate_max_match, size - i);
+
+            int32_t candidate = head[hash];
+            for (int chain = 0; chain < deflate_max_chain && candidate >= 0; chain++)
+            {
+                const size_t distance = i - static_cast<size_t>(candidate);
+                if (distance > deflate_window - 1)
+                    break;
+
+                uint32_t length = 0;
+                const uint8_t* a = &data[candidate];
+                const uint8_t* b = &data[i];
+                while (length < limit && a[length] == b[length])
+                    length++;
+
+                if (length > best_length)
+                {
+                    best_length = length;
+                    best_distance = static_cast<uint32_t>(distance);
+                    if (length == limit)
+                        break;
+                }
+                candidate = previous[candidate & (deflate_window - 1)];
+            }
+        }
+
+        const size_t advance = best_length >= deflate_min_match ? best_length : 1;
+        if (best_length >= deflate_min_match)
+            write_match(writer, best_length, best_distance);
+        else
+            write_literal(writer, data[i]);
+
+        /*
+         * Insert the covered positions so later matches can find them.
+         * Long matches are in runs that the first positions already find,
+         * so only their start is inserted, as zlib's fast levels do.
+         */
+        const size_t end = i + advance;
+        const size_t inserted = advance <= deflate_max_insert ? end : i + 1;
+        for (; i < inserted && i + deflate_min_match <= size; i++)
+        {
+            const uint32_t hash = hash3(&data[i]);
+            previous[i & (deflate_window - 1)] = head[hash];
+            head[hash] = static_cast<int32_t>(i);
+        }
+        i = end;
+    }
+
+    write_literal(writer, 256);
+}
+
+static void write_adler(std::vector<uint8_t>& out, uint32_t checksum)
+{
+    out.push_back(static_cast<uint8_t>(checksum >> 24));
+    out.push_back(static_cast<uint8_t>(checksum >> 16));
+    out.push_back(static_cast<uint8_t>(checksum >> 8));
+    out.push_back(static_cast<uint8_t>(checksum));
+}
+
+static void zlib_compress(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    BitWriter writer(out);
+    deflate_block(data.data(), data.size(), writer, true);
+    writer.flush();
+
+    write_adler(out, adler32(data.data(), data.size()));
+}
+
+static uint8_t paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<uint8_t>(a);
+    return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+static uint64_t filtered_cost(const uint8_t* row, size_t size)
+{
+    uint64_t sum = 0;
+    for (size_t x = 0; x < size; x++)
+        sum += row[x] < 128 ? row[x] : 256 - row[x];
+    return sum;
+}
+
+/*
+ * Filter every row with each PNG filter and keep the one with the smallest
+ * sum of absolute values, the heuristic libpng uses. first_above is the
+ * row before the first one when the image is filtered in bands.
+ */
+static void filter_rows(const ImageView& image, std::vector<uint8_t>& filtered, const uint8_t* first_above = nullptr)
+{
+    const size_t row_bytes = static_cast<size_t>(image.width) * 4;
+    filtered.resize((row_bytes + 1) * image.height);
+
+    thread_local std::vector<uint8_t> candidates;
+    thread_local std::vector<uint8_t> zeros;
+    candidates.resize(row_bytes * 5);
+    zeros.assign(row_bytes, 0);
+
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = image.pixels + y * image.stride;
+        const uint8_t* above = y > 0 ? row - image.stride : first_above != nullptr ? first_above : zeros.data();
+
+        uint8_t* none = &candidates[0];
+        uint8_t* sub = &candidates[row_bytes];
+        uint8_t* up = &candidates[row_bytes * 2];
+        uint8_t* average = &candidates[row_bytes * 3];
+        uint8_t* predicted = &candidates[row_bytes * 4];
+
+        std::memcpy(none, row, row_bytes);
+        for (size_t x = 0; x < 4; x++)
+        {
+            sub[x] = row[x];
+            up[x] = static_cast<uint8_t>(row[x] - above[x]);
+            average[x] = static_cast<uint8_t>(row[x] - (above[x] >> 1));
+            predicted[x] = static_cast<uint8_t>(row[x] - above[x]);
+        }
+        for (size_t x = 4; x < row_bytes; x++)
+        {
+            sub[x] = static_cast<uint8_t>(row[x] - row[x - 4]);
+            up[x] = static_cast<uint8_t>(row[x] - above[x]);
+            average[x] = static_cast<uint8_t>(row[x] - ((row[x - 4] + above[x]) >> 1));
+            predicted[x] = static_cast<uint8_t>(row[x] - paeth(row[x - 4], above[x], above[x - 4]));
+        }
+
+        uint64_t best_sum = UINT64_MAX;
+        int best_filter = 0;
+        for (int filter = 0; filter < 5; filter++)
+        {
+            const uint64_t sum = filtered_cost(&candidates[row_bytes * filter], row_bytes);
+            if (sum < best_sum)
+            {
+                best_sum = sum;
+                best_filter = filter;
+            }
+        }
+
+        uint8_t* out = &filtered[(row_bytes + 1) * y];
+        out[0] = static_cast<uint8_t>(best_filter);
+        std::memcpy(out + 1, &candidates[row_bytes * best_filter], row_bytes);
+    }
+}
+
+static void write_u32(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void write_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+    write_u32(out, static_cast<uint32_t>(size));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    write_u32(out, crc32(&out[start], size + 4));
+}
+
+void encode_png(const ImageView& image, std::vector<uint8_t>& out)
+{
+    thread_local std::vector<uint8_t> filtered;
+    thread_local std::vector<uint8_t> compressed;
+
+    filter_rows(image, filtered);
+    compressed.clear();
+    zlib_compress(filtered, compressed);
+
+    out.clear();
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), signature, signature + sizeof(signature));
+
+    std::vector<uint8_t>& header = filtered;
+    header.clear();
+    write_u32(header, static_cast<uint32_t>(image.width));
+    write_u32(header, static_cast<uint32_t>(image.height));
+    header.push_back(8); /* Bit depth. */
+    header.push_back(6); /* RGBA. */
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    write_chunk(out, "IHDR", header.data(), header.size());
+    write_chunk(out, "IDAT", compressed.data(), compressed.size());
+    write_chunk(out, "IEND", nullptr, 0);
+}
+
+PngWriter::~PngWriter(void)
+{
+    if (m_file != nullptr)
+        std::fclose(m_file);
+}
+
+bool PngWriter::write(const std::vector<uint8_t>& bytes)
+{
+    if (m_failed == false && std::fwrite(bytes.data(), 1, bytes.size(), m_file) != bytes.size())
+        m_failed = true;
+    return m_failed == false;
+}
+
+bool PngWriter::open(const char* path, int width, int height)
+{
+    m_file = std::fopen(path, "wb");
+    if (m_file == nullptr)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_rows_written = 0;
+    m_adler = 1;
+    m_bits = 0;
+    m_bit_count = 0;
+    m_failed = false;
+    m_previous_row.assign(static_cast<size_t>(width) * 4, 0);
+
+    std::vector<uint8_t> header;
+    write_u32(header, static_cast<uint32_t>(width));
+    write_u32(header, static_cast<uint32_t>(height));
+    header.push_back(8); /* Bit depth. */
+    header.push_back(6); /* RGBA. */
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    m_chunk.clear();
+    const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    m_chunk.insert(m_chunk.end(), signature, signature + sizeof(signature));
+    write_chunk(m_chunk, "IHDR", header.data(), header.size());
+    if (write(m_chunk) == false)
+        return false;
+
+    /*
+     * The zlib header goes out with the first band.
+     */
+    m_compressed.assign({ 0x78, 0x01 });
+    return true;
+}
+
+/*
+ * Every band becomes one deflate block and one IDAT chunk. The last
+ * partial byte of a block is carried into the next one.
+ */
+bool PngWriter::write_rows(const ImageView& rows)
+{
+    if (m_file == nullptr || rows.width != m_width || m_rows_written + rows.height > m_height)
+        return false;
+
+    filter_rows(rows, m_filtered, m_rows_written > 0 ? m_previous_row.data() : nullptr);
+    m_adler = adler32(m_filtered.data(), m_filtered.size(), m_adler);
+
+    BitWriter writer(m_compressed, m_bits, m_bit_count);
+    deflate_block(m_filtered.data(), m_filtered.size(), writer, false);
+    m_bits = writer.pending_bits();
+    m_bit_count = writer.pending_count();
+
+    std::memcpy(m_previous_row.data(), rows.pixels + (rows.height - 1) * rows.stride, m_previous_row.size());
+    m_rows_written += rows.height;
+
+    m_chunk.clear();
+    write_chunk(m_chunk, "IDAT", m_compressed.data(), m_compressed.size());
+    m_compressed.clear();
+    return write(m_chunk);
+}
+
+bool PngWriter::close(void)
+{
+    if (m_file == nullptr)
+        return false;
+
+    /*
+     * An empty final block ends the deflate stream.
+     */
+    BitWriter writer(m_compressed, m_bits, m_bit_count);
+    writer.write(1, 1);
+    writer.write(1, 2);
+    write_literal(writer, 256);
+    writer.flush();
+    write_adler(m_compressed, m_adler);
+
+    m_chunk.clear();
+    write_chunk(m_chunk, "IDAT", m_compressed.data(), m_compressed.size());
+    write_chunk(m_chunk, "IEND", nullptr, 0);
+    write(m_chunk);
+
+    const bool complete = m_rows_written == m_height;
+    const bool closed = std::fclose(m_file) == 0;
+    m_file = nullptr;
+    return complete == true && closed == true && m_failed == false;
+}
+
+/*
+ * QOI, https://qoiformat.org. One pass, no entropy coding.
+ */
+void encode_qoi(const ImageView& image, std::vector<uint8_t>& out)
+{
+    out.clear();
+    out.reserve(static_cast<size_t>(image.width) * image.height * 5 / 2);
+
+    const uint8_t magic[] = { 'q', 'o', 'i', 'f' };
+    out.insert(out.end(), magic, magic + sizeof(magic));
+    write_u32(out, static_cast<uint32_t>(image.width));
+    write_u32(out, static_cast<uint32_t>(image.height));
+    out.push_back(4); /* RGBA. */
+    out.push_back(0); /* sRGB with linear alpha. */
+
+    std::array<std::array<uint8_t, 4>, 64> index{};
+    std::array<uint8_t, 4> previous = { 0, 0, 0, 255 };
+    int run = 0;
+
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = image.pixels + y * image.stride;
+        for (int x = 0; x < image.width; x++)
+        {
+            const std::array<uint8_t, 4> pixel = { row[x * 4], row[x * 4 + 1], row[x * 4 + 2], row[x * 4 + 3] };
+
+            if (pixel == previous)
+            {
+                run++;
+                if (run == 62)
+                {
+                    out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            const size_t hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+            if (index[hash] == pixel)
+            {
+                out.push_back(static_cast<uint8_t>(hash));
+            }
+            else if (pixel[3] == previous[3])
+            {
+                const int dr = static_cast<int8_t>(pixel[0] - previous[0]);
+                const int dg = static_cast<int8_t>(pixel[1] - previous[1]);
+                const int db = static_cast<int8_t>(pixel[2] - previous[2]);
+                const int dr_dg = dr - dg;
+                const int db_dg = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                {
+                    out.push_back(static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                }
+                else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                {
+                    out.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+                    out.push_back(static_cast<uint8_t>(((dr_dg + 8) << 4) | (db_dg + 8)));
+                }
+                else
+                {
+                    out.push_back(0xFE);
+                    out.insert(out.end(), pixel.begin(), pixel.begin() + 3);
+                }
+            }
+            else
+            {
+                out.push_back(0xFF);
+                out.insert(out.end(), pixel.begin(), pixel.end());
+            }
+
+            index[hash] = pixel;
+            previous = pixel;
+        }
+    }
+
+    if (run > 0)
+        out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+
+    const uint8_t end[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out.insert(out.end(), end, end + sizeof(end));
+}
+
+void encode_image(ImageFormat format, const ImageView& image, std::vector<uint8_t>& out)
+{
+    if (format == ImageFormat::qoi)
+        encode_qoi(image, out);
+    else
+        encode_png(image, out);
+}
+
+const char* image_extension(ImageFormat format)
+{
+    return format == ImageFormat::qoi ? ".qoi" : ".png";
+}
+
+bool write_file(const char* path, const std::vector<uint8_t>& data)
+{
+    std::FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && written == true;
+}
+
+bool write_png(const char* path, const ImageView& image)
+{
+    thread_local std::vector<uint8_t> encoded;
+    encode_png(image, encoded);
+    return write_file(path, encoded);
+}
+
+bool load_image(const char* path, Image& image)
+{
+    stbi_set_flip_vertically_on_load(0);
+
+    int channels = 0;
+    uint8_t* pixels = stbi_load(path, &image.width, &image.height, &channels, 4);
+    if (pixels == nullptr)
+        return false;
+
+    image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+} // namespace cg
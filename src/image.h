@@ -0,0 +1,106 @@
+#ifndef CG_IMAGE
+#define CG_IMAGE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * 8 bit RGBA pixels, rows top to bottom without padding.
+ */
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/*
+ * View of RGBA8 pixels owned elsewhere. stride is the byte offset from one
+ * row to the next and may be negative, so bottom-up GL readbacks can be
+ * passed without flipping: point pixels at the last row and negate the
+ * stride.
+ */
+struct ImageView
+{
+    const uint8_t* pixels;
+    int width;
+    int height;
+    ptrdiff_t stride;
+};
+
+ImageView view_of(const Image& image);
+
+/*
+ * PNG encoding with per-row filters and fixed Huffman deflate. Much faster
+ * than zlib's default level at a somewhat larger size. Reuses out's storage
+ * and scratch buffers per thread, so it is safe to call from job workers.
+ */
+void encode_png(const ImageView& image, std::vector<uint8_t>& out);
+bool write_png(const char* path, const ImageView& image);
+
+/*
+ * Writes a PNG a band of rows at a time, top to bottom, so images larger
+ * than memory can be written. Only the current band is held.
+ */
+class PngWriter
+{
+public:
+    PngWriter(void) = default;
+    ~PngWriter(void);
+
+    PngWriter(const PngWriter&) = delete;
+    PngWriter& operator=(const PngWriter&) = delete;
+
+    bool open(const char* path, int width, int height);
+    bool write_rows(const ImageView& rows);
+
+    /*
+     * False if any write failed or fewer rows than the height arrived.
+     */
+    bool close(void);
+
+private:
+    bool write(const std::vector<uint8_t>& bytes);
+
+    std::FILE* m_file = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    int m_rows_written = 0;
+    uint32_t m_adler = 1;
+    uint64_t m_bits = 0;
+    int m_bit_count = 0;
+    bool m_failed = false;
+    std::vector<uint8_t> m_previous_row;
+    std::vector<uint8_t> m_filtered;
+    std::vector<uint8_t> m_compressed;
+    std::vector<uint8_t> m_chunk;
+};
+
+/*
+ * QOI: several times faster than PNG to encode, at a larger size.
+ */
+void encode_qoi(const ImageView& image, std::vector<uint8_t>& out);
+
+enum class ImageFormat
+{
+    png,
+    qoi
+};
+
+void encode_image(ImageFormat format, const ImageView& image, std::vector<uint8_t>& out);
+const char* image_extension(ImageFormat format);
+bool write_file(const char* path, const std::vector<uint8_t>& data);
+
+/*
+ * Any format stb_image reads. Converted to RGBA8.
+ */
+bool load_image(const char* path, Image& image);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,210 @@
+#include "input.h"
+
+#include <algorithm>
+
+namespace cg
+{
+
+/*
+ * Events buffered between two frames. GLFW calls the callbacks from inside
+ * glfwPollEvents() on the main thread, so no synchronisation is needed.
+ */
+constexpr size_t input_ring_size = 256;
+
+static std::array<InputEvent, input_ring_size> s_ring;
+static size_t s_ring_head = 0;
+static size_t s_ring_count = 0;
+static uint64_t s_dropped = 0;
+
+/*
+ * Ring slot of the pending repeat per key, or -1.
+ */
+static std::array<int16_t, GLFW_KEY_LAST + 1> s_pending_repeat;
+
+static InputState s_state{};
+static bool s_has_cursor = false;
+
+static InputEvent* push_event(void)
+{
+    if (s_ring_count == input_ring_size)
+    {
+        s_dropped++;
+        return nullptr;
+    }
+
+    InputEvent* event = &s_ring[(s_ring_head + s_ring_count) % input_ring_size];
+    *event = {};
+    s_ring_count++;
+    return event;
+}
+
+static InputEvent* last_event(void)
+{
+    if (s_ring_count == 0)
+        return nullptr;
+    return &s_ring[(s_ring_head + s_ring_count - 1) % input_ring_size];
+}
+
+static void key_callback(GLFWwindow* window,
+                         int key,
+                         int scancode,
+                         int action,
+                         int mode)
+{
+    if (key < 0 || key > GLFW_KEY_LAST)
+        return;
+
+    if (action == GLFW_REPEAT && s_pending_repeat[key] >= 0)
+    {
+        s_ring[s_pending_repeat[key]].count++;
+        return;
+    }
+
+    InputEvent* event = push_event();
+    if (event == nullptr)
+        return;
+
+    event->type = InputEventType::key;
+    event->code = key;
+    event->action = action;
+    event->count = 1;
+
+    /*
+     * Only repeats after the last press or release may be merged, so the
+     * order of state changes is kept.
+     */
+    if (action == GLFW_REPEAT)
+        s_pending_repeat[key] = static_cast<int16_t>(event - s_ring.data());
+    else
+        s_pending_repeat[key] = -1;
+}
+
+static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST)
+        return;
+
+    InputEvent* event = push_event();
+    if (event == nullptr)
+        return;
+
+    event->type = InputEventType::mouse_button;
+    event->code = button;
+    event->action = action;
+    event->count = 1;
+}
+
+static void cursor_callback(GLFWwindow* window, double x, double y)
+{
+    /*
+     * Only the newest position of a run of moves matters.
+     */
+    InputEvent* event = last_event();
+    if (event == nullptr || event->type != InputEventType::cursor)
+        event = push_event();
+    if (event == nullptr)
+        return;
+
+    event->type = InputEventType::cursor;
+    event->x = x;
+    event->y = y;
+    event->count++;
+}
+
+static void scroll_callback(GLFWwindow* window, double x, double y)
+{
+    InputEvent* event = last_event();
+    if (event == nullptr || event->type != InputEventType::scroll)
+    {
+        event = push_event();
+        if (event == nullptr)
+            return;
+        event->type = InputEventType::scroll;
+    }
+
+    event->x += x;
+    event->y += y;
+    event->count++;
+}
+
+void init_input(GLFWwindow* window)
+{
+    s_pending_repeat.fill(-1);
+
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+}
+
+static void apply(const InputEvent& event)
+{
+    switch (event.type)
+    {
+        case InputEventType::key:
+            if (event.action == GLFW_PRESS)
+            {
+                s_state.keys_down[event.code] = 1;
+                s_state.keys_pressed[event.code] = 1;
+            }
+            else if (event.action == GLFW_RELEASE)
+            {
+                s_state.keys_down[event.code] = 0;
+                s_state.keys_released[event.code] = 1;
+            }
+            else
+            {
+                const int repeats = s_state.key_repeats[event.code] + event.count;
+                s_state.key_repeats[event.code] = static_cast<uint16_t>(std::min(repeats, 0xFFFF));
+            }
+            break;
+        case InputEventType::mouse_button:
+            s_state.buttons_down[event.code] = event.action != GLFW_RELEASE;
+            if (event.action == GLFW_PRESS)
+                s_state.buttons_pressed[event.code] = 1;
+            break;
+        case InputEventType::cursor:
+            if (s_has_cursor == true)
+            {
+                s_state.cursor_dx += event.x - s_state.cursor_x;
+                s_state.cursor_dy += event.y - s_state.cursor_y;
+            }
+            s_state.cursor_x = event.x;
+            s_state.cursor_y = event.y;
+            s_has_cursor = true;
+            break;
+        case InputEventType::scroll:
+            s_state.scroll_x += event.x;
+            s_state.scroll_y += event.y;
+            break;
+    }
+}
+
+const InputState& begin_input_frame(void)
+{
+    s_state.keys_pressed.fill(0);
+    s_state.keys_released.fill(0);
+    s_state.key_repeats.fill(0);
+    s_state.buttons_pressed.fill(0);
+    s_state.cursor_dx = 0.0;
+    s_state.cursor_dy = 0.0;
+    s_state.scroll_x = 0.0;
+    s_state.scroll_y = 0.0;
+
+    for (size_t i = 0; i < s_ring_count; i++)
+        apply(s_ring[(s_ring_head + i) % input_ring_size]);
+
+    s_ring_head = 0;
+    s_ring_count = 0;
+    s_pending_repeat.fill(-1);
+
+    s_state.frame++;
+    return s_state;
+}
+
+uint64_t dropped_input_events(void)
+{
+    return s_dropped;
+}
+
+} // namespace cg
@@ -0,0 +1,85 @@
+#ifndef CG_INPUT
+#define CG_INPUT
+
+#include "GLFW/glfw3.h"
+
+#include <array>
+#include <cstdint>
+
+namespace cg
+{
+
+enum class InputEventType : uint8_t
+{
+    key,
+    mouse_button,
+    cursor,
+    scroll
+};
+
+/*
+ * Raw event as recorded from the GLFW callbacks.
+ * Key repeats are coalesced: a repeat of a key that already has a pending
+ * repeat bumps its count instead of taking another slot.
+ */
+struct InputEvent
+{
+    InputEventType type;
+    int code;     /* Key or mouse button. */
+    int action;   /* GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT. */
+    int count;    /* Coalesced repeats. */
+    double x;     /* Cursor position or scroll offset. */
+    double y;
+};
+
+/*
+ * Polled state for the current frame. Built once per frame from the
+ * buffered events by begin_input_frame().
+ */
+struct InputState
+{
+    std::array<uint8_t, GLFW_KEY_LAST + 1> keys_down;
+    std::array<uint8_t, GLFW_KEY_LAST + 1> keys_pressed;
+    std::array<uint8_t, GLFW_KEY_LAST + 1> keys_released;
+    std::array<uint16_t, GLFW_KEY_LAST + 1> key_repeats;
+    std::array<uint8_t, GLFW_MOUSE_BUTTON_LAST + 1> buttons_down;
+    std::array<uint8_t, GLFW_MOUSE_BUTTON_LAST + 1> buttons_pressed;
+    double cursor_x;
+    double cursor_y;
+    double cursor_dx;
+    double cursor_dy;
+    double scroll_x;
+    double scroll_y;
+    uint64_t frame;
+
+    bool down(int key) const { return keys_down[key] != 0; }
+    bool pressed(int key) const { return keys_pressed[key] != 0; }
+    bool released(int key) const { return keys_released[key] != 0; }
+
+    /*
+     * Presses plus repeats this frame. Use for actions that step once per
+     * key event, like rotating by a fixed amount.
+     */
+    int triggers(int key) const { return keys_pressed[key] + key_repeats[key]; }
+};
+
+/*
+ * Install the GLFW input callbacks. Call before init_ImGui so ImGui chains
+ * to them.
+ */
+void init_input(GLFWwindow* window);
+
+/*
+ * Drain the event ring into the per-frame state. Call once per frame,
+ * right after glfwPollEvents().
+ */
+const InputState& begin_input_frame(void);
+
+/*
+ * Events dropped because the ring was full since startup.
+ */
+uint64_t dropped_input_events(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,169 @@
+#include "job_benchmark.h"
+#include "jobs.h"
+
+#include "glm/ext.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+namespace cg
+{
+
+constexpr size_t animation_count = 1 << 20;
+constexpr size_t culling_count = 1 << 20;
+constexpr size_t decode_width = 4096 * 4;
+constexpr size_t decode_height = 1024;
+
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+static double time_ms(const auto& function)
+{
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    function();
+    return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+/*
+ * Animation. Blend two poses per object and build a world matrix.
+ */
+static void animation(std::vector<glm::mat4>& out)
+{
+    parallel_for(out.size(), 1024, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const float t = static_cast<float>(i % 97) / 97.0f;
+            const glm::quat a = glm::angleAxis(0.1f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+            const glm::quat b = glm::angleAxis(0.2f * i, glm::vec3(1.0f, 0.0f, 0.0f));
+            out[i] = glm::translate(glm::mat4(1.0f), glm::vec3(t, 0.0f, -t)) *
+                     glm::mat4_cast(glm::slerp(a, b, t));
+        }
+    });
+}
+
+/*
+ * Frustum culling. Test boxes against the six planes of a projection.
+ */
+static void culling(const std::vector<Aabb>& boxes, std::vector<uint8_t>& visible)
+{
+    const glm::mat4 m = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 1.0f, 100.0f);
+    const glm::mat4 t = glm::transpose(m);
+    const glm::vec4 planes[6] =
+    {
+        t[3] + t[0], t[3] - t[0],
+        t[3] + t[1], t[3] - t[1],
+        t[3] + t[2], t[3] - t[2]
+    };
+
+    parallel_for(boxes.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint8_t inside = 1;
+            for (const glm::vec4& plane : planes)
+            {
+                const glm::vec3 p(plane.x > 0.0f ? boxes[i].max.x : boxes[i].min.x,
+                                  plane.y > 0.0f ? boxes[i].max.y : boxes[i].min.y,
+                                  plane.z > 0.0f ? boxes[i].max.z : boxes[i].min.z);
+                if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+                    inside = 0;
+            }
+            visible[i] = inside;
+        }
+    });
+}
+
+/*
+ * Asset decode. PNG style Paeth unfiltering, one job per row band.
+ * Rows depend on the row above, so every band restarts from its own seed
+ * row like independently compressed image strips.
+ */
+static void decode(std::vector<uint8_t>& image)
+{
+    constexpr size_t band = 16;
+    parallel_for(decode_height / band, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t strip = begin; strip < end; strip++)
+        {
+            for (size_t y = strip * band + 1; y < (strip + 1) * band; y++)
+            {
+                uint8_t* row = &image[y * decode_width];
+                const uint8_t* up = row - decode_width;
+                for (size_t x = 4; x < decode_width; x++)
+                {
+                    const int a = row[x - 4];
+                    const int b = up[x];
+                    const int c = up[x - 4];
+                    const int p = a + b - c;
+                    const int pa = std::abs(p - a);
+                    const int pb = std::abs(p - b);
+                    const int pc = std::abs(p - c);
+                    const int predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    row[x] = static_cast<uint8_t>(row[x] + predictor);
+                }
+            }
+        }
+    });
+}
+
+std::vector<JobBenchmarkResult> run_job_benchmark(unsigned int max_workers)
+{
+    std::vector<glm::mat4> matrices(animation_count);
+    std::vector<Aabb> boxes(culling_count);
+    std::vector<uint8_t> visible(culling_count);
+    std::vector<uint8_t> image(decode_width * decode_height);
+
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        const glm::vec3 center((i % 101) - 50.0f, (i % 37) - 18.0f, -float(i % 113));
+        boxes[i] = { center - 0.5f, center + 0.5f };
+    }
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+
+    std::vector<JobBenchmarkResult> results;
+    for (unsigned int workers = 1; workers <= max_workers; workers++)
+    {
+        shutdown_jobs();
+        init_jobs(workers);
+
+        const double animation_ms = time_ms([&]() { animation(matrices); });
+        const double culling_ms = time_ms([&]() { culling(boxes, visible); });
+        const double decode_ms = time_ms([&]() { decode(image); });
+
+        std::vector<JobStats> worker_stats;
+        job_stats(worker_stats);
+
+        double busy = 0.0;
+        for (const JobStats& stats : worker_stats)
+            busy += static_cast<double>(stats.busy_ns) / stats.elapsed_ns;
+
+        const JobBenchmarkResult result =
+        {
+            .workers = workers,
+            .animation_ms = animation_ms,
+            .culling_ms = culling_ms,
+            .decode_ms = decode_ms,
+            .utilisation = busy / workers
+        };
+
+        std::cout << "Jobs benchmark " << workers << " workers: "
+                  << "animation " << result.animation_ms << " ms, "
+                  << "culling " << result.culling_ms << " ms, "
+                  << "decode " << result.decode_ms << " ms, "
+                  << "utilisation " << result.utilisation * 100.0 << "%" << std::endl;
+
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+} // namespace cg
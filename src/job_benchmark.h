@@ -0,0 +1,28 @@
+#ifndef CG_JOB_BENCHMARK
+#define CG_JOB_BENCHMARK
+
+#include <vector>
+
+namespace cg
+{
+
+struct JobBenchmarkResult
+{
+    unsigned int workers;
+    double animation_ms;
+    double culling_ms;
+    double decode_ms;
+    double utilisation; /* Average busy fraction over all workers. */
+};
+
+/*
+ * Run the representative workloads with 1 to max_workers workers.
+ * Restarts the job system for every worker count and leaves it running
+ * with max_workers workers. Must be called from the main thread while no
+ * jobs are in flight.
+ */
+std::vector<JobBenchmarkResult> run_job_benchmark(unsigned int max_workers);
+
+} // namespace cg
+
+#endif
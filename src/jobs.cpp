@@ -0,0 +1,366 @@
+#include "jobs.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace cg
+{
+
+/*
+ * Jobs in flight per worker. Power of two.
+ */
+constexpr size_t jobs_per_worker = 4096;
+
+static uint64_t now_ns(void)
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Chase-Lev work stealing deque.
+ * The owner pushes and pops at the bottom, thieves steal from the top.
+ * Only the owning worker may call push() and pop().
+ */
+class WorkStealingQueue
+{
+public:
+    bool push(Job* job)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= static_cast<int64_t>(jobs_per_worker))
+            return false;
+
+        m_jobs[bottom & mask].store(job, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job* pop(void)
+    {
+        const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            /* Empty. */
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = m_jobs[bottom & mask].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            /* Last job. Race against thieves for it. */
+            if (m_top.compare_exchange_strong(top,
+                                              top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed) == false)
+            {
+                job = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job* steal(void)
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return nullptr;
+
+        Job* job = m_jobs[top & mask].load(std::memory_order_relaxed);
+        if (m_top.compare_exchange_strong(top,
+                                          top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed) == false)
+        {
+            return nullptr;
+        }
+        return job;
+    }
+
+private:
+    static constexpr int64_t mask = jobs_per_worker - 1;
+
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+    std::array<std::atomic<Job*>, jobs_per_worker> m_jobs{};
+};
+
+struct alignas(64) Worker
+{
+    WorkStealingQueue queue;
+    std::unique_ptr<Job[]> jobs = std::make_unique<Job[]>(jobs_per_worker);
+    size_t next_job = 0;
+    uint32_t random = 0;
+
+    std::atomic<uint64_t> jobs_executed = 0;
+    std::atomic<uint64_t> jobs_stolen = 0;
+    std::atomic<uint64_t> busy_ns = 0;
+};
+
+static std::vector<std::unique_ptr<Worker>> s_workers;
+static std::vector<std::thread> s_threads;
+static std::atomic<bool> s_running = false;
+static std::atomic<uint32_t> s_epoch = 0;
+static std::atomic<int> s_sleepers = 0;
+static uint64_t s_stats_start = 0;
+
+static thread_local unsigned int s_worker_index = 0;
+static thread_local bool s_is_worker = false;
+
+/*
+ * Jobs of threads outside the pool, and of workers whose ring is full. Both
+ * run inline in submit_job().
+ */
+static thread_local Job s_inline_job;
+
+/*
+ * A ring slot is free again once its job has run, which the executing
+ * thread marks by clearing the function. The counter is read first, since
+ * the owner may reuse the slot right after.
+ */
+static void execute(Worker& worker, Job* job, bool stolen)
+{
+    JobCounter* counter = job->counter;
+    const uint64_t start = now_ns();
+    {
+        CG_PROFILE_SCOPE("job");
+        job->function(*job);
+    }
+    std::atomic_ref(job->function).store(nullptr, std::memory_order_release);
+    if (counter != nullptr)
+        counter->value.fetch_sub(1, std::memory_order_release);
+
+    worker.busy_ns.fetch_add(now_ns() - start, std::memory_order_relaxed);
+    worker.jobs_executed.fetch_add(1, std::memory_order_relaxed);
+    if (stolen == true)
+        worker.jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Own deque first, then steal starting at a random victim.
+ * Returns true if a job was executed.
+ */
+static bool run_one(unsigned int index)
+{
+    Worker& worker = *s_workers[index];
+
+    Job* job = worker.queue.pop();
+    if (job != nullptr)
+    {
+        execute(worker, job, false);
+        return true;
+    }
+
+    const size_t count = s_workers.size();
+    worker.random ^= worker.random << 13;
+    worker.random ^= worker.random >> 17;
+    worker.random ^= worker.random << 5;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t victim = (worker.random + i) % count;
+        if (victim == index)
+            continue;
+
+        job = s_workers[victim]->queue.steal();
+        if (job != nullptr)
+        {
+            execute(worker, job, true);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void worker_loop(unsigned int index)
+{
+    s_worker_index = index;
+    s_is_worker = true;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "Worker %u", index);
+    set_profiler_thread_name(name);
+
+    while (s_running.load(std::memory_order_relaxed) == true)
+    {
+        if (run_one(index) == true)
+            continue;
+
+        /*
+         * Nothing to do. Spin briefly, then sleep until new work is
+         * submitted. Check once more after announcing the sleep so a
+         * submission in between is not missed.
+         */
+        bool found = false;
+        for (int i = 0; i < 64 && found == false; i++)
+        {
+            std::this_thread::yield();
+            found = run_one(index);
+        }
+        if (found == true)
+            continue;
+
+        const uint32_t epoch = s_epoch.load();
+        s_sleepers.fetch_add(1);
+        if (run_one(index) == false && s_running.load() == true)
+            s_epoch.wait(epoch);
+        s_sleepers.fetch_sub(1);
+    }
+}
+
+void init_jobs(unsigned int worker_count)
+{
+    if (s_running.load() == true)
+        return;
+
+    if (worker_count == 0)
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < worker_count; i++)
+    {
+        s_workers.push_back(std::make_unique<Worker>());
+        s_workers.back()->random = 0x9E3779B9u * (i + 1);
+    }
+
+    s_worker_index = 0;
+    s_is_worker = true;
+    s_running.store(true);
+    reset_job_stats();
+
+    for (unsigned int i = 1; i < worker_count; i++)
+        s_threads.emplace_back(worker_loop, i);
+}
+
+void shutdown_jobs(void)
+{
+    if (s_running.exchange(false) == false)
+        return;
+
+    s_epoch.fetch_add(1);
+    s_epoch.notify_all();
+
+    for (std::thread& thread : s_threads)
+        thread.join();
+
+    s_threads.clear();
+    s_workers.clear();
+    s_is_worker = false;
+}
+
+unsigned int job_worker_count(void)
+{
+    return s_workers.empty() == true ? 1 : static_cast<unsigned int>(s_workers.size());
+}
+
+unsigned int job_worker_index(void)
+{
+    return s_worker_index;
+}
+
+Job* allocate_job(void (*function)(Job&), JobCounter* counter)
+{
+    Job* job = &s_inline_job;
+    if (s_is_worker == true)
+    {
+        /*
+         * If the next slot still holds a job that has not run, this thread
+         * has jobs_per_worker jobs in flight. The new job then takes the
+         * inline job and runs on submit instead of overwriting it.
+         */
+        Worker& worker = *s_workers[s_worker_index];
+        Job* slot = &worker.jobs[worker.next_job & (jobs_per_worker - 1)];
+        if (std::atomic_ref(slot->function).load(std::memory_order_acquire) == nullptr)
+        {
+            job = slot;
+            worker.next_job++;
+        }
+    }
+
+    job->function = function;
+    job->counter = counter;
+    if (counter != nullptr)
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void submit_job(Job* job)
+{
+    /*
+     * Threads outside the pool have no deque, and a full ring has no slot.
+     * Run the job inline, from a copy, since it may submit jobs of its own
+     * that reuse the inline job.
+     */
+    if (job == &s_inline_job)
+    {
+        Job local = *job;
+        local.function(local);
+        if (local.counter != nullptr)
+            local.counter->value.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    Worker& worker = *s_workers[s_worker_index];
+    if (worker.queue.push(job) == false)
+    {
+        execute(worker, job, false);
+        return;
+    }
+
+    s_epoch.fetch_add(1);
+    if (s_sleepers.load() > 0)
+        s_epoch.notify_one();
+}
+
+void wait_for_counter(const JobCounter& counter)
+{
+    while (counter.value.load(std::memory_order_acquire) > 0)
+    {
+        if (s_is_worker == false || run_one(s_worker_index) == false)
+            std::this_thread::yield();
+    }
+}
+
+void job_stats(std::vector<JobStats>& stats)
+{
+    const uint64_t elapsed = now_ns() - s_stats_start;
+
+    stats.clear();
+    for (const auto& worker : s_workers)
+    {
+        stats.push_back(
+        {
+            .jobs_executed = worker->jobs_executed.load(std::memory_order_relaxed),
+            .jobs_stolen = worker->jobs_stolen.load(std::memory_order_relaxed),
+            .busy_ns = worker->busy_ns.load(std::memory_order_relaxed),
+            .elapsed_ns = elapsed
+        });
+    }
+}
+
+void reset_job_stats(void)
+{
+    for (const auto& worker : s_workers)
+    {
+        worker->jobs_executed.store(0, std::memory_order_relaxed);
+        worker->jobs_stolen.store(0, std::memory_order_relaxed);
+        worker->busy_ns.store(0, std::memory_order_relaxed);
+    }
+    s_stats_start = now_ns();
+}
+
+} // namespace cg
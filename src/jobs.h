@@ -0,0 +1,142 @@
+#ifndef CG_JOBS
+#define CG_JOBS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * Counts unfinished jobs. Jobs decrement it when they complete, so waiting
+ * for zero waits for a whole batch. Also used to express dependencies: a job
+ * that needs the results of a batch waits on its counter, and the waiting
+ * thread keeps executing other jobs in the meantime.
+ */
+struct JobCounter
+{
+    std::atomic<int> value = 0;
+};
+
+/*
+ * A unit of work. Small callables are stored inline so submitting a job
+ * never touches the heap.
+ */
+struct alignas(64) Job
+{
+    static constexpr size_t storage_size = 48;
+
+    void (*function)(Job& job);
+    JobCounter* counter;
+    alignas(8) unsigned char storage[storage_size];
+
+    template <typename T>
+    T& data(void)
+    {
+        return *std::launder(reinterpret_cast<T*>(storage));
+    }
+};
+
+/*
+ * Per worker statistics since the last reset_job_stats().
+ */
+struct JobStats
+{
+    uint64_t jobs_executed;
+    uint64_t jobs_stolen;
+    uint64_t busy_ns;
+    uint64_t elapsed_ns;
+};
+
+/*
+ * Start worker_count - 1 threads. The calling thread is worker 0 and only
+ * runs jobs while it waits. Zero means one worker per hardware thread.
+ */
+void init_jobs(unsigned int worker_count = 0);
+void shutdown_jobs(void);
+unsigned int job_worker_count(void);
+
+/*
+ * Worker index of the calling thread. 0 for the main thread.
+ */
+unsigned int job_worker_index(void);
+
+/*
+ * Allocate a job from the calling thread's ring and push it to its deque.
+ * The ring holds 4096 jobs per worker and is reused round-robin. A slot is
+ * only reused once its job has run; while a thread has 4096 jobs in flight,
+ * further jobs run inline in submit_job() instead of in parallel.
+ */
+Job* allocate_job(void (*function)(Job&), JobCounter* counter);
+void submit_job(Job* job);
+
+/*
+ * Run other jobs until the counter reaches zero.
+ */
+void wait_for_counter(const JobCounter& counter);
+
+/*
+ * Fills stats with one entry per worker. Reuses the vector's storage.
+ */
+void job_stats(std::vector<JobStats>& stats);
+void reset_job_stats(void);
+
+/*
+ * Submit a callable. It is copied into the job's inline storage.
+ */
+template <typename F>
+void run_job(F&& function, JobCounter* counter)
+{
+    using Callable = std::decay_t<F>;
+    static_assert(sizeof(Callable) <= Job::storage_size, "Job callable too large.");
+    static_assert(std::is_trivially_destructible_v<Callable>,
+                  "Job callable must be trivially destructible.");
+
+    Job* job = allocate_job([](Job& job) { job.data<Callable>()(); }, counter);
+    new (job->storage) Callable(std::forward<F>(function));
+    submit_job(job);
+}
+
+/*
+ * Split [0, count) into chunks of at most grain items and run
+ * function(begin, end) on every chunk in parallel. Returns when all chunks
+ * are done.
+ */
+template <typename F>
+void parallel_for(size_t count, size_t grain, const F& function)
+{
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    /*
+     * Keep the number of chunks well inside the job ring.
+     */
+    constexpr size_t max_chunks = 1024;
+    if (count / grain > max_chunks)
+        grain = (count + max_chunks - 1) / max_chunks;
+
+    if (count <= grain)
+    {
+        function(size_t(0), count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        const size_t end = begin + grain < count ? begin + grain : count;
+        const F* callable = &function;
+        run_job([callable, begin, end]() { (*callable)(begin, end); }, &counter);
+    }
+    wait_for_counter(counter);
+}
+
+} // namespace cg
+
+#endif
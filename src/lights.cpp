@@ -0,0 +1,157 @@
+#include "glad/glad.h"
+
+#include "lights.h"
+#include "bvh.h"
+#include "gl_debug.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+LightingSettings lighting_settings =
+{
+    .path = LightingPath::single,
+    .light_count = 4096,
+    .light_radius = 3.0f,
+    .light_intensity = 1.0f,
+    .cluster_assignment = ClusterAssignment::gpu
+};
+
+static unsigned int s_buffer = 0;
+static std::vector<PointLight> s_lights;
+static LightingSettings s_placed_settings{};
+static Bounds s_placed_bounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+
+bool init_lights(void)
+{
+    if (GLAD_GL_VERSION_4_3 == 0)
+        return false;
+
+    glGenBuffers(1, &s_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_point_lights * sizeof(PointLight), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    label_gl_object(GL_BUFFER, s_buffer, "point lights");
+
+    s_lights.reserve(max_point_lights);
+    s_lights.clear();
+    s_placed_settings = {};
+    return true;
+}
+
+void cleanup_lights(void)
+{
+    glDeleteBuffers(1, &s_buffer);
+    s_buffer = 0;
+    s_lights.clear();
+}
+
+/*
+ * Integer hash to [0, 1), so every run places the same lights.
+ */
+static float random_unit(uint32_t index, uint32_t dimension)
+{
+    uint32_t hash = (index * 4u + dimension) * 2654435761u;
+    hash ^= hash >> 15;
+    hash *= 2246822519u;
+    hash ^= hash >> 13;
+    return static_cast<float>(hash >> 8) / 16777216.0f;
+}
+
+/*
+ * Saturated colour of the hue, 0 to 1 around the wheel.
+ */
+static glm::vec3 hue_color(float hue)
+{
+    const glm::vec3 phase = glm::fract(glm::vec3(hue) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f));
+    return glm::clamp(glm::abs(phase * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+}
+
+void update_lights(const DrawItem* const* items, size_t count)
+{
+    const Bounds cube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+    Bounds scene{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (size_t i = 0; i < count; i++)
+    {
+        const Bounds bounds = transform_bounds(cube, items[i]->model);
+        scene.min = i == 0 ? bounds.min : glm::min(scene.min, bounds.min);
+        scene.max = i == 0 ? bounds.max : glm::max(scene.max, bounds.max);
+    }
+
+    const int light_count = std::clamp(lighting_settings.light_count, 0, max_point_lights);
+    if (light_count == static_cast<int>(s_lights.size()) &&
+        lighting_settings.light_radius == s_placed_settings.light_radius &&
+        lighting_settings.light_intensity == s_placed_settings.light_intensity &&
+        scene.min == s_placed_bounds.min && scene.max == s_placed_bounds.max)
+        return;
+
+    /*
+     * Spread through the box grown by a little, so the outside faces are
+     * lit too.
+     */
+    const glm::vec3 low = scene.min - glm::vec3(1.0f);
+    const glm::vec3 size = scene.max - scene.min + glm::vec3(2.0f);
+    s_lights.resize(light_count);
+    for (int i = 0; i < light_count; i++)
+    {
+        const uint32_t index = static_cast<uint32_t>(i);
+        const glm::vec3 position = low + size * glm::vec3(random_unit(index, 0),
+                                                          random_unit(index, 1),
+                                                          random_unit(index, 2));
+        s_lights[i] =
+        {
+            .position_radius = glm::vec4(position, lighting_settings.light_radius),
+            .color = glm::vec4(hue_color(random_unit(index, 3)) * lighting_settings.light_intensity, 1.0f)
+        };
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, s_lights.size() * sizeof(PointLight), s_lights.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_placed_settings = lighting_settings;
+    s_placed_bounds = scene;
+}
+
+void bind_lights(unsigned int program)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, s_buffer);
+    glUniform1i(get_uniform_location(program, "u_light_count"), static_cast<int>(s_lights.size()));
+}
+
+unsigned int light_buffer(void)
+{
+    return s_buffer;
+}
+
+size_t point_light_count(void)
+{
+    return s_lights.size();
+}
+
+const PointLight* point_lights(void)
+{
+    return s_lights.data();
+}
+
+const char* lighting_path_name(LightingPath path)
+{
+    switch (path)
+    {
+        case LightingPath::clustered:
+            return "clustered";
+        case LightingPath::forward:
+            return "forward";
+        case LightingPath::deferred:
+            return "deferred";
+        case LightingPath::single:
+        default:
+            return "single";
+    }
+}
+
+} // namespace cg
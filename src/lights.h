@@ -0,0 +1,80 @@
+#ifndef CG_LIGHTS
+#define CG_LIGHTS
+
+#include "glm/ext.hpp"
+
+#include <cstddef>
+
+namespace cg
+{
+
+struct DrawItem;
+
+constexpr int max_point_lights = 16384;
+
+/*
+ * How render_scene() lights the scene. Every path but single uses the
+ * point lights and ignores shadow_settings.
+ */
+enum class LightingPath
+{
+    single,   /* The light of set_light(); textured, or phong with shadows. */
+    forward,  /* Every fragment evaluates every point light. */
+    deferred, /* G-buffer, lights culled into screen tiles, one lighting pass. */
+    clustered /* Forward, each fragment evaluating its view space cluster's lights. */
+};
+
+/*
+ * Where the clustered path builds its light lists.
+ */
+enum class ClusterAssignment
+{
+    gpu, /* A compute pass every frame. */
+    cpu  /* Jobs with SIMD tests, then an upload. */
+};
+
+struct LightingSettings
+{
+    LightingPath path;
+    int light_count;       /* 0 to max_point_lights. */
+    float light_radius;    /* Where a light's contribution reaches zero. */
+    float light_intensity;
+    ClusterAssignment cluster_assignment;
+};
+extern LightingSettings lighting_settings;
+
+/*
+ * One light as the shaders see it, std430.
+ */
+struct PointLight
+{
+    glm::vec4 position_radius;
+    glm::vec4 color;
+};
+
+/*
+ * Needs a current context with GL loaded. Returns false below OpenGL 4.3,
+ * which has no shader storage buffers.
+ */
+bool init_lights(void);
+void cleanup_lights(void);
+
+/*
+ * Scatter the lights through the box around the items. They are placed
+ * again only when the settings or the box change.
+ */
+void update_lights(const DrawItem* const* items, size_t count);
+
+/*
+ * Bind the lights to shader storage binding 0 and set u_light_count.
+ */
+void bind_lights(unsigned int program);
+unsigned int light_buffer(void);
+size_t point_light_count(void);
+const PointLight* point_lights(void);
+
+const char* lighting_path_name(LightingPath path);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,69 @@
+#include "linear_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace cg
+{
+
+LinearAllocator::LinearAllocator(size_t block_size)
+    : m_block_size(block_size)
+{
+}
+
+void* LinearAllocator::allocate(size_t size, size_t alignment)
+{
+    while (m_block < m_blocks.size())
+    {
+        Block& block = m_blocks[m_block];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.memory.get());
+        const uintptr_t aligned = (base + m_offset + alignment - 1) & ~(alignment - 1);
+        const size_t end = aligned - base + size;
+
+        if (end <= block.size)
+        {
+            m_used += end - m_offset;
+            m_offset = end;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        /*
+         * Does not fit. Move on to the next block, the tail of this one is
+         * wasted until the next reset.
+         */
+        m_block++;
+        m_offset = 0;
+    }
+
+    /*
+     * Out of blocks. Double what there is, and oversized requests get a
+     * block of their own.
+     */
+    const size_t block_size = std::max({ m_block_size, bytes_reserved(), size + alignment });
+    m_blocks.push_back({ std::make_unique<std::byte[]>(block_size), block_size });
+    m_block = m_blocks.size() - 1;
+    m_offset = 0;
+    return allocate(size, alignment);
+}
+
+void LinearAllocator::reset(void)
+{
+    m_block = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+size_t LinearAllocator::bytes_used(void) const
+{
+    return m_used;
+}
+
+size_t LinearAllocator::bytes_reserved(void) const
+{
+    size_t reserved = 0;
+    for (const Block& block : m_blocks)
+        reserved += block.size;
+    return reserved;
+}
+
+} // namespace cg
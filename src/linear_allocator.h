@@ -0,0 +1,51 @@
+#ifndef CG_LINEAR_ALLOCATOR
+#define CG_LINEAR_ALLOCATOR
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * Bump allocator. Allocations are only freed all at once by reset().
+ * Blocks are kept across resets, so once warmed up it stops touching the
+ * heap. Every new block is as large as all before it, so a peak that
+ * comes after the warm-up usually still fits. Not thread safe; give
+ * every thread its own.
+ */
+class LinearAllocator
+{
+public:
+    explicit LinearAllocator(size_t block_size = 64 * 1024);
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void reset(void);
+
+    template <typename T>
+    T* allocate_array(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    size_t bytes_used(void) const;
+    size_t bytes_reserved(void) const;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_block_size;
+    size_t m_block = 0;
+    size_t m_offset = 0;
+    size_t m_used = 0;
+};
+
+} // namespace cg
+
+#endif
@@ -2,42 +2,35 @@
 
 #include "ui.h"
 #include "structs.h"
-#include "vendor/stb_image.h"
-
-#include <array>
-#include <fstream>
+#include "simulation.h"
+#include "jobs.h"
+#include "renderer.h"
+#include "input.h"
+#include "frame_arena.h"
+#include "allocation_tracker.h"
+#include "gpu_profiler.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "gl_counters.h"
+#include "gl_debug.h"
+#include "path_tracer.h"
+#include "render_target.h"
+
+#include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <optional>
-#include <unordered_map>
-
-/*
- * Constants.
- */
-constexpr auto clear_color = glm::vec4(0.45f, 0.55f, 0.60f, 0.90f);
 
 /*
  * Globals. For convenience.
  */
-static std::unordered_map<std::string, int> g_uniform_locations;
-static unsigned int g_program = 0;
+static cg::DrawItem* g_cube = nullptr;
 static glm::mat4 g_model = glm::mat4(
     1.0f, 0.0f, 0.0f, 0.0f,
     0.0f, 1.0f, 0.0f, 0.0f,
     0.0f, 0.0f, 1.0f, 0.0f,
     0.0f, 0.0f, 0.0f, 1.0f
 );
-
-static glm::vec3 g_light_pos = glm::vec3(1.0f, 1.0f, 2.0f);
-static glm::vec3 g_light_color = glm::vec3(1.0f); /* White light */
-
-/*
- * Forward declarations.
- */
-static void set_model(unsigned int);
-static void set_view(unsigned int);
-static void set_projection(unsigned int);
-static void set_light_pos(unsigned int);
-static void set_light_color(unsigned int);
+static cg::RenderTarget g_path_target{};
 
 /*
  * Checks for OpenGL errors.
@@ -61,39 +54,25 @@ static void glfw_error_callback(int error, const char* description)
 }
 
 /*
- * Window keypress event callback.
+ * Apply the input of this frame.
+ * Runs once per frame, however many key events arrived.
  */
-static void key_callback(GLFWwindow* window,
-                         int key,
-                         int scancode,
-                         int action,
-                         int mode)
+static void process_input(GLFWwindow* window)
 {
-    switch (key)
-    {
-        case GLFW_KEY_ESCAPE:
-            /* Close on escape. */
-            glfwSetWindowShouldClose(window, true);
-            break;
-        case GLFW_KEY_X:
-            /* For debugging. */
-            gl_print_error();
-            break;
-        case GLFW_KEY_A:
-            g_model = glm::rotate(g_model,
-                                  glm::radians(5.0f),
-                                  glm::vec3(0.0f, 1.0f, 0.0f));
-            set_model(g_program);
-            break;
-        case GLFW_KEY_D:
-            break;
-        case GLFW_KEY_W:
-            break;
-        case GLFW_KEY_S:
-            break;
-        default:
-            break;
-    }
+    const cg::InputState& input = cg::begin_input_frame();
+
+    /* Close on escape. */
+    if (input.pressed(GLFW_KEY_ESCAPE) == true)
+        glfwSetWindowShouldClose(window, true);
+
+    /* For debugging. */
+    if (input.pressed(GLFW_KEY_X) == true)
+        gl_print_error();
+
+    /* Applied on the next simulation step. */
+    const int rotations = input.triggers(GLFW_KEY_A);
+    if (rotations > 0)
+        cg::queue_rotation(glm::radians(5.0f) * rotations);
 }
 
 /*
@@ -106,7 +85,6 @@ static void size_callback(GLFWwindow* window, int width, int height)
 
     glViewport(0, 0, width, height);
     cg::perspective.aspect = static_cast<float>(width) / height;
-    set_projection(g_program);
 };
 
 /*
@@ -132,6 +110,12 @@ GLFWwindow* init_window(void)
      */
     glfwWindowHint(GLFW_SAMPLES, 4);
 
+    /*
+     * Debug context. Errors and driver warnings are reported through
+     * the KHR_debug callback instead of glGetError polling.
+     */
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, cg::gl_debug_settings.debug_context);
+
     /*
      * Create the graphics context and make it current.
      */
@@ -154,7 +138,7 @@ GLFWwindow* init_window(void)
     /*
      * Set event callbacks.
      */
-    glfwSetKeyCallback(window, key_callback);
+    cg::init_input(window);
     glfwSetWindowSizeCallback(window, size_callback);
 
     /*
@@ -163,19 +147,13 @@ GLFWwindow* init_window(void)
      */
     gladLoadGL();
 
-    return window;
-}
+    /*
+     * Only wraps the GL functions in builds with CG_GL_COUNTERS_ENABLED.
+     */
+    cg::install_gl_counters();
+    cg::init_gl_debug();
 
-/*
- * Clear color and depth buffers.
- */
-static void clear(void)
-{
-    glClearColor(clear_color.x * clear_color.w,
-                 clear_color.y * clear_color.w,
-                 clear_color.z * clear_color.w,
-                 clear_color.w);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return window;
 }
 
 /*
@@ -188,454 +166,196 @@ static void cleanup_window(GLFWwindow* window)
 }
 
 /*
- * Read shader from file.
- */
-static std::optional<std::string> read_shader(const std::string& path)
-{
-    std::string result;
-
-    std::ifstream in(path, std::ios::in | std::ios::binary);
-    if (in.good() == false)
-        return std::nullopt;
-
-    in.seekg(0, std::ios::end);
-    size_t size = in.tellg();
-
-    if (size == -1)
-        return std::nullopt;
-
-    result.resize(size);
-    in.seekg(0, std::ios::beg);
-    in.read(&result[0], size);
-
-    return result;
-}
-
-/*
- * Compile shader.
- * Copy the shader source string here just in case.
- * c_str will point to garbage if a string reference goes out of scope.
- */
-static unsigned int compile_shader(const std::string shader_source,
-                                   unsigned int type)
-{
-    unsigned int shader = glCreateShader(type);
-
-    const char* c_str = shader_source.c_str();
-    glShaderSource(shader, 1, &c_str, nullptr);
-
-    glCompileShader(shader);
-
-    /*
-     * Compile error checking.
-     */
-    int is_compiled = 0;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
-    if (is_compiled == 0)
-    {
-        std::string log;
-        int length = 0;
-        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
-        log.resize(length);
-        glGetShaderInfoLog(shader, length, nullptr, &log[0]);
-
-        std::string type_s = type == GL_VERTEX_SHADER ? "vertex" : "fragment";
-        std::cerr << "Failed to compile " << type_s << " shader." << std::endl;
-        std::cerr << log << std::endl;
-
-        glDeleteShader(shader);
-        return 0;
-    }
-
-    return shader;
-}
-
-/*
- * Compile and link shader program.
+ * Init scene.
  */
-static unsigned int create_shader(const std::string& vertex_source,
-                                  const std::string& fragment_source)
+static bool init(void)
 {
-    unsigned int program = glCreateProgram();
-    unsigned int vertex_shader = compile_shader(vertex_source, GL_VERTEX_SHADER);
-    if (vertex_shader == 0)
-        return 0;
-    unsigned int fragment_shader = compile_shader(fragment_source, GL_FRAGMENT_SHADER);
-    if (fragment_shader == 0)
-        return 0;
-
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    glValidateProgram(program);
-
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-
-    glDetachShader(program, vertex_shader);
-    glDetachShader(program, fragment_shader);
-
-    return program;
-}
+    if (cg::init_renderer() == false)
+        return false;
 
-int get_uniform_location(unsigned int program, const std::string& location)
-{
-    if (g_uniform_locations.find(location) != g_uniform_locations.end())
-        return g_uniform_locations[location];
-
-    int uniform = glGetUniformLocation(program, location.c_str());
-    if (uniform == -1)
-        std::cout << "Warning: Uniform " << location <<
-        " does not exist. This uniform will not be set." << std::endl;
-
-    g_uniform_locations[location] = uniform;
-    return uniform;
-}
-
-static void set_vec3(unsigned int program,
-                     const glm::vec3& vector,
-                     const std::string& location)
-{
-    int uniform = get_uniform_location(program, location);
-    if (uniform == -1)
-        return;
-    glUniform3fv(uniform, 1, glm::value_ptr(vector));
-}
+    std::cout << "Data init check:" << std::endl;
+    if (gl_print_error() != 0)
+        return false;
 
-static void set_matrix(unsigned int program,
-                       const glm::mat4& matrix,
-                       const std::string& location)
-{
-    int uniform = get_uniform_location(program, location);
-    if (uniform == -1)
-        return;
-    glUniformMatrix4fv(uniform, 1, false, glm::value_ptr(matrix));
-}
+    g_cube = cg::create_draw_item(g_model);
 
-/*
- * Set model matrix uniform.
- */
-static void set_model(unsigned int program)
-{
-    set_matrix(program, g_model, "u_model");
+    if (cg::init_path_tracer() == false)
+        std::cerr << "Path tracer preview unavailable." << std::endl;
+    return true;
 }
 
 /*
- * Set view matrix uniform.
+ * Pull the newest simulation state.
+ * Interpolated so motion stays smooth when the render and simulation rates
+ * differ.
  */
-static void set_view(unsigned int program)
+static void update(void)
 {
-    glm::mat4 view = glm::lookAt(cg::camera.eye,
-                                 cg::camera.center,
-                                 cg::camera.up);
-
-    set_matrix(program, view, "u_view");
-    set_vec3(program, cg::camera.eye, "u_view_pos");
+    g_model = cg::interpolate_model(cg::simulation_snapshot(), cg::sim_clock());
+    g_cube->model = g_model;
 }
 
 /*
- * Set projection matrix uniform.
+ * Milliseconds between two steady clock points.
  */
-static void set_projection(unsigned int program)
+static double elapsed_ms(std::chrono::steady_clock::time_point begin,
+                         std::chrono::steady_clock::time_point end)
 {
-    glm::mat4 projection = glm::perspective(cg::perspective.fov,
-                                            cg::perspective.aspect,
-                                            cg::perspective.z_near,
-                                            cg::perspective.z_far);
-
-    set_matrix(program, projection, "u_projection");
+    return std::chrono::duration<double, std::milli>(end - begin).count();
 }
 
 /*
- * Set light position.
+ * One more sample of the path tracer, uploaded and stretched over the
+ * window in place of render_scene().
  */
-static void set_light_pos(unsigned int program)
+static void present_path_tracer(GLFWwindow* window)
 {
-    set_vec3(program, g_light_pos, "u_light_pos");
-}
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    const int trace_width = std::max(1, static_cast<int>(width * cg::path_tracer_settings.resolution_scale));
+    const int trace_height = std::max(1, static_cast<int>(height * cg::path_tracer_settings.resolution_scale));
 
-/*
- * Set light color.
- */
-static void set_light_color(unsigned int program)
-{
-    set_vec3(program, g_light_color, "u_light_color");
-}
+    cg::path_trace_pass(trace_width, trace_height);
 
-/*
- * Vertex buffer object.
- * Uploads draw data to GPU memory.
- */
-static unsigned int init_vbo(void)
-{
-    /*
-     * Cube.
-     */
-    std::array<float, 288> vertices =
+    if (g_path_target.width != trace_width || g_path_target.height != trace_height)
     {
-    /* Position            Normal                Texture Coords */
-    /* Front face */
-    -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 1.0f,
-
-     0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 1.0f,
-    -0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 0.0f,
-
-    /* Back face */
-    -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 1.0f,
-
-     0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 1.0f,
-    -0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 0.0f,
-
-    /* Left face */
-    -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
-
-    -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
-
-    /* Right face */
-     0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
-
-     0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
-
-    /* Top face */
-    -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 1.0f,
-
-     0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 1.0f,
-    -0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 1.0f,
-    -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 0.0f,
-
-    /* Bottom face */
-    -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 1.0f,
-
-     0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 0.0f
-    };
-
-    unsigned int vbo = 0;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices[0], GL_STATIC_DRAW);
-
-    return vbo;
-}
-
-/*
- * Vertex array object.
- * Specifies the format of the draw data.
- */
-static unsigned int init_vao(void)
-{
-    unsigned int vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    /*
-     * Position attribute.
-     */
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    /*
-     * Normal attribute.
-     */
-    glVertexAttribPointer(1, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+        cg::destroy_render_target(g_path_target);
+        g_path_target = cg::create_render_target(trace_width, trace_height, "path tracer");
+    }
 
     /*
-     * Texture coordinate attribute.
+     * Rows arrive top first; the blit turns them over. Bind to edit, so
+     * this works on 3.3 like the rest of the window.
      */
-    glVertexAttribPointer(2, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    return vao;
+    const cg::ImageView image = cg::path_tracer_view();
+    glBindTexture(GL_TEXTURE_2D, g_path_target.color);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, g_path_target.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, trace_width, trace_height,
+                      0, height, width, 0,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 /*
- * Load and bind texture image.
+ * Create window and begin drawing.
  */
-static unsigned int init_texture(const std::string& path)
+static void run(void)
 {
-    int texture_width = 0;
-    int texture_height= 0;
-    int texture_bpp = 0;
-
-    stbi_set_flip_vertically_on_load(1);
+    GLFWwindow* window = init_window();
+    if (window == nullptr)
+        std::exit(1);
 
-    unsigned char* texture_data = stbi_load(path.c_str(),
-                                            &texture_width,
-                                            &texture_height,
-                                            &texture_bpp,
-                                            4);
+    cg::set_profiler_thread_name("Main");
 
-    if (texture_data == nullptr)
+    cg::init_ImGui(window);
+    if (init() == false)
     {
-        std::cerr << "Failed to load texture." << std::endl;
-        return 0;
+        cg::cleanup_renderer();
+        cg::cleanup_ImGui();
+        cleanup_window(window);
+        std::exit(1);
     }
-
-    unsigned int texture = 0;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    cg::init_gpu_profiler();
 
     /*
-     * Texture wrapping and filtering.
-     * Required.
+     * Worker threads for parallel engine work. This thread is worker 0.
      */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA8,
-                 texture_width,
-                 texture_height,
-                 0,
-                 GL_RGBA,
-                 GL_UNSIGNED_BYTE,
-                 texture_data);
-
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    stbi_image_free(texture_data);
-    return texture;
-}
-
-/*
- * Shader setup.
- */
-static unsigned int init_program(const std::string& vertex_path,
-                                 const std::string& fragment_path)
-{
-    const auto vertex_source = read_shader(vertex_path);
-    const auto fragment_source = read_shader(fragment_path);
-    if (vertex_source.has_value() == false ||
-        fragment_source.has_value() == false)
-    {
-        std::cerr << "Failed to read shaders." << std::endl;
-        return 0;
-    }
-
-    unsigned int program = create_shader(vertex_source.value(),
-                                         fragment_source.value());
+    cg::init_jobs();
 
-    return program;
-}
-
-/*
- * Init scene.
- */
-static void init(void)
-{
     /*
-     * Enable z-buffer and multisampling.
+     * Simulation runs on its own thread at a fixed timestep.
      */
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_MULTISAMPLE);
+    cg::start_simulation();
+
+    auto last_present = std::chrono::steady_clock::now();
+    uint64_t last_gpu_frame = UINT64_MAX;
 
     /*
-     * Blending. For transparency.
+     * Main loop.
+     * Runs every frame.
      */
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_BLEND);
-
-    unsigned int vbo = init_vbo();
-    unsigned int vao = init_vao();
-    unsigned int texture = init_texture("resources/textures/tu_white.png");
+    while (glfwWindowShouldClose(window) == 0)
+    {
+        const auto frame_start = std::chrono::steady_clock::now();
 
-    std::cout << "Data init check:" << std::endl;
-    if (gl_print_error() != 0)
-        return;
+        /*
+         * Nothing in here may allocate once warmed up.
+         * See allocation_tracker.h.
+         */
+        cg::begin_allocation_frame();
+        cg::begin_frame_arena();
+        cg::profiler_frame_mark();
 
-    unsigned int program = init_program("resources/shaders/tex_v.glsl",
-                                        "resources/shaders/tex_f.glsl");
+        {
+            CG_PROFILE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
-    if (program == 0)
-    {
-        std::cerr << "Failed to compile shaders." << std::endl;
-        return;
-    }
+        process_input(window);
 
-    glUseProgram(program);
-    g_program = program;
+        cg::begin_gpu_frame();
 
-    /*
-     * Set PVM matrix.
-     */
-    set_model(program);
-    set_view(program);
-    set_projection(program);
+        cg::render_ImGui();
 
-    /*
-     * Set light parameters.
-     */
-    set_light_pos(program);
-    set_light_color(program);
-}
+        update();
 
-/*
- * Draw function.
- */
-static void render(void)
-{
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-}
+        if (cg::path_tracer_settings.enabled == true && cg::path_tracer_available() == true)
+        {
+            present_path_tracer(window);
+        }
+        else
+        {
+            cg::clear_frame();
+            cg::render_scene();
+        }
 
-/*
- * Create window and begin drawing.
- */
-static void run(void)
-{
-    GLFWwindow* window = init_window();
-    if (window == nullptr)
-        std::exit(1);
+        cg::display_ImGui();
 
-    cg::init_ImGui(window);
-    init();
+        cg::end_gpu_frame();
 
-    /*
-     * Main loop.
-     * Runs every frame.
-     */
-    while (glfwWindowShouldClose(window) == 0)
-    {
-        glfwPollEvents();
+        const auto cpu_end = std::chrono::steady_clock::now();
+        cg::record_frame_time(cg::FrameMetric::cpu, elapsed_ms(frame_start, cpu_end));
 
-        cg::render_ImGui();
+        {
+            CG_PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
-        clear();
+        const auto present = std::chrono::steady_clock::now();
+        cg::record_frame_time(cg::FrameMetric::present, elapsed_ms(last_present, present));
+        last_present = present;
 
-        render();
+        /*
+         * GPU times arrive a few frames late, sometimes several at once.
+         * Count each frame once.
+         */
+        last_gpu_frame = cg::for_each_new_gpu_frame(last_gpu_frame, [](const cg::GpuFrameResult& gpu_frame)
+        {
+            cg::record_frame_time(cg::FrameMetric::gpu, gpu_frame.total_ms);
+        });
 
-        cg::display_ImGui();
+        cg::end_stats_frame();
+        cg::end_gl_counter_frame();
 
-        glfwSwapBuffers(window);
+        cg::end_allocation_frame();
     }
 
     /*
      * Cleanup.
      */
+    cg::write_frame_stats_json("frame_stats.json");
+    cg::stop_simulation();
+    cg::shutdown_jobs();
+    cg::cleanup_gpu_profiler();
+    cg::destroy_render_target(g_path_target);
+    cg::cleanup_path_tracer();
+    cg::cleanup_renderer();
     cg::cleanup_ImGui();
     cleanup_window(window);
 }
@@ -647,4 +367,3 @@ int main(void)
      */
     run();
 }
-
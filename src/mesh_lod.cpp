@@ -0,0 +1,687 @@
+#include "glad/glad.h"
+
+#include "mesh_lod.h"
+#include "command_list.h"
+#include "gl_debug.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace cg
+{
+
+LodSettings lod_settings =
+{
+    .enabled = false,
+    .forced_level = -1,
+    .pixel_error = 1.0f,
+    .hysteresis = 0.25f
+};
+
+/*
+ * The mesh every item draws while enabled: 6912 triangles in full.
+ */
+constexpr int mesh_subdivisions = 24;
+constexpr float mesh_radius = 0.125f;
+
+/*
+ * Bounding sphere of the unit cube, which holds the mesh.
+ */
+constexpr float item_radius = 0.8660254f;
+
+/*
+ * The quadrics measure in position, normal and texture coordinate space.
+ * Normals and texture coordinates are scaled to weigh about as much as
+ * positions do across the unit cube.
+ */
+constexpr size_t attribute_count = 8;
+constexpr double normal_weight = 0.5;
+constexpr double uv_weight = 1.0;
+
+/*
+ * A collapse must not turn a triangle further than this, as the cosine
+ * between its normals before and after.
+ */
+constexpr double min_normal_cosine = 0.2;
+
+/*
+ * Sum of squared distances to the planes of triangles, weighted by their
+ * area: x^T A x + 2 b^T x + c, with A symmetric and kept as its upper
+ * triangle. In more than three dimensions the plane is the triangle's
+ * affine span (Garland and Heckbert, 1998).
+ */
+template <size_t N>
+struct Quadric
+{
+    std::array<double, N * (N + 1) / 2> a;
+    std::array<double, N> b;
+    double c;
+};
+
+template <size_t N>
+static double dot(const std::array<double, N>& x, const std::array<double, N>& y)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < N; i++)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+template <size_t N>
+static Quadric<N> triangle_quadric(const std::array<double, N>& p0,
+                                   const std::array<double, N>& p1,
+                                   const std::array<double, N>& p2,
+                                   double weight)
+{
+    Quadric<N> quadric{};
+
+    std::array<double, N> e1;
+    std::array<double, N> e2;
+    for (size_t i = 0; i < N; i++)
+    {
+        e1[i] = p1[i] - p0[i];
+        e2[i] = p2[i] - p0[i];
+    }
+
+    /*
+     * Orthonormal basis of the triangle's span.
+     */
+    const double length1 = std::sqrt(dot<N>(e1, e1));
+    if (length1 < 1e-12)
+        return quadric;
+    for (double& value : e1)
+        value /= length1;
+
+    const double along = dot<N>(e2, e1);
+    for (size_t i = 0; i < N; i++)
+        e2[i] -= along * e1[i];
+    const double length2 = std::sqrt(dot<N>(e2, e2));
+    if (length2 < 1e-12)
+        return quadric;
+    for (double& value : e2)
+        value /= length2;
+
+    const double p0_e1 = dot<N>(p0, e1);
+    const double p0_e2 = dot<N>(p0, e2);
+
+    size_t k = 0;
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i; j < N; j++, k++)
+            quadric.a[k] = weight * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+    for (size_t i = 0; i < N; i++)
+        quadric.b[i] = weight * (p0_e1 * e1[i] + p0_e2 * e2[i] - p0[i]);
+    quadric.c = weight * (dot<N>(p0, p0) - p0_e1 * p0_e1 - p0_e2 * p0_e2);
+    return quadric;
+}
+
+template <size_t N>
+static void add(Quadric<N>& quadric, const Quadric<N>& other)
+{
+    for (size_t k = 0; k < quadric.a.size(); k++)
+        quadric.a[k] += other.a[k];
+    for (size_t i = 0; i < N; i++)
+        quadric.b[i] += other.b[i];
+    quadric.c += other.c;
+}
+
+template <size_t N>
+static double evaluate(const Quadric<N>& quadric, const std::array<double, N>& x)
+{
+    double sum = quadric.c;
+    size_t k = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+        sum += quadric.a[k++] * x[i] * x[i];
+        for (size_t j = i + 1; j < N; j++, k++)
+            sum += 2.0 * quadric.a[k] * x[i] * x[j];
+        sum += 2.0 * quadric.b[i] * x[i];
+    }
+    return sum;
+}
+
+using Position = std::array<double, 3>;
+using Attributes = std::array<double, attribute_count>;
+
+static Position position_of(const Mesh& mesh, uint32_t vertex)
+{
+    const float* v = &mesh.vertices[vertex * 8];
+    return { v[0], v[1], v[2] };
+}
+
+static Attributes attributes_of(const Mesh& mesh, uint32_t vertex)
+{
+    const float* v = &mesh.vertices[vertex * 8];
+    return
+    {
+        v[0], v[1], v[2],
+        v[3] * normal_weight, v[4] * normal_weight, v[5] * normal_weight,
+        v[6] * uv_weight, v[7] * uv_weight
+    };
+}
+
+static glm::dvec3 to_vec(const Position& position)
+{
+    return glm::dvec3(position[0], position[1], position[2]);
+}
+
+Mesh rounded_cube_mesh(int subdivisions, float radius)
+{
+    /*
+     * Every face spans u and v, with u x v pointing out.
+     */
+    struct Face
+    {
+        glm::vec3 normal;
+        glm::vec3 u;
+        glm::vec3 v;
+    };
+    static constexpr std::array<Face, 6> faces =
+    {{
+        { glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3( 1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(-1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3( 0.0f, 0.0f,  1.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3( 0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f,  0.0f) },
+        { glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3( 1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+        { glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3( 1.0f, 0.0f,  0.0f), glm::vec3(0.0f, 0.0f,  1.0f) }
+    }};
+
+    Mesh mesh;
+    const size_t row = static_cast<size_t>(subdivisions) + 1;
+    mesh.vertices.reserve(faces.size() * row * row * 8);
+    mesh.indices.reserve(faces.size() * subdivisions * subdivisions * 6);
+
+    /*
+     * A point of the cube moves onto the sphere of the given radius around
+     * the nearest point of the smaller core box.
+     */
+    const glm::vec3 core_extent(0.5f - radius);
+    for (const Face& face : faces)
+    {
+        const uint32_t base = static_cast<uint32_t>(mesh.vertices.size() / 8);
+        for (int j = 0; j <= subdivisions; j++)
+        {
+            for (int i = 0; i <= subdivisions; i++)
+            {
+                const float s = static_cast<float>(i) / static_cast<float>(subdivisions);
+                const float t = static_cast<float>(j) / static_cast<float>(subdivisions);
+                const glm::vec3 point = face.normal * 0.5f + face.u * (s - 0.5f) + face.v * (t - 0.5f);
+                const glm::vec3 core = glm::clamp(point, -core_extent, core_extent);
+                const glm::vec3 normal = glm::normalize(point - core);
+                const glm::vec3 position = core + normal * radius;
+                mesh.vertices.insert(mesh.vertices.end(),
+                                     { position.x, position.y, position.z, normal.x, normal.y, normal.z, s, t });
+            }
+        }
+
+        for (int j = 0; j < subdivisions; j++)
+        {
+            for (int i = 0; i < subdivisions; i++)
+            {
+                const uint32_t a = base + static_cast<uint32_t>(j * row + i);
+                const uint32_t b = a + 1;
+                const uint32_t c = a + static_cast<uint32_t>(row) + 1;
+                const uint32_t d = a + static_cast<uint32_t>(row);
+                mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+            }
+        }
+    }
+
+    return mesh;
+}
+
+/*
+ * Moving vertex from onto vertex to.
+ */
+struct Collapse
+{
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t from_version;
+    uint32_t to_version;
+
+    bool operator>(const Collapse& other) const
+    {
+        return cost > other.cost;
+    }
+};
+
+/*
+ * Working state of build_lod_chain(). Triangles of a vertex are listed
+ * in vertex_triangles; removed ones are dropped from the lists lazily.
+ */
+struct Simplifier
+{
+    std::vector<std::array<uint32_t, 3>> triangles;
+    std::vector<uint8_t> removed;
+    std::vector<std::vector<uint32_t>> vertex_triangles;
+    std::vector<Quadric<attribute_count>> quadrics;
+    std::vector<Quadric<3>> position_quadrics;
+    std::vector<double> areas;
+    std::vector<Attributes> attributes;
+    std::vector<Position> positions;
+    std::vector<uint8_t> locked;
+    std::vector<uint32_t> versions;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+};
+
+static bool contains(const std::array<uint32_t, 3>& triangle, uint32_t vertex)
+{
+    return triangle[0] == vertex || triangle[1] == vertex || triangle[2] == vertex;
+}
+
+static void push_collapse(Simplifier& simplifier, uint32_t from, uint32_t to)
+{
+    if (simplifier.locked[from] != 0)
+        return;
+
+    Quadric<attribute_count> merged = simplifier.quadrics[from];
+    add(merged, simplifier.quadrics[to]);
+    simplifier.heap.push(
+    {
+        .cost = evaluate(merged, simplifier.attributes[to]),
+        .from = from,
+        .to = to,
+        .from_version = simplifier.versions[from],
+        .to_version = simplifier.versions[to]
+    });
+}
+
+static void gather_neighbours(const Simplifier& simplifier, uint32_t vertex, std::vector<uint32_t>& neighbours)
+{
+    neighbours.clear();
+    for (uint32_t triangle : simplifier.vertex_triangles[vertex])
+    {
+        if (simplifier.removed[triangle] != 0)
+            continue;
+        for (uint32_t other : simplifier.triangles[triangle])
+            if (other != vertex && std::find(neighbours.begin(), neighbours.end(), other) == neighbours.end())
+                neighbours.push_back(other);
+    }
+}
+
+/*
+ * The edge must have a triangle on either side, the collapse must keep
+ * the surface a manifold (the two vertices share no neighbours but the
+ * ones opposite the edge) and must not fold any triangle over.
+ */
+static bool can_collapse(const Simplifier& simplifier, uint32_t from, uint32_t to,
+                         std::vector<uint32_t>& from_neighbours, std::vector<uint32_t>& to_neighbours)
+{
+    int shared = 0;
+    for (uint32_t triangle : simplifier.vertex_triangles[from])
+        if (simplifier.removed[triangle] == 0 && contains(simplifier.triangles[triangle], to) == true)
+            shared++;
+    if (shared != 2)
+        return false;
+
+    gather_neighbours(simplifier, from, from_neighbours);
+    gather_neighbours(simplifier, to, to_neighbours);
+    int common = 0;
+    for (uint32_t neighbour : from_neighbours)
+        if (std::find(to_neighbours.begin(), to_neighbours.end(), neighbour) != to_neighbours.end())
+            common++;
+    if (common != 2)
+        return false;
+
+    const glm::dvec3 target = to_vec(simplifier.positions[to]);
+    for (uint32_t triangle : simplifier.vertex_triangles[from])
+    {
+        const std::array<uint32_t, 3>& corners = simplifier.triangles[triangle];
+        if (simplifier.removed[triangle] != 0 || contains(corners, to) == true)
+            continue;
+
+        std::array<glm::dvec3, 3> before;
+        std::array<glm::dvec3, 3> after;
+        for (int i = 0; i < 3; i++)
+        {
+            before[i] = to_vec(simplifier.positions[corners[i]]);
+            after[i] = corners[i] == from ? target : before[i];
+        }
+
+        const glm::dvec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+        const glm::dvec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+        const double lengths = glm::length(normal_before) * glm::length(normal_after);
+        if (lengths < 1e-20 || glm::dot(normal_before, normal_after) < min_normal_cosine * lengths)
+            return false;
+    }
+
+    return true;
+}
+
+static void append_level(const Simplifier& simplifier, Mesh& mesh, std::vector<LodLevel>& levels, double error)
+{
+    const size_t first = mesh.indices.size();
+    for (size_t triangle = 0; triangle < simplifier.triangles.size(); triangle++)
+        if (simplifier.removed[triangle] == 0)
+            mesh.indices.insert(mesh.indices.end(), simplifier.triangles[triangle].begin(),
+                                simplifier.triangles[triangle].end());
+
+    levels.push_back(
+    {
+        .first_index = static_cast<int>(first),
+        .index_count = static_cast<int>(mesh.indices.size() - first),
+        .error = static_cast<float>(error)
+    });
+}
+
+std::vector<LodLevel> build_lod_chain(Mesh& mesh)
+{
+    const size_t vertex_count = mesh.vertices.size() / 8;
+    const size_t triangle_count = mesh.indices.size() / 3;
+
+    std::vector<LodLevel> levels;
+    levels.push_back({ .first_index = 0, .index_count = static_cast<int>(mesh.indices.size()), .error = 0.0f });
+
+    Simplifier simplifier;
+    simplifier.triangles.resize(triangle_count);
+    simplifier.removed.assign(triangle_count, 0);
+    simplifier.vertex_triangles.resize(vertex_count);
+    simplifier.quadrics.assign(vertex_count, {});
+    simplifier.position_quadrics.assign(vertex_count, {});
+    simplifier.areas.assign(vertex_count, 0.0);
+    simplifier.locked.assign(vertex_count, 0);
+    simplifier.versions.assign(vertex_count, 0);
+    simplifier.attributes.resize(vertex_count);
+    simplifier.positions.resize(vertex_count);
+    for (uint32_t vertex = 0; vertex < vertex_count; vertex++)
+    {
+        simplifier.attributes[vertex] = attributes_of(mesh, vertex);
+        simplifier.positions[vertex] = position_of(mesh, vertex);
+    }
+
+    /*
+     * Every vertex starts with the quadrics of the triangles around it.
+     * Edges used by one triangle lie on a border; those used by more than
+     * two are no surface to collapse across either.
+     */
+    std::unordered_map<uint64_t, int> edge_uses;
+    for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        std::array<uint32_t, 3>& corners = simplifier.triangles[triangle];
+        std::copy(mesh.indices.begin() + triangle * 3, mesh.indices.begin() + triangle * 3 + 3, corners.begin());
+
+        const glm::dvec3 p0 = to_vec(simplifier.positions[corners[0]]);
+        const glm::dvec3 p1 = to_vec(simplifier.positions[corners[1]]);
+        const glm::dvec3 p2 = to_vec(simplifier.positions[corners[2]]);
+        const double area = 0.5 * glm::length(glm::cross(p1 - p0, p2 - p0));
+
+        const Quadric<attribute_count> quadric = triangle_quadric<attribute_count>(
+            simplifier.attributes[corners[0]], simplifier.attributes[corners[1]], simplifier.attributes[corners[2]], area);
+        const Quadric<3> position_quadric = triangle_quadric<3>(
+            simplifier.positions[corners[0]], simplifier.positions[corners[1]], simplifier.positions[corners[2]], area);
+
+        for (int i = 0; i < 3; i++)
+        {
+            const uint32_t vertex = corners[i];
+            simplifier.vertex_triangles[vertex].push_back(triangle);
+            add(simplifier.quadrics[vertex], quadric);
+            add(simplifier.position_quadrics[vertex], position_quadric);
+            simplifier.areas[vertex] += area;
+
+            const uint32_t next = corners[(i + 1) % 3];
+            edge_uses[static_cast<uint64_t>(std::min(vertex, next)) << 32 | std::max(vertex, next)]++;
+        }
+    }
+
+    for (const auto& [edge, uses] : edge_uses)
+    {
+        if (uses == 2)
+            continue;
+        simplifier.locked[edge >> 32] = 1;
+        simplifier.locked[edge & 0xffffffffu] = 1;
+    }
+
+    for (const std::array<uint32_t, 3>& corners : simplifier.triangles)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            push_collapse(simplifier, corners[i], corners[(i + 1) % 3]);
+            push_collapse(simplifier, corners[(i + 1) % 3], corners[i]);
+        }
+    }
+
+    /*
+     * Cheapest collapse first. An entry is stale once either vertex took
+     * part in a later collapse; the edges around the surviving vertex are
+     * queued again with its new quadric.
+     */
+    size_t live = triangle_count;
+    size_t target = triangle_count / 2;
+    double error = 0.0;
+    std::vector<uint32_t> from_neighbours;
+    std::vector<uint32_t> to_neighbours;
+    while (simplifier.heap.empty() == false && levels.size() < max_lod_levels)
+    {
+        const Collapse collapse = simplifier.heap.top();
+        simplifier.heap.pop();
+
+        const uint32_t from = collapse.from;
+        const uint32_t to = collapse.to;
+        if (simplifier.versions[from] != collapse.from_version || simplifier.versions[to] != collapse.to_version)
+            continue;
+        if (can_collapse(simplifier, from, to, from_neighbours, to_neighbours) == false)
+            continue;
+
+        /*
+         * The level's error is the largest distance, as the position
+         * quadric averages it, of any vertex moved so far.
+         */
+        Quadric<3> merged = simplifier.position_quadrics[from];
+        add(merged, simplifier.position_quadrics[to]);
+        const double weight = simplifier.areas[from] + simplifier.areas[to];
+        if (weight > 0.0)
+            error = std::max(error, std::sqrt(std::max(evaluate(merged, simplifier.positions[to]), 0.0) / weight));
+
+        for (uint32_t triangle : simplifier.vertex_triangles[from])
+        {
+            if (simplifier.removed[triangle] != 0)
+                continue;
+
+            std::array<uint32_t, 3>& corners = simplifier.triangles[triangle];
+            if (contains(corners, to) == true)
+            {
+                simplifier.removed[triangle] = 1;
+                live--;
+                continue;
+            }
+
+            std::replace(corners.begin(), corners.end(), from, to);
+            simplifier.vertex_triangles[to].push_back(triangle);
+        }
+        simplifier.vertex_triangles[from].clear();
+
+        std::vector<uint32_t>& around = simplifier.vertex_triangles[to];
+        around.erase(std::remove_if(around.begin(), around.end(),
+                                    [&](uint32_t triangle) { return simplifier.removed[triangle] != 0; }),
+                     around.end());
+
+        add(simplifier.quadrics[to], simplifier.quadrics[from]);
+        add(simplifier.position_quadrics[to], simplifier.position_quadrics[from]);
+        simplifier.areas[to] += simplifier.areas[from];
+        simplifier.versions[from]++;
+        simplifier.versions[to]++;
+
+        for (uint32_t triangle : around)
+        {
+            for (uint32_t other : simplifier.triangles[triangle])
+            {
+                if (other == to)
+                    continue;
+                push_collapse(simplifier, to, other);
+                push_collapse(simplifier, other, to);
+            }
+        }
+
+        if (live <= target)
+        {
+            append_level(simplifier, mesh, levels, error);
+            target = live / 2;
+        }
+    }
+
+    /*
+     * What is left once nothing more can go, if it is much less than the
+     * last level.
+     */
+    if (levels.size() < max_lod_levels && live * 5 < static_cast<size_t>(levels.back().index_count / 3) * 4)
+        append_level(simplifier, mesh, levels, error);
+
+    return levels;
+}
+
+static std::vector<LodLevel> s_levels;
+static unsigned int s_vbo = 0;
+static unsigned int s_ebo = 0;
+static unsigned int s_vao = 0;
+static float s_pixels_per_unit = 0.0f;
+static LodStats s_stats{};
+
+bool init_mesh_lod(void)
+{
+    s_stats = {};
+    return lod_settings.enabled == false || prepare_mesh_lod() == true;
+}
+
+bool prepare_mesh_lod(void)
+{
+    if (s_levels.empty() == false)
+        return true;
+
+    Mesh mesh = rounded_cube_mesh(mesh_subdivisions, mesh_radius);
+    s_levels = build_lod_chain(mesh);
+    if (s_levels.empty() == true)
+        return false;
+
+    glGenVertexArrays(1, &s_vao);
+    glBindVertexArray(s_vao);
+
+    glGenBuffers(1, &s_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, s_vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+    label_gl_object(GL_BUFFER, s_vbo, "lod mesh vertices");
+
+    glGenBuffers(1, &s_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+    label_gl_object(GL_BUFFER, s_ebo, "lod mesh indices");
+
+    /*
+     * Same layout as the cube: position, normal, texture coordinate.
+     */
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    label_gl_object(GL_VERTEX_ARRAY, s_vao, "lod mesh");
+    return true;
+}
+
+void cleanup_mesh_lod(void)
+{
+    glDeleteVertexArrays(1, &s_vao);
+    glDeleteBuffers(1, &s_vbo);
+    glDeleteBuffers(1, &s_ebo);
+    s_vao = 0;
+    s_vbo = 0;
+    s_ebo = 0;
+    s_levels.clear();
+}
+
+unsigned int lod_vertex_array(void)
+{
+    return s_vao;
+}
+
+const std::vector<LodLevel>& lod_levels(void)
+{
+    return s_levels;
+}
+
+void begin_lod_selection(void)
+{
+    std::array<int, 4> viewport{};
+    glGetIntegerv(GL_VIEWPORT, viewport.data());
+
+    /*
+     * Pixels one unit covers at distance one: half the viewport height
+     * times cot(perspective.fov / 2). The projection's own value is
+     * larger when the viewport holds only a tile of the image.
+     */
+    const float cot_half_fov = projection_matrix()[1][1];
+    s_pixels_per_unit = 0.5f * static_cast<float>(viewport[3]) * cot_half_fov;
+    s_stats = {};
+}
+
+void select_lod(DrawItem& item)
+{
+    const int count = static_cast<int>(s_levels.size());
+    int level = std::min(static_cast<int>(item.lod), count - 1);
+
+    if (lod_settings.forced_level >= 0)
+    {
+        level = std::min(lod_settings.forced_level, count - 1);
+    }
+    else
+    {
+        const glm::vec3 center(item.model[3]);
+        const float scale = std::max({ glm::length(glm::vec3(item.model[0])),
+                                       glm::length(glm::vec3(item.model[1])),
+                                       glm::length(glm::vec3(item.model[2])) });
+        const float distance = std::max(glm::distance(camera.eye, center) - item_radius * scale, perspective.z_near);
+        const float pixels = scale / distance * s_pixels_per_unit;
+
+        if (s_levels[level].error * pixels > lod_settings.pixel_error)
+        {
+            while (level > 0 && s_levels[level].error * pixels > lod_settings.pixel_error)
+                level--;
+        }
+        else
+        {
+            const float coarser_error = lod_settings.pixel_error * (1.0f - lod_settings.hysteresis);
+            while (level + 1 < count && s_levels[level + 1].error * pixels <= coarser_error)
+                level++;
+        }
+    }
+
+    if (level != item.lod)
+        s_stats.switches++;
+    s_stats.items[level]++;
+    item.lod = static_cast<uint8_t>(level);
+}
+
+void record_item_draw(CommandList& list, const DrawItem& item)
+{
+    if (lod_settings.enabled == false)
+    {
+        list.draw_arrays(Primitive::triangles, 0, static_cast<int>(cube_vertex_count));
+        return;
+    }
+
+    const LodLevel& level = s_levels[std::min<size_t>(item.lod, s_levels.size() - 1)];
+    list.draw_elements(Primitive::triangles, level.first_index, level.index_count);
+}
+
+uint64_t item_triangles(const DrawItem& item)
+{
+    if (lod_settings.enabled == false)
+        return cube_vertex_count / 3;
+
+    return s_levels[std::min<size_t>(item.lod, s_levels.size() - 1)].index_count / 3;
+}
+
+const LodStats& last_lod_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
@@ -0,0 +1,123 @@
+#ifndef CG_MESH_LOD
+#define CG_MESH_LOD
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+class CommandList;
+struct DrawItem;
+
+constexpr int max_lod_levels = 8;
+
+/*
+ * With enabled, every draw item is a cube with rounded edges, fine
+ * enough that drawing it in full everywhere costs, and simplified into a
+ * chain of levels of detail when loaded. Without, the plain cube.
+ */
+struct LodSettings
+{
+    bool enabled;
+    int forced_level;  /* -1 picks by screen-space error, else this level for every item. */
+    float pixel_error; /* Largest projected error of the level picked, in pixels. */
+    float hysteresis;  /* A coarser level must be this fraction under pixel_error. */
+};
+extern LodSettings lod_settings;
+
+/*
+ * Indexed triangles, 8 floats a vertex as in cube_vertices().
+ */
+struct Mesh
+{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+/*
+ * Triangles of one level in the mesh's index buffer. The error is the
+ * largest distance in object space by which the simplified surface
+ * departs from the full one, as far as the quadrics tell.
+ */
+struct LodLevel
+{
+    int first_index;
+    int index_count;
+    float error;
+};
+
+/*
+ * Of the last selection.
+ */
+struct LodStats
+{
+    uint64_t switches; /* Items that changed level. */
+    std::array<uint64_t, max_lod_levels> items; /* At every level. */
+};
+
+/*
+ * The unit cube with its edges rounded by radius, every face a grid of
+ * subdivisions x subdivisions quads. Faces keep the cube's texture
+ * coordinates, so they do not share vertices.
+ */
+Mesh rounded_cube_mesh(int subdivisions, float radius);
+
+/*
+ * Quadric error simplification by half-edge collapses, one level each
+ * time the triangle count halves, until max_lod_levels or nothing more
+ * can go. The quadrics cover the normal and texture coordinates as well
+ * as the position, so a collapse that would smear the attributes costs
+ * as much as one that bends the surface. Vertices on a border are
+ * locked, which also keeps the seams between faces closed. Level 0 is
+ * the mesh itself; all levels index its vertices, and the indices of
+ * every level are appended to mesh.indices.
+ */
+std::vector<LodLevel> build_lod_chain(Mesh& mesh);
+
+/*
+ * Needs a current context with GL loaded. Builds the mesh and its levels
+ * only with lod_settings.enabled; they take a while.
+ */
+bool init_mesh_lod(void);
+void cleanup_mesh_lod(void);
+
+/*
+ * Builds the mesh and its levels if that has not happened yet. Call
+ * before drawing with lod_settings.enabled; false if the build fails.
+ */
+bool prepare_mesh_lod(void);
+
+/*
+ * The mesh's vertices and all its levels, with the attribute layout of
+ * the cube's vertex array.
+ */
+unsigned int lod_vertex_array(void);
+const std::vector<LodLevel>& lod_levels(void);
+
+/*
+ * Once a frame, for cg::camera, cg::perspective and the bound viewport,
+ * then select_lod() for every item. An item gets the coarsest level
+ * whose error, projected at the item's nearest possible distance, stays
+ * under lod_settings.pixel_error. It moves to a coarser level only once
+ * that is under by the hysteresis, so it does not flicker between two
+ * levels at the threshold.
+ */
+void begin_lod_selection(void);
+void select_lod(DrawItem& item);
+
+/*
+ * Record the draw of one item: the cube, or the item's level of the
+ * mesh. The list must have the matching vertex array bound, that of
+ * lod_vertex_array() while lod_settings.enabled.
+ */
+void record_item_draw(CommandList& list, const DrawItem& item);
+uint64_t item_triangles(const DrawItem& item);
+
+const LodStats& last_lod_stats(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,610 @@
+#include "occlusion.h"
+#include "cpu_features.h"
+#include "frame_arena.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+OcclusionSettings occlusion_settings =
+{
+    .enabled = false,
+    .width = 320,
+    .max_occluders = 64,
+    .min_occluder_size = 0.05f
+};
+
+/*
+ * Two depth layers per tile, after Intel's masked occlusion culling.
+ * z0 is a far bound of every pixel in the tile. Triangles in front of it
+ * are merged into a working layer: their coverage is or'ed into mask and
+ * z1 is the farthest of their depths. Once the working layer covers the
+ * whole tile it replaces z0. Depth grows away from the camera, 1 is far.
+ */
+struct alignas(32) Tile
+{
+    std::array<uint32_t, occlusion_tile_height> mask; /* Bit 31 is the left pixel. */
+    float z0;
+    float z1;
+};
+
+/*
+ * Where an edge crosses a row of pixels, in pixels from the left of the
+ * buffer: slope * row centre + offset. Left edges cover pixels to the
+ * right of the crossing, right edges to the left of it. Horizontal edges
+ * cover whole rows where slope * row centre + offset is positive.
+ */
+enum class EdgeKind
+{
+    left,
+    right,
+    horizontal
+};
+
+struct RowEdge
+{
+    float slope;
+    float offset;
+    EdgeKind kind;
+};
+
+struct OccluderTriangle
+{
+    std::array<RowEdge, 3> edges;
+    glm::vec3 depth; /* z = x * depth.x + y * depth.y + depth.z */
+    float max_depth;
+    int min_x;       /* Pixel bounds, inclusive. Empty if min_x > max_x. */
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+/*
+ * Occludees are moved this much towards the camera before testing.
+ */
+constexpr float depth_bias = 1e-5f;
+
+struct Candidate
+{
+    float size;
+    const DrawItem* item;
+};
+
+using MaskFunction = void (*)(const OccluderTriangle& triangle, int x, int y, uint32_t* masks);
+
+static std::vector<Tile> s_tiles;
+static int s_tiles_x = 0;
+static int s_tiles_y = 0;
+static OcclusionStats s_stats{};
+
+/*
+ * Pixels at and right of first, in tile coordinates.
+ */
+static uint32_t mask_from(int first)
+{
+    if (first <= 0)
+        return ~0u;
+    if (first >= occlusion_tile_width)
+        return 0u;
+    return ~0u >> first;
+}
+
+/*
+ * Coverage of the 8 rows of the tile at pixel x, y.
+ */
+static void row_masks_scalar(const OccluderTriangle& triangle, int x, int y, uint32_t* masks)
+{
+    for (int row = 0; row < occlusion_tile_height; row++)
+    {
+        const float py = static_cast<float>(y + row) + 0.5f;
+        uint32_t mask = ~0u;
+        for (const RowEdge& edge : triangle.edges)
+        {
+            const float value = edge.slope * py + edge.offset;
+            if (edge.kind == EdgeKind::horizontal)
+            {
+                mask = value > 0.0f ? mask : 0u;
+                continue;
+            }
+
+            const float crossing = std::clamp(value - static_cast<float>(x), -1.0f, 33.0f);
+            if (edge.kind == EdgeKind::left)
+                mask &= mask_from(static_cast<int>(std::floor(crossing)) + 1);
+            else
+                mask &= ~mask_from(static_cast<int>(std::ceil(crossing)));
+        }
+        masks[row] = mask;
+    }
+}
+
+#if defined(CG_AVX2)
+/*
+ * All 8 rows at once, one row per lane. Variable shifts by 32 or more
+ * give zero, so the masks need no clamping at the tile edges.
+ */
+CG_TARGET_AVX2 static void row_masks_avx2(const OccluderTriangle& triangle, int x, int y, uint32_t* masks)
+{
+    const __m256 rows = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(y) + 0.5f),
+                                      _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i mask = ones;
+
+    for (const RowEdge& edge : triangle.edges)
+    {
+        if (edge.kind == EdgeKind::horizontal)
+        {
+            const __m256 value = _mm256_fmadd_ps(_mm256_set1_ps(edge.slope), rows, _mm256_set1_ps(edge.offset));
+            const __m256 inside = _mm256_cmp_ps(value, _mm256_setzero_ps(), _CMP_GT_OQ);
+            mask = _mm256_and_si256(mask, _mm256_castps_si256(inside));
+            continue;
+        }
+
+        __m256 crossing = _mm256_fmadd_ps(_mm256_set1_ps(edge.slope),
+                                          rows,
+                                          _mm256_set1_ps(edge.offset - static_cast<float>(x)));
+        crossing = _mm256_min_ps(_mm256_max_ps(crossing, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(33.0f));
+
+        if (edge.kind == EdgeKind::left)
+        {
+            const __m256i first = _mm256_add_epi32(_mm256_cvttps_epi32(_mm256_floor_ps(crossing)),
+                                                   _mm256_set1_epi32(1));
+            mask = _mm256_and_si256(mask, _mm256_srlv_epi32(ones, first));
+        }
+        else
+        {
+            const __m256i end = _mm256_max_epi32(_mm256_cvttps_epi32(_mm256_ceil_ps(crossing)),
+                                                 _mm256_setzero_si256());
+            mask = _mm256_andnot_si256(_mm256_srlv_epi32(ones, end), mask);
+        }
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(masks), mask);
+}
+#endif
+
+static MaskFunction select_row_masks(void)
+{
+#if defined(CG_AVX2)
+    if (cpu_has_avx2() == true)
+        return row_masks_avx2;
+#endif
+    return row_masks_scalar;
+}
+
+/*
+ * Merge a triangle's coverage of a tile, with depth its farthest depth
+ * inside the tile.
+ */
+static void merge(Tile& tile, const uint32_t* coverage, float depth)
+{
+    if (depth >= tile.z0)
+        return;
+
+    uint32_t any = 0;
+    for (int row = 0; row < occlusion_tile_height; row++)
+        any |= coverage[row];
+    if (any == 0)
+        return;
+
+    /*
+     * Much nearer than the working layer: start a new one rather than
+     * push this triangle back to the old layer's depth.
+     */
+    if (tile.z1 - depth > tile.z0 - tile.z1)
+    {
+        tile.mask.fill(0);
+        tile.z1 = 0.0f;
+    }
+
+    tile.z1 = std::max(tile.z1, depth);
+    uint32_t full = ~0u;
+    for (int row = 0; row < occlusion_tile_height; row++)
+    {
+        tile.mask[row] |= coverage[row];
+        full &= tile.mask[row];
+    }
+
+    if (full == ~0u)
+    {
+        tile.z0 = tile.z1;
+        tile.z1 = 0.0f;
+        tile.mask.fill(0);
+    }
+}
+
+/*
+ * Farthest depth of the triangle's plane over a tile, clamped to the
+ * farthest vertex, as the plane extrapolates past the triangle.
+ */
+static float tile_depth(const OccluderTriangle& triangle, int x, int y)
+{
+    const float px = static_cast<float>(triangle.depth.x > 0.0f ? x + occlusion_tile_width : x);
+    const float py = static_cast<float>(triangle.depth.y > 0.0f ? y + occlusion_tile_height : y);
+    return std::min(triangle.max_depth, triangle.depth.x * px + triangle.depth.y * py + triangle.depth.z);
+}
+
+static RowEdge row_edge(const glm::vec3& a, const glm::vec3& b, float sign)
+{
+    /*
+     * Inside is sign * ((b - a) x (p - a)) > 0, that is
+     * ex * px + ey * py + ec > 0.
+     */
+    const float ex = -(b.y - a.y) * sign;
+    const float ey = (b.x - a.x) * sign;
+    const float ec = -(ex * a.x + ey * a.y);
+
+    if (ex == 0.0f)
+        return RowEdge{ .slope = ey, .offset = ec, .kind = EdgeKind::horizontal };
+
+    /*
+     * Crossing at ex * x + ey * y + ec = 0, less half a pixel so whole
+     * numbers fall between pixel centres.
+     */
+    return RowEdge
+    {
+        .slope = -ey / ex,
+        .offset = -ec / ex - 0.5f,
+        .kind = ex > 0.0f ? EdgeKind::left : EdgeKind::right
+    };
+}
+
+/*
+ * Screen space setup. Vertices are pixel x, y from the top left and depth.
+ * False if the triangle covers nothing.
+ */
+static bool setup_triangle(const std::array<glm::vec3, 3>& v, int width, int height, OccluderTriangle& triangle)
+{
+    const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (std::abs(area) < 1e-6f)
+        return false;
+
+    const float min_x = std::min({ v[0].x, v[1].x, v[2].x });
+    const float max_x = std::max({ v[0].x, v[1].x, v[2].x });
+    const float min_y = std::min({ v[0].y, v[1].y, v[2].y });
+    const float max_y = std::max({ v[0].y, v[1].y, v[2].y });
+    triangle.min_x = std::max(static_cast<int>(std::floor(min_x)), 0);
+    triangle.max_x = std::min(static_cast<int>(std::floor(max_x)), width - 1);
+    triangle.min_y = std::max(static_cast<int>(std::floor(min_y)), 0);
+    triangle.max_y = std::min(static_cast<int>(std::floor(max_y)), height - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+        return false;
+
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (size_t i = 0; i < 3; i++)
+        triangle.edges[i] = row_edge(v[i], v[(i + 1) % 3], sign);
+
+    const float dz1 = v[1].z - v[0].z;
+    const float dz2 = v[2].z - v[0].z;
+    triangle.depth.x = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+    triangle.depth.y = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+    triangle.depth.z = v[0].z - triangle.depth.x * v[0].x - triangle.depth.y * v[0].y;
+    triangle.max_depth = std::max({ v[0].z, v[1].z, v[2].z });
+    return true;
+}
+
+/*
+ * The front facing triangles of one occluder. The cube's winding is not
+ * consistent, so faces are picked by their normals. Triangles reaching in
+ * front of the near plane are dropped, which only loses occlusion.
+ */
+static uint64_t setup_occluder(const DrawItem& item,
+                               const glm::mat4& view_projection,
+                               int width,
+                               int height,
+                               OccluderTriangle* triangles)
+{
+    const float* vertices = cube_vertices();
+    const glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(item.model)));
+    const glm::mat4 model_view_projection = view_projection * item.model;
+
+    uint64_t count = 0;
+    for (size_t t = 0; t < cube_vertex_count / 3; t++)
+    {
+        OccluderTriangle& triangle = triangles[t];
+        triangle.min_x = 1;
+        triangle.max_x = 0;
+
+        const float* first = &vertices[t * 3 * 8];
+        const glm::vec3 normal = normal_matrix * glm::vec3(first[3], first[4], first[5]);
+        const glm::vec3 point = glm::vec3(item.model * glm::vec4(first[0], first[1], first[2], 1.0f));
+        if (glm::dot(normal, camera.eye - point) <= 0.0f)
+            continue;
+
+        std::array<glm::vec3, 3> screen;
+        bool in_front = true;
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float* vertex = &vertices[(t * 3 + i) * 8];
+            const glm::vec4 clip = model_view_projection * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f);
+            if (clip.w <= 1e-5f || clip.z < -clip.w)
+            {
+                in_front = false;
+                break;
+            }
+
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * width,
+                                  (0.5f - ndc.y * 0.5f) * height,
+                                  ndc.z * 0.5f + 0.5f);
+        }
+
+        if (in_front == true && setup_triangle(screen, width, height, triangle) == true)
+            count++;
+    }
+    return count;
+}
+
+/*
+ * Occluders are picked by how large they look: bounding radius over
+ * distance, largest first, which is roughly front to back.
+ */
+static size_t select_occluders(const DrawItem** items, size_t count, const DrawItem** occluders)
+{
+    Candidate* candidates = frame_allocate<Candidate>(count);
+    size_t candidate_count = 0;
+
+    const glm::vec3 forward = glm::normalize(camera.center - camera.eye);
+    for (size_t i = 0; i < count; i++)
+    {
+        const glm::mat4& model = items[i]->model;
+        const glm::vec3 center = glm::vec3(model[3]);
+        const float radius = 0.5f * std::sqrt(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])) +
+                                              glm::dot(glm::vec3(model[1]), glm::vec3(model[1])) +
+                                              glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+        const float distance = glm::length(center - camera.eye);
+        if (distance <= radius || glm::dot(center - camera.eye, forward) < -radius)
+            continue;
+
+        const float size = radius / distance;
+        if (size >= occlusion_settings.min_occluder_size)
+            candidates[candidate_count++] = Candidate{ size, items[i] };
+    }
+
+    const size_t occluder_count = std::min(candidate_count, occlusion_settings.max_occluders);
+    const auto larger = [](const Candidate& a, const Candidate& b) { return a.size > b.size; };
+    std::partial_sort(candidates, candidates + occluder_count, candidates + candidate_count, larger);
+    for (size_t i = 0; i < occluder_count; i++)
+        occluders[i] = candidates[i].item;
+    return occluder_count;
+}
+
+enum class BoxResult
+{
+    visible,
+    outside_frustum,
+    occluded
+};
+
+/*
+ * Unit cube of an item against the frustum, then against the buffer:
+ * hidden if, in every tile the screen rectangle touches, its nearest
+ * depth is behind z0, or behind z1 where the working layer covers the
+ * rectangle.
+ */
+static BoxResult test_box(const glm::mat4& model_view_projection, int width, int height)
+{
+    std::array<int, 6> outside{};
+    bool crosses_near = false;
+    float min_x = FLT_MAX;
+    float max_x = -FLT_MAX;
+    float min_y = FLT_MAX;
+    float max_y = -FLT_MAX;
+    float min_z = FLT_MAX;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const glm::vec4 local((corner & 1) != 0 ? 0.5f : -0.5f,
+                              (corner & 2) != 0 ? 0.5f : -0.5f,
+                              (corner & 4) != 0 ? 0.5f : -0.5f,
+                              1.0f);
+        const glm::vec4 clip = model_view_projection * local;
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z < -clip.w;
+        outside[5] += clip.z > clip.w;
+
+        if (clip.w <= 1e-5f || clip.z < -clip.w)
+        {
+            crosses_near = true;
+            continue;
+        }
+
+        const float inv_w = 1.0f / clip.w;
+        const float x = (clip.x * inv_w * 0.5f + 0.5f) * width;
+        const float y = (0.5f - clip.y * inv_w * 0.5f) * height;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, clip.z * inv_w * 0.5f + 0.5f);
+    }
+
+    /*
+     * An occluder's own faces are merged at its nearest depth give or take
+     * rounding; keep it from hiding itself.
+     */
+    min_z -= depth_bias;
+
+    for (const int count : outside)
+        if (count == 8)
+            return BoxResult::outside_frustum;
+    if (crosses_near == true)
+        return BoxResult::visible;
+
+    const int x0 = std::max(static_cast<int>(std::floor(min_x)), 0);
+    const int x1 = std::min(static_cast<int>(std::floor(max_x)), width - 1);
+    const int y0 = std::max(static_cast<int>(std::floor(min_y)), 0);
+    const int y1 = std::min(static_cast<int>(std::floor(max_y)), height - 1);
+    if (x0 > x1 || y0 > y1)
+        return BoxResult::outside_frustum;
+
+    for (int ty = y0 / occlusion_tile_height; ty <= y1 / occlusion_tile_height; ty++)
+    {
+        for (int tx = x0 / occlusion_tile_width; tx <= x1 / occlusion_tile_width; tx++)
+        {
+            const Tile& tile = s_tiles[static_cast<size_t>(ty) * s_tiles_x + tx];
+            if (min_z > tile.z0)
+                continue;
+            if (min_z <= tile.z1)
+                return BoxResult::visible;
+
+            const int left = x0 - tx * occlusion_tile_width;
+            const int right = x1 - tx * occlusion_tile_width + 1;
+            const uint32_t columns = mask_from(left) & ~mask_from(right);
+            const int first_row = std::max(y0 - ty * occlusion_tile_height, 0);
+            const int last_row = std::min(y1 - ty * occlusion_tile_height, occlusion_tile_height - 1);
+            for (int row = first_row; row <= last_row; row++)
+                if ((columns & ~tile.mask[row]) != 0)
+                    return BoxResult::visible;
+        }
+    }
+
+    return BoxResult::occluded;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+size_t cull_occluded_items(const DrawItem** items, size_t count, const glm::mat4& view_projection)
+{
+    CG_PROFILE_SCOPE("occlusion culling");
+    static const MaskFunction row_masks = select_row_masks();
+    const auto start = std::chrono::steady_clock::now();
+
+    const int width = std::max(occlusion_settings.width / occlusion_tile_width, 1) * occlusion_tile_width;
+    const int rows = static_cast<int>(std::ceil(width / perspective.aspect / occlusion_tile_height));
+    const int height = std::max(rows, 1) * occlusion_tile_height;
+    s_tiles_x = width / occlusion_tile_width;
+    s_tiles_y = height / occlusion_tile_height;
+    s_tiles.resize(static_cast<size_t>(s_tiles_x) * s_tiles_y);
+
+    /*
+     * Occluders, their triangles in fixed slots, then one job per row of
+     * tiles. Rows share nothing, so no locking.
+     */
+    const DrawItem** occluders = frame_allocate<const DrawItem*>(occlusion_settings.max_occluders);
+    const size_t occluder_count = select_occluders(items, count, occluders);
+    constexpr size_t triangles_per_occluder = cube_vertex_count / 3;
+    OccluderTriangle* triangles = frame_allocate<OccluderTriangle>(occluder_count * triangles_per_occluder);
+
+    std::atomic<uint64_t> triangle_count = 0;
+    {
+        CG_PROFILE_SCOPE("occluder setup");
+        parallel_for(occluder_count, 8, [&](size_t begin, size_t end)
+        {
+            uint64_t local = 0;
+            for (size_t i = begin; i < end; i++)
+                local += setup_occluder(*occluders[i], view_projection, width, height,
+                                        &triangles[i * triangles_per_occluder]);
+            triangle_count.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+
+    {
+        CG_PROFILE_SCOPE("occluder raster");
+        const size_t total = occluder_count * triangles_per_occluder;
+        parallel_for(static_cast<size_t>(s_tiles_y), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t ty = begin; ty < end; ty++)
+            {
+                Tile* row = &s_tiles[ty * s_tiles_x];
+                for (int tx = 0; tx < s_tiles_x; tx++)
+                    row[tx] = Tile{ .mask = {}, .z0 = 1.0f, .z1 = 0.0f };
+
+                const int y = static_cast<int>(ty) * occlusion_tile_height;
+                for (size_t t = 0; t < total; t++)
+                {
+                    const OccluderTriangle& triangle = triangles[t];
+                    if (triangle.min_x > triangle.max_x ||
+                        triangle.max_y < y || triangle.min_y >= y + occlusion_tile_height)
+                        continue;
+
+                    for (int tx = triangle.min_x / occlusion_tile_width; tx <= triangle.max_x / occlusion_tile_width; tx++)
+                    {
+                        const int x = tx * occlusion_tile_width;
+                        alignas(32) uint32_t coverage[occlusion_tile_height];
+                        row_masks(triangle, x, y, coverage);
+                        merge(row[tx], coverage, tile_depth(triangle, x, y));
+                    }
+                }
+            }
+        });
+    }
+    const auto rasterised = std::chrono::steady_clock::now();
+
+    /*
+     * Test every item, then compact in order on this thread.
+     */
+    uint8_t* results = frame_allocate<uint8_t>(count);
+    {
+        CG_PROFILE_SCOPE("occludee test");
+        parallel_for(count, 256, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                results[i] = static_cast<uint8_t>(test_box(view_projection * items[i]->model, width, height));
+        });
+    }
+
+    size_t visible = 0;
+    uint64_t frustum_culled = 0;
+    uint64_t occluded = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const BoxResult result = static_cast<BoxResult>(results[i]);
+        if (result == BoxResult::visible)
+            items[visible++] = items[i];
+        else if (result == BoxResult::outside_frustum)
+            frustum_culled++;
+        else
+            occluded++;
+    }
+
+    s_stats =
+    {
+        .occluders = occluder_count,
+        .occluder_triangles = triangle_count.load(std::memory_order_relaxed),
+        .tested = count,
+        .frustum_culled = frustum_culled,
+        .occluded = occluded,
+        .raster_ms = elapsed_ms(start, rasterised),
+        .test_ms = elapsed_ms(rasterised, std::chrono::steady_clock::now())
+    };
+    return visible;
+}
+
+const OcclusionStats& last_occlusion_stats(void)
+{
+    return s_stats;
+}
+
+int occlusion_tiles_x(void)
+{
+    return s_tiles_x;
+}
+
+int occlusion_tiles_y(void)
+{
+    return s_tiles_y;
+}
+
+float occlusion_tile_depth(int x, int y)
+{
+    return s_tiles[static_cast<size_t>(y) * s_tiles_x + x].z0;
+}
+
+} // namespace cg
@@ -0,0 +1,65 @@
+#ifndef CG_OCCLUSION
+#define CG_OCCLUSION
+
+#include "glm/ext.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+struct DrawItem;
+
+/*
+ * The buffer is split into tiles of 32 x 8 pixels. Every row of a tile is
+ * one 32 bit coverage mask, so a triangle covers a whole tile row with a
+ * few shifts and the eight rows of a tile fill one AVX2 register.
+ */
+constexpr int occlusion_tile_width = 32;
+constexpr int occlusion_tile_height = 8;
+
+struct OcclusionSettings
+{
+    bool enabled;
+    int width;               /* Pixels, a multiple of 32. The height follows the aspect. */
+    size_t max_occluders;    /* Largest items on screen rasterised as occluders. */
+    float min_occluder_size; /* Bounding radius over distance; smaller items never occlude. */
+};
+extern OcclusionSettings occlusion_settings;
+
+/*
+ * What the last cull_occluded_items() did.
+ */
+struct OcclusionStats
+{
+    uint64_t occluders;
+    uint64_t occluder_triangles; /* Front facing, rasterised. */
+    uint64_t tested;
+    uint64_t frustum_culled;
+    uint64_t occluded;
+    double raster_ms; /* Occluder selection, setup and rasterisation. */
+    double test_ms;
+};
+
+/*
+ * Rasterise the largest items into a low resolution masked depth buffer
+ * and test every item's bounding box against it. Items outside the
+ * frustum or behind the occluders are removed from items, the rest keep
+ * their order. Returns how many are left. Runs on the job workers; call
+ * from the main thread, per frame arrays come from the frame arena.
+ */
+size_t cull_occluded_items(const DrawItem** items, size_t count, const glm::mat4& view_projection);
+const OcclusionStats& last_occlusion_stats(void);
+
+/*
+ * Resolution of the last frame's buffer and its conservative far depth
+ * per tile, for debug views.
+ */
+int occlusion_tiles_x(void);
+int occlusion_tiles_y(void);
+float occlusion_tile_depth(int x, int y);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,678 @@
+#include "path_tracer.h"
+#include "bvh.h"
+#include "cpu_features.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace cg
+{
+
+PathTracerSettings path_tracer_settings =
+{
+    .enabled = false,
+    .resolution_scale = 0.5f,
+    .max_bounces = 2
+};
+
+constexpr int tile_size = 16;
+constexpr size_t max_stack = 128;
+constexpr float ray_epsilon = 1e-3f;
+
+/*
+ * Refits of the top level are kept until they make it this much more
+ * expensive than a fresh build.
+ */
+constexpr float max_refit_cost = 1.5f;
+
+/*
+ * In object space: every item shares the cube's triangles.
+ */
+struct Triangle
+{
+    glm::vec3 v0;
+    glm::vec3 e1; /* v1 - v0 */
+    glm::vec3 e2; /* v2 - v0 */
+    glm::vec3 normal;
+    glm::vec2 uv0;
+    glm::vec2 uv1;
+    glm::vec2 uv2;
+};
+
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverse; /* 1 / direction, finite. */
+};
+
+struct Hit
+{
+    float t;
+    float u;
+    float v;
+    uint32_t triangle;
+    uint32_t instance;
+};
+
+struct Instance
+{
+    glm::mat4 world_to_object;
+    glm::mat3 normal_to_world;
+};
+
+struct Texture
+{
+    int width;
+    int height;
+    std::vector<glm::vec3> texels; /* Bottom row first, as GL stores them. */
+};
+
+/*
+ * Hash chain seeded per pixel and sample, so the image does not depend on
+ * how tiles land on workers.
+ */
+struct Random
+{
+    uint32_t state;
+
+    float next(void);
+};
+
+static std::vector<const DrawItem*> s_items;
+static std::vector<Triangle> s_triangles;
+static Bvh s_mesh_bvh;
+static std::vector<Instance> s_instances;
+static std::vector<Bounds> s_instance_bounds;
+static Bvh s_scene_bvh;
+static float s_built_cost = 0.0f;
+static Texture s_texture;
+static std::vector<glm::vec3> s_accumulation;
+static std::vector<uint32_t> s_pixels;
+static int s_width = 0;
+static int s_height = 0;
+static uint64_t s_scene_hash = 0;
+static uint64_t s_view_hash = 0;
+static PathTracerStats s_stats{};
+
+/*
+ * PCG hash.
+ */
+static uint32_t hash(uint32_t value)
+{
+    const uint32_t state = value * 747796405u + 2891336453u;
+    const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float Random::next(void)
+{
+    state = hash(state);
+    return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+}
+
+/*
+ * FNV-1a.
+ */
+static uint64_t hash_bytes(uint64_t seed, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+        seed = (seed ^ bytes[i]) * 1099511628211ull;
+    return seed;
+}
+
+static bool load_texture(const char* path)
+{
+    Image image;
+    if (load_image(path, image) == false)
+    {
+        std::cerr << "Failed to load texture " << path << "." << std::endl;
+        return false;
+    }
+
+    s_texture.width = image.width;
+    s_texture.height = image.height;
+    s_texture.texels.resize(static_cast<size_t>(image.width) * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = &image.pixels[static_cast<size_t>(image.height - 1 - y) * image.width * 4];
+        for (int x = 0; x < image.width; x++)
+            s_texture.texels[static_cast<size_t>(y) * image.width + x] =
+                glm::vec3(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]) / 255.0f;
+    }
+    return true;
+}
+
+/*
+ * GL_LINEAR with GL_CLAMP_TO_EDGE, like the raster path.
+ */
+static glm::vec3 sample_texture(const glm::vec2& uv)
+{
+    const float x = uv.x * s_texture.width - 0.5f;
+    const float y = uv.y * s_texture.height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+
+    const int x0 = std::clamp(static_cast<int>(fx), 0, s_texture.width - 1);
+    const int y0 = std::clamp(static_cast<int>(fy), 0, s_texture.height - 1);
+    const int x1 = std::clamp(static_cast<int>(fx) + 1, 0, s_texture.width - 1);
+    const int y1 = std::clamp(static_cast<int>(fy) + 1, 0, s_texture.height - 1);
+
+    const glm::vec3* row0 = &s_texture.texels[static_cast<size_t>(y0) * s_texture.width];
+    const glm::vec3* row1 = &s_texture.texels[static_cast<size_t>(y1) * s_texture.width];
+    return glm::mix(glm::mix(row0[x0], row0[x1], x - fx), glm::mix(row1[x0], row1[x1], x - fx), y - fy);
+}
+
+static Ray make_ray(const glm::vec3& origin, const glm::vec3& direction)
+{
+    /*
+     * Zero components would turn slab distances into NaN.
+     */
+    const auto safe = [](float value) { return std::abs(value) > 1e-20f ? value : 1e-20f; };
+    return Ray
+    {
+        .origin = origin,
+        .direction = direction,
+        .inverse = glm::vec3(1.0f / safe(direction.x), 1.0f / safe(direction.y), 1.0f / safe(direction.z))
+    };
+}
+
+/*
+ * Slab test of the four children. Returns a bit per child hit closer than
+ * t_max and writes the entry distances.
+ */
+static unsigned int intersect_children(const Bvh4Node& node, const Ray& ray, float t_max, float* t_near)
+{
+#if defined(CG_SSE)
+    const __m128 origin_x = _mm_set1_ps(ray.origin.x);
+    const __m128 origin_y = _mm_set1_ps(ray.origin.y);
+    const __m128 origin_z = _mm_set1_ps(ray.origin.z);
+    const __m128 inverse_x = _mm_set1_ps(ray.inverse.x);
+    const __m128 inverse_y = _mm_set1_ps(ray.inverse.y);
+    const __m128 inverse_z = _mm_set1_ps(ray.inverse.z);
+
+    const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x.data()), origin_x), inverse_x);
+    const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x.data()), origin_x), inverse_x);
+    const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y.data()), origin_y), inverse_y);
+    const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y.data()), origin_y), inverse_y);
+    const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z.data()), origin_z), inverse_z);
+    const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z.data()), origin_z), inverse_z);
+
+    __m128 entry = _mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1));
+    entry = _mm_max_ps(entry, _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+    __m128 exit = _mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1));
+    exit = _mm_min_ps(exit, _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(t_max)));
+
+    _mm_storeu_ps(t_near, entry);
+    return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(entry, exit)));
+#else
+    unsigned int mask = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+        const glm::vec3 t0 = (glm::vec3(node.min_x[i], node.min_y[i], node.min_z[i]) - ray.origin) * ray.inverse;
+        const glm::vec3 t1 = (glm::vec3(node.max_x[i], node.max_y[i], node.max_z[i]) - ray.origin) * ray.inverse;
+        const glm::vec3 near = glm::min(t0, t1);
+        const glm::vec3 far = glm::max(t0, t1);
+        t_near[i] = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        const float t_far = std::min(std::min(far.x, far.y), std::min(far.z, t_max));
+        if (t_near[i] <= t_far)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/*
+ * Möller-Trumbore. Both sides count.
+ */
+static bool intersect_triangle(const Triangle& triangle, const Ray& ray, float t_max, Hit& hit)
+{
+    const glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+    const float determinant = glm::dot(triangle.e1, p);
+    if (std::abs(determinant) < 1e-12f)
+        return false;
+
+    const float inverse = 1.0f / determinant;
+    const glm::vec3 s = ray.origin - triangle.v0;
+    const float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    const glm::vec3 q = glm::cross(s, triangle.e1);
+    const float v = glm::dot(ray.direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    const float t = glm::dot(triangle.e2, q) * inverse;
+    if (t <= 1e-4f || t >= t_max)
+        return false;
+
+    hit.t = t;
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+/*
+ * Nearest hit closer than hit.t, with leaf(primitive) testing one
+ * primitive and shrinking hit.t. Children are visited near to far, so
+ * farther subtrees are mostly skipped once something is hit. With any_hit
+ * the first hit ends the search, for shadow rays.
+ */
+template <typename Leaf>
+static bool traverse(const Bvh& bvh, const Ray& ray, Hit& hit, bool any_hit, const Leaf& leaf)
+{
+    std::array<uint32_t, max_stack> stack;
+    size_t top = 0;
+    stack[top++] = 0;
+    bool found = false;
+
+    while (top > 0)
+    {
+        const Bvh4Node& node = bvh.nodes[stack[--top]];
+        alignas(16) float t_near[4];
+        unsigned int mask = intersect_children(node, ray, hit.t, t_near);
+
+        std::array<uint32_t, 4> children;
+        std::array<float, 4> distances;
+        size_t child_count = 0;
+        while (mask != 0)
+        {
+            const unsigned int i = static_cast<unsigned int>(std::countr_zero(mask));
+            mask &= mask - 1;
+            if (node.child[i] == bvh_empty)
+                continue;
+
+            if (node.count[i] == 0)
+            {
+                /*
+                 * Insertion sort, farthest first, so the nearest ends up
+                 * on top of the stack.
+                 */
+                size_t slot = child_count++;
+                while (slot > 0 && distances[slot - 1] < t_near[i])
+                {
+                    children[slot] = children[slot - 1];
+                    distances[slot] = distances[slot - 1];
+                    slot--;
+                }
+                children[slot] = node.child[i];
+                distances[slot] = t_near[i];
+                continue;
+            }
+
+            for (uint32_t p = node.child[i]; p < node.child[i] + node.count[i]; p++)
+            {
+                if (leaf(bvh.primitives[p]) == true)
+                {
+                    found = true;
+                    if (any_hit == true)
+                        return true;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < child_count && top < max_stack; i++)
+            stack[top++] = children[i];
+    }
+
+    return found;
+}
+
+/*
+ * Through the instances' tree into the cube's, with the ray moved to
+ * object space. The inverse transform rescales the direction of a scaled
+ * instance, but t is a parameter along the ray rather than a distance, so
+ * the same t gives the same point in both spaces and hits compare as is.
+ */
+static bool trace(const Ray& ray, Hit& hit, bool any_hit)
+{
+    return traverse(s_scene_bvh, ray, hit, any_hit, [&](uint32_t instance)
+    {
+        const glm::mat4& world_to_object = s_instances[instance].world_to_object;
+        const Ray local = make_ray(glm::vec3(world_to_object * glm::vec4(ray.origin, 1.0f)),
+                                   glm::vec3(world_to_object * glm::vec4(ray.direction, 0.0f)));
+        const bool hit_mesh = traverse(s_mesh_bvh, local, hit, any_hit, [&](uint32_t triangle)
+        {
+            if (intersect_triangle(s_triangles[triangle], local, hit.t, hit) == false)
+                return false;
+            hit.triangle = triangle;
+            return true;
+        });
+        if (hit_mesh == true)
+            hit.instance = instance;
+        return hit_mesh;
+    });
+}
+
+/*
+ * Cosine weighted direction around normal.
+ */
+static glm::vec3 sample_hemisphere(const glm::vec3& normal, Random& random)
+{
+    const float r = std::sqrt(random.next());
+    const float phi = 6.28318530718f * random.next();
+    const glm::vec3 helper = std::abs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    const glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+    const glm::vec3 bitangent = glm::cross(normal, tangent);
+    return glm::normalize(tangent * (r * std::cos(phi)) +
+                          bitangent * (r * std::sin(phi)) +
+                          normal * std::sqrt(std::max(0.0f, 1.0f - r * r)));
+}
+
+struct Lighting
+{
+    glm::vec3 light_position;
+    glm::vec3 light_color;
+    glm::vec3 sky;
+    int max_bounces;
+};
+
+/*
+ * Diffuse surfaces with the texture as albedo. The point light has no
+ * falloff, like phong_f; rays that leave the scene see the clear color.
+ */
+static glm::vec3 radiance(Ray ray, const Lighting& lighting, Random& random, uint64_t& rays)
+{
+    glm::vec3 result(0.0f);
+    glm::vec3 throughput(1.0f);
+
+    for (int bounce = 0; bounce <= lighting.max_bounces; bounce++)
+    {
+        Hit hit{ .t = FLT_MAX, .u = 0.0f, .v = 0.0f, .triangle = 0, .instance = 0 };
+        rays++;
+        if (trace(ray, hit, false) == false)
+        {
+            result += throughput * lighting.sky;
+            break;
+        }
+
+        const Triangle& triangle = s_triangles[hit.triangle];
+        const glm::vec3 position = ray.origin + ray.direction * hit.t;
+        const glm::vec3 world_normal = glm::normalize(s_instances[hit.instance].normal_to_world * triangle.normal);
+        const glm::vec3 normal = glm::dot(world_normal, ray.direction) > 0.0f ? -world_normal : world_normal;
+        const glm::vec2 uv = triangle.uv0 * (1.0f - hit.u - hit.v) + triangle.uv1 * hit.u + triangle.uv2 * hit.v;
+        const glm::vec3 albedo = sample_texture(uv);
+        const glm::vec3 origin = position + normal * ray_epsilon;
+
+        const glm::vec3 to_light = lighting.light_position - position;
+        const float distance = glm::length(to_light);
+        const float cosine = glm::dot(normal, to_light) / distance;
+        if (cosine > 0.0f)
+        {
+            Hit shadow{ .t = distance, .u = 0.0f, .v = 0.0f, .triangle = 0, .instance = 0 };
+            rays++;
+            if (trace(make_ray(origin, to_light / distance), shadow, true) == false)
+                result += throughput * albedo * lighting.light_color * cosine;
+        }
+
+        /*
+         * Lambertian BRDF over a cosine weighted pdf leaves the albedo.
+         */
+        throughput *= albedo;
+        ray = make_ray(origin, sample_hemisphere(normal, random));
+    }
+
+    return result;
+}
+
+static uint32_t pack_color(const glm::vec3& color)
+{
+    const glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return static_cast<uint32_t>(c.r) | (static_cast<uint32_t>(c.g) << 8) |
+           (static_cast<uint32_t>(c.b) << 16) | 0xFF000000u;
+}
+
+/*
+ * The cube in object space and its tree, shared by every item.
+ */
+static void build_mesh(void)
+{
+    const float* vertices = cube_vertices();
+    constexpr size_t triangle_count = cube_vertex_count / 3;
+
+    std::vector<Bounds> bounds(triangle_count);
+    s_triangles.resize(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        std::array<glm::vec3, 3> position;
+        std::array<glm::vec2, 3> uv;
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float* vertex = &vertices[(t * 3 + i) * 8];
+            position[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+            uv[i] = glm::vec2(vertex[6], vertex[7]);
+        }
+
+        const glm::vec3 e1 = position[1] - position[0];
+        const glm::vec3 e2 = position[2] - position[0];
+        s_triangles[t] = Triangle
+        {
+            .v0 = position[0],
+            .e1 = e1,
+            .e2 = e2,
+            .normal = glm::normalize(glm::cross(e1, e2)),
+            .uv0 = uv[0],
+            .uv1 = uv[1],
+            .uv2 = uv[2]
+        };
+        bounds[t] = Bounds
+        {
+            glm::min(position[0], glm::min(position[1], position[2])),
+            glm::max(position[0], glm::max(position[1], position[2]))
+        };
+    }
+
+    build_bvh(bounds.data(), bounds.size(), s_mesh_bvh);
+}
+
+/*
+ * Moving items only changes their instances, so the top level is refitted
+ * in place. It is rebuilt when the item count changes, or when refits have
+ * made it max_refit_cost times as expensive as it was when built.
+ */
+static void update_scene(size_t item_count)
+{
+    const auto start = std::chrono::steady_clock::now();
+    if (s_mesh_bvh.nodes.empty() == true)
+        build_mesh();
+
+    const Bounds mesh_bounds = bvh_bounds(s_mesh_bvh);
+    s_instances.resize(item_count);
+    s_instance_bounds.resize(item_count);
+    for (size_t i = 0; i < item_count; i++)
+    {
+        const glm::mat4& model = s_items[i]->model;
+        s_instances[i] = Instance
+        {
+            .world_to_object = glm::inverse(model),
+            .normal_to_world = glm::transpose(glm::inverse(glm::mat3(model)))
+        };
+        s_instance_bounds[i] = transform_bounds(mesh_bounds, model);
+    }
+
+    bool rebuild = s_scene_bvh.nodes.empty() == true || s_scene_bvh.primitives.size() != item_count;
+    if (rebuild == false)
+    {
+        refit_bvh(s_instance_bounds.data(), s_scene_bvh);
+        rebuild = bvh_sah_cost(s_scene_bvh) > max_refit_cost * s_built_cost;
+        if (rebuild == false)
+            s_stats.refits++;
+    }
+
+    if (rebuild == true)
+    {
+        build_bvh(s_instance_bounds.data(), s_instance_bounds.size(), s_scene_bvh);
+        s_built_cost = bvh_sah_cost(s_scene_bvh);
+        s_stats.builds++;
+    }
+
+    s_stats.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    s_stats.triangles = s_triangles.size() * item_count;
+    s_stats.bvh_nodes = s_mesh_bvh.nodes.size() + s_scene_bvh.nodes.size();
+}
+
+bool init_path_tracer(void)
+{
+    if (load_texture("resources/textures/tu_white.png") == false)
+        return false;
+
+    s_items.resize(max_draw_items);
+    s_scene_hash = 0;
+    s_view_hash = 0;
+    return true;
+}
+
+void cleanup_path_tracer(void)
+{
+    s_items.clear();
+    s_triangles.clear();
+    s_mesh_bvh = Bvh{};
+    s_instances.clear();
+    s_instance_bounds.clear();
+    s_scene_bvh = Bvh{};
+    s_texture = Texture{};
+    s_accumulation.clear();
+    s_pixels.clear();
+    s_width = 0;
+    s_height = 0;
+}
+
+bool path_tracer_available(void)
+{
+    return s_items.empty() == false;
+}
+
+void restart_path_tracer(void)
+{
+    std::fill(s_accumulation.begin(), s_accumulation.end(), glm::vec3(0.0f));
+    s_stats.samples = 0;
+}
+
+void path_trace_pass(int width, int height)
+{
+    CG_PROFILE_SCOPE("path trace");
+
+    /*
+     * Update the instances when any item moved, restart when anything seen
+     * changed.
+     */
+    const size_t item_count = gather_draw_items(s_items.data(), s_items.size());
+    uint64_t scene_hash = hash_bytes(14695981039346656037ull, &item_count, sizeof(item_count));
+    for (size_t i = 0; i < item_count; i++)
+        scene_hash = hash_bytes(scene_hash, &s_items[i]->model, sizeof(glm::mat4));
+
+    const glm::mat4 view_projection = projection_matrix() * view_matrix();
+    const glm::vec3 light_pos = light_position();
+    const glm::vec3 light_col = light_color();
+    uint64_t view_hash = hash_bytes(scene_hash, &view_projection, sizeof(view_projection));
+    view_hash = hash_bytes(view_hash, &light_pos, sizeof(light_pos));
+    view_hash = hash_bytes(view_hash, &light_col, sizeof(light_col));
+    view_hash = hash_bytes(view_hash, &path_tracer_settings.max_bounces, sizeof(int));
+
+    if (scene_hash != s_scene_hash || s_scene_bvh.nodes.empty() == true)
+    {
+        CG_PROFILE_SCOPE("path tracer BVH");
+        update_scene(item_count);
+        s_scene_hash = scene_hash;
+    }
+
+    if (width != s_width || height != s_height)
+    {
+        s_width = width;
+        s_height = height;
+        s_accumulation.resize(static_cast<size_t>(width) * height);
+        s_pixels.resize(static_cast<size_t>(width) * height);
+        s_view_hash = ~view_hash;
+    }
+
+    if (view_hash != s_view_hash)
+    {
+        restart_path_tracer();
+        s_view_hash = view_hash;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+    const Lighting lighting =
+    {
+        .light_position = light_pos,
+        .light_color = light_col,
+        .sky = glm::vec3(clear_color) * clear_color.w,
+        .max_bounces = std::max(path_tracer_settings.max_bounces, 0)
+    };
+    const uint32_t sample = static_cast<uint32_t>(s_stats.samples);
+    const float weight = 1.0f / static_cast<float>(sample + 1);
+
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    const int tiles_y = (height + tile_size - 1) / tile_size;
+    std::atomic<uint64_t> rays = 0;
+
+    parallel_for(static_cast<size_t>(tiles_x) * tiles_y, 1, [&](size_t begin, size_t end)
+    {
+        uint64_t local_rays = 0;
+        for (size_t tile = begin; tile < end; tile++)
+        {
+            const int x0 = static_cast<int>(tile % tiles_x) * tile_size;
+            const int y0 = static_cast<int>(tile / tiles_x) * tile_size;
+            for (int y = y0; y < std::min(y0 + tile_size, height); y++)
+            {
+                for (int x = x0; x < std::min(x0 + tile_size, width); x++)
+                {
+                    Random random{ hash(static_cast<uint32_t>(x) + hash(static_cast<uint32_t>(y) + hash(sample))) };
+
+                    /*
+                     * Jittered inside the pixel, so the average is also
+                     * antialiased.
+                     */
+                    const glm::vec2 ndc((x + random.next()) / width * 2.0f - 1.0f,
+                                        1.0f - (y + random.next()) / height * 2.0f);
+                    const glm::vec4 near = inverse_view_projection * glm::vec4(ndc, -1.0f, 1.0f);
+                    const glm::vec4 far = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+                    const glm::vec3 origin = glm::vec3(near) / near.w;
+                    const glm::vec3 direction = glm::normalize(glm::vec3(far) / far.w - origin);
+
+                    const size_t index = static_cast<size_t>(y) * width + x;
+                    glm::vec3& sum = s_accumulation[index];
+                    sum += radiance(make_ray(origin, direction), lighting, random, local_rays);
+                    s_pixels[index] = pack_color(sum * weight);
+                }
+            }
+        }
+        rays.fetch_add(local_rays, std::memory_order_relaxed);
+    });
+
+    s_stats.samples++;
+    s_stats.rays = rays.load(std::memory_order_relaxed);
+    s_stats.pass_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ImageView path_tracer_view(void)
+{
+    return ImageView
+    {
+        .pixels = reinterpret_cast<const uint8_t*>(s_pixels.data()),
+        .width = s_width,
+        .height = s_height,
+        .stride = static_cast<ptrdiff_t>(s_width) * 4
+    };
+}
+
+const PathTracerStats& path_tracer_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
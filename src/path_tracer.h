@@ -0,0 +1,62 @@
+#ifndef CG_PATH_TRACER
+#define CG_PATH_TRACER
+
+#include "image.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+struct PathTracerSettings
+{
+    bool enabled;           /* Shown in place of render_scene() by the application. */
+    float resolution_scale; /* Of the window. */
+    int max_bounces;        /* Diffuse bounces after the first hit. */
+};
+extern PathTracerSettings path_tracer_settings;
+
+struct PathTracerStats
+{
+    uint64_t samples;   /* Per pixel, accumulated since the last restart. */
+    uint64_t rays;      /* Camera, bounce and shadow rays of the last pass. */
+    double pass_ms;     /* Tracing only, without a BVH update. */
+    double build_ms;    /* Last update of the instances and their BVH. */
+    uint64_t builds;    /* Of the instances' BVH, since init. */
+    uint64_t refits;
+    size_t triangles;
+    size_t bvh_nodes;   /* The cube's and the instances'. */
+};
+
+/*
+ * Loads the texture. Needs no GL context.
+ */
+bool init_path_tracer(void);
+void cleanup_path_tracer(void);
+
+/*
+ * Between a successful init_path_tracer() and cleanup_path_tracer().
+ * Nothing else here may be called outside of that.
+ */
+bool path_tracer_available(void);
+
+/*
+ * Add one sample per pixel of the renderer's draw items, seen from
+ * cg::camera and lit by the renderer's light. Items are instances of one
+ * cube BVH under a BVH of their bounds, which is refitted when they move.
+ * Accumulation restarts when they, the camera, the light or the size
+ * change. Pixels are traced in 16 x 16 tiles on the job workers.
+ */
+void path_trace_pass(int width, int height);
+void restart_path_tracer(void);
+
+/*
+ * The running average, top row first.
+ */
+ImageView path_tracer_view(void);
+const PathTracerStats& path_tracer_stats(void);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef CG_POOL
+#define CG_POOL
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace cg
+{
+
+/*
+ * Fixed capacity object pool with an intrusive free list.
+ * Storage is part of the pool, so creating and destroying objects never
+ * touches the heap. Not thread safe.
+ */
+template <typename T, size_t Capacity>
+class Pool
+{
+public:
+    Pool(void)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+            m_next[i] = static_cast<uint32_t>(i + 1);
+    }
+
+    ~Pool(void)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            if (m_alive[i] == true)
+                get(i)->~T();
+        }
+    }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    /*
+     * Returns nullptr when the pool is full.
+     */
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        if (m_free == Capacity)
+            return nullptr;
+
+        const size_t index = m_free;
+        m_free = m_next[index];
+        m_alive[index] = true;
+        m_size++;
+        return new (&m_storage[index * sizeof(T)]) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        const size_t index = index_of(object);
+        object->~T();
+        m_alive[index] = false;
+        m_next[index] = static_cast<uint32_t>(m_free);
+        m_free = index;
+        m_size--;
+    }
+
+    size_t index_of(const T* object) const
+    {
+        return (reinterpret_cast<const std::byte*>(object) - m_storage) / sizeof(T);
+    }
+
+    /*
+     * Visit live objects in storage order.
+     */
+    template <typename F>
+    void for_each(const F& function)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            if (m_alive[i] == true)
+                function(*get(i));
+        }
+    }
+
+    size_t size(void) const { return m_size; }
+    static constexpr size_t capacity(void) { return Capacity; }
+
+private:
+    T* get(size_t index)
+    {
+        return std::launder(reinterpret_cast<T*>(&m_storage[index * sizeof(T)]));
+    }
+
+    alignas(T) std::byte m_storage[Capacity * sizeof(T)];
+    std::array<uint32_t, Capacity> m_next;
+    std::array<bool, Capacity> m_alive{};
+    size_t m_free = 0;
+    size_t m_size = 0;
+};
+
+} // namespace cg
+
+#endif
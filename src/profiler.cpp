@@ -0,0 +1,289 @@
+#include "profiler.h"
+#include "gpu_profiler.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * Zones per thread ring. Older zones are overwritten.
+ */
+constexpr size_t profile_buffer_size = 1 << 16;
+
+/*
+ * Atomic so the trace writer may read a slot while its thread overwrites
+ * it; relaxed accesses cost nothing over plain ones.
+ */
+struct ProfileZone
+{
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> begin;
+    std::atomic<uint64_t> end;
+};
+
+/*
+ * Written only by its thread. The write count is published with release
+ * order so the trace writer sees complete zones. The ring wraps while the
+ * writer reads it, so see write_trace() for which zones it can trust.
+ */
+struct ProfileBuffer
+{
+    std::array<ProfileZone, profile_buffer_size> zones;
+    std::atomic<uint64_t> count = 0;
+    uint32_t id = 0;
+    char name[32] = {};
+};
+
+static std::mutex s_buffers_mutex;
+static std::vector<std::unique_ptr<ProfileBuffer>> s_buffers;
+static thread_local ProfileBuffer* t_buffer = nullptr;
+
+/*
+ * Tick to nanosecond conversion. Calibrated against the steady clock
+ * between the first use and the time a trace is written.
+ */
+static uint64_t steady_ns(void)
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint64_t s_ticks_origin = profile_ticks();
+static const uint64_t s_steady_origin = steady_ns();
+
+/*
+ * Frame range being captured.
+ */
+static uint64_t s_frame = 0;
+static std::array<uint64_t, 1024> s_frame_ticks;
+static uint64_t s_capture_first = 0;
+static uint64_t s_capture_count = 0;
+static std::string s_capture_path;
+static bool s_capture_pending = false;
+
+static ProfileBuffer& thread_buffer(void)
+{
+    if (t_buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(s_buffers_mutex);
+        s_buffers.push_back(std::make_unique<ProfileBuffer>());
+        t_buffer = s_buffers.back().get();
+        t_buffer->id = static_cast<uint32_t>(s_buffers.size());
+        std::snprintf(t_buffer->name, sizeof(t_buffer->name), "Thread %u", t_buffer->id);
+    }
+    return *t_buffer;
+}
+
+void record_profile_zone(const char* name, uint64_t begin, uint64_t end)
+{
+    ProfileBuffer& buffer = thread_buffer();
+    const uint64_t count = buffer.count.load(std::memory_order_relaxed);
+    ProfileZone& zone = buffer.zones[count % profile_buffer_size];
+
+    /*
+     * Whoever sees any of the new zone also sees the count before it.
+     */
+    std::atomic_thread_fence(std::memory_order_release);
+    zone.name.store(name, std::memory_order_relaxed);
+    zone.begin.store(begin, std::memory_order_relaxed);
+    zone.end.store(end, std::memory_order_relaxed);
+    buffer.count.store(count + 1, std::memory_order_release);
+}
+
+void set_profiler_thread_name(const char* name)
+{
+    ProfileBuffer& buffer = thread_buffer();
+    std::snprintf(buffer.name, sizeof(buffer.name), "%s", name);
+}
+
+static void write_trace(void);
+
+void profiler_frame_mark(void)
+{
+    s_frame_ticks[s_frame % s_frame_ticks.size()] = profile_ticks();
+
+    /*
+     * GPU results trail the CPU by up to gpu_profiler_latency frames.
+     */
+    if (s_capture_pending == true &&
+        s_frame == s_capture_first + s_capture_count + gpu_profiler_latency + 1)
+    {
+        write_trace();
+        s_capture_pending = false;
+    }
+
+    s_frame++;
+}
+
+void capture_trace(uint64_t frame_count, const char* path)
+{
+    if (frame_count == 0 || frame_count >= s_frame_ticks.size() - gpu_profiler_latency - 2)
+        return;
+
+    s_capture_first = s_frame;
+    s_capture_count = frame_count;
+    s_capture_path = path;
+    s_capture_pending = true;
+}
+
+bool trace_capture_pending(void)
+{
+    return s_capture_pending;
+}
+
+/*
+ * Chrome trace event format. Times are microseconds.
+ */
+static void write_event(std::ofstream& out,
+                        bool& first,
+                        const char* name,
+                        uint32_t tid,
+                        double begin_us,
+                        double duration_us)
+{
+    out << (first == true ? "\n" : ",\n");
+    out << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+        << ",\"ts\":" << begin_us << ",\"dur\":" << duration_us << "}";
+    first = false;
+}
+
+static void write_thread_name(std::ofstream& out, bool& first, uint32_t tid, const char* name)
+{
+    out << (first == true ? "\n" : ",\n");
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+        << ",\"args\":{\"name\":\"" << name << "\"}}";
+    first = false;
+}
+
+static void write_trace(void)
+{
+    const uint64_t ticks_now = profile_ticks();
+    const uint64_t steady_now = steady_ns();
+    const double ns_per_tick = static_cast<double>(steady_now - s_steady_origin) /
+                               static_cast<double>(ticks_now - s_ticks_origin);
+
+    const auto to_us = [&](uint64_t ticks)
+    {
+        return (s_steady_origin + (static_cast<double>(ticks) - s_ticks_origin) * ns_per_tick) / 1000.0;
+    };
+
+    const uint64_t range_begin = s_frame_ticks[s_capture_first % s_frame_ticks.size()];
+    const uint64_t range_end =
+        s_frame_ticks[(s_capture_first + s_capture_count) % s_frame_ticks.size()];
+    const double range_begin_us = to_us(range_begin);
+    const double range_end_us = to_us(range_end);
+
+    std::ofstream out(s_capture_path);
+    if (out.good() == false)
+        return;
+
+    out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+
+    /*
+     * The other threads keep recording meanwhile. Zones in the range are
+     * copied up to the count published when the copy starts. A thread
+     * that wraps around its ring during the copy may have overwritten
+     * some of them, so the count is read again afterwards, and those it
+     * may have reached are dropped.
+     */
+    struct CopiedZone
+    {
+        uint64_t index;
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+    std::vector<CopiedZone> copied;
+
+    {
+        std::lock_guard<std::mutex> lock(s_buffers_mutex);
+        for (const auto& buffer : s_buffers)
+        {
+            write_thread_name(out, first, buffer->id, buffer->name);
+
+            const uint64_t count = buffer->count.load(std::memory_order_acquire);
+            const uint64_t oldest = count > profile_buffer_size ? count - profile_buffer_size : 0;
+            copied.clear();
+            for (uint64_t i = oldest; i < count; i++)
+            {
+                const ProfileZone& zone = buffer->zones[i % profile_buffer_size];
+                const uint64_t begin = zone.begin.load(std::memory_order_relaxed);
+                if (begin < range_begin || begin >= range_end)
+                    continue;
+
+                copied.push_back({ i, zone.name.load(std::memory_order_relaxed), begin,
+                                   zone.end.load(std::memory_order_relaxed) });
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t overwritten = buffer->count.load(std::memory_order_relaxed);
+            for (const CopiedZone& zone : copied)
+            {
+                if (zone.index + profile_buffer_size <= overwritten)
+                    continue;
+
+                const double begin = to_us(zone.begin);
+                write_event(out, first, zone.name, buffer->id, begin, to_us(zone.end) - begin);
+            }
+        }
+    }
+
+    /*
+     * GPU track. GPU timestamps are moved onto the steady clock with the
+     * offset measured by the GPU profiler.
+     */
+    constexpr uint32_t gpu_tid = 0;
+    write_thread_name(out, first, gpu_tid, "GPU");
+    const double offset_us = gpu_clock_offset_ns() / 1000.0;
+
+    for (size_t i = 0; i < gpu_history_size(); i++)
+    {
+        const GpuFrameResult& frame = gpu_history(i);
+        if (frame.zone_count == 0)
+            continue;
+
+        const double origin_us = frame.origin_ns / 1000.0 + offset_us;
+        if (origin_us < range_begin_us || origin_us >= range_end_us)
+            continue;
+
+        for (size_t z = 0; z < frame.zone_count; z++)
+        {
+            const GpuZoneResult& zone = frame.zones[z];
+            write_event(out,
+                        first,
+                        zone.name,
+                        gpu_tid,
+                        origin_us + zone.begin_ms * 1000.0,
+                        zone.ms * 1000.0);
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+double measure_profile_overhead_ns(void)
+{
+    constexpr int iterations = 10000;
+
+    const uint64_t start = steady_ns();
+    for (int i = 0; i < iterations; i++)
+    {
+        ProfileScope scope("overhead");
+    }
+    const uint64_t elapsed = steady_ns() - start;
+
+    return static_cast<double>(elapsed) / iterations;
+}
+
+} // namespace cg
@@ -0,0 +1,102 @@
+#ifndef CG_PROFILER
+#define CG_PROFILER
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/*
+ * Scoped CPU zones. Build with CG_PROFILE=0 to compile them out.
+ */
+#ifndef CG_PROFILE
+#define CG_PROFILE 1
+#endif
+
+#define CG_PROFILE_CONCAT_IMPL(a, b) a##b
+#define CG_PROFILE_CONCAT(a, b) CG_PROFILE_CONCAT_IMPL(a, b)
+
+#if CG_PROFILE
+#define CG_PROFILE_SCOPE(name) \
+    ::cg::ProfileScope CG_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define CG_PROFILE_SCOPE(name)
+#endif
+
+namespace cg
+{
+
+/*
+ * Raw timestamp. The TSC on x86, the steady clock in nanoseconds elsewhere.
+ * Converted to nanoseconds only when a trace is written.
+ */
+inline uint64_t profile_ticks(void)
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*
+ * Append a finished zone to the calling thread's buffer.
+ * Lock free; every thread writes only to its own ring.
+ */
+void record_profile_zone(const char* name, uint64_t begin, uint64_t end);
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : m_name(name), m_begin(profile_ticks())
+    {
+    }
+
+    ~ProfileScope(void)
+    {
+        record_profile_zone(m_name, m_begin, profile_ticks());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+/*
+ * Name shown for the calling thread in traces. Copied.
+ */
+void set_profiler_thread_name(const char* name);
+
+/*
+ * Call at the start of every frame on the main thread.
+ */
+void profiler_frame_mark(void);
+
+/*
+ * Write the next frame_count frames to path as Chrome trace event JSON,
+ * loadable in chrome://tracing and Perfetto. GPU zones from the GPU profiler
+ * are merged in on their own track. The file is written a few frames after
+ * the range ends, once the GPU results are in.
+ */
+void capture_trace(uint64_t frame_count, const char* path);
+bool trace_capture_pending(void);
+
+/*
+ * Average cost of one zone in nanoseconds, measured on the calling thread.
+ * Records its own zones, so do not call it while a capture is running.
+ */
+double measure_profile_overhead_ns(void);
+
+} // namespace cg
+
+#endif
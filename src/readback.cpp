@@ -0,0 +1,120 @@
+#include "glad/glad.h"
+
+#include "readback.h"
+#include "gl_debug.h"
+
+namespace cg
+{
+
+ReadbackRing::ReadbackRing(int width, int height, size_t slot_count)
+    : m_slots(std::make_unique<Slot[]>(slot_count)),
+      m_slot_count(slot_count),
+      m_width(width),
+      m_height(height)
+{
+    const GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        Slot& slot = m_slots[i];
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+        slot.mapped = static_cast<const uint8_t*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags));
+        label_gl_object(GL_BUFFER, slot.buffer, "readback");
+
+        /*
+         * Bottom-up rows, presented top-down.
+         */
+        const ptrdiff_t stride = static_cast<ptrdiff_t>(width) * 4;
+        slot.frame.view =
+        {
+            .pixels = slot.mapped + stride * (height - 1),
+            .width = width,
+            .height = height,
+            .stride = -stride
+        };
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+ReadbackRing::~ReadbackRing(void)
+{
+    for (size_t i = 0; i < m_slot_count; i++)
+    {
+        Slot& slot = m_slots[i];
+        if (slot.fence != nullptr)
+            glDeleteSync(static_cast<GLsync>(slot.fence));
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool ReadbackRing::capture(const RenderTarget& target, uint64_t tag)
+{
+    if (target.width != m_width || target.height != m_height)
+        return false;
+
+    Slot& slot = m_slots[m_captured % m_slot_count];
+    if (slot.state.load(std::memory_order_acquire) != SlotState::free)
+        return false;
+
+    /*
+     * With a pack buffer bound glReadPixels only records a copy into it.
+     */
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame.tag = tag;
+    slot.state.store(SlotState::pending, std::memory_order_relaxed);
+    m_captured++;
+    return true;
+}
+
+const ReadbackFrame* ReadbackRing::acquire(bool wait)
+{
+    if (m_acquired == m_captured)
+        return nullptr;
+
+    Slot& slot = m_slots[m_acquired % m_slot_count];
+    const GLsync fence = static_cast<GLsync>(slot.fence);
+
+    /*
+     * Flush on the first check so the fence is guaranteed to signal.
+     */
+    const GLuint64 timeout = wait == true ? UINT64_MAX : 0;
+    const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return nullptr;
+
+    glDeleteSync(fence);
+    slot.fence = nullptr;
+    slot.state.store(SlotState::acquired, std::memory_order_relaxed);
+    m_acquired++;
+    return &slot.frame;
+}
+
+void ReadbackRing::release(const ReadbackFrame* frame)
+{
+    for (size_t i = 0; i < m_slot_count; i++)
+    {
+        if (&m_slots[i].frame == frame)
+        {
+            m_slots[i].state.store(SlotState::free, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+} // namespace cg
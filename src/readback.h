@@ -0,0 +1,86 @@
+#ifndef CG_READBACK
+#define CG_READBACK
+
+#include "image.h"
+#include "render_target.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace cg
+{
+
+/*
+ * A frame read back from the GPU. Rows are stored bottom-up as GL returns
+ * them; view is set up to read top-down.
+ */
+struct ReadbackFrame
+{
+    ImageView view;
+    uint64_t tag;
+};
+
+/*
+ * Asynchronous readback of a RenderTarget through a ring of pixel buffer
+ * objects. capture() only queues the copy and a fence; the CPU never waits
+ * for the GPU unless acquire() is asked to. Buffers are persistently
+ * mapped, so acquired frames can be read directly on any thread until
+ * they are released.
+ *
+ * capture() and acquire() must be called on the GL thread. release() may
+ * be called from any thread.
+ */
+class ReadbackRing
+{
+public:
+    ReadbackRing(int width, int height, size_t slot_count);
+    ~ReadbackRing(void);
+
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+    /*
+     * Queue a copy of the target's color attachment. Returns false when
+     * every slot is still pending or acquired.
+     */
+    bool capture(const RenderTarget& target, uint64_t tag);
+
+    /*
+     * The oldest captured frame, once the GPU has finished writing it.
+     * nullptr if there is none, or it is not ready and wait is false.
+     */
+    const ReadbackFrame* acquire(bool wait);
+    void release(const ReadbackFrame* frame);
+
+    size_t pending(void) const { return m_captured - m_acquired; }
+
+private:
+    enum class SlotState : uint32_t
+    {
+        free,
+        pending,
+        acquired
+    };
+
+    struct Slot
+    {
+        unsigned int buffer = 0;
+        void* fence = nullptr;
+        const uint8_t* mapped = nullptr;
+        ReadbackFrame frame{};
+        std::atomic<SlotState> state = SlotState::free;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_slot_count;
+    size_t m_captured = 0;
+    size_t m_acquired = 0;
+    int m_width;
+    int m_height;
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,75 @@
+#include "glad/glad.h"
+
+#include "render_target.h"
+#include "gl_debug.h"
+
+#include <iostream>
+
+namespace cg
+{
+
+RenderTarget create_render_target(int width, int height, const char* label)
+{
+    RenderTarget target{};
+    target.width = width;
+    target.height = height;
+
+    glGenTextures(1, &target.color);
+    glBindTexture(GL_TEXTURE_2D, target.color);
+    /*
+     * Immutable storage is 4.2; before that the same single level.
+     */
+    if (GLAD_GL_VERSION_4_2 != 0)
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &target.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Render target incomplete: " << status << std::endl;
+        destroy_render_target(target);
+        return target;
+    }
+
+    label_gl_object(GL_FRAMEBUFFER, target.framebuffer, label);
+    label_gl_object(GL_TEXTURE, target.color, label);
+    label_gl_object(GL_RENDERBUFFER, target.depth, label);
+    return target;
+}
+
+void destroy_render_target(RenderTarget& target)
+{
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.depth);
+    glDeleteTextures(1, &target.color);
+    target.framebuffer = 0;
+    target.depth = 0;
+    target.color = 0;
+}
+
+void bind_render_target(const RenderTarget& target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+}
+
+} // namespace cg
@@ -0,0 +1,33 @@
+#ifndef CG_RENDER_TARGET
+#define CG_RENDER_TARGET
+
+namespace cg
+{
+
+/*
+ * Framebuffer with an RGBA8 color texture and a depth renderbuffer.
+ * For rendering without a window and for passes that are read back.
+ */
+struct RenderTarget
+{
+    unsigned int framebuffer;
+    unsigned int color;
+    unsigned int depth;
+    int width;
+    int height;
+};
+
+/*
+ * Returns a target with framebuffer 0 if it is incomplete.
+ */
+RenderTarget create_render_target(int width, int height, const char* label);
+void destroy_render_target(RenderTarget& target);
+
+/*
+ * Bind for drawing and set the viewport to cover it.
+ */
+void bind_render_target(const RenderTarget& target);
+
+} // namespace cg
+
+#endif
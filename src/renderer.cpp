@@ -0,0 +1,910 @@
+#include "glad/glad.h"
+
+#include "renderer.h"
+#include "structs.h"
+#include "clustered.h"
+#include "command_list.h"
+#include "deferred.h"
+#include "depth_prepass.h"
+#include "frame_arena.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "jobs.h"
+#include "lights.h"
+#include "mesh_lod.h"
+#include "occlusion.h"
+#include "pool.h"
+#include "profiler.h"
+#include "shadows.h"
+#include "transparency.h"
+#include "vendor/stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+namespace cg
+{
+
+/*
+ * Lets the uniform cache be searched with a string_view, so looking up a
+ * literal does not build a std::string.
+ */
+struct StringHash
+{
+    using is_transparent = void;
+
+    size_t operator()(std::string_view string) const
+    {
+        return std::hash<std::string_view>{}(string);
+    }
+};
+
+using UniformCache = std::unordered_map<std::string, int, StringHash, std::equal_to<>>;
+
+static std::unordered_map<unsigned int, UniformCache> s_uniform_locations;
+static unsigned int s_program = 0;
+static unsigned int s_lit_program = 0; /* With shadow_settings.enabled. */
+static unsigned int s_forward_program = 0; /* LightingPath::forward. */
+static unsigned int s_vbo = 0;
+static unsigned int s_vao = 0;
+static unsigned int s_texture = 0;
+static Pool<DrawItem, max_draw_items> s_draw_items;
+static RenderStats s_stats{};
+static RendererFeatures s_features{};
+
+static glm::vec3 s_light_pos = glm::vec3(1.0f, 1.0f, 2.0f);
+static glm::vec3 s_light_color = glm::vec3(1.0f); /* White light */
+static bool s_light_dirty = true;
+
+/*
+ * Part of the view the projection covers, as left, right, bottom, top in
+ * normalised device coordinates of the full frustum.
+ */
+static glm::vec4 s_projection_window = glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+
+/*
+ * Read shader from file.
+ */
+static std::optional<std::string> read_shader(const std::string& path)
+{
+    std::string result;
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (in.good() == false)
+        return std::nullopt;
+
+    in.seekg(0, std::ios::end);
+    size_t size = in.tellg();
+
+    if (size == -1)
+        return std::nullopt;
+
+    result.resize(size);
+    in.seekg(0, std::ios::beg);
+    in.read(&result[0], size);
+
+    /*
+     * The shaders ask for 4.6 but use nothing past 4.5. Software renderers
+     * such as llvmpipe stop at 4.5, so lower the directive to match.
+     */
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    const size_t directive = result.find("#version 460");
+    if (directive != std::string::npos && major * 10 + minor < 46 && major * 10 + minor >= 33)
+    {
+        const std::string version = std::to_string(major * 100 + minor * 10);
+        result.replace(directive + 9, 3, version);
+    }
+
+    return result;
+}
+
+/*
+ * Compile shader.
+ * Copy the shader source string here just in case.
+ * c_str will point to garbage if a string reference goes out of scope.
+ */
+static unsigned int compile_shader(const std::string shader_source,
+                                   unsigned int type)
+{
+    unsigned int shader = glCreateShader(type);
+
+    const char* c_str = shader_source.c_str();
+    glShaderSource(shader, 1, &c_str, nullptr);
+
+    glCompileShader(shader);
+
+    /*
+     * Compile error checking.
+     */
+    int is_compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
+    if (is_compiled == 0)
+    {
+        std::string log;
+        int length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        log.resize(length);
+        glGetShaderInfoLog(shader, length, nullptr, &log[0]);
+
+        std::string type_s = type == GL_VERTEX_SHADER   ? "vertex"
+                           : type == GL_COMPUTE_SHADER ? "compute"
+                                                       : "fragment";
+        std::cerr << "Failed to compile " << type_s << " shader." << std::endl;
+        std::cerr << log << std::endl;
+
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+/*
+ * Compile and link shader program.
+ */
+static unsigned int create_shader(const std::string& vertex_source,
+                                  const std::string& fragment_source)
+{
+    unsigned int program = glCreateProgram();
+    unsigned int vertex_shader = compile_shader(vertex_source, GL_VERTEX_SHADER);
+    if (vertex_shader == 0)
+        return 0;
+    unsigned int fragment_shader = compile_shader(fragment_source, GL_FRAGMENT_SHADER);
+    if (fragment_shader == 0)
+        return 0;
+
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glValidateProgram(program);
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    glDetachShader(program, vertex_shader);
+    glDetachShader(program, fragment_shader);
+
+    return program;
+}
+
+int get_uniform_location(unsigned int program, std::string_view location)
+{
+    UniformCache& cache = s_uniform_locations[program];
+    const auto cached = cache.find(location);
+    if (cached != cache.end())
+        return cached->second;
+
+    const std::string name(location);
+    int uniform = glGetUniformLocation(program, name.c_str());
+    if (uniform == -1)
+        std::cout << "Warning: Uniform " << name <<
+        " does not exist. This uniform will not be set." << std::endl;
+
+    cache.emplace(name, uniform);
+    return uniform;
+}
+
+static void set_vec3(unsigned int program,
+                     const glm::vec3& vector,
+                     std::string_view location)
+{
+    int uniform = get_uniform_location(program, location);
+    if (uniform == -1)
+        return;
+    glUniform3fv(uniform, 1, glm::value_ptr(vector));
+}
+
+static void set_matrix(unsigned int program,
+                       const glm::mat4& matrix,
+                       std::string_view location)
+{
+    int uniform = get_uniform_location(program, location);
+    if (uniform == -1)
+        return;
+    glUniformMatrix4fv(uniform, 1, false, glm::value_ptr(matrix));
+}
+
+/*
+ * Set view matrix uniform.
+ */
+static void set_view(unsigned int program)
+{
+    set_matrix(program, view_matrix(), "u_view");
+    set_vec3(program, camera.eye, "u_view_pos");
+}
+
+/*
+ * Set projection matrix uniform.
+ */
+static void set_projection(unsigned int program)
+{
+    set_matrix(program, projection_matrix(), "u_projection");
+}
+
+/*
+ * Set light position.
+ */
+static void set_light_pos(unsigned int program)
+{
+    set_vec3(program, s_light_pos, "u_light_pos");
+}
+
+/*
+ * Set light color.
+ */
+static void set_light_color(unsigned int program)
+{
+    set_vec3(program, s_light_color, "u_light_color");
+}
+
+/*
+ * Cube.
+ */
+static constexpr std::array<float, cube_vertex_count * 8> cube_vertex_data =
+{
+    /* Position            Normal                Texture Coords */
+    /* Front face */
+    -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 1.0f,
+
+     0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f, 0.0f,
+
+    /* Back face */
+    -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 1.0f,
+
+     0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f, 0.0f,
+
+    /* Left face */
+    -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
+
+    -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
+
+    /* Right face */
+     0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
+
+     0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f, 1.0f,
+     0.5f, -0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 1.0f,
+     0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f, 0.0f,
+
+    /* Top face */
+    -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 0.0f,
+     0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 0.0f,
+     0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 1.0f,
+
+     0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f, 0.0f,
+
+    /* Bottom face */
+    -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 0.0f,
+     0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 0.0f,
+     0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 1.0f,
+
+     0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f, 0.0f
+};
+
+/*
+ * Vertex buffer object.
+ * Uploads draw data to GPU memory.
+ */
+static unsigned int init_vbo(void)
+{
+    unsigned int vbo = 0;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertex_data), cube_vertex_data.data(), GL_STATIC_DRAW);
+    label_gl_object(GL_BUFFER, vbo, "cube vertices");
+
+    return vbo;
+}
+
+/*
+ * Vertex array object.
+ * Specifies the format of the draw data.
+ */
+static unsigned int init_vao(void)
+{
+    unsigned int vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    /*
+     * Position attribute.
+     */
+    glVertexAttribPointer(0, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    /*
+     * Normal attribute.
+     */
+    glVertexAttribPointer(1, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    /*
+     * Texture coordinate attribute.
+     */
+    glVertexAttribPointer(2, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    label_gl_object(GL_VERTEX_ARRAY, vao, "cube");
+    return vao;
+}
+
+/*
+ * Load and bind texture image.
+ */
+static unsigned int init_texture(const std::string& path)
+{
+    int texture_width = 0;
+    int texture_height= 0;
+    int texture_bpp = 0;
+
+    stbi_set_flip_vertically_on_load(1);
+
+    unsigned char* texture_data = stbi_load(path.c_str(),
+                                            &texture_width,
+                                            &texture_height,
+                                            &texture_bpp,
+                                            4);
+
+    if (texture_data == nullptr)
+    {
+        std::cerr << "Failed to load texture." << std::endl;
+        return 0;
+    }
+
+    unsigned int texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    /*
+     * Texture wrapping and filtering.
+     * Required.
+     */
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_RGBA8,
+                 texture_width,
+                 texture_height,
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 texture_data);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+    label_gl_object(GL_TEXTURE, texture, path.c_str());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    stbi_image_free(texture_data);
+    return texture;
+}
+
+/*
+ * Shader setup.
+ */
+unsigned int load_program(const std::string& vertex_path, const std::string& fragment_path)
+{
+    const auto vertex_source = read_shader(vertex_path);
+    const auto fragment_source = read_shader(fragment_path);
+    if (vertex_source.has_value() == false ||
+        fragment_source.has_value() == false)
+    {
+        std::cerr << "Failed to read shaders." << std::endl;
+        return 0;
+    }
+
+    unsigned int program = create_shader(vertex_source.value(),
+                                         fragment_source.value());
+    if (program != 0)
+        label_gl_object(GL_PROGRAM, program, fragment_path.c_str());
+
+    return program;
+}
+
+unsigned int load_compute_program(const std::string& compute_path)
+{
+    const auto compute_source = read_shader(compute_path);
+    if (compute_source.has_value() == false)
+    {
+        std::cerr << "Failed to read shader " << compute_path << "." << std::endl;
+        return 0;
+    }
+
+    const unsigned int shader = compile_shader(compute_source.value(), GL_COMPUTE_SHADER);
+    if (shader == 0)
+        return 0;
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+
+    int is_linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (is_linked == 0)
+    {
+        std::cerr << "Failed to link " << compute_path << "." << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    label_gl_object(GL_PROGRAM, program, compute_path.c_str());
+    return program;
+}
+
+bool init_renderer(void)
+{
+    /*
+     * Enable z-buffer and multisampling.
+     */
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_MULTISAMPLE);
+
+    /*
+     * Blending. For transparency.
+     */
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_BLEND);
+
+    s_vbo = init_vbo();
+    s_vao = init_vao();
+    s_texture = init_texture("resources/textures/tu_white.png");
+    if (s_texture == 0)
+        return false;
+
+    s_program = load_program("resources/shaders/tex_v.glsl", "resources/shaders/tex_f.glsl");
+    if (s_program == 0)
+    {
+        std::cerr << "Failed to compile shaders." << std::endl;
+        return false;
+    }
+
+    /*
+     * Without shadows, shadow_settings.enabled is ignored.
+     */
+    s_features.shadows = init_shadows() == true;
+    if (s_features.shadows == true)
+    {
+        s_lit_program = load_program("resources/shaders/phong_shadow_v.glsl", "resources/shaders/phong_shadow_f.glsl");
+        s_features.shadows = s_lit_program != 0;
+    }
+    if (s_features.shadows == false)
+        std::cerr << "Failed to set up shadows, drawing without them." << std::endl;
+
+    /*
+     * The point light paths are optional. Without them, every path falls
+     * back to the single light, see available_path().
+     */
+    s_features.point_lights = init_lights() == true;
+    if (s_features.point_lights == true)
+    {
+        s_forward_program = load_program("resources/shaders/phong_v.glsl", "resources/shaders/lights_forward_f.glsl");
+        s_features.point_lights = s_forward_program != 0;
+    }
+    s_features.deferred = s_features.point_lights == true && init_deferred() == true;
+    s_features.clustered = s_features.point_lights == true && init_clusters() == true;
+    if (s_features.point_lights == false)
+        std::cerr << "Point lights are unavailable, they need OpenGL 4.3." << std::endl;
+    else if (s_features.deferred == false || s_features.clustered == false)
+        std::cerr << "Failed to set up the deferred or clustered path." << std::endl;
+
+    s_features.transparency = init_transparency() == true;
+    s_features.weighted_oit = s_features.transparency == true && weighted_oit_supported() == true;
+    if (s_features.transparency == false)
+        std::cerr << "Failed to set up transparency, drawing without the transparent cubes." << std::endl;
+    else if (s_features.weighted_oit == false)
+        std::cerr << "Failed to set up weighted blended OIT, drawing sorted." << std::endl;
+
+    s_features.depth_prepass = init_depth_prepass() == true;
+    if (s_features.depth_prepass == false)
+    {
+        std::cerr << "Failed to set up the depth pre-pass, drawing without it." << std::endl;
+        depth_prepass_settings.mode = DepthPrepassMode::off;
+        depth_prepass_settings.show_overdraw = false;
+    }
+
+    s_features.lod = init_mesh_lod() == true;
+    if (s_features.lod == false)
+    {
+        std::cerr << "Failed to build the levels of detail, drawing the plain cube." << std::endl;
+        lod_settings.enabled = false;
+    }
+
+    s_light_dirty = true;
+    return true;
+}
+
+const RendererFeatures& renderer_features(void)
+{
+    return s_features;
+}
+
+void cleanup_renderer(void)
+{
+    destroy_all_draw_items();
+    cleanup_shadows();
+    cleanup_deferred();
+    cleanup_clusters();
+    cleanup_lights();
+    cleanup_transparency();
+    cleanup_depth_prepass();
+    cleanup_mesh_lod();
+    s_uniform_locations.clear();
+
+    glDeleteProgram(s_program);
+    glDeleteProgram(s_lit_program);
+    glDeleteProgram(s_forward_program);
+    glDeleteTextures(1, &s_texture);
+    glDeleteVertexArrays(1, &s_vao);
+    glDeleteBuffers(1, &s_vbo);
+    s_program = 0;
+    s_lit_program = 0;
+    s_forward_program = 0;
+    s_texture = 0;
+    s_vao = 0;
+    s_vbo = 0;
+    s_features = {};
+}
+
+DrawItem* create_draw_item(const glm::mat4& model)
+{
+    return s_draw_items.create(DrawItem{ .model = model, .lod = 0 });
+}
+
+void destroy_draw_item(DrawItem* item)
+{
+    s_draw_items.destroy(item);
+}
+
+void destroy_all_draw_items(void)
+{
+    s_draw_items.for_each([](DrawItem& item) { s_draw_items.destroy(&item); });
+}
+
+size_t draw_item_count(void)
+{
+    return s_draw_items.size();
+}
+
+size_t gather_draw_items(const DrawItem** items, size_t capacity)
+{
+    size_t count = 0;
+    s_draw_items.for_each([&](const DrawItem& item)
+    {
+        if (count < capacity)
+            items[count++] = &item;
+    });
+    return count;
+}
+
+const float* cube_vertices(void)
+{
+    return cube_vertex_data.data();
+}
+
+glm::vec3 light_position(void)
+{
+    return s_light_pos;
+}
+
+glm::vec3 light_color(void)
+{
+    return s_light_color;
+}
+
+void set_light(const glm::vec3& position, const glm::vec3& color)
+{
+    s_light_pos = position;
+    s_light_color = color;
+    s_light_dirty = true;
+}
+
+glm::mat4 view_matrix(void)
+{
+    return glm::lookAt(camera.eye, camera.center, camera.up);
+}
+
+glm::mat4 projection_matrix(void)
+{
+    glm::mat4 projection = glm::perspective(perspective.fov,
+                                            perspective.aspect,
+                                            perspective.z_near,
+                                            perspective.z_far);
+
+    /*
+     * An off-centre part of the same frustum.
+     */
+    if (s_projection_window != glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f))
+    {
+        const float top = perspective.z_near * std::tan(perspective.fov * 0.5f);
+        const float right = top * perspective.aspect;
+        projection = glm::frustum(right * s_projection_window.x,
+                                  right * s_projection_window.y,
+                                  top * s_projection_window.z,
+                                  top * s_projection_window.w,
+                                  perspective.z_near,
+                                  perspective.z_far);
+    }
+
+    return projection;
+}
+
+void set_projection_window(const glm::vec4& window)
+{
+    s_projection_window = window;
+}
+
+void reset_projection_window(void)
+{
+    s_projection_window = glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
+}
+
+void clear_frame(void)
+{
+    CG_PROFILE_SCOPE("clear");
+    GpuZone zone("clear");
+
+    glClearColor(clear_color.x * clear_color.w,
+                 clear_color.y * clear_color.w,
+                 clear_color.z * clear_color.w,
+                 clear_color.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/*
+ * Of the mesh record_item_draw() draws.
+ */
+static unsigned int item_vertex_array(void)
+{
+    return lod_settings.enabled == true ? lod_vertex_array() : s_vao;
+}
+
+/*
+ * The path of lighting_settings, or the nearest the context supports.
+ */
+static LightingPath available_path(void)
+{
+    LightingPath path = lighting_settings.path;
+    if ((path == LightingPath::deferred && s_features.deferred == false) ||
+        (path == LightingPath::clustered && s_features.clustered == false))
+        path = LightingPath::forward;
+    if (path == LightingPath::forward && s_features.point_lights == false)
+        path = LightingPath::single;
+    return path;
+}
+
+/*
+ * One draw per item, recorded into command lists on the worker threads.
+ */
+static CommandList* record_draws(const DrawItem* const* items,
+                                 size_t item_count,
+                                 unsigned int program,
+                                 unsigned int vertex_array,
+                                 size_t& list_count)
+{
+    const int model_location = get_uniform_location(program, "u_model");
+    list_count = (item_count + draws_per_command_list - 1) / draws_per_command_list;
+    CommandList* lists = frame_allocate<CommandList>(list_count);
+
+    parallel_for(list_count, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            CommandList& list = *new (&lists[i]) CommandList(command_allocator());
+            list.bind_program(program);
+            list.bind_vertex_array(vertex_array);
+            list.bind_texture(0, s_texture);
+
+            const size_t first = i * draws_per_command_list;
+            const size_t last = std::min(first + draws_per_command_list, item_count);
+            for (size_t item = first; item < last; item++)
+            {
+                list.set_mat4(model_location, items[item]->model);
+                record_item_draw(list, *items[item]);
+            }
+        }
+    });
+
+    return lists;
+}
+
+/*
+ * Draw items are recorded into command lists on the worker threads and
+ * replayed here, on the thread that owns the GL context.
+ */
+void render_scene(void)
+{
+    CG_PROFILE_SCOPE("render");
+    reset_command_allocators();
+
+    /*
+     * Per frame arrays live in the frame arena. Levels of detail are
+     * picked for every item, hidden or not, so shadows match.
+     */
+    if (lod_settings.enabled == true && (s_features.lod == false || prepare_mesh_lod() == false))
+    {
+        if (s_features.lod == true)
+            std::cerr << "Failed to build the levels of detail, drawing the plain cube." << std::endl;
+        s_features.lod = false;
+        lod_settings.enabled = false;
+    }
+    const bool lod = lod_settings.enabled;
+    if (lod == true)
+        begin_lod_selection();
+    const DrawItem** items = frame_allocate<const DrawItem*>(s_draw_items.size());
+    size_t item_count = 0;
+    s_draw_items.for_each([&](DrawItem& item)
+    {
+        if (lod == true)
+            select_lod(item);
+        items[item_count++] = &item;
+    });
+
+    /*
+     * Before occlusion culling: hidden items still cast shadows, and the
+     * lights and transparent cubes fill the box around all of them.
+     */
+    const bool show_overdraw = depth_prepass_settings.show_overdraw == true && s_features.depth_prepass == true;
+    const LightingPath selected_path = available_path();
+    const LightingPath path = show_overdraw == true ? LightingPath::single : selected_path;
+    const bool shadows_enabled = shadow_settings.enabled == true && s_features.shadows == true;
+    const bool shadows = path == LightingPath::single && shadows_enabled == true && show_overdraw == false;
+    if (shadows == true)
+        render_shadow_maps(items, item_count, item_vertex_array());
+    if (path != LightingPath::single)
+        update_lights(items, item_count);
+    if (s_features.transparency == true)
+        update_transparent_objects(items, item_count);
+
+    GpuZone zone("scene");
+    unsigned int program = shadows == true ? s_lit_program : s_program;
+    if (path == LightingPath::forward)
+        program = s_forward_program;
+    else if (path == LightingPath::deferred)
+    {
+        begin_deferred();
+        program = deferred_geometry_program();
+    }
+    else if (path == LightingPath::clustered)
+    {
+        assign_light_clusters();
+        program = clustered_program();
+    }
+    else if (show_overdraw == true)
+    {
+        program = overdraw_program();
+    }
+
+    /*
+     * Camera uniforms change every frame, the light rarely.
+     */
+    glUseProgram(program);
+    set_view(program);
+    set_projection(program);
+    if (shadows == true)
+    {
+        bind_shadow_maps(program);
+    }
+    else if (path == LightingPath::forward)
+    {
+        bind_lights(program);
+    }
+    else if (path == LightingPath::clustered)
+    {
+        bind_light_clusters(program);
+    }
+    else if (program == s_program && s_light_dirty == true)
+    {
+        set_light_pos(s_program);
+        set_light_color(s_program);
+        s_light_dirty = false;
+    }
+
+    if (occlusion_settings.enabled == true)
+        item_count = cull_occluded_items(items, item_count, projection_matrix() * view_matrix());
+
+    /*
+     * Depth first, so the shading pass runs once per pixel: GL_EQUAL
+     * passes only the nearest fragment, and the depth is already there.
+     */
+    const bool lit = selected_path != LightingPath::single || shadows_enabled == true;
+    const bool prepass = s_features.depth_prepass == true && path != LightingPath::deferred &&
+                         use_depth_prepass(s_draw_items.size(), lit);
+    size_t prepass_list_count = 0;
+    if (prepass == true)
+    {
+        GpuZone prepass_zone("depth pre-pass");
+        const unsigned int depth_program = depth_prepass_program();
+        glUseProgram(depth_program);
+        set_matrix(depth_program, view_matrix(), "u_view");
+        set_projection(depth_program);
+
+        const unsigned int prepass_vertex_array = lod == true ? lod_vertex_array() : depth_prepass_vertex_array();
+        CommandList* prepass_lists = record_draws(items, item_count, depth_program,
+                                                  prepass_vertex_array, prepass_list_count);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        submit_commands(prepass_lists, prepass_list_count);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    /*
+     * Every shaded fragment adds up over black.
+     */
+    if (show_overdraw == true)
+    {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+
+    size_t list_count = 0;
+    const unsigned int vertex_array = show_overdraw == true && lod == false ? depth_prepass_vertex_array()
+                                                                            : item_vertex_array();
+    CommandList* lists = record_draws(items, item_count, program, vertex_array, list_count);
+    begin_shading_pass(prepass);
+    submit_commands(lists, list_count);
+    end_shading_pass();
+
+    if (prepass == true)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    if (show_overdraw == true)
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (path == LightingPath::deferred)
+        resolve_deferred();
+    if (show_overdraw == false && s_features.transparency == true)
+        render_transparent_objects(s_vao);
+
+    uint64_t triangles = 0;
+    for (size_t i = 0; i < item_count; i++)
+        triangles += item_triangles(*items[i]);
+
+    const size_t passes = prepass == true ? 2 : 1;
+    s_stats =
+    {
+        .draw_calls = item_count * passes,
+        .triangles = triangles * passes,
+        .command_lists = list_count + prepass_list_count
+    };
+}
+
+const RenderStats& last_render_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
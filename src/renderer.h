@@ -0,0 +1,126 @@
+#ifndef CG_RENDERER
+#define CG_RENDERER
+
+#include "glm/ext.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cg
+{
+
+constexpr auto clear_color = glm::vec4(0.45f, 0.55f, 0.60f, 0.90f);
+
+/*
+ * Draw calls are recorded into command lists of this many objects each.
+ */
+constexpr size_t draws_per_command_list = 256;
+constexpr size_t max_draw_items = 4096;
+
+/*
+ * Something to draw every frame. Owned by the renderer's pool.
+ */
+struct DrawItem
+{
+    glm::mat4 model;
+    uint8_t lod; /* Level of detail picked last, see select_lod(). */
+};
+
+/*
+ * What the last render_scene() submitted. Counted by the renderer itself,
+ * so it is also available without CG_GL_COUNTERS_ENABLED.
+ */
+struct RenderStats
+{
+    uint64_t draw_calls;
+    uint64_t triangles;
+    uint64_t command_lists;
+};
+
+/*
+ * Parts of the renderer that could be set up. Those that need more than
+ * OpenGL 3.3, or fail to set up, are left out, and render_scene() draws
+ * without them.
+ */
+struct RendererFeatures
+{
+    bool shadows;       /* Phong with cascaded shadow maps; depth texture arrays, 4.2. */
+    bool point_lights;  /* The forward path; shader storage buffers, 4.3. */
+    bool deferred;      /* Compute shaders, 4.3. */
+    bool clustered;     /* Compute shaders, 4.3. */
+    bool transparency;  /* The transparent cubes; shader storage buffers, 4.3. */
+    bool weighted_oit;  /* Else TransparencyMode::weighted draws sorted. */
+    bool depth_prepass; /* Also the overdraw view. */
+    bool lod;           /* Cleared when building the levels of detail fails. */
+};
+
+/*
+ * Shared by the application and the headless tools. Needs a current
+ * context with GL loaded. Returns false if the scene resources are missing.
+ */
+bool init_renderer(void);
+void cleanup_renderer(void);
+const RendererFeatures& renderer_features(void);
+
+DrawItem* create_draw_item(const glm::mat4& model);
+void destroy_draw_item(DrawItem* item);
+void destroy_all_draw_items(void);
+size_t draw_item_count(void);
+
+/*
+ * The scene as submitted, for backends other than GL. Items are written in
+ * the order render_scene() draws them; returns how many, at most capacity.
+ */
+size_t gather_draw_items(const DrawItem** items, size_t capacity);
+
+/*
+ * The mesh every draw item uses: position, normal and texture coordinate,
+ * 8 floats per vertex, as separate triangles.
+ */
+constexpr size_t cube_vertex_count = 36;
+const float* cube_vertices(void);
+
+/*
+ * Clear color and depth of the bound framebuffer.
+ */
+void clear_frame(void);
+
+/*
+ * Draw every item from cg::camera with cg::perspective.
+ */
+void render_scene(void);
+const RenderStats& last_render_stats(void);
+
+/*
+ * Matrices render_scene() uses, from cg::camera and cg::perspective.
+ */
+glm::mat4 view_matrix(void);
+glm::mat4 projection_matrix(void);
+
+/*
+ * Render only part of the view: left, right, bottom, top in normalised
+ * device coordinates of the full projection, which may extend past -1
+ * and 1. Used to render images larger than a framebuffer in tiles.
+ */
+void set_projection_window(const glm::vec4& window);
+void reset_projection_window(void);
+
+/*
+ * Light parameters, uploaded on the next render_scene().
+ */
+void set_light(const glm::vec3& position, const glm::vec3& color);
+glm::vec3 light_position(void);
+glm::vec3 light_color(void);
+
+/*
+ * Shader helpers for additional passes.
+ */
+unsigned int load_program(const std::string& vertex_path, const std::string& fragment_path);
+unsigned int load_compute_program(const std::string& compute_path);
+int get_uniform_location(unsigned int program, std::string_view name);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,168 @@
+#include "scene.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <array>
+#include <cmath>
+
+namespace cg
+{
+
+/*
+ * Some variation so the cubes do not all face the camera the same way.
+ */
+static glm::mat4 cube_at(const glm::vec3& position, size_t index)
+{
+    const float angle = static_cast<float>(index) * 0.37f;
+    return glm::rotate(glm::translate(glm::mat4(1.0f), position),
+                       angle,
+                       glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+}
+
+static void build_cube(void)
+{
+    create_draw_item(glm::mat4(1.0f));
+}
+
+/*
+ * 16 x 16 x 16 cubes. Draw call bound.
+ */
+static void build_grid(void)
+{
+    constexpr int size = 16;
+    constexpr float spacing = 2.0f;
+    constexpr float offset = (size - 1) * spacing * 0.5f;
+
+    size_t index = 0;
+    for (int z = 0; z < size; z++)
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++, index++)
+                create_draw_item(cube_at(glm::vec3(x, y, z) * spacing - offset, index));
+}
+
+/*
+ * 16 walls of 16 x 16 cubes behind each other. Overdraw bound.
+ */
+static void build_layers(void)
+{
+    constexpr int size = 16;
+    constexpr int layers = 16;
+    constexpr float spacing = 1.1f;
+    constexpr float offset = (size - 1) * spacing * 0.5f;
+
+    size_t index = 0;
+    for (int layer = 0; layer < layers; layer++)
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++, index++)
+            {
+                const glm::vec3 position(x * spacing - offset, y * spacing - offset, -layer * 1.5f);
+                create_draw_item(cube_at(position, index));
+            }
+}
+
+/*
+ * 32 x 32 blocks of buildings with streets between them, seen from street
+ * level. Most buildings are hidden behind nearer ones.
+ */
+static void build_city(void)
+{
+    constexpr int blocks = 32;
+    constexpr float spacing = 6.0f;
+    constexpr float offset = (blocks - 1) * spacing * 0.5f;
+
+    for (int z = 0; z < blocks; z++)
+        for (int x = 0; x < blocks; x++)
+        {
+            /*
+             * Integer hash, so every run builds the same skyline.
+             */
+            uint32_t hash = static_cast<uint32_t>(z * blocks + x) * 2654435761u;
+            hash ^= hash >> 15;
+            const float height = 4.0f + static_cast<float>(hash % 29);
+            const float width = 3.0f + static_cast<float>((hash >> 8) % 2);
+
+            const glm::vec3 position(x * spacing - offset, height * 0.5f, z * spacing - offset);
+            create_draw_item(glm::scale(glm::translate(glm::mat4(1.0f), position),
+                                        glm::vec3(width, height, width)));
+        }
+}
+
+static constexpr std::array<CameraKey, 4> cube_path =
+{{
+    { glm::vec3(0.0f, 0.0f, 5.0f),  glm::vec3(0.0f) },
+    { glm::vec3(5.0f, 2.0f, 0.0f),  glm::vec3(0.0f) },
+    { glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f) },
+    { glm::vec3(-5.0f, -2.0f, 0.0f), glm::vec3(0.0f) }
+}};
+
+static constexpr std::array<CameraKey, 4> grid_path =
+{{
+    { glm::vec3(0.0f, 5.0f, 45.0f),   glm::vec3(0.0f) },
+    { glm::vec3(30.0f, 20.0f, 30.0f), glm::vec3(0.0f) },
+    { glm::vec3(0.0f, 0.0f, 10.0f),   glm::vec3(0.0f, 0.0f, -10.0f) },
+    { glm::vec3(-30.0f, -10.0f, 30.0f), glm::vec3(0.0f) }
+}};
+
+static constexpr std::array<CameraKey, 3> layers_path =
+{{
+    { glm::vec3(0.0f, 0.0f, 20.0f),  glm::vec3(0.0f, 0.0f, -10.0f) },
+    { glm::vec3(6.0f, 3.0f, 14.0f),  glm::vec3(0.0f, 0.0f, -10.0f) },
+    { glm::vec3(-6.0f, -3.0f, 14.0f), glm::vec3(0.0f, 0.0f, -10.0f) }
+}};
+
+/*
+ * Down one street, across and back along another, at eye height.
+ */
+static constexpr std::array<CameraKey, 4> city_path =
+{{
+    { glm::vec3(0.0f, 1.7f, 100.0f),   glm::vec3(0.0f, 1.7f, 0.0f) },
+    { glm::vec3(0.0f, 1.7f, 0.0f),     glm::vec3(-60.0f, 1.7f, 0.0f) },
+    { glm::vec3(-36.0f, 1.7f, 0.0f),   glm::vec3(-36.0f, 1.7f, 60.0f) },
+    { glm::vec3(-36.0f, 40.0f, 60.0f), glm::vec3(0.0f, 1.7f, 0.0f) }
+}};
+
+static const std::array<Scene, 4> s_scenes =
+{{
+    { "cube", "One cube, orbiting camera.", build_cube, cube_path.data(), cube_path.size() },
+    { "grid", "4096 cubes in a 16^3 grid.", build_grid, grid_path.data(), grid_path.size() },
+    { "layers", "16 walls of 256 cubes, heavy overdraw.", build_layers, layers_path.data(), layers_path.size() },
+    { "city", "1024 buildings from street level, mostly occluded.", build_city, city_path.data(), city_path.size() }
+}};
+
+size_t scene_count(void)
+{
+    return s_scenes.size();
+}
+
+const Scene& scene(size_t index)
+{
+    return s_scenes[index];
+}
+
+const Scene* find_scene(std::string_view name)
+{
+    for (const Scene& scene : s_scenes)
+        if (name == scene.name)
+            return &scene;
+    return nullptr;
+}
+
+void load_scene(const Scene& scene)
+{
+    destroy_all_draw_items();
+    scene.build();
+}
+
+void follow_camera_path(const Scene& scene, float t)
+{
+    const float position = glm::fract(t) * static_cast<float>(scene.path_length);
+    const size_t key = static_cast<size_t>(position) % scene.path_length;
+    const float blend = position - std::floor(position);
+
+    const CameraKey& from = scene.path[key];
+    const CameraKey& to = scene.path[(key + 1) % scene.path_length];
+    camera.eye = glm::mix(from.eye, to.eye, blend);
+    camera.center = glm::mix(from.center, to.center, blend);
+}
+
+} // namespace cg
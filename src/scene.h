@@ -0,0 +1,51 @@
+#ifndef CG_SCENE
+#define CG_SCENE
+
+#include "glm/ext.hpp"
+
+#include <cstddef>
+#include <string_view>
+
+namespace cg
+{
+
+/*
+ * A point on a camera path. Keys are evenly spaced in time and the path
+ * loops back to the first key.
+ */
+struct CameraKey
+{
+    glm::vec3 eye;
+    glm::vec3 center;
+};
+
+/*
+ * Fixed test scenes for the headless tools, so runs are comparable
+ * between builds and machines.
+ */
+struct Scene
+{
+    const char* name;
+    const char* description;
+    void (*build)(void);
+    const CameraKey* path;
+    size_t path_length;
+};
+
+size_t scene_count(void);
+const Scene& scene(size_t index);
+const Scene* find_scene(std::string_view name);
+
+/*
+ * Replace every draw item with the scene's.
+ */
+void load_scene(const Scene& scene);
+
+/*
+ * Move cg::camera along the scene's path. t in [0, 1] covers it once.
+ */
+void follow_camera_path(const Scene& scene, float t);
+
+} // namespace cg
+
+#endif
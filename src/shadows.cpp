@@ -0,0 +1,484 @@
+#include "glad/glad.h"
+
+#include "shadows.h"
+#include "bvh.h"
+#include "command_list.h"
+#include "frame_arena.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "jobs.h"
+#include "mesh_lod.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace cg
+{
+
+ShadowSettings shadow_settings =
+{
+    .enabled = false,
+    .cascade_count = 4,
+    .resolution = 2048,
+    .max_distance = 60.0f,
+    .split_lambda = 0.75f,
+    .first_cached_cascade = 2,
+    .refresh_interval = 8
+};
+
+/*
+ * Cached cascades cover this much more than their slice of the frustum,
+ * so the camera can move a little before they have to be refitted.
+ */
+constexpr float cached_margin = 1.25f;
+
+/*
+ * Depth bias of the depth pass, in the units of glPolygonOffset.
+ */
+constexpr float slope_bias = 2.0f;
+constexpr float constant_bias = 1.0f;
+
+static const char* const s_zone_names[max_shadow_cascades] =
+{
+    "shadow cascade 0",
+    "shadow cascade 1",
+    "shadow cascade 2",
+    "shadow cascade 3"
+};
+
+/*
+ * A square box in light space, as last rendered.
+ */
+struct Cascade
+{
+    glm::mat4 view_projection; /* World to the cascade's clip space. */
+    glm::vec2 center;          /* Light space. */
+    float radius;              /* Half the side of the box. */
+    float texel;               /* World size of a texel. */
+    uint64_t content_hash;
+    uint64_t rendered_frame;
+    bool valid;
+};
+
+/*
+ * A cascade fitted to this frame's slice of the frustum.
+ */
+struct CascadeFit
+{
+    glm::vec2 center;
+    float radius;
+};
+
+static unsigned int s_program = 0;
+static unsigned int s_texture = 0;
+static unsigned int s_framebuffer = 0;
+static int s_texture_resolution = 0;
+static std::array<Cascade, max_shadow_cascades> s_cascades{};
+static ShadowSettings s_cached_settings{};
+static glm::vec3 s_cached_light = glm::vec3(0.0f);
+static glm::vec3 s_light_direction = glm::vec3(0.0f, 1.0f, 0.0f);
+static uint64_t s_frame = 0;
+static ShadowStats s_stats{};
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * The array is recreated when the resolution changes. Depth compares in
+ * the sampler, so a linear filter gives 2 x 2 percentage closer filtering;
+ * outside every cascade the border reads as lit.
+ */
+static bool create_shadow_texture(int resolution)
+{
+    glDeleteTextures(1, &s_texture);
+    glGenTextures(1, &s_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, s_texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, max_shadow_cascades);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    const float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    label_gl_object(GL_TEXTURE, s_texture, "shadow cascades");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, s_texture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Shadow framebuffer incomplete: " << status << std::endl;
+        return false;
+    }
+
+    s_texture_resolution = resolution;
+    return true;
+}
+
+bool init_shadows(void)
+{
+    if (GLAD_GL_VERSION_4_2 == 0)
+        return false;
+
+    s_program = load_program("resources/shaders/shadow_depth_v.glsl", "resources/shaders/shadow_depth_f.glsl");
+    if (s_program == 0)
+        return false;
+
+    glGenFramebuffers(1, &s_framebuffer);
+    label_gl_object(GL_FRAMEBUFFER, s_framebuffer, "shadow cascades");
+    if (create_shadow_texture(shadow_settings.resolution) == false)
+        return false;
+
+    s_cascades = {};
+    s_stats = {};
+    s_frame = 0;
+    return true;
+}
+
+void cleanup_shadows(void)
+{
+    glDeleteProgram(s_program);
+    glDeleteFramebuffers(1, &s_framebuffer);
+    glDeleteTextures(1, &s_texture);
+    s_program = 0;
+    s_framebuffer = 0;
+    s_texture = 0;
+    s_texture_resolution = 0;
+}
+
+/*
+ * Mix of even and logarithmic split distances (practical split scheme).
+ */
+static float split_distance(int split, int count, float z_near, float z_far)
+{
+    const float fraction = static_cast<float>(split) / static_cast<float>(count);
+    const float even = z_near + (z_far - z_near) * fraction;
+    const float logarithmic = z_near * std::pow(z_far / z_near, fraction);
+    return glm::mix(even, logarithmic, shadow_settings.split_lambda);
+}
+
+/*
+ * Bounding sphere of the slice, centred on the view axis. Its radius
+ * does not change as the camera turns and is rounded up, so the box keeps
+ * its size and the texel grid stays put.
+ */
+static CascadeFit fit_cascade(const glm::mat4& light_view, float start, float end)
+{
+    const float tan_y = std::tan(perspective.fov * 0.5f);
+    const float tan_x = tan_y * perspective.aspect;
+    const glm::mat4 camera_to_world = glm::inverse(view_matrix());
+
+    glm::vec3 center(0.0f);
+    std::array<glm::vec3, 8> corners;
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        const float depth = i < 4 ? start : end;
+        const float x = (i & 1) != 0 ? tan_x : -tan_x;
+        const float y = (i & 2) != 0 ? tan_y : -tan_y;
+        corners[i] = glm::vec3(camera_to_world * glm::vec4(x * depth, y * depth, -depth, 1.0f));
+        center += corners[i] / 8.0f;
+    }
+
+    float radius = 0.0f;
+    for (const glm::vec3& corner : corners)
+        radius = std::max(radius, glm::length(corner - center));
+
+    return CascadeFit
+    {
+        .center = glm::vec2(light_view * glm::vec4(center, 1.0f)),
+        .radius = std::ceil(radius * 16.0f) / 16.0f
+    };
+}
+
+/*
+ * Move the box by whole texels only, so edges do not shimmer as the
+ * camera moves.
+ */
+static Cascade make_cascade(const glm::mat4& light_view, const CascadeFit& fit, float margin, const Bounds& scene)
+{
+    const float radius = std::ceil(fit.radius * margin * 16.0f) / 16.0f;
+    const float texel = 2.0f * radius / static_cast<float>(shadow_settings.resolution);
+    const glm::vec2 center = glm::floor(fit.center / texel) * texel;
+
+    /*
+     * Light space looks down -z. Every caster is in front of the near
+     * plane, and depth clamping keeps anything outside it anyway.
+     */
+    const glm::mat4 projection = glm::ortho(center.x - radius, center.x + radius,
+                                            center.y - radius, center.y + radius,
+                                            -scene.max.z - 1.0f, -scene.min.z + 1.0f);
+    return Cascade
+    {
+        .view_projection = projection * light_view,
+        .center = center,
+        .radius = radius,
+        .texel = texel,
+        .content_hash = 0,
+        .rendered_frame = s_frame,
+        .valid = true
+    };
+}
+
+static bool covers(const Cascade& cascade, const CascadeFit& fit)
+{
+    const glm::vec2 offset = glm::abs(fit.center - cascade.center);
+    return std::max(offset.x, offset.y) + fit.radius <= cascade.radius;
+}
+
+/*
+ * Items whose light space box overlaps the cascade's, in draw order.
+ * Returns how many, and hashes their model matrices and the number of
+ * triangles they are drawn with, which changes with their level of detail.
+ */
+static size_t cull_cascade(const Cascade& cascade,
+                           const DrawItem* const* items,
+                           const Bounds* light_bounds,
+                           size_t count,
+                           const DrawItem** culled,
+                           uint64_t& hash)
+{
+    hash = 14695981039346656037ull;
+    size_t culled_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const Bounds& bounds = light_bounds[i];
+        if (bounds.max.x < cascade.center.x - cascade.radius || bounds.min.x > cascade.center.x + cascade.radius ||
+            bounds.max.y < cascade.center.y - cascade.radius || bounds.min.y > cascade.center.y + cascade.radius)
+            continue;
+
+        culled[culled_count++] = items[i];
+
+        std::array<uint32_t, 16> words;
+        std::memcpy(words.data(), glm::value_ptr(items[i]->model), sizeof(words));
+        for (uint32_t word : words)
+            hash = (hash ^ word) * 1099511628211ull;
+        hash = (hash ^ item_triangles(*items[i])) * 1099511628211ull;
+    }
+    hash = (hash ^ culled_count) * 1099511628211ull;
+    return culled_count;
+}
+
+static void draw_cascade(int index, const DrawItem* const* items, size_t count, unsigned int vertex_array)
+{
+    GpuZone zone(s_zone_names[index]);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, s_texture, 0, index);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    const int model_location = get_uniform_location(s_program, "u_model");
+    const int light_location = get_uniform_location(s_program, "u_light_view_projection");
+    const glm::mat4 view_projection = s_cascades[index].view_projection;
+    const size_t list_count = (count + draws_per_command_list - 1) / draws_per_command_list;
+    CommandList* lists = frame_allocate<CommandList>(list_count);
+
+    parallel_for(list_count, 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            CommandList& list = *new (&lists[i]) CommandList(command_allocator());
+            list.bind_program(s_program);
+            list.bind_vertex_array(vertex_array);
+            list.set_mat4(light_location, view_projection);
+
+            const size_t first = i * draws_per_command_list;
+            const size_t last = std::min(first + draws_per_command_list, count);
+            for (size_t item = first; item < last; item++)
+            {
+                list.set_mat4(model_location, items[item]->model);
+                record_item_draw(list, *items[item]);
+            }
+        }
+    });
+
+    submit_commands(lists, list_count);
+}
+
+/*
+ * GPU time of the cascades rendered in the latest resolved frame. Cascades
+ * reused in that frame keep their last time.
+ */
+static void read_gpu_times(void)
+{
+    const GpuFrameResult* frame = latest_gpu_frame();
+    if (frame == nullptr)
+        return;
+
+    for (size_t zone = 0; zone < frame->zone_count; zone++)
+    {
+        for (int i = 0; i < max_shadow_cascades; i++)
+        {
+            if (frame->zones[zone].name == s_zone_names[i])
+                s_stats.cascades[i].gpu_ms = frame->zones[zone].ms;
+        }
+    }
+}
+
+/*
+ * Anything that moves every cascade: fitted boxes no longer match.
+ */
+static bool settings_changed(void)
+{
+    return shadow_settings.cascade_count != s_cached_settings.cascade_count ||
+           shadow_settings.resolution != s_cached_settings.resolution ||
+           shadow_settings.max_distance != s_cached_settings.max_distance ||
+           shadow_settings.split_lambda != s_cached_settings.split_lambda ||
+           light_position() != s_cached_light;
+}
+
+void render_shadow_maps(const DrawItem* const* items, size_t count, unsigned int vertex_array)
+{
+    CG_PROFILE_SCOPE("shadow maps");
+    GpuZone zone("shadows");
+    s_frame++;
+
+    if (shadow_settings.resolution != s_texture_resolution &&
+        create_shadow_texture(shadow_settings.resolution) == false)
+        return;
+
+    if (settings_changed() == true)
+    {
+        for (Cascade& cascade : s_cascades)
+            cascade.valid = false;
+        s_cached_settings = shadow_settings;
+        s_cached_light = light_position();
+    }
+
+    s_light_direction = glm::normalize(light_position());
+    const glm::vec3 up = std::abs(s_light_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), -s_light_direction, up);
+
+    /*
+     * Light space boxes of every item, for culling and the depth range.
+     */
+    Bounds* light_bounds = frame_allocate<Bounds>(count);
+    const DrawItem** culled = frame_allocate<const DrawItem*>(count);
+    const Bounds cube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+    Bounds scene{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (size_t i = 0; i < count; i++)
+    {
+        light_bounds[i] = transform_bounds(cube, light_view * items[i]->model);
+        scene.min = i == 0 ? light_bounds[i].min : glm::min(scene.min, light_bounds[i].min);
+        scene.max = i == 0 ? light_bounds[i].max : glm::max(scene.max, light_bounds[i].max);
+    }
+
+    /*
+     * The caller may have different draw and read framebuffers bound.
+     */
+    int previous_draw_framebuffer = 0;
+    int previous_read_framebuffer = 0;
+    std::array<int, 4> previous_viewport;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_draw_framebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+    glViewport(0, 0, s_texture_resolution, s_texture_resolution);
+    glEnable(GL_DEPTH_CLAMP);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(slope_bias, constant_bias);
+
+    const int cascade_count = std::clamp(shadow_settings.cascade_count, 1, max_shadow_cascades);
+    const float z_near = perspective.z_near;
+    const float z_far = std::max(std::min(perspective.z_far, shadow_settings.max_distance), z_near * 2.0f);
+    bool refreshed = false;
+
+    for (int i = 0; i < cascade_count; i++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        CascadeStats& stats = s_stats.cascades[i];
+        Cascade& cascade = s_cascades[i];
+        stats.start = split_distance(i, cascade_count, z_near, z_far);
+        stats.end = split_distance(i + 1, cascade_count, z_near, z_far);
+        const CascadeFit fit = fit_cascade(light_view, stats.start, stats.end);
+
+        /*
+         * Near cascades follow the camera every frame. Far ones are kept
+         * while they still cover their slice and nothing in them moved,
+         * and otherwise refreshed every refresh_interval frames, one per
+         * frame so the cost stays even.
+         */
+        const bool cached = i >= shadow_settings.first_cached_cascade;
+        bool render = cached == false || cascade.valid == false || covers(cascade, fit) == false;
+        if (render == false && refreshed == false &&
+            s_frame - cascade.rendered_frame >= static_cast<uint64_t>(std::max(shadow_settings.refresh_interval, 1)))
+        {
+            render = true;
+            refreshed = true;
+        }
+
+        uint64_t hash = 0;
+        size_t culled_count = 0;
+        if (render == false)
+        {
+            culled_count = cull_cascade(cascade, items, light_bounds, count, culled, hash);
+            render = hash != cascade.content_hash;
+        }
+
+        if (render == true)
+        {
+            cascade = make_cascade(light_view, fit, cached == true ? cached_margin : 1.0f, scene);
+            culled_count = cull_cascade(cascade, items, light_bounds, count, culled, hash);
+            cascade.content_hash = hash;
+            draw_cascade(i, culled, culled_count, vertex_array);
+            stats.draw_calls = culled_count;
+            stats.renders++;
+        }
+
+        stats.rendered = render;
+        stats.cpu_ms = elapsed_ms(start);
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<unsigned int>(previous_draw_framebuffer));
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<unsigned int>(previous_read_framebuffer));
+    glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+
+    s_stats.cascade_count = cascade_count;
+    read_gpu_times();
+}
+
+void bind_shadow_maps(unsigned int program)
+{
+    std::array<glm::mat4, max_shadow_cascades> matrices{};
+    glm::vec4 splits(0.0f);
+    glm::vec4 texels(0.0f);
+    for (int i = 0; i < s_stats.cascade_count; i++)
+    {
+        matrices[i] = s_cascades[i].view_projection;
+        splits[i] = s_stats.cascades[i].end;
+        texels[i] = s_cascades[i].texel;
+    }
+
+    glUniformMatrix4fv(get_uniform_location(program, "u_cascade_matrices"), max_shadow_cascades, false,
+                       glm::value_ptr(matrices[0]));
+    glUniform4fv(get_uniform_location(program, "u_cascade_splits"), 1, glm::value_ptr(splits));
+    glUniform4fv(get_uniform_location(program, "u_cascade_texels"), 1, glm::value_ptr(texels));
+    glUniform1i(get_uniform_location(program, "u_cascade_count"), s_stats.cascade_count);
+    glUniform3fv(get_uniform_location(program, "u_light_dir"), 1, glm::value_ptr(s_light_direction));
+    glUniform3fv(get_uniform_location(program, "u_light_color"), 1, glm::value_ptr(light_color()));
+    glUniform1i(get_uniform_location(program, "u_shadow_map"), 1);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, s_texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+const ShadowStats& last_shadow_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
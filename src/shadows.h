@@ -0,0 +1,72 @@
+#ifndef CG_SHADOWS
+#define CG_SHADOWS
+
+#include "glm/ext.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+struct DrawItem;
+
+constexpr int max_shadow_cascades = 4;
+
+struct ShadowSettings
+{
+    bool enabled;              /* Lights the scene with phong and a directional light. */
+    int cascade_count;         /* 1 to max_shadow_cascades. */
+    int resolution;            /* Of every cascade, square. */
+    float max_distance;        /* From the camera; farther is unshadowed. */
+    float split_lambda;        /* 0 splits the distance evenly, 1 logarithmically. */
+    int first_cached_cascade;  /* This one and farther are reused between frames. */
+    int refresh_interval;      /* Frames a cached cascade is reused at most. */
+};
+extern ShadowSettings shadow_settings;
+
+struct CascadeStats
+{
+    float start;         /* View distance the cascade covers. */
+    float end;
+    uint64_t draw_calls; /* Of its last render. */
+    uint64_t renders;    /* Since init. */
+    bool rendered;       /* Last frame, rather than reused. */
+    double cpu_ms;       /* Fitting and culling, plus recording and submitting when rendered. */
+    double gpu_ms;       /* Of its last render with a resolved GPU zone. */
+};
+
+struct ShadowStats
+{
+    int cascade_count;
+    std::array<CascadeStats, max_shadow_cascades> cascades;
+};
+
+/*
+ * Needs a current context with GL loaded. Returns false below OpenGL 4.2,
+ * which has no immutable texture storage.
+ */
+bool init_shadows(void);
+void cleanup_shadows(void);
+
+/*
+ * Fit the cascades to the view frustum of cg::camera and cg::perspective
+ * and render the ones that need it into the depth array, each with the
+ * items inside its box. Leaves the framebuffer and viewport as found. The
+ * light shines from light_position() towards the origin, like a sun
+ * infinitely far along that direction.
+ */
+void render_shadow_maps(const DrawItem* const* items, size_t count, unsigned int vertex_array);
+
+/*
+ * Bind the depth array to texture unit 1 and set the light and cascade
+ * uniforms of a program using phong_shadow_f.glsl.
+ */
+void bind_shadow_maps(unsigned int program);
+
+const ShadowStats& last_shadow_stats(void);
+
+} // namespace cg
+
+#endif
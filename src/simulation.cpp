@@ -0,0 +1,157 @@
+#include "simulation.h"
+#include "triple_buffer.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace cg
+{
+
+SimSettings sim_settings =
+{
+    .timestep = 1.0 / 60.0,
+    .max_catch_up = 5,
+    .extra_load_ms = 0.0f
+};
+
+static TripleBuffer<SimSnapshot> s_snapshots;
+static std::thread s_thread;
+static std::atomic<bool> s_running = false;
+static std::atomic<float> s_pending_rotation = 0.0f;
+
+double sim_clock(void)
+{
+    using namespace std::chrono;
+    static const auto start = steady_clock::now();
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+/*
+ * Busy work standing in for animation, particles and physics.
+ */
+static void simulate_load(float milliseconds)
+{
+    if (milliseconds <= 0.0f)
+        return;
+
+    const double end = sim_clock() + milliseconds / 1000.0;
+    while (sim_clock() < end)
+        std::this_thread::yield();
+}
+
+/*
+ * Advance the state by one fixed step.
+ */
+static void step(SimState& state, double timestep)
+{
+    CG_PROFILE_SCOPE("simulation step");
+
+    const float rotation = s_pending_rotation.exchange(0.0f);
+    if (rotation != 0.0f)
+    {
+        state.model_rotation = glm::rotate(state.model_rotation,
+                                           rotation,
+                                           glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    simulate_load(sim_settings.extra_load_ms.load(std::memory_order_relaxed));
+
+    state.tick++;
+    state.time += timestep;
+}
+
+static void simulation_loop(SimState current)
+{
+    set_profiler_thread_name("Simulation");
+
+    SimState previous = current;
+    double next = current.time + sim_settings.timestep;
+
+    while (s_running.load(std::memory_order_relaxed) == true)
+    {
+        /*
+         * Fixed timestep. Run every step that is due, but drop time instead
+         * of spiralling when the simulation cannot keep up.
+         */
+        int steps = 0;
+        while (sim_clock() >= next && steps < sim_settings.max_catch_up)
+        {
+            previous = current;
+            step(current, sim_settings.timestep);
+            next += sim_settings.timestep;
+            steps++;
+        }
+
+        if (steps == sim_settings.max_catch_up)
+        {
+            current.time = sim_clock();
+            previous.time = current.time - sim_settings.timestep;
+            next = current.time + sim_settings.timestep;
+        }
+
+        if (steps > 0)
+            s_snapshots.write({ previous, current });
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(next - sim_clock()));
+    }
+}
+
+void start_simulation(void)
+{
+    if (s_running.exchange(true) == true)
+        return;
+
+    /*
+     * Publish the initial state before the thread starts so the renderer
+     * never sees an empty snapshot.
+     */
+    const SimState initial =
+    {
+        .model_rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+        .tick = 0,
+        .time = sim_clock()
+    };
+    s_snapshots.write({ initial, initial });
+
+    s_thread = std::thread(simulation_loop, initial);
+}
+
+void stop_simulation(void)
+{
+    if (s_running.exchange(false) == false)
+        return;
+    s_thread.join();
+}
+
+void queue_rotation(float radians)
+{
+    s_pending_rotation.fetch_add(radians);
+}
+
+const SimSnapshot& simulation_snapshot(void)
+{
+    return s_snapshots.read();
+}
+
+/*
+ * Render one step behind the simulation so there are always two states to
+ * interpolate between.
+ */
+glm::mat4 interpolate_model(const SimSnapshot& snapshot, double now)
+{
+    const double span = snapshot.current.time - snapshot.previous.time;
+    double alpha = 1.0;
+    if (span > 0.0)
+        alpha = (now - sim_settings.timestep - snapshot.previous.time) / span;
+
+    alpha = glm::clamp(alpha, 0.0, 1.0);
+
+    const glm::quat rotation = glm::slerp(snapshot.previous.model_rotation,
+                                          snapshot.current.model_rotation,
+                                          static_cast<float>(alpha));
+    return glm::mat4_cast(rotation);
+}
+
+} // namespace cg
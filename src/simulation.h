@@ -0,0 +1,63 @@
+#ifndef CG_SIMULATION
+#define CG_SIMULATION
+
+#include "glm/ext.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Everything the simulation owns.
+ * Copied by value into the triple buffer, so keep it plain data.
+ */
+struct SimState
+{
+    glm::quat model_rotation;
+    uint64_t tick;
+    double time; /* Seconds on the steady clock this state represents. */
+};
+
+/*
+ * The two newest states. The renderer interpolates between them.
+ */
+struct SimSnapshot
+{
+    SimState previous;
+    SimState current;
+};
+
+struct SimSettings
+{
+    double timestep;    /* Fixed simulation step in seconds. */
+    int max_catch_up;   /* Max steps per wakeup before dropping time. */
+    std::atomic<float> extra_load_ms; /* Artificial work per step. For testing. */
+};
+extern SimSettings sim_settings;
+
+void start_simulation(void);
+void stop_simulation(void);
+
+/*
+ * Thread safe. Queue a rotation around the Y axis for the next step.
+ */
+void queue_rotation(float radians);
+
+/*
+ * Render thread. Newest snapshot and the interpolated model matrix for the
+ * given point in time.
+ */
+const SimSnapshot& simulation_snapshot(void);
+glm::mat4 interpolate_model(const SimSnapshot& snapshot, double now);
+
+/*
+ * Steady clock in seconds. Shared time base for both threads.
+ */
+double sim_clock(void);
+
+} // namespace cg
+
+#endif
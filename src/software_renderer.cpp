@@ -0,0 +1,858 @@
+#include "software_renderer.h"
+#include "cpu_features.h"
+#include "jobs.h"
+#include "occlusion.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <iostream>
+
+namespace cg
+{
+
+constexpr int tile_size = 64;
+constexpr size_t max_varyings = 8;
+
+/*
+ * Vertex work is split into at most this many chunks. Every chunk bins
+ * into its own lists, and tiles walk the chunks in order, so triangles
+ * are blended in submission order without any locking.
+ */
+constexpr size_t bin_chunks = 64;
+
+/*
+ * Clipping against the near plane turns a triangle into at most two.
+ */
+constexpr size_t max_triangles_per_item = cube_vertex_count / 3 * 2;
+
+/*
+ * The bins always have room for every tile this many times over, so a
+ * scene that is small during warm-up can move up close without growing
+ * them.
+ */
+constexpr size_t min_bin_layers = 16;
+
+/*
+ * Edge function a * (x - anchor x) + b * (y - anchor y), positive inside.
+ * The anchor is the edge's lexicographically smaller end, so the two
+ * triangles sharing an edge compute exactly negated values and the
+ * top-left rule assigns every pixel centre on it to exactly one of them.
+ */
+struct Edge
+{
+    float a;
+    float b;
+    float x;
+    float y;
+    bool top_left;
+};
+
+/*
+ * Attribute linear in screen space: value at the triangle's anchor plus
+ * the gradient times the offset from it.
+ */
+struct Plane
+{
+    float dx;
+    float dy;
+    float value;
+};
+
+struct RasterTriangle
+{
+    std::array<Edge, 3> edges;
+    float x;
+    float y;
+    Plane depth;
+    Plane inv_w;
+    std::array<Plane, max_varyings> varyings; /* Divided by w. */
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+struct ClipVertex
+{
+    glm::vec4 position;
+    std::array<float, max_varyings> varyings;
+};
+
+struct MipLevel
+{
+    int width;
+    int height;
+    std::vector<glm::vec4> texels; /* Bottom row first, as GL stores them. */
+};
+
+struct ChunkStats
+{
+    uint64_t culled;
+    uint64_t clipped;
+    uint64_t binned;
+};
+
+/*
+ * Per frame state of one tile job.
+ */
+struct TileContext
+{
+    SoftwareTarget* target;
+    const SoftwareRenderOptions* options;
+    int x0;
+    int y0;
+    int x1; /* Inclusive, inside the target. */
+    int y1;
+    uint64_t fragments;
+};
+
+struct ShadeInputs
+{
+    glm::vec3 light_position;
+    glm::vec3 light_color;
+    glm::vec3 view_position;
+};
+
+using RasterFunction = void (*)(TileContext& tile, const RasterTriangle& triangle);
+
+static std::vector<MipLevel> s_texture;
+static std::vector<const DrawItem*> s_items;
+static std::vector<RasterTriangle> s_triangles;
+static std::array<ChunkStats, bin_chunks> s_chunk_stats{};
+
+/*
+ * Triangles of one chunk, and where its bins start in s_bin_entries.
+ */
+struct ChunkBins
+{
+    uint32_t first_triangle;
+    uint32_t end_triangle;
+    uint32_t first_entry;
+};
+
+/*
+ * The bins of all chunks are one array of triangle indices, sorted by
+ * chunk, then tile. Tile t of a chunk is from its first_entry plus
+ * offsets[t] up to plus offsets[t + 1], with tile_count + 2 offsets per
+ * chunk.
+ */
+static std::array<ChunkBins, bin_chunks> s_chunk_bins{};
+static std::vector<uint32_t> s_bin_entries;
+static std::vector<uint32_t> s_bin_offsets;
+static RasterFunction s_raster = nullptr;
+static bool s_avx2 = false;
+static ShadeInputs s_shade{};
+static SoftwareStats s_stats{};
+
+void resize_software_target(SoftwareTarget& target, int width, int height)
+{
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    const int tiles_y = (height + tile_size - 1) / tile_size;
+    target.width = width;
+    target.height = height;
+    target.stride = tiles_x * tile_size;
+    target.color.assign(static_cast<size_t>(target.stride) * tiles_y * tile_size, 0);
+    target.depth.assign(target.color.size(), 1.0f);
+}
+
+ImageView software_view(const SoftwareTarget& target)
+{
+    return
+    {
+        .pixels = reinterpret_cast<const uint8_t*>(target.color.data()),
+        .width = target.width,
+        .height = target.height,
+        .stride = static_cast<ptrdiff_t>(target.stride) * 4
+    };
+}
+
+static uint32_t pack_color(const glm::vec4& color)
+{
+    const glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return static_cast<uint32_t>(c.r) | (static_cast<uint32_t>(c.g) << 8) |
+           (static_cast<uint32_t>(c.b) << 16) | (static_cast<uint32_t>(c.a) << 24);
+}
+
+static glm::vec4 unpack_color(uint32_t color)
+{
+    return glm::vec4(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24) / 255.0f;
+}
+
+/*
+ * Same texture and orientation as the GL path, which loads it flipped.
+ * Box filtered down to 1 x 1 for trilinear sampling.
+ */
+static bool load_texture(const char* path)
+{
+    Image image;
+    if (load_image(path, image) == false)
+    {
+        std::cerr << "Failed to load texture " << path << "." << std::endl;
+        return false;
+    }
+
+    s_texture.clear();
+    MipLevel level{ image.width, image.height, {} };
+    level.texels.resize(static_cast<size_t>(image.width) * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t* row = &image.pixels[static_cast<size_t>(image.height - 1 - y) * image.width * 4];
+        for (int x = 0; x < image.width; x++)
+            level.texels[static_cast<size_t>(y) * image.width + x] =
+                glm::vec4(row[x * 4], row[x * 4 + 1], row[x * 4 + 2], row[x * 4 + 3]) / 255.0f;
+    }
+    s_texture.push_back(std::move(level));
+
+    while (s_texture.back().width > 1 || s_texture.back().height > 1)
+    {
+        const MipLevel& source = s_texture.back();
+        MipLevel next{ std::max(source.width / 2, 1), std::max(source.height / 2, 1), {} };
+        next.texels.resize(static_cast<size_t>(next.width) * next.height);
+
+        const auto texel = [&](int x, int y)
+        {
+            x = std::min(x, source.width - 1);
+            y = std::min(y, source.height - 1);
+            return source.texels[static_cast<size_t>(y) * source.width + x];
+        };
+
+        for (int y = 0; y < next.height; y++)
+            for (int x = 0; x < next.width; x++)
+                next.texels[static_cast<size_t>(y) * next.width + x] =
+                    0.25f * (texel(x * 2, y * 2) + texel(x * 2 + 1, y * 2) +
+                             texel(x * 2, y * 2 + 1) + texel(x * 2 + 1, y * 2 + 1));
+
+        s_texture.push_back(std::move(next));
+    }
+
+    return true;
+}
+
+/*
+ * GL_LINEAR with GL_CLAMP_TO_EDGE.
+ */
+static glm::vec4 sample_bilinear(const MipLevel& level, float u, float v)
+{
+    const float x = u * level.width - 0.5f;
+    const float y = v * level.height - 0.5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float tx = x - fx;
+    const float ty = y - fy;
+
+    const int x0 = std::clamp(static_cast<int>(fx), 0, level.width - 1);
+    const int y0 = std::clamp(static_cast<int>(fy), 0, level.height - 1);
+    const int x1 = std::clamp(static_cast<int>(fx) + 1, 0, level.width - 1);
+    const int y1 = std::clamp(static_cast<int>(fy) + 1, 0, level.height - 1);
+
+    const glm::vec4* row0 = &level.texels[static_cast<size_t>(y0) * level.width];
+    const glm::vec4* row1 = &level.texels[static_cast<size_t>(y1) * level.width];
+    const glm::vec4 top = glm::mix(row0[x0], row0[x1], tx);
+    const glm::vec4 bottom = glm::mix(row1[x0], row1[x1], tx);
+    return glm::mix(top, bottom, ty);
+}
+
+static float evaluate(const Plane& plane, float x, float y)
+{
+    return plane.value + plane.dx * x + plane.dy * y;
+}
+
+/*
+ * Fragment stage of tex_f or phong_f, then blending with
+ * GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA.
+ */
+static void shade(TileContext& tile, const RasterTriangle& triangle, int x, int y)
+{
+    const float px = static_cast<float>(x) + 0.5f - triangle.x;
+    const float py = static_cast<float>(y) + 0.5f - triangle.y;
+    const float w = 1.0f / evaluate(triangle.inv_w, px, py);
+    const float u = evaluate(triangle.varyings[0], px, py) * w;
+    const float v = evaluate(triangle.varyings[1], px, py) * w;
+
+    glm::vec4 color;
+    if (tile.options->filter == SoftwareFilter::trilinear && s_texture.size() > 1)
+    {
+        /*
+         * u / w and 1 / w are linear in screen space, so the derivatives
+         * of u are exact: (d(u / w) - u * d(1 / w)) * w.
+         */
+        const MipLevel& base = s_texture[0];
+        const float dudx = (triangle.varyings[0].dx - u * triangle.inv_w.dx) * w * base.width;
+        const float dvdx = (triangle.varyings[1].dx - v * triangle.inv_w.dx) * w * base.height;
+        const float dudy = (triangle.varyings[0].dy - u * triangle.inv_w.dy) * w * base.width;
+        const float dvdy = (triangle.varyings[1].dy - v * triangle.inv_w.dy) * w * base.height;
+        const float rho = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+        const float lod = std::clamp(0.5f * std::log2(std::max(rho, 1e-12f)),
+                                     0.0f,
+                                     static_cast<float>(s_texture.size() - 1));
+
+        const size_t level = static_cast<size_t>(lod);
+        const size_t next = std::min(level + 1, s_texture.size() - 1);
+        color = glm::mix(sample_bilinear(s_texture[level], u, v),
+                         sample_bilinear(s_texture[next], u, v),
+                         lod - static_cast<float>(level));
+    }
+    else
+    {
+        color = sample_bilinear(s_texture[0], u, v);
+    }
+
+    if (tile.options->pipeline == SoftwarePipeline::phong)
+    {
+        const glm::vec3 position(evaluate(triangle.varyings[2], px, py) * w,
+                                 evaluate(triangle.varyings[3], px, py) * w,
+                                 evaluate(triangle.varyings[4], px, py) * w);
+        const glm::vec3 normal = glm::normalize(glm::vec3(evaluate(triangle.varyings[5], px, py),
+                                                          evaluate(triangle.varyings[6], px, py),
+                                                          evaluate(triangle.varyings[7], px, py)));
+
+        const glm::vec3 ambient = 0.3f * s_shade.light_color;
+        const glm::vec3 light_direction = glm::normalize(s_shade.light_position - position);
+        const glm::vec3 diffuse = std::max(glm::dot(normal, light_direction), 0.0f) * s_shade.light_color;
+        const glm::vec3 view_direction = glm::normalize(s_shade.view_position - position);
+        const glm::vec3 reflect_direction = glm::reflect(-light_direction, normal);
+        const float spec = std::pow(std::max(glm::dot(view_direction, reflect_direction), 0.0f), 32.0f);
+        const glm::vec3 specular = 0.5f * spec * s_shade.light_color;
+
+        color = glm::vec4((ambient + diffuse + specular) * glm::vec3(color), 1.0f);
+    }
+
+    uint32_t& destination = tile.target->color[static_cast<size_t>(y) * tile.target->stride + x];
+    const float alpha = std::clamp(color.a, 0.0f, 1.0f);
+    destination = pack_color(color * alpha + unpack_color(destination) * (1.0f - alpha));
+    tile.fragments++;
+}
+
+static void raster_scalar(TileContext& tile, const RasterTriangle& triangle)
+{
+    const int x_begin = std::max(triangle.min_x, tile.x0);
+    const int x_end = std::min(triangle.max_x, tile.x1);
+    const int y_begin = std::max(triangle.min_y, tile.y0);
+    const int y_end = std::min(triangle.max_y, tile.y1);
+    SoftwareTarget& target = *tile.target;
+
+    for (int y = y_begin; y <= y_end; y++)
+    {
+        const float py = static_cast<float>(y) + 0.5f;
+        float* depth_row = &target.depth[static_cast<size_t>(y) * target.stride];
+
+        for (int x = x_begin; x <= x_end; x++)
+        {
+            const float px = static_cast<float>(x) + 0.5f;
+
+            bool inside = true;
+            for (const Edge& edge : triangle.edges)
+            {
+                const float value = edge.a * (px - edge.x) + edge.b * (py - edge.y);
+                inside = inside && (value > 0.0f || (value == 0.0f && edge.top_left == true));
+            }
+            if (inside == false)
+                continue;
+
+            const float z = evaluate(triangle.depth, px - triangle.x, py - triangle.y);
+            if (z < 0.0f || z > 1.0f || z >= depth_row[x])
+                continue;
+
+            depth_row[x] = z;
+            shade(tile, triangle, x, y);
+        }
+    }
+}
+
+#if defined(CG_AVX2)
+/*
+ * Eight pixels of a row per step: edge functions, coverage, depth test
+ * and depth write in AVX2, then the covered pixels are shaded.
+ */
+CG_TARGET_AVX2 static void raster_avx2(TileContext& tile, const RasterTriangle& triangle)
+{
+    const int x_begin = std::max(triangle.min_x, tile.x0);
+    const int x_end = std::min(triangle.max_x, tile.x1);
+    const int y_begin = std::max(triangle.min_y, tile.y0);
+    const int y_end = std::min(triangle.max_y, tile.y1);
+    SoftwareTarget& target = *tile.target;
+
+    /*
+     * Tiles start on multiples of 8, so blocks never straddle two tiles.
+     */
+    const int block_begin = x_begin & ~7;
+
+    const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 width = _mm256_set1_ps(static_cast<float>(target.width));
+
+    for (int y = y_begin; y <= y_end; y++)
+    {
+        const float py = static_cast<float>(y) + 0.5f;
+        float* depth_row = &target.depth[static_cast<size_t>(y) * target.stride];
+
+        __m256 edge_rows[3];
+        for (size_t i = 0; i < 3; i++)
+            edge_rows[i] = _mm256_set1_ps(triangle.edges[i].b * (py - triangle.edges[i].y));
+        const __m256 depth_row_value = _mm256_set1_ps(triangle.depth.value + triangle.depth.dy * (py - triangle.y));
+
+        for (int x = block_begin; x <= x_end; x += 8)
+        {
+            const float fx = static_cast<float>(x);
+            __m256 covered = _mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(fx), lanes), width, _CMP_LT_OQ);
+
+            for (size_t i = 0; i < 3; i++)
+            {
+                const Edge& edge = triangle.edges[i];
+                const __m256 offset = _mm256_add_ps(_mm256_set1_ps(fx - edge.x), lanes);
+                const __m256 value = _mm256_fmadd_ps(_mm256_set1_ps(edge.a), offset, edge_rows[i]);
+                const __m256 inside = edge.top_left == true ? _mm256_cmp_ps(value, zero, _CMP_GE_OQ)
+                                                            : _mm256_cmp_ps(value, zero, _CMP_GT_OQ);
+                covered = _mm256_and_ps(covered, inside);
+            }
+
+            if (_mm256_movemask_ps(covered) == 0)
+                continue;
+
+            const __m256 offset = _mm256_add_ps(_mm256_set1_ps(fx - triangle.x), lanes);
+            const __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(triangle.depth.dx), offset, depth_row_value);
+            const __m256 stored = _mm256_loadu_ps(depth_row + x);
+
+            __m256 passed = _mm256_and_ps(covered, _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+            passed = _mm256_and_ps(passed, _mm256_cmp_ps(z, zero, _CMP_GE_OQ));
+            passed = _mm256_and_ps(passed, _mm256_cmp_ps(z, one, _CMP_LE_OQ));
+
+            unsigned int bits = static_cast<unsigned int>(_mm256_movemask_ps(passed));
+            if (bits == 0)
+                continue;
+
+            _mm256_maskstore_ps(depth_row + x, _mm256_castps_si256(passed), z);
+            while (bits != 0)
+            {
+                shade(tile, triangle, x + std::countr_zero(bits), y);
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+#endif
+
+/*
+ * Screen space setup of a clipped triangle. False if it covers no pixel
+ * centre of the target.
+ */
+static bool setup_triangle(const std::array<ClipVertex, 3>& vertices,
+                           size_t varying_count,
+                           int width,
+                           int height,
+                           RasterTriangle& triangle)
+{
+    std::array<glm::vec3, 3> screen;
+    std::array<float, 3> inv_w;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const glm::vec4& p = vertices[i].position;
+        inv_w[i] = 1.0f / p.w;
+        screen[i] = glm::vec3((p.x * inv_w[i] * 0.5f + 0.5f) * width,
+                              (0.5f - p.y * inv_w[i] * 0.5f) * height,
+                              p.z * inv_w[i] * 0.5f + 0.5f);
+    }
+
+    const float min_x = std::min({ screen[0].x, screen[1].x, screen[2].x });
+    const float max_x = std::max({ screen[0].x, screen[1].x, screen[2].x });
+    const float min_y = std::min({ screen[0].y, screen[1].y, screen[2].y });
+    const float max_y = std::max({ screen[0].y, screen[1].y, screen[2].y });
+    triangle.min_x = std::max(static_cast<int>(std::floor(min_x)), 0);
+    triangle.min_y = std::max(static_cast<int>(std::floor(min_y)), 0);
+    triangle.max_x = std::min(static_cast<int>(std::ceil(max_x)), width - 1);
+    triangle.max_y = std::min(static_cast<int>(std::ceil(max_y)), height - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+        return false;
+
+    float area = 0.0f;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const glm::vec3& p = screen[(i + 1) % 3];
+        const glm::vec3& q = screen[(i + 2) % 3];
+        const bool p_first = p.x < q.x || (p.x == q.x && p.y < q.y);
+        const glm::vec3& anchor = p_first == true ? p : q;
+
+        Edge& edge = triangle.edges[i];
+        edge.a = p.y - q.y;
+        edge.b = q.x - p.x;
+        edge.x = anchor.x;
+        edge.y = anchor.y;
+        if (i == 0)
+            area = edge.a * (screen[0].x - anchor.x) + edge.b * (screen[0].y - anchor.y);
+    }
+
+    /*
+     * No culling, like the GL path: flip clockwise triangles so inside is
+     * always positive.
+     */
+    if (std::abs(area) < 1e-8f)
+        return false;
+    if (area < 0.0f)
+    {
+        for (Edge& edge : triangle.edges)
+        {
+            edge.a = -edge.a;
+            edge.b = -edge.b;
+        }
+        area = -area;
+    }
+
+    /*
+     * Screen y grows downwards: top edges have the inside below them.
+     */
+    for (Edge& edge : triangle.edges)
+        edge.top_left = edge.a > 0.0f || (edge.a == 0.0f && edge.b > 0.0f);
+
+    triangle.x = screen[0].x;
+    triangle.y = screen[0].y;
+    const auto plane = [&](float f0, float f1, float f2)
+    {
+        const std::array<Edge, 3>& e = triangle.edges;
+        return Plane
+        {
+            .dx = (e[0].a * f0 + e[1].a * f1 + e[2].a * f2) / area,
+            .dy = (e[0].b * f0 + e[1].b * f1 + e[2].b * f2) / area,
+            .value = f0
+        };
+    };
+
+    triangle.depth = plane(screen[0].z, screen[1].z, screen[2].z);
+    triangle.inv_w = plane(inv_w[0], inv_w[1], inv_w[2]);
+    for (size_t k = 0; k < varying_count; k++)
+        triangle.varyings[k] = plane(vertices[0].varyings[k] * inv_w[0],
+                                     vertices[1].varyings[k] * inv_w[1],
+                                     vertices[2].varyings[k] * inv_w[2]);
+    return true;
+}
+
+/*
+ * Sutherland-Hodgman against z = -w, the only plane that has to be
+ * clipped: the others are handled by the bounding box and depth range.
+ */
+static size_t clip_near(const std::array<ClipVertex, 3>& input,
+                        size_t varying_count,
+                        std::array<ClipVertex, 4>& output)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const ClipVertex& a = input[i];
+        const ClipVertex& b = input[(i + 1) % 3];
+        const float da = a.position.z + a.position.w;
+        const float db = b.position.z + b.position.w;
+
+        if (da >= 0.0f)
+            output[count++] = a;
+
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            const float t = da / (da - db);
+            ClipVertex& v = output[count++];
+            v.position = glm::mix(a.position, b.position, t);
+            for (size_t k = 0; k < varying_count; k++)
+                v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+        }
+    }
+    return count;
+}
+
+static bool outside_frustum(const std::array<ClipVertex, 3>& vertices)
+{
+    const auto all = [&](auto outside)
+    {
+        return outside(vertices[0].position) && outside(vertices[1].position) && outside(vertices[2].position);
+    };
+
+    return all([](const glm::vec4& p) { return p.x > p.w; }) ||
+           all([](const glm::vec4& p) { return p.x < -p.w; }) ||
+           all([](const glm::vec4& p) { return p.y > p.w; }) ||
+           all([](const glm::vec4& p) { return p.y < -p.w; }) ||
+           all([](const glm::vec4& p) { return p.z > p.w; }) ||
+           all([](const glm::vec4& p) { return p.z < -p.w; });
+}
+
+/*
+ * Vertex stage of tex_v or phong_v for the items of one chunk, then
+ * clipping, setup and binning.
+ */
+static void process_chunk(size_t chunk,
+                          size_t chunk_count,
+                          size_t item_count,
+                          const glm::mat4& view_projection,
+                          const SoftwareTarget& target,
+                          const SoftwareRenderOptions& options)
+{
+    const size_t first = item_count * chunk / chunk_count;
+    const size_t last = item_count * (chunk + 1) / chunk_count;
+    const bool phong = options.pipeline == SoftwarePipeline::phong;
+    const size_t varying_count = phong == true ? 8 : 2;
+
+    const int tiles_x = target.stride / tile_size;
+    const size_t tile_count = static_cast<size_t>(tiles_x) * (target.color.size() / target.stride / tile_size);
+    uint32_t* offsets = &s_bin_offsets[chunk * (tile_count + 2)];
+    std::fill(offsets, offsets + tile_count + 2, 0u);
+
+    ChunkStats stats{};
+    const uint32_t first_triangle = static_cast<uint32_t>(first * max_triangles_per_item);
+    uint32_t triangle_index = first_triangle;
+    const float* mesh = cube_vertices();
+
+    for (size_t item = first; item < last; item++)
+    {
+        const glm::mat4& model = s_items[item]->model;
+        const glm::mat4 mvp = view_projection * model;
+        const glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+        for (size_t t = 0; t < cube_vertex_count / 3; t++)
+        {
+            std::array<ClipVertex, 3> vertices;
+            for (size_t i = 0; i < 3; i++)
+            {
+                const float* source = &mesh[(t * 3 + i) * 8];
+                const glm::vec4 position(source[0], source[1], source[2], 1.0f);
+                ClipVertex& v = vertices[i];
+                v.position = mvp * position;
+                v.varyings[0] = source[6];
+                v.varyings[1] = source[7];
+                if (phong == true)
+                {
+                    const glm::vec3 world = glm::vec3(model * position);
+                    const glm::vec3 normal = normal_matrix * glm::vec3(source[3], source[4], source[5]);
+                    v.varyings[2] = world.x;
+                    v.varyings[3] = world.y;
+                    v.varyings[4] = world.z;
+                    v.varyings[5] = normal.x;
+                    v.varyings[6] = normal.y;
+                    v.varyings[7] = normal.z;
+                }
+            }
+
+            if (outside_frustum(vertices) == true)
+            {
+                stats.culled++;
+                continue;
+            }
+
+            std::array<ClipVertex, 4> clipped;
+            size_t clipped_count = 3;
+            const bool crosses_near = vertices[0].position.z < -vertices[0].position.w ||
+                                      vertices[1].position.z < -vertices[1].position.w ||
+                                      vertices[2].position.z < -vertices[2].position.w;
+            if (crosses_near == true)
+            {
+                stats.clipped++;
+                clipped_count = clip_near(vertices, varying_count, clipped);
+            }
+            else
+            {
+                std::copy(vertices.begin(), vertices.end(), clipped.begin());
+            }
+
+            for (size_t fan = 1; fan + 1 < clipped_count; fan++)
+            {
+                const std::array<ClipVertex, 3> triangle_vertices = { clipped[0], clipped[fan], clipped[fan + 1] };
+                RasterTriangle& triangle = s_triangles[triangle_index];
+                if (setup_triangle(triangle_vertices, varying_count, target.width, target.height, triangle) == false)
+                {
+                    stats.culled++;
+                    continue;
+                }
+
+                for (int ty = triangle.min_y / tile_size; ty <= triangle.max_y / tile_size; ty++)
+                {
+                    for (int tx = triangle.min_x / tile_size; tx <= triangle.max_x / tile_size; tx++)
+                    {
+                        offsets[static_cast<size_t>(ty) * tiles_x + tx + 2]++;
+                        stats.binned++;
+                    }
+                }
+                triangle_index++;
+            }
+        }
+    }
+
+    /*
+     * Counting sort: offsets[t + 1] is now where tile t starts, and
+     * bin_chunk() moves it to where tile t + 1 starts.
+     */
+    for (size_t i = 2; i < tile_count + 2; i++)
+        offsets[i] += offsets[i - 1];
+
+    s_chunk_stats[chunk] = stats;
+    s_chunk_bins[chunk].first_triangle = first_triangle;
+    s_chunk_bins[chunk].end_triangle = triangle_index;
+}
+
+/*
+ * Write the triangles of one chunk into its bins, in submission order.
+ */
+static void bin_chunk(size_t chunk, size_t tile_count, int tiles_x)
+{
+    const ChunkBins& bins = s_chunk_bins[chunk];
+    uint32_t* offsets = &s_bin_offsets[chunk * (tile_count + 2)];
+    uint32_t* entries = s_bin_entries.data() + bins.first_entry;
+
+    for (uint32_t index = bins.first_triangle; index < bins.end_triangle; index++)
+    {
+        const RasterTriangle& triangle = s_triangles[index];
+        for (int ty = triangle.min_y / tile_size; ty <= triangle.max_y / tile_size; ty++)
+            for (int tx = triangle.min_x / tile_size; tx <= triangle.max_x / tile_size; tx++)
+                entries[offsets[static_cast<size_t>(ty) * tiles_x + tx + 1]++] = index;
+    }
+}
+
+bool init_software_renderer(void)
+{
+    if (load_texture("resources/textures/tu_white.png") == false)
+        return false;
+
+    s_items.resize(max_draw_items);
+    s_triangles.resize(max_draw_items * max_triangles_per_item);
+
+#if defined(CG_AVX2)
+    s_avx2 = cpu_has_avx2();
+    s_raster = s_avx2 == true ? raster_avx2 : raster_scalar;
+#else
+    s_avx2 = false;
+    s_raster = raster_scalar;
+#endif
+    return true;
+}
+
+void cleanup_software_renderer(void)
+{
+    s_texture.clear();
+    s_items.clear();
+    s_triangles.clear();
+    s_bin_entries.clear();
+    s_bin_offsets.clear();
+    s_raster = nullptr;
+}
+
+bool software_renderer_uses_avx2(void)
+{
+    return s_avx2;
+}
+
+void software_clear(SoftwareTarget& target)
+{
+    CG_PROFILE_SCOPE("software clear");
+
+    const uint32_t color = pack_color(glm::vec4(glm::vec3(clear_color) * clear_color.w, clear_color.w));
+    std::fill(target.color.begin(), target.color.end(), color);
+    std::fill(target.depth.begin(), target.depth.end(), 1.0f);
+}
+
+void software_render_scene(SoftwareTarget& target, const SoftwareRenderOptions& options)
+{
+    CG_PROFILE_SCOPE("software render");
+
+    const glm::mat4 view_projection = projection_matrix() * view_matrix();
+    size_t item_count = gather_draw_items(s_items.data(), s_items.size());
+    if (occlusion_settings.enabled == true)
+        item_count = cull_occluded_items(s_items.data(), item_count, view_projection);
+    s_shade =
+    {
+        .light_position = light_position(),
+        .light_color = light_color(),
+        .view_position = camera.eye
+    };
+
+    const int tiles_x = target.stride / tile_size;
+    const int tiles_y = static_cast<int>(target.color.size() / target.stride / tile_size);
+    const size_t tile_count = static_cast<size_t>(tiles_x) * tiles_y;
+    const size_t chunk_count = std::clamp<size_t>(item_count, 1, bin_chunks);
+
+    /*
+     * Bins keep their capacity, so a warmed up frame does not allocate.
+     */
+    if (s_bin_offsets.size() < chunk_count * (tile_count + 2))
+        s_bin_offsets.resize(chunk_count * (tile_count + 2));
+
+    {
+        CG_PROFILE_SCOPE("software vertices");
+        parallel_for(chunk_count, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t chunk = begin; chunk < end; chunk++)
+                process_chunk(chunk, chunk_count, item_count, view_projection, target, options);
+        });
+
+        /*
+         * The entries keep room for twice the busiest frame yet, so a
+         * warmed up frame rarely grows them.
+         */
+        uint32_t entry_count = 0;
+        for (size_t chunk = 0; chunk < chunk_count; chunk++)
+        {
+            s_chunk_bins[chunk].first_entry = entry_count;
+            entry_count += static_cast<uint32_t>(s_chunk_stats[chunk].binned);
+        }
+        if (s_bin_entries.size() < entry_count)
+            s_bin_entries.resize(std::max(static_cast<size_t>(entry_count) * 2, tile_count * min_bin_layers));
+
+        parallel_for(chunk_count, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t chunk = begin; chunk < end; chunk++)
+                bin_chunk(chunk, tile_count, tiles_x);
+        });
+    }
+
+    std::atomic<uint64_t> fragments = 0;
+    {
+        CG_PROFILE_SCOPE("software tiles");
+        parallel_for(tile_count, 1, [&](size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; index++)
+            {
+                const int tx = static_cast<int>(index % tiles_x);
+                const int ty = static_cast<int>(index / tiles_x);
+                TileContext tile =
+                {
+                    .target = &target,
+                    .options = &options,
+                    .x0 = tx * tile_size,
+                    .y0 = ty * tile_size,
+                    .x1 = std::min((tx + 1) * tile_size, target.width) - 1,
+                    .y1 = std::min((ty + 1) * tile_size, target.height) - 1,
+                    .fragments = 0
+                };
+                if (tile.x0 > tile.x1 || tile.y0 > tile.y1)
+                    continue;
+
+                for (size_t chunk = 0; chunk < chunk_count; chunk++)
+                {
+                    const uint32_t* offsets = &s_bin_offsets[chunk * (tile_count + 2)];
+                    const uint32_t* entries = s_bin_entries.data() + s_chunk_bins[chunk].first_entry;
+                    for (uint32_t entry = offsets[index]; entry < offsets[index + 1]; entry++)
+                        s_raster(tile, s_triangles[entries[entry]]);
+                }
+
+                fragments.fetch_add(tile.fragments, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    s_stats = {};
+    s_stats.triangles = item_count * (cube_vertex_count / 3);
+    for (size_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        s_stats.triangles_culled += s_chunk_stats[chunk].culled;
+        s_stats.triangles_clipped += s_chunk_stats[chunk].clipped;
+        s_stats.tile_triangles += s_chunk_stats[chunk].binned;
+    }
+    s_stats.fragments = fragments.load(std::memory_order_relaxed);
+}
+
+const SoftwareStats& last_software_stats(void)
+{
+    return s_stats;
+}
+
+} // namespace cg
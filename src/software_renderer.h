@@ -0,0 +1,86 @@
+#ifndef CG_SOFTWARE_RENDERER
+#define CG_SOFTWARE_RENDERER
+
+#include "image.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * The shader pairs the CPU backend implements.
+ */
+enum class SoftwarePipeline
+{
+    textured, /* tex_v / tex_f */
+    phong     /* phong_v / phong_f */
+};
+
+enum class SoftwareFilter
+{
+    bilinear, /* Level 0 only, like the GL path's GL_LINEAR. */
+    trilinear /* Mipmapped, level of detail from the UV derivatives. */
+};
+
+struct SoftwareRenderOptions
+{
+    SoftwarePipeline pipeline = SoftwarePipeline::textured;
+    SoftwareFilter filter = SoftwareFilter::bilinear;
+};
+
+/*
+ * Color and depth of the CPU backend. Rows run top to bottom and are
+ * padded to whole tiles, so the rasteriser never checks the edges.
+ */
+struct SoftwareTarget
+{
+    int width = 0;
+    int height = 0;
+    int stride = 0;              /* Pixels per row. */
+    std::vector<uint32_t> color; /* RGBA8. */
+    std::vector<float> depth;
+};
+
+void resize_software_target(SoftwareTarget& target, int width, int height);
+ImageView software_view(const SoftwareTarget& target);
+
+/*
+ * What the last software_render_scene() did.
+ */
+struct SoftwareStats
+{
+    uint64_t triangles;         /* Submitted. */
+    uint64_t triangles_culled;  /* Outside the frustum or degenerate. */
+    uint64_t triangles_clipped; /* Crossed the near plane. */
+    uint64_t tile_triangles;    /* Triangle and tile pairs binned. */
+    uint64_t fragments;         /* Passed the depth test and were shaded. */
+};
+
+/*
+ * Loads the texture and picks the AVX2 or scalar rasteriser. Needs no GL
+ * context.
+ */
+bool init_software_renderer(void);
+void cleanup_software_renderer(void);
+bool software_renderer_uses_avx2(void);
+
+/*
+ * Clear to the renderer's clear color and far depth.
+ */
+void software_clear(SoftwareTarget& target);
+
+/*
+ * Draw the renderer's draw items from cg::camera with cg::perspective,
+ * like render_scene(). Vertices are transformed, clipped and binned into
+ * 64 x 64 pixel tiles in parallel, then every tile is rasterised by one
+ * job: edge functions 8 pixels at a time, depth test, perspective-correct
+ * varyings, texture sampling and alpha blending in submission order.
+ */
+void software_render_scene(SoftwareTarget& target, const SoftwareRenderOptions& options);
+const SoftwareStats& last_software_stats(void);
+
+} // namespace cg
+
+#endif
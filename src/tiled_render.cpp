@@ -0,0 +1,160 @@
+#include "glad/glad.h"
+
+#include "tiled_render.h"
+#include "frame_arena.h"
+#include "image.h"
+#include "jobs.h"
+#include "render_target.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace cg
+{
+
+/*
+ * Largest square the framebuffer, its attachments and the viewport allow.
+ */
+static int max_tile_extent(void)
+{
+    GLint renderbuffer = 0;
+    GLint texture = 0;
+    GLint viewport[2] = {};
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbuffer);
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &texture);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, viewport);
+    return std::min({ renderbuffer, texture, viewport[0], viewport[1] });
+}
+
+TiledRenderResult render_tiled(const TiledRenderOptions& options)
+{
+    TiledRenderResult result{};
+    const auto start = std::chrono::steady_clock::now();
+
+    const int overlap = std::max(options.overlap, 0);
+    const int tile = std::min(options.tile_size, max_tile_extent() - 2 * overlap);
+    if (tile <= 0)
+        return result;
+
+    const int extent = tile + 2 * overlap;
+    result.tile_size = tile;
+    result.tiles_x = (options.width + tile - 1) / tile;
+    result.tiles_y = (options.height + tile - 1) / tile;
+
+    RenderTarget target = create_render_target(extent, extent, "tile");
+    if (target.framebuffer == 0)
+        return result;
+
+    PngWriter writer;
+    if (writer.open(options.path, options.width, options.height) == false)
+    {
+        std::cerr << "Failed to open " << options.path << std::endl;
+        destroy_render_target(target);
+        return result;
+    }
+
+    /*
+     * The frustum keeps the aspect of the whole image; every tile renders
+     * a square part of it.
+     */
+    const float saved_aspect = perspective.aspect;
+    perspective.aspect = static_cast<float>(options.width) / options.height;
+
+    const size_t band_stride = static_cast<size_t>(options.width) * 4;
+    std::array<std::vector<uint8_t>, 2> bands;
+    for (std::vector<uint8_t>& band : bands)
+        band.resize(band_stride * tile);
+
+    /*
+     * At most one band is being written while the next one renders.
+     */
+    JobCounter writing;
+    bool written = true;
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, options.width);
+
+    for (int ty = 0; ty < result.tiles_y; ty++)
+    {
+        const int y0 = ty * tile;
+        const int rows = std::min(tile, options.height - y0);
+        std::vector<uint8_t>& band = bands[ty % 2];
+
+        for (int tx = 0; tx < result.tiles_x; tx++)
+        {
+            const int x0 = tx * tile;
+            const int columns = std::min(tile, options.width - x0);
+
+            /*
+             * Pixel rectangle of the whole target, guard band included,
+             * mapped into the image's normalised device coordinates. Image
+             * rows run top down, NDC y bottom up.
+             */
+            const float left = static_cast<float>(x0 - overlap);
+            const float top = static_cast<float>(y0 - overlap);
+            set_projection_window(glm::vec4(-1.0f + 2.0f * left / options.width,
+                                            -1.0f + 2.0f * (left + extent) / options.width,
+                                            1.0f - 2.0f * (top + extent) / options.height,
+                                            1.0f - 2.0f * top / options.height));
+
+            begin_frame_arena();
+            bind_render_target(target);
+            clear_frame();
+            render_scene();
+
+            /*
+             * The kept rows sit overlap pixels below the target's top edge.
+             * They land bottom-up in the band.
+             */
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+            glReadPixels(overlap,
+                         extent - overlap - rows,
+                         columns,
+                         rows,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE,
+                         band.data() + static_cast<size_t>(x0) * 4);
+        }
+
+        /*
+         * Band ty - 1 must be written first; it also frees its buffer for
+         * band ty + 1.
+         */
+        wait_for_counter(writing);
+
+        const ImageView view =
+        {
+            .pixels = band.data() + band_stride * (rows - 1),
+            .width = options.width,
+            .height = rows,
+            .stride = -static_cast<ptrdiff_t>(band_stride)
+        };
+        PngWriter* png = &writer;
+        bool* ok = &written;
+        run_job([png, view, ok]()
+        {
+            if (png->write_rows(view) == false)
+                *ok = false;
+        }, &writing);
+    }
+
+    wait_for_counter(writing);
+
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    reset_projection_window();
+    perspective.aspect = saved_aspect;
+    destroy_render_target(target);
+
+    result.written = writer.close() == true && written == true;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // namespace cg
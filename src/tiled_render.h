@@ -0,0 +1,39 @@
+#ifndef CG_TILED_RENDER
+#define CG_TILED_RENDER
+
+namespace cg
+{
+
+struct TiledRenderOptions
+{
+    const char* path;  /* PNG output. */
+    int width;
+    int height;
+    int tile_size;     /* Upper bound; also limited by the GL maximums. */
+    int overlap;       /* Guard band rendered around every tile and discarded. */
+};
+
+struct TiledRenderResult
+{
+    bool written;
+    int tile_size;     /* Visible part of each tile. */
+    int tiles_x;
+    int tiles_y;
+    double seconds;
+};
+
+/*
+ * Render the current view at a size no framebuffer could hold. The
+ * projection is split into off-centre sub-frusta, one per tile; each row
+ * of tiles is read into a band and streamed to a PngWriter on a job
+ * worker while the next row renders, so only two bands are ever held.
+ *
+ * Each tile is rendered overlap pixels larger on every side than the part
+ * kept, so screen-space effects sample real neighbours instead of the tile
+ * edge. Needs the renderer and the job system initialised.
+ */
+TiledRenderResult render_tiled(const TiledRenderOptions& options);
+
+} // namespace cg
+
+#endif
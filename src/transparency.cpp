@@ -0,0 +1,441 @@
+#include "glad/glad.h"
+
+#include "transparency.h"
+#include "bvh.h"
+#include "gl_debug.h"
+#include "gpu_profiler.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "structs.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace cg
+{
+
+TransparencySettings transparency_settings =
+{
+    .mode = TransparencyMode::sorted,
+    .object_count = 0,
+    .opacity = 0.35f
+};
+
+/*
+ * One cube as transparent_v.glsl sees it, std430.
+ */
+struct TransparentObject
+{
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+struct SortKey
+{
+    float depth; /* Of the centre, along the view direction. */
+    uint32_t index;
+};
+
+static unsigned int s_sorted_program = 0;
+static unsigned int s_weighted_program = 0;
+static unsigned int s_composite_program = 0;
+static unsigned int s_object_buffer = 0;
+static unsigned int s_order_buffer = 0; /* Drawing order of the sorted mode. */
+static unsigned int s_vertex_array = 0; /* Empty, for the full screen triangle. */
+static std::vector<TransparentObject> s_objects;
+static std::vector<SortKey> s_keys;
+static std::vector<uint32_t> s_order;
+static TransparencySettings s_placed_settings{};
+static Bounds s_placed_bounds{ glm::vec3(0.0f), glm::vec3(0.0f) };
+static TransparencyStats s_stats{};
+
+/*
+ * Targets of the weighted mode, sized to cover the viewport from the
+ * framebuffer's origin so the depth can be copied rectangle to rectangle.
+ */
+static unsigned int s_framebuffer = 0;
+static unsigned int s_accumulation = 0;
+static unsigned int s_revealage = 0;
+static unsigned int s_depth = 0;
+static int s_width = 0;
+static int s_height = 0;
+static GLenum s_depth_format = GL_NONE;
+
+static unsigned int create_texture(GLenum format, int width, int height, const char* label)
+{
+    unsigned int texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    label_gl_object(GL_TEXTURE, texture, label);
+    return texture;
+}
+
+static void delete_targets(void)
+{
+    glDeleteTextures(1, &s_accumulation);
+    glDeleteTextures(1, &s_revealage);
+    glDeleteRenderbuffers(1, &s_depth);
+    s_accumulation = 0;
+    s_revealage = 0;
+    s_depth = 0;
+    s_width = 0;
+    s_height = 0;
+    s_depth_format = GL_NONE;
+}
+
+/*
+ * glBlitFramebuffer() copies depth only between equal formats, so the
+ * copy is made in whatever the frame uses. GL_NONE without depth.
+ */
+static GLenum bound_depth_format(void)
+{
+    int framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    const GLenum depth = framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+    const GLenum stencil = framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+
+    int type = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    if (type == GL_NONE)
+        return GL_NONE;
+
+    int depth_bits = 0;
+    int component_type = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits);
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, depth, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE,
+                                          &component_type);
+
+    int stencil_type = GL_NONE;
+    int stencil_bits = 0;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, stencil, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE,
+                                          &stencil_type);
+    if (stencil_type != GL_NONE)
+        glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, stencil, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE,
+                                              &stencil_bits);
+
+    if (component_type == GL_FLOAT)
+        return stencil_bits > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+    if (stencil_bits > 0)
+        return GL_DEPTH24_STENCIL8;
+    if (depth_bits <= 16)
+        return GL_DEPTH_COMPONENT16;
+    return depth_bits <= 24 ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT32;
+}
+
+/*
+ * Accumulated premultiplied colour and weight in RGBA16F, and how much of
+ * the background shows through in R8.
+ */
+static bool create_targets(int width, int height, GLenum depth_format, unsigned int target_framebuffer)
+{
+    delete_targets();
+    s_accumulation = create_texture(GL_RGBA16F, width, height, "oit accumulation");
+    s_revealage = create_texture(GL_R8, width, height, "oit revealage");
+    glGenRenderbuffers(1, &s_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, s_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, depth_format, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    label_gl_object(GL_RENDERBUFFER, s_depth, "oit depth");
+
+    const bool has_stencil = depth_format == GL_DEPTH24_STENCIL8 || depth_format == GL_DEPTH32F_STENCIL8;
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, s_accumulation, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, s_revealage, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              has_stencil == true ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              s_depth);
+    const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "OIT targets incomplete: " << status << std::endl;
+        delete_targets();
+        return false;
+    }
+
+    s_width = width;
+    s_height = height;
+    s_depth_format = depth_format;
+    return true;
+}
+
+bool init_transparency(void)
+{
+    if (GLAD_GL_VERSION_4_3 == 0)
+        return false;
+
+    s_sorted_program = load_program("resources/shaders/transparent_v.glsl", "resources/shaders/transparent_f.glsl");
+    if (s_sorted_program == 0)
+        return false;
+
+    s_weighted_program = load_program("resources/shaders/transparent_v.glsl",
+                                      "resources/shaders/transparent_oit_f.glsl");
+    s_composite_program = load_program("resources/shaders/deferred_light_v.glsl",
+                                       "resources/shaders/oit_composite_f.glsl");
+    if (s_weighted_program == 0 || s_composite_program == 0)
+    {
+        glDeleteProgram(s_weighted_program);
+        glDeleteProgram(s_composite_program);
+        s_weighted_program = 0;
+        s_composite_program = 0;
+    }
+
+    glGenBuffers(1, &s_object_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_object_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_transparent_objects * sizeof(TransparentObject), nullptr,
+                 GL_DYNAMIC_DRAW);
+    label_gl_object(GL_BUFFER, s_object_buffer, "transparent objects");
+    glGenBuffers(1, &s_order_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_order_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, max_transparent_objects * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+    label_gl_object(GL_BUFFER, s_order_buffer, "transparent order");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenFramebuffers(1, &s_framebuffer);
+    label_gl_object(GL_FRAMEBUFFER, s_framebuffer, "oit");
+    glGenVertexArrays(1, &s_vertex_array);
+
+    s_objects.reserve(max_transparent_objects);
+    s_objects.clear();
+    s_keys.resize(max_transparent_objects);
+    s_order.resize(max_transparent_objects);
+    s_placed_settings = {};
+    s_stats = {};
+    return true;
+}
+
+void cleanup_transparency(void)
+{
+    delete_targets();
+    glDeleteProgram(s_sorted_program);
+    glDeleteProgram(s_weighted_program);
+    glDeleteProgram(s_composite_program);
+    glDeleteBuffers(1, &s_object_buffer);
+    glDeleteBuffers(1, &s_order_buffer);
+    glDeleteFramebuffers(1, &s_framebuffer);
+    glDeleteVertexArrays(1, &s_vertex_array);
+    s_sorted_program = 0;
+    s_weighted_program = 0;
+    s_composite_program = 0;
+    s_object_buffer = 0;
+    s_order_buffer = 0;
+    s_framebuffer = 0;
+    s_vertex_array = 0;
+    s_objects.clear();
+}
+
+/*
+ * Integer hash to [0, 1), so every run places the same cubes.
+ */
+static float random_unit(uint32_t index, uint32_t dimension)
+{
+    uint32_t hash = (index * 8u + dimension) * 2246822519u;
+    hash ^= hash >> 13;
+    hash *= 2654435761u;
+    hash ^= hash >> 16;
+    return static_cast<float>(hash >> 8) / 16777216.0f;
+}
+
+void update_transparent_objects(const DrawItem* const* items, size_t count)
+{
+    if (transparency_settings.object_count <= 0 && s_objects.empty() == true)
+        return;
+
+    const Bounds cube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+    Bounds scene{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (size_t i = 0; i < count; i++)
+    {
+        const Bounds bounds = transform_bounds(cube, items[i]->model);
+        scene.min = i == 0 ? bounds.min : glm::min(scene.min, bounds.min);
+        scene.max = i == 0 ? bounds.max : glm::max(scene.max, bounds.max);
+    }
+
+    const int object_count = std::clamp(transparency_settings.object_count, 0, max_transparent_objects);
+    if (object_count == static_cast<int>(s_objects.size()) &&
+        transparency_settings.opacity == s_placed_settings.opacity &&
+        scene.min == s_placed_bounds.min && scene.max == s_placed_bounds.max)
+        return;
+
+    /*
+     * Turned a little and smaller than the scene's cubes, so they cut
+     * through each other and through the opaque ones.
+     */
+    const glm::vec3 low = scene.min - glm::vec3(1.0f);
+    const glm::vec3 size = scene.max - scene.min + glm::vec3(2.0f);
+    s_objects.resize(object_count);
+    for (int i = 0; i < object_count; i++)
+    {
+        const uint32_t index = static_cast<uint32_t>(i);
+        const glm::vec3 position = low + size * glm::vec3(random_unit(index, 0),
+                                                          random_unit(index, 1),
+                                                          random_unit(index, 2));
+        const float scale = 0.3f + 0.5f * random_unit(index, 3);
+        const float angle = glm::two_pi<float>() * random_unit(index, 4);
+        const glm::vec3 color = glm::vec3(random_unit(index, 5), random_unit(index, 6), random_unit(index, 7));
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, angle, glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f)));
+        s_objects[i] =
+        {
+            .model = glm::scale(model, glm::vec3(scale)),
+            .color = glm::vec4(0.2f + 0.8f * color, transparency_settings.opacity)
+        };
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_object_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, s_objects.size() * sizeof(TransparentObject), s_objects.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    s_placed_settings = transparency_settings;
+    s_placed_bounds = scene;
+}
+
+static void draw_objects(unsigned int program, unsigned int vertex_array, bool sorted)
+{
+    glUseProgram(program);
+    glUniformMatrix4fv(get_uniform_location(program, "u_view"), 1, false, glm::value_ptr(view_matrix()));
+    glUniformMatrix4fv(get_uniform_location(program, "u_projection"), 1, false,
+                       glm::value_ptr(projection_matrix()));
+    glUniform3fv(get_uniform_location(program, "u_view_pos"), 1, glm::value_ptr(camera.eye));
+    glUniform3fv(get_uniform_location(program, "u_light_pos"), 1, glm::value_ptr(light_position()));
+    glUniform3fv(get_uniform_location(program, "u_light_color"), 1, glm::value_ptr(light_color()));
+    glUniform1i(get_uniform_location(program, "u_sorted"), sorted == true ? 1 : 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, s_object_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, s_order_buffer);
+
+    glBindVertexArray(vertex_array);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<int>(cube_vertex_count), static_cast<int>(s_objects.size()));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, 0);
+}
+
+/*
+ * Farthest centre first, then blended in that order. Cubes that cut
+ * through each other, and the faces of one cube, still blend wrongly.
+ */
+static void render_sorted(unsigned int vertex_array)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const glm::vec4 depth_row = glm::row(view_matrix(), 2);
+    const size_t count = s_objects.size();
+    for (size_t i = 0; i < count; i++)
+        s_keys[i] = { -glm::dot(depth_row, s_objects[i].model[3]), static_cast<uint32_t>(i) };
+    std::sort(s_keys.begin(), s_keys.begin() + count,
+              [](const SortKey& a, const SortKey& b) { return a.depth > b.depth; });
+    for (size_t i = 0; i < count; i++)
+        s_order[i] = s_keys[i].index;
+    s_stats.sort_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, s_order_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(uint32_t), s_order.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glDepthMask(GL_FALSE);
+    draw_objects(s_sorted_program, vertex_array, true);
+    glDepthMask(GL_TRUE);
+}
+
+/*
+ * McGuire and Bavoil's weighted blended order independent transparency.
+ * Every fragment adds its weighted premultiplied colour to one target and
+ * multiplies the other by what it lets through; the composite divides
+ * the sum by the weights and lays it over the frame.
+ */
+static void render_weighted(unsigned int vertex_array)
+{
+    int target_framebuffer = 0;
+    std::array<int, 4> viewport{};
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport.data());
+
+    const int width = viewport[0] + viewport[2];
+    const int height = viewport[1] + viewport[3];
+    const GLenum depth_format = bound_depth_format();
+    if (depth_format == GL_NONE)
+        return;
+    if ((width != s_width || height != s_height || depth_format != s_depth_format) &&
+        create_targets(width, height, depth_format, static_cast<unsigned int>(target_framebuffer)) == false)
+        return;
+
+    const int x0 = viewport[0];
+    const int y0 = viewport[1];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<unsigned int>(target_framebuffer));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, s_framebuffer);
+    glBlitFramebuffer(x0, y0, width, height, x0, y0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, s_framebuffer);
+
+    const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, zero);
+    glClearBufferfv(GL_COLOR, 1, one);
+
+    glDepthMask(GL_FALSE);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    draw_objects(s_weighted_program, vertex_array, false);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_TRUE);
+
+    GpuZone zone("oit composite");
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(target_framebuffer));
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(s_composite_program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, s_accumulation);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, s_revealage);
+    glBindVertexArray(s_vertex_array);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void render_transparent_objects(unsigned int vertex_array)
+{
+    CG_PROFILE_SCOPE("transparency");
+    s_stats = { .objects = s_objects.size(), .sort_ms = 0.0 };
+    if (s_objects.empty() == true)
+        return;
+
+    GpuZone zone("transparency");
+    if (transparency_settings.mode == TransparencyMode::weighted && weighted_oit_supported() == true)
+        render_weighted(vertex_array);
+    else
+        render_sorted(vertex_array);
+}
+
+bool weighted_oit_supported(void)
+{
+    return s_weighted_program != 0 && s_composite_program != 0;
+}
+
+const TransparencyStats& last_transparency_stats(void)
+{
+    return s_stats;
+}
+
+const char* transparency_mode_name(TransparencyMode mode)
+{
+    switch (mode)
+    {
+        case TransparencyMode::weighted:
+            return "weighted";
+        case TransparencyMode::sorted:
+        default:
+            return "sorted";
+    }
+}
+
+} // namespace cg
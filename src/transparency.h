@@ -0,0 +1,69 @@
+#ifndef CG_TRANSPARENCY
+#define CG_TRANSPARENCY
+
+#include <cstddef>
+
+namespace cg
+{
+
+struct DrawItem;
+
+constexpr int max_transparent_objects = 16384;
+
+/*
+ * How render_scene() draws the transparent objects, after everything
+ * opaque.
+ */
+enum class TransparencyMode
+{
+    sorted,  /* Back to front on the CPU, blended over the frame in order. */
+    weighted /* Weighted blended OIT: accumulated in any order, then composited. */
+};
+
+struct TransparencySettings
+{
+    TransparencyMode mode;
+    int object_count; /* 0 to max_transparent_objects; 0 draws none. */
+    float opacity;
+};
+extern TransparencySettings transparency_settings;
+
+/*
+ * Of the last render_transparent_objects().
+ */
+struct TransparencyStats
+{
+    size_t objects;
+    double sort_ms; /* Depth keys and sorting; 0 when weighted. */
+};
+
+/*
+ * Needs a current context with GL loaded. Returns false below OpenGL 4.3,
+ * which has no shader storage buffers. The weighted mode is set up
+ * separately; without it, it draws sorted.
+ */
+bool init_transparency(void);
+void cleanup_transparency(void);
+bool weighted_oit_supported(void);
+
+/*
+ * Scatter the transparent cubes through the box around the items, as
+ * update_lights() does. They are placed again only when the settings or
+ * the box change.
+ */
+void update_transparent_objects(const DrawItem* const* items, size_t count);
+
+/*
+ * Draw the transparent cubes, lit by the light of set_light(), into the
+ * bound framebuffer and viewport. Tests against the depth already there
+ * and leaves it unchanged.
+ */
+void render_transparent_objects(unsigned int vertex_array);
+
+const TransparencyStats& last_transparency_stats(void);
+
+const char* transparency_mode_name(TransparencyMode mode);
+
+} // namespace cg
+
+#endif
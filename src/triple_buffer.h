@@ -0,0 +1,79 @@
+#ifndef CG_TRIPLE_BUFFER
+#define CG_TRIPLE_BUFFER
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace cg
+{
+
+/*
+ * Lock-free single producer, single consumer triple buffer.
+ * The writer always owns one slot, the reader always owns one slot and the
+ * third slot is the hand-off point. Publishing and acquiring are a single
+ * atomic exchange each, so neither side ever waits on the other.
+ *
+ * The shared state packs the index of the hand-off slot in the low bits and
+ * a "fresh data" flag in bit 2.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(void) = default;
+
+    explicit TripleBuffer(const T& initial)
+    {
+        m_slots.fill(initial);
+    }
+
+    /*
+     * Writer side. Fill the returned slot, then call publish().
+     */
+    T& back(void)
+    {
+        return m_slots[m_back];
+    }
+
+    void publish(void)
+    {
+        const uint8_t previous = m_shared.exchange(m_back | fresh_bit,
+                                                   std::memory_order_acq_rel);
+        m_back = previous & index_mask;
+    }
+
+    void write(const T& value)
+    {
+        back() = value;
+        publish();
+    }
+
+    /*
+     * Reader side. Returns the newest published value. If nothing new was
+     * published since the last call the previous value is returned again.
+     */
+    const T& read(void)
+    {
+        if ((m_shared.load(std::memory_order_relaxed) & fresh_bit) != 0)
+        {
+            const uint8_t previous = m_shared.exchange(m_front,
+                                                       std::memory_order_acq_rel);
+            m_front = previous & index_mask;
+        }
+        return m_slots[m_front];
+    }
+
+private:
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh_bit = 0x4;
+
+    std::array<T, 3> m_slots{};
+    std::atomic<uint8_t> m_shared{1};
+    uint8_t m_back = 0;
+    uint8_t m_front = 2;
+};
+
+} // namespace cg
+
+#endif
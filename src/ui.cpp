@@ -3,12 +3,55 @@
 #include "backends/imgui_impl_opengl3.h"
 #include "ui.h"
 #include "structs.h"
+#include "simulation.h"
+#include "jobs.h"
+#include "job_benchmark.h"
+#include "allocation_tracker.h"
+#include "gpu_profiler.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "gl_counters.h"
+#include "gl_debug.h"
+#include "input.h"
+#include "occlusion.h"
+#include "shadows.h"
+#include "deferred.h"
+#include "depth_prepass.h"
+#include "clustered.h"
+#include "lights.h"
+#include "mesh_lod.h"
+#include "renderer.h"
+#include "path_tracer.h"
+#include "transparency.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
 
 namespace cg
 {
 
+/*
+ * Worker statistics of the Jobs window, being gathered and shown. The two
+ * are swapped every second, so both are reserved here, before the
+ * steady-state allocation check starts.
+ */
+static std::vector<JobStats> s_current_job_stats;
+static std::vector<JobStats> s_job_stats;
+
 void init_ImGui(GLFWwindow* window)
 {
+    /*
+     * As many workers as init_jobs() starts by default.
+     */
+    const unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+    s_current_job_stats.reserve(workers);
+    s_job_stats.reserve(workers);
+
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
@@ -20,8 +63,705 @@ void init_ImGui(GLFWwindow* window)
     ImGui_ImplOpenGL3_Init(cg::version.glsl_version);
 }
 
+/*
+ * Frame times next to the simulation load.
+ * Raising the load should not move the frame time graph.
+ */
+static void show_simulation_window(void)
+{
+    static std::array<float, 120> frame_times{};
+    static size_t frame_index = 0;
+
+    const ImGuiIO& io = ImGui::GetIO();
+    frame_times[frame_index] = io.DeltaTime * 1000.0f;
+    frame_index = (frame_index + 1) % frame_times.size();
+
+    ImGui::Begin("Simulation");
+    ImGui::Text("Frame: %.2f ms (%.0f FPS)", 1000.0f / io.Framerate, io.Framerate);
+    ImGui::Text("Tick: %llu",
+                static_cast<unsigned long long>(simulation_snapshot().current.tick));
+    ImGui::Text("Heap allocations: %llu",
+                static_cast<unsigned long long>(last_frame_allocations()));
+    ImGui::PlotLines("Frame time (ms)",
+                     frame_times.data(),
+                     static_cast<int>(frame_times.size()),
+                     static_cast<int>(frame_index),
+                     nullptr,
+                     0.0f,
+                     50.0f,
+                     ImVec2(0.0f, 60.0f));
+
+    float load = sim_settings.extra_load_ms.load();
+    if (ImGui::SliderFloat("Step load (ms)", &load, 0.0f, 50.0f) == true)
+        sim_settings.extra_load_ms.store(load);
+
+    ImGui::End();
+}
+
+/*
+ * Per worker utilisation, refreshed every second.
+ * The benchmark blocks the frame while it runs.
+ */
+static void show_jobs_window(void)
+{
+    static std::vector<JobBenchmarkResult> benchmark;
+    std::vector<JobStats>& stats = s_job_stats;
+
+    job_stats(s_current_job_stats);
+    if (s_current_job_stats.empty() == false && s_current_job_stats[0].elapsed_ns >= 1000000000)
+    {
+        stats.swap(s_current_job_stats);
+        reset_job_stats();
+    }
+
+    ImGui::Begin("Jobs");
+    ImGui::Text("Workers: %u", job_worker_count());
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        const float busy = static_cast<float>(stats[i].busy_ns) / stats[i].elapsed_ns;
+        ImGui::Text("Worker %zu: %llu jobs, %llu stolen",
+                    i,
+                    static_cast<unsigned long long>(stats[i].jobs_executed),
+                    static_cast<unsigned long long>(stats[i].jobs_stolen));
+        ImGui::ProgressBar(busy);
+    }
+
+    if (ImGui::Button("Run scaling benchmark") == true)
+    {
+        benchmark = run_job_benchmark(job_worker_count());
+        stats.clear();
+    }
+
+    if (benchmark.empty() == false &&
+        ImGui::BeginTable("Benchmark", 5, ImGuiTableFlags_Borders) == true)
+    {
+        ImGui::TableSetupColumn("Workers");
+        ImGui::TableSetupColumn("Animation (ms)");
+        ImGui::TableSetupColumn("Culling (ms)");
+        ImGui::TableSetupColumn("Decode (ms)");
+        ImGui::TableSetupColumn("Utilisation");
+        ImGui::TableHeadersRow();
+        for (const JobBenchmarkResult& result : benchmark)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", result.workers);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", result.animation_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", result.culling_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", result.decode_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.0f%%", result.utilisation * 100.0);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+/*
+ * Zone time of the named zone in a history frame, 0 if it did not run.
+ * Names are compared by pointer, they are string literals.
+ */
+static float gpu_zone_ms(const GpuFrameResult& frame, const char* name)
+{
+    for (size_t i = 0; i < frame.zone_count; i++)
+    {
+        if (frame.zones[i].name == name)
+            return static_cast<float>(frame.zones[i].ms);
+    }
+    return 0.0f;
+}
+
+/*
+ * Live timing tree of the newest resolved frame, graphs over the history
+ * and CSV export.
+ */
+static void show_gpu_profiler_window(void)
+{
+    static bool exported = false;
+
+    ImGui::Begin("GPU Profiler");
+
+    const GpuFrameResult* latest = latest_gpu_frame();
+    if (latest == nullptr)
+    {
+        ImGui::Text("Waiting for results.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Frame %llu: %.3f ms GPU (%llu dropped)",
+                static_cast<unsigned long long>(latest->frame),
+                latest->total_ms,
+                static_cast<unsigned long long>(dropped_gpu_frames()));
+
+    for (size_t i = 0; i < latest->zone_count; i++)
+    {
+        const GpuZoneResult& zone = latest->zones[i];
+        const float indent = 16.0f * (zone.depth + 1);
+        const float share = latest->total_ms > 0.0 ? zone.ms / latest->total_ms : 0.0f;
+
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%s %.3f ms", zone.name, zone.ms);
+
+        ImGui::Indent(indent);
+        ImGui::ProgressBar(share, ImVec2(-1.0f, 0.0f), overlay);
+        ImGui::Unindent(indent);
+    }
+
+    ImGui::PlotLines("Frame (ms)",
+                     [](void*, int index)
+                     {
+                         return static_cast<float>(gpu_history(index).total_ms);
+                     },
+                     nullptr,
+                     static_cast<int>(gpu_history_size()),
+                     0,
+                     nullptr,
+                     0.0f,
+                     FLT_MAX,
+                     ImVec2(0.0f, 60.0f));
+
+    for (size_t i = 0; i < latest->zone_count; i++)
+    {
+        const char* name = latest->zones[i].name;
+        ImGui::PlotLines(name,
+                         [](void* data, int index)
+                         {
+                             return gpu_zone_ms(gpu_history(index), static_cast<const char*>(data));
+                         },
+                         const_cast<char*>(name),
+                         static_cast<int>(gpu_history_size()),
+                         0,
+                         nullptr,
+                         0.0f,
+                         FLT_MAX,
+                         ImVec2(0.0f, 40.0f));
+    }
+
+    if (ImGui::Button("Export CSV") == true)
+        exported = export_gpu_csv("gpu_profile.csv");
+    if (exported == true)
+    {
+        ImGui::SameLine();
+        ImGui::Text("Wrote gpu_profile.csv");
+    }
+
+    ImGui::End();
+}
+
+/*
+ * Chrome trace capture of the next few frames.
+ */
+static void show_cpu_profiler_window(void)
+{
+    ImGui::Begin("CPU Profiler");
+#if CG_PROFILE
+    static int frames = 10;
+    static double overhead_ns = 0.0;
+
+    ImGui::InputInt("Frames", &frames);
+    frames = std::max(1, std::min(frames, 500));
+
+    if (trace_capture_pending() == true)
+    {
+        ImGui::Text("Capturing...");
+    }
+    else if (ImGui::Button("Capture trace.json") == true)
+    {
+        capture_trace(static_cast<uint64_t>(frames), "trace.json");
+    }
+
+    if (trace_capture_pending() == false && ImGui::Button("Measure zone overhead") == true)
+        overhead_ns = measure_profile_overhead_ns();
+    if (overhead_ns > 0.0)
+        ImGui::Text("%.1f ns per zone", overhead_ns);
+#else
+    ImGui::Text("Built with CG_PROFILE=0.");
+#endif
+    ImGui::End();
+}
+
+/*
+ * Percentiles of the rolling window. Averages hide hitches, so the tail is
+ * shown next to the median.
+ */
+static void show_frame_stats_window(void)
+{
+    ImGui::Begin("Frame Stats");
+
+    float threshold = static_cast<float>(frame_stats_settings.hitch_threshold_ms);
+    if (ImGui::SliderFloat("Hitch threshold (ms)", &threshold, 5.0f, 100.0f) == true)
+        frame_stats_settings.hitch_threshold_ms = threshold;
+
+    if (ImGui::BeginTable("Percentiles", 7, ImGuiTableFlags_Borders) == true)
+    {
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("p50");
+        ImGui::TableSetupColumn("p90");
+        ImGui::TableSetupColumn("p99");
+        ImGui::TableSetupColumn("p99.9");
+        ImGui::TableSetupColumn("Worst");
+        ImGui::TableSetupColumn("Hitches");
+        ImGui::TableHeadersRow();
+
+        for (size_t i = 0; i < static_cast<size_t>(FrameMetric::count); i++)
+        {
+            const FrameMetric metric = static_cast<FrameMetric>(i);
+            const FrameStatsSummary& stats = window_frame_stats(metric);
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", frame_metric_name(metric));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.p50);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.p90);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.p99);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.p999);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", stats.worst);
+            ImGui::TableNextColumn();
+            if (stats.hitches > 0)
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "%llu",
+                                   static_cast<unsigned long long>(stats.hitches));
+            else
+                ImGui::Text("0");
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Last %llu frames, updated every %llu frames.",
+                static_cast<unsigned long long>(frame_stats_settings.window_frames),
+                static_cast<unsigned long long>(std::max<uint64_t>(frame_stats_settings.window_frames / frame_stats_slices, 1)));
+
+    /*
+     * A long frame can overflow the input ring, so dropped events show up
+     * here next to the hitches that caused them.
+     */
+    ImGui::Text("Input events dropped: %llu",
+                static_cast<unsigned long long>(dropped_input_events()));
+    ImGui::End();
+}
+
+/*
+ * GL calls made by the renderer last frame. ImGui's backend loads its own
+ * GL functions and is not counted.
+ */
+static void show_gl_counters_window(void)
+{
+    ImGui::Begin("GL Counters");
+
+    if (gl_counters_enabled() == false)
+    {
+        ImGui::Text("Built without CG_GL_COUNTERS_ENABLED. Configure with");
+        ImGui::Text("-DCG_GL_COUNTERS=ON, or run premake with --gl-counters.");
+        ImGui::End();
+        return;
+    }
+
+    const GlCounters& counters = last_frame_gl_counters();
+    const auto row = [](const char* name, uint64_t value)
+    {
+        ImGui::Text("%-24s %llu", name, static_cast<unsigned long long>(value));
+    };
+
+    row("GL calls", counters.calls);
+    row("Draw calls", counters.draw_calls);
+    row("Compute dispatches", counters.compute_dispatches);
+    row("Memory barriers", counters.memory_barriers);
+    row("Queries", counters.queries);
+    row("Primitives", counters.primitives);
+    row("Program binds", counters.program_binds);
+    row("Vertex array binds", counters.vertex_array_binds);
+    row("Buffer binds", counters.buffer_binds);
+    row("Texture binds", counters.texture_binds);
+    row("Framebuffer binds", counters.framebuffer_binds);
+    row("Render state changes", counters.render_state_changes);
+    row("Uniform updates", counters.uniform_updates);
+    row("Buffer bytes uploaded", counters.buffer_bytes_uploaded);
+    row("Texture bytes uploaded", counters.texture_bytes_uploaded);
+
+    ImGui::End();
+}
+
+/*
+ * KHR_debug messages. Performance warnings are listed apart from the rest,
+ * they point at stalls rather than bugs.
+ */
+static void show_gl_debug_window(void)
+{
+    static std::vector<GlDebugMessage> messages;
+
+    ImGui::Begin("GL Debug");
+
+    if (gl_debug_enabled() == false)
+    {
+        ImGui::Text("No debug context.");
+        ImGui::End();
+        return;
+    }
+
+    const GlDebugStats stats = gl_debug_stats();
+    ImGui::Text("Messages: %llu  Errors: %llu  Dropped: %llu",
+                static_cast<unsigned long long>(stats.messages),
+                static_cast<unsigned long long>(stats.errors),
+                static_cast<unsigned long long>(stats.dropped));
+
+    gl_debug_messages(messages);
+
+    const auto table = [](const char* id, bool performance)
+    {
+        if (ImGui::BeginTable(id, 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg) == false)
+            return;
+
+        ImGui::TableSetupColumn("Count", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Severity", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Message");
+        ImGui::TableHeadersRow();
+
+        for (const GlDebugMessage& message : messages)
+        {
+            if (message.performance != performance)
+                continue;
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(message.count));
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(gl_debug_type_name(message.type));
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(gl_debug_severity_name(message.severity));
+            ImGui::TableNextColumn();
+            ImGui::TextWrapped("%s", message.text);
+        }
+        ImGui::EndTable();
+    };
+
+    char header[64];
+    std::snprintf(header, sizeof(header), "Performance warnings (%llu)###performance",
+                  static_cast<unsigned long long>(stats.performance_warnings));
+    if (ImGui::CollapsingHeader(header, ImGuiTreeNodeFlags_DefaultOpen) == true)
+        table("performance", true);
+
+    if (ImGui::CollapsingHeader("Messages", ImGuiTreeNodeFlags_DefaultOpen) == true)
+        table("messages", false);
+
+    ImGui::End();
+}
+
+/*
+ * Occlusion culling switch, last frame's results and the buffer's far
+ * depth per tile, white near and black far.
+ */
+static void show_occlusion_window(void)
+{
+    ImGui::Begin("Occlusion");
+    ImGui::Checkbox("Cull occluded items", &occlusion_settings.enabled);
+
+    int occluders = static_cast<int>(occlusion_settings.max_occluders);
+    if (ImGui::SliderInt("Occluders", &occluders, 1, 256) == true)
+        occlusion_settings.max_occluders = static_cast<size_t>(occluders);
+
+    if (occlusion_settings.enabled == false || occlusion_tiles_x() == 0)
+    {
+        ImGui::End();
+        return;
+    }
+
+    const OcclusionStats& stats = last_occlusion_stats();
+    ImGui::Text("Occluders: %llu (%llu triangles)",
+                static_cast<unsigned long long>(stats.occluders),
+                static_cast<unsigned long long>(stats.occluder_triangles));
+    ImGui::Text("Tested: %llu  Outside frustum: %llu  Occluded: %llu",
+                static_cast<unsigned long long>(stats.tested),
+                static_cast<unsigned long long>(stats.frustum_culled),
+                static_cast<unsigned long long>(stats.occluded));
+    ImGui::Text("Raster: %.3f ms  Test: %.3f ms", stats.raster_ms, stats.test_ms);
+
+    /*
+     * One cell per tile, in the tiles' 4:1 shape at 1/2 scale.
+     */
+    constexpr float cell_width = occlusion_tile_width * 0.5f;
+    constexpr float cell_height = occlusion_tile_height * 0.5f;
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    for (int y = 0; y < occlusion_tiles_y(); y++)
+    {
+        for (int x = 0; x < occlusion_tiles_x(); x++)
+        {
+            /*
+             * Depth is far from linear; the square root spreads it out.
+             */
+            const float shade = 1.0f - std::sqrt(occlusion_tile_depth(x, y));
+            const ImVec2 min(origin.x + x * cell_width, origin.y + y * cell_height);
+            const ImVec2 max(min.x + cell_width, min.y + cell_height);
+            draw_list->AddRectFilled(min, max, ImGui::GetColorU32(ImVec4(shade, shade, shade, 1.0f)));
+        }
+    }
+    ImGui::Dummy(ImVec2(occlusion_tiles_x() * cell_width, occlusion_tiles_y() * cell_height));
+
+    ImGui::End();
+}
+
+/*
+ * Cascade settings and, per cascade, its range and whether the last frame
+ * rendered or reused it. GPU times lag a few frames behind.
+ */
+static void show_shadows_window(void)
+{
+    ImGui::Begin("Shadows");
+    if (renderer_features().shadows == false)
+    {
+        ImGui::TextDisabled("Shadows need OpenGL 4.2.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Cascaded shadow maps", &shadow_settings.enabled);
+    ImGui::SliderInt("Cascades", &shadow_settings.cascade_count, 1, max_shadow_cascades);
+    ImGui::SliderFloat("Distance", &shadow_settings.max_distance, 5.0f, 100.0f);
+    ImGui::SliderFloat("Split lambda", &shadow_settings.split_lambda, 0.0f, 1.0f);
+    ImGui::SliderInt("First cached", &shadow_settings.first_cached_cascade, 0, max_shadow_cascades);
+    ImGui::SliderInt("Refresh interval", &shadow_settings.refresh_interval, 1, 60);
+
+    int resolution_log2 = static_cast<int>(std::log2(static_cast<float>(shadow_settings.resolution)));
+    if (ImGui::SliderInt("Resolution", &resolution_log2, 9, 12, "%d (log2)") == true)
+        shadow_settings.resolution = 1 << resolution_log2;
+
+    const ShadowStats& stats = last_shadow_stats();
+    if (shadow_settings.enabled == true &&
+        ImGui::BeginTable("Cascades", 6, ImGuiTableFlags_Borders) == true)
+    {
+        ImGui::TableSetupColumn("Range");
+        ImGui::TableSetupColumn("Draws");
+        ImGui::TableSetupColumn("Renders");
+        ImGui::TableSetupColumn("Last frame");
+        ImGui::TableSetupColumn("CPU (ms)");
+        ImGui::TableSetupColumn("GPU (ms)");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < stats.cascade_count; i++)
+        {
+            const CascadeStats& cascade = stats.cascades[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f - %.1f", cascade.start, cascade.end);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(cascade.draw_calls));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(cascade.renders));
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(cascade.rendered == true ? "rendered" : "reused");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", cascade.cpu_ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", cascade.gpu_ms);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+/*
+ * Point light path and, for the deferred one, how many lights the tiles
+ * kept a few frames ago.
+ */
+static void show_lighting_window(void)
+{
+    ImGui::Begin("Lighting");
+
+    /*
+     * Paths the context could not set up are greyed out.
+     */
+    const RendererFeatures& features = renderer_features();
+    const int path = static_cast<int>(lighting_settings.path);
+    const char* const paths[] = { "Single light", "Forward, every light", "Deferred, tiled", "Clustered forward" };
+    const bool available[] = { true, features.point_lights, features.deferred, features.clustered };
+    if (ImGui::BeginCombo("Path", paths[path]) == true)
+    {
+        for (int i = 0; i < IM_ARRAYSIZE(paths); i++)
+        {
+            const ImGuiSelectableFlags flags = available[i] == true ? 0 : ImGuiSelectableFlags_Disabled;
+            if (ImGui::Selectable(paths[i], i == path, flags) == true)
+                lighting_settings.path = static_cast<LightingPath>(i);
+        }
+        ImGui::EndCombo();
+    }
+    if (features.point_lights == false)
+        ImGui::TextDisabled("Point lights need OpenGL 4.3.");
+    ImGui::SliderInt("Lights", &lighting_settings.light_count, 0, max_point_lights);
+    ImGui::SliderFloat("Radius", &lighting_settings.light_radius, 0.5f, 20.0f);
+    ImGui::SliderFloat("Intensity", &lighting_settings.light_intensity, 0.1f, 4.0f);
+
+    if (lighting_settings.path == LightingPath::deferred)
+    {
+        const DeferredStats& stats = last_deferred_stats();
+        const int tiles = stats.tiles_x * stats.tiles_y;
+        ImGui::Text("Tiles: %d x %d", stats.tiles_x, stats.tiles_y);
+        ImGui::Text("Lights per tile: %.1f mean, %u most",
+                    tiles > 0 ? static_cast<double>(stats.light_tile_pairs) / tiles : 0.0,
+                    stats.max_tile_lights);
+        ImGui::Text("Tiles over %d lights: %u", max_lights_per_tile, stats.overflowed_tiles);
+    }
+    else if (lighting_settings.path == LightingPath::clustered)
+    {
+        int assignment = static_cast<int>(lighting_settings.cluster_assignment);
+        const char* const assignments[] = { "GPU compute", "CPU jobs" };
+        if (ImGui::Combo("Assignment", &assignment, assignments, IM_ARRAYSIZE(assignments)) == true)
+            lighting_settings.cluster_assignment = static_cast<ClusterAssignment>(assignment);
+
+        const ClusterStats& stats = last_cluster_stats();
+        ImGui::Text("Clusters: %d x %d x %d", cluster_tiles_x, cluster_tiles_y, cluster_slices);
+        ImGui::Text("Lights per cluster: %.1f mean, %u most",
+                    static_cast<double>(stats.light_cluster_pairs) / cluster_count,
+                    stats.max_cluster_lights);
+        ImGui::Text("Clusters that lost lights: %u", stats.overflowed_clusters);
+        ImGui::Text("Assignment: %.2f ms CPU", stats.cpu_ms);
+    }
+
+    ImGui::End();
+}
+
+/*
+ * Depth before shading, and what it saves.
+ */
+static void show_depth_prepass_window(void)
+{
+    ImGui::Begin("Depth Pre-pass");
+    if (renderer_features().depth_prepass == false)
+    {
+        ImGui::TextDisabled("The depth pre-pass could not be set up.");
+        ImGui::End();
+        return;
+    }
+
+    int mode = static_cast<int>(depth_prepass_settings.mode);
+    const char* const modes[] = { "Off", "On", "Automatic" };
+    if (ImGui::Combo("Mode", &mode, modes, IM_ARRAYSIZE(modes)) == true)
+        depth_prepass_settings.mode = static_cast<DepthPrepassMode>(mode);
+    ImGui::SliderFloat("Overdraw threshold", &depth_prepass_settings.overdraw_threshold, 1.0f, 4.0f);
+    ImGui::Checkbox("Show overdraw", &depth_prepass_settings.show_overdraw);
+
+    const DepthPrepassStats& stats = last_depth_prepass_stats();
+    ImGui::Text("Pre-pass: %s%s", stats.enabled == true ? "on" : "off", stats.measuring == true ? ", measuring" : "");
+    if (stats.measurements > 0)
+        ImGui::Text("Shaded fragments per visible pixel: %.2f", stats.overdraw);
+
+    ImGui::End();
+}
+
+/*
+ * Rounded cubes with levels of detail, and how many items drew each.
+ */
+static void show_lod_window(void)
+{
+    ImGui::Begin("Level of Detail");
+    if (renderer_features().lod == false)
+    {
+        ImGui::TextDisabled("The levels of detail could not be built.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Rounded cubes with LOD", &lod_settings.enabled);
+
+    const std::vector<LodLevel>& levels = lod_levels();
+    ImGui::SliderInt("Forced level", &lod_settings.forced_level, -1, static_cast<int>(levels.size()) - 1);
+    ImGui::SliderFloat("Pixel error", &lod_settings.pixel_error, 0.1f, 8.0f);
+    ImGui::SliderFloat("Hysteresis", &lod_settings.hysteresis, 0.0f, 0.9f);
+
+    if (lod_settings.enabled == true)
+    {
+        const LodStats& stats = last_lod_stats();
+        for (size_t i = 0; i < levels.size(); i++)
+            ImGui::Text("Level %zu: %5d triangles, error %.4f, %llu items", i, levels[i].index_count / 3,
+                        levels[i].error, static_cast<unsigned long long>(stats.items[i]));
+        ImGui::Text("Switched level: %llu", static_cast<unsigned long long>(stats.switches));
+    }
+
+    ImGui::End();
+}
+
+/*
+ * Transparent cubes over the scene, sorted or order independent.
+ */
+static void show_transparency_window(void)
+{
+    ImGui::Begin("Transparency");
+    const RendererFeatures& features = renderer_features();
+    if (features.transparency == false)
+    {
+        ImGui::TextDisabled("Transparent cubes need OpenGL 4.3.");
+        ImGui::End();
+        return;
+    }
+
+    /*
+     * Without weighted blended OIT there is only the sorted mode.
+     */
+    if (features.weighted_oit == true)
+    {
+        int mode = static_cast<int>(transparency_settings.mode);
+        const char* const modes[] = { "Sorted back to front", "Weighted blended OIT" };
+        if (ImGui::Combo("Mode", &mode, modes, IM_ARRAYSIZE(modes)) == true)
+            transparency_settings.mode = static_cast<TransparencyMode>(mode);
+    }
+    ImGui::SliderInt("Cubes", &transparency_settings.object_count, 0, max_transparent_objects);
+    ImGui::SliderFloat("Opacity", &transparency_settings.opacity, 0.05f, 1.0f);
+
+    const TransparencyStats& stats = last_transparency_stats();
+    ImGui::Text("Drawn: %zu, sorting %.2f ms", stats.objects, stats.sort_ms);
+
+    ImGui::End();
+}
+
+/*
+ * CPU path traced preview in place of the raster view. Rays per second
+ * are of the last pass.
+ */
+static void show_path_tracer_window(void)
+{
+    ImGui::Begin("Path Tracer");
+    if (path_tracer_available() == false)
+    {
+        ImGui::TextDisabled("The path tracer could not be set up.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Show path traced preview", &path_tracer_settings.enabled);
+    ImGui::SliderFloat("Resolution", &path_tracer_settings.resolution_scale, 0.125f, 1.0f);
+    ImGui::SliderInt("Bounces", &path_tracer_settings.max_bounces, 0, 8);
+
+    if (path_tracer_settings.enabled == true)
+    {
+        const PathTracerStats& stats = path_tracer_stats();
+        const double rays_per_second = stats.pass_ms > 0.0 ? stats.rays / stats.pass_ms * 1000.0 : 0.0;
+        ImGui::Text("Samples: %llu", static_cast<unsigned long long>(stats.samples));
+        ImGui::Text("Pass: %.1f ms, %.2f Mrays/s", stats.pass_ms, rays_per_second / 1e6);
+        ImGui::Text("Triangles: %zu  BVH nodes: %zu  Update: %.2f ms",
+                    stats.triangles, stats.bvh_nodes, stats.build_ms);
+        ImGui::Text("Instance BVH: %llu builds, %llu refits",
+                    static_cast<unsigned long long>(stats.builds),
+                    static_cast<unsigned long long>(stats.refits));
+        if (ImGui::Button("Restart") == true)
+            restart_path_tracer();
+    }
+
+    ImGui::End();
+}
+
 void render_ImGui(void)
 {
+    CG_PROFILE_SCOPE("render_ImGui");
+
     bool show_demo_window = false;
 
     ImGui_ImplOpenGL3_NewFrame();
@@ -33,11 +773,28 @@ void render_ImGui(void)
         ImGui::ShowDemoWindow(&show_demo_window);
     }
 
+    show_simulation_window();
+    show_jobs_window();
+    show_gpu_profiler_window();
+    show_cpu_profiler_window();
+    show_frame_stats_window();
+    show_gl_counters_window();
+    show_gl_debug_window();
+    show_occlusion_window();
+    show_shadows_window();
+    show_lighting_window();
+    show_transparency_window();
+    show_lod_window();
+    show_depth_prepass_window();
+    show_path_tracer_window();
+
     ImGui::Render();
 }
 
 void display_ImGui(void)
 {
+    CG_PROFILE_SCOPE("display_ImGui");
+    GpuZone zone("ImGui");
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 